@@ -19,6 +19,7 @@ using namespace std;
 #define STR_SIZE 300
 #define ARR_SIZE 20
 #define comm_port 1235 // The port used for the socket connection to the GUI
+#define daemon_port 1236 // The port used by the Backend in daemon mode to receive the requests of the GUI
 
 // Global variable for allowing the backend to work as a server for the GUI
 // The content of this variable is handled by the argument parser
@@ -98,8 +99,46 @@ struct Response_LIST_KEYS : Response_GENERIC
   }
 };
 
+/**
+ * Request struct sent by the GUI to the Backend running in daemon mode.
+ * It contains the same command line that would be used to start the Backend, the daemon answers with the Response Struct of the
+ * requested utility.
+ */
+struct Request_DAEMON
+{
+  char cmd[ARR_SIZE*STR_SIZE]; // The command line (the arguments are separated by spaces, use " " for arguments containing spaces)
+
+  // This method lets cereal know which data members to serialize
+  template<class Archive>
+  void serialize(Archive & archive)
+  {
+    archive( cmd ); // serialize things by passing them to the archive
+  }
+};
+
 int network(int listenPort);
 
+/**
+ * This function creates the socket used to listen for connections of the GUI on the provided listenPort.
+ *
+ * returns: listening socket ID, -1 in case of error
+ */
+int listenForGUI(int listenPort);
+
+/**
+ * This function waits for a connection of the GUI on a socket returned by listenForGUI.
+ *
+ * returns: socket ID, -1 in case of error
+ */
+int acceptGUI(int listenSock);
+
+/**
+ * This function receives a Request Struct sent by the GUI to the Backend running in daemon mode.
+ *
+ * returns: 0 if the request was received, -1 in case of error
+ */
+int receiveRequestFromGUI(int sock, Request_DAEMON& req);
+
 /**
  * This functions closes and cleans the socket connection.
  *
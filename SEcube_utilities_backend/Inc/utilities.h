@@ -22,9 +22,17 @@ using namespace std;
 
 enum Utilities {DEFAULT, ENCRYPTION, DECRYPTION, DIGEST, DEV_LIST, K_LIST, UPDATE_PATH};
 
+// Global variable for allowing the Backend to serve multiple requests of the GUI (daemon mode)
+// When it is true, login(), logout() and the SEkey functions below keep the session and SEkey open between requests
+extern int daemon_on;
+
 // Utilities:
 int login(array<uint8_t, L1Parameters::Size::PIN>, int);
 int logout();
+int close_session(); // Logs out and stops SEkey even in daemon mode. returns: 0 if successful, -1 in case of error
+int reopen_devices(); // Creates l1 again to open the SEcube devices connected now. returns: 0 if successful, -1 in case of error
+int sekey_acquire(); // Starts SEkey, unless it is already running in daemon mode. returns: 0 if successful, the SEkey error otherwise
+void sekey_release(); // Stops SEkey, unless in daemon mode
 
 void print_command_line(); // Prints the helper on the command_line.
 
@@ -3,9 +3,14 @@
  * Contains the main function, that extracts all the input parameters and perform the requested security utility.
  *
  * In case the gui_server flag is provided, all the output messages are forwarded to the GUI via socket.
+ *
+ * In case the daemon flag is provided (Linux only), the Backend keeps running and serves the requests of the GUI received via socket,
+ * keeping the SEcube session and SEkey open between consecutive requests.
  */
 
 #include <thread>
+#include <algorithm>
+#include <cctype>
 #include <fstream>
 #include <iostream>
 #include <unistd.h>
@@ -28,9 +33,36 @@ unique_ptr<L1> l1;
 // The content of this variable is handled by the argument parser
 int gui_server_on = false; // If true the GUI server is on
 
-int main(int argc, char *argv[]) {
-	l0 = make_unique<L0>();
-	l1 = make_unique<L1>();
+// Global variable for allowing the Backend to serve multiple requests of the GUI, see serve_gui_requests()
+int daemon_on = false; // If true the Backend is running in daemon mode
+static int daemon_socket = -1; // In daemon mode, the connection to the GUI of the request being served
+
+/**
+ * Returns the socket used to send the response to the GUI: the connection of the current request in daemon mode,
+ * a new connection otherwise.
+ */
+static int connect_to_gui() {
+	if (daemon_on) {
+		return daemon_socket;
+	}
+	return network(comm_port);
+}
+
+/**
+ * Closes the socket returned by connect_to_gui(). In daemon mode the connection is closed by serve_gui_requests().
+ */
+static void disconnect_from_gui(int sock) {
+	if (!daemon_on) {
+		closeAndCleanConnection(sock);
+	}
+}
+
+/**
+ * Extracts all the input parameters and performs the requested security utility.
+ *
+ * returns: 0 if the utility was successful, -1 in case of error
+ */
+static int run_utility(int argc, char *argv[]) {
 	array<uint8_t, L1Parameters::Size::PIN> new_pin;
 
 	// Parameters, used for all the utilities:
@@ -194,7 +226,7 @@ int main(int argc, char *argv[]) {
 
 			// Connect to the GUI:
 			if(gui_server_on){
-				gui_socket = network(comm_port);
+				gui_socket = connect_to_gui();
 			}
 
 			// Login:
@@ -247,7 +279,7 @@ int main(int argc, char *argv[]) {
 				// Use SEKey to find an usable key for the specified user(s) or group:
 				if (find_key(keyID, user, group)) {
 
-					if(sekey_start(*l0, l1.get()) != 0){ // In case of error starting SEKey:
+					if(sekey_acquire() != 0){ // In case of error starting SEKey:
 						cout << "Error starting SEKey!" << endl;
 
 						// For GUI interfacing:
@@ -259,7 +291,7 @@ int main(int argc, char *argv[]) {
 						return -1;
 					}
 					encryption(gui_socket, path, keyID, alg); // The encryption utility is called with the KeyID obtained using SEKey
-					sekey_stop();
+					sekey_release();
 				}
 				else {
 					cout << "SEKey: No valid key found!" << endl;
@@ -275,7 +307,7 @@ int main(int argc, char *argv[]) {
 
 			// Clean GUI connection:
 			if(gui_server_on){
-				closeAndCleanConnection(gui_socket);
+				disconnect_from_gui(gui_socket);
 			}
 
 			break;
@@ -283,7 +315,7 @@ int main(int argc, char *argv[]) {
 
 			// Connect to the GUI:
 			if(gui_server_on){
-				gui_socket = network(comm_port);
+				gui_socket = connect_to_gui();
 			}
 
 			// Login:
@@ -316,7 +348,7 @@ int main(int argc, char *argv[]) {
 					return -1;
 				}
 
-				if(sekey_start(*l0, l1.get()) != 0){ // In case of error starting SEKey:
+				if(sekey_acquire() != 0){ // In case of error starting SEKey:
 					cout << "Error starting SEKey!" << endl;
 
 					// For GUI interfacing:
@@ -332,13 +364,13 @@ int main(int argc, char *argv[]) {
 			decryption_w_encrypted_filename(gui_socket, path); // The decryption utility is called
 
 			if (decrypt_with_sekey)
-				sekey_stop();
+				sekey_release();
 
 			logout();
 
 			// Clean GUI connection:
 			if(gui_server_on){
-				closeAndCleanConnection(gui_socket);
+				disconnect_from_gui(gui_socket);
 			}
 
 			break;
@@ -346,7 +378,7 @@ int main(int argc, char *argv[]) {
 
 			// Connect to the GUI:
 			if(gui_server_on){
-				gui_socket = network(comm_port);
+				gui_socket = connect_to_gui();
 			}
 
 			// Login:
@@ -402,7 +434,7 @@ int main(int argc, char *argv[]) {
 
 				// Use SEKey to find an usable key for the specified user(s) or group:
 				if (find_key(keyID, user, group)) {
-					if(sekey_start(*l0, l1.get()) != 0){ // In case of error starting SEKey:
+					if(sekey_acquire() != 0){ // In case of error starting SEKey:
 						cout << "Error starting SEKey!" << endl;
 
 						// For GUI interfacing:
@@ -414,7 +446,7 @@ int main(int argc, char *argv[]) {
 						return -1;
 					}
 					digest(gui_socket, path, keyID, alg, usenonce, nonce); // The digest utility is called with the KeyID obtained using SEKey
-					sekey_stop();
+					sekey_release();
 				}
 				else {
 					cout << "SEKey: No valid key found!" << endl;
@@ -430,7 +462,7 @@ int main(int argc, char *argv[]) {
 
 			// Clean GUI connection:
 			if(gui_server_on){
-				closeAndCleanConnection(gui_socket);
+				disconnect_from_gui(gui_socket);
 			}
 
 			break;
@@ -438,14 +470,14 @@ int main(int argc, char *argv[]) {
 
 			// Connect to the GUI:
 			if(gui_server_on){
-				gui_socket = network(comm_port);
+				gui_socket = connect_to_gui();
 			}
 
 			list_devices(gui_socket);
 
 			// Clean GUI connection:
 			if(gui_server_on){
-				closeAndCleanConnection(gui_socket);
+				disconnect_from_gui(gui_socket);
 			}
 
 			break;
@@ -453,7 +485,7 @@ int main(int argc, char *argv[]) {
 
 			// Connect to the GUI:
 			if(gui_server_on){
-				gui_socket = network(comm_port);
+				gui_socket = connect_to_gui();
 			}
 
 			// Login:
@@ -476,7 +508,7 @@ int main(int argc, char *argv[]) {
 
 			// Clean GUI connection:
 			if(gui_server_on){
-				closeAndCleanConnection(gui_socket);
+				disconnect_from_gui(gui_socket);
 			}
 
 			break;
@@ -484,7 +516,7 @@ int main(int argc, char *argv[]) {
 
 			// Connect to the GUI:
 			if(gui_server_on){
-				gui_socket = network(comm_port);
+				gui_socket = connect_to_gui();
 			}
 
 			// Login:
@@ -516,6 +548,11 @@ int main(int argc, char *argv[]) {
 
 			cout << "Path correctly updated!" << endl;
 
+			// SEkey must be restarted to use the new path:
+			if (daemon_on) {
+				close_session();
+			}
+
 			// For GUI interfacing:
 			if(gui_server_on) {
 				Response_GENERIC resp;
@@ -533,3 +570,119 @@ int main(int argc, char *argv[]) {
 
 	return 0;
 }
+
+#ifdef __linux__
+/**
+ * Splits a command line received from the GUI in arguments. Arguments are separated by spaces, the ones containing
+ * spaces must be enclosed in double quotes.
+ */
+static vector<string> split_command(const char* cmd) {
+	vector<string> args;
+	string cur;
+	bool quoted = false, pending = false;
+	for (const char* c = cmd; *c != '\0'; c++) {
+		if (*c == '"') {
+			quoted = !quoted;
+			pending = true;
+		} else if (isspace((unsigned char)*c) && !quoted) {
+			if (pending) {
+				args.push_back(cur);
+			}
+			cur.clear();
+			pending = false;
+		} else {
+			cur += *c;
+			pending = true;
+		}
+	}
+	if (pending) {
+		args.push_back(cur);
+	}
+	return args;
+}
+
+/**
+ * Daemon mode: waits for the requests of the GUI on the provided port and performs them one at a time.
+ * Each request contains a command line, the response of the utility is sent back on the same connection.
+ * The SEcube session and SEkey are kept open while consecutive requests use the same device and pin; after
+ * a failed request they are closed, so the next request starts from scratch.
+ * The request "-quit" stops the daemon.
+ *
+ * returns: 0 when stopped by the GUI, -1 in case of error
+ */
+static int serve_gui_requests(int port) {
+
+	int listen_socket = listenForGUI(port);
+	if (listen_socket < 0) {
+		cout << "Error! Cannot start the daemon! Quit." << endl;
+		return -1;
+	}
+	cout << "[LOG] [Backend] Daemon started on port " << port << "." << endl;
+
+	daemon_on = true;
+	gui_server_on = true;
+	bool quit = false;
+	while (!quit) {
+		int sock = acceptGUI(listen_socket);
+		if (sock < 0) {
+			continue;
+		}
+
+		Request_DAEMON req;
+		if (receiveRequestFromGUI(sock, req) == 0) {
+			vector<string> args = split_command(req.cmd);
+			if (find(args.begin(), args.end(), "-quit") != args.end()) {
+				Response_GENERIC resp;
+				sendErrorToGUI<Response_GENERIC>(sock, resp, 0, "Daemon stopped!");
+				quit = true;
+			} else {
+				// The command line sent by the GUI may start with the name of the Backend, as argv does
+				if (args.empty() || args[0][0] == '-') {
+					args.insert(args.begin(), "secube_cmd.exe");
+				}
+				vector<char*> argv_req;
+				for (string& arg : args) {
+					argv_req.push_back(&arg[0]);
+				}
+				argv_req.push_back(nullptr);
+
+				daemon_socket = sock;
+				int ret;
+				try {
+					ret = run_utility((int)args.size(), argv_req.data());
+				} catch (...) {
+					cout << "Unexpected error! The request was not completed." << endl;
+					ret = -1;
+				}
+				daemon_socket = -1;
+				if (ret != 0) {
+					close_session();
+				}
+			}
+		}
+
+		closeAndCleanConnection(sock);
+	}
+
+	close_session();
+	closeAndCleanConnection(listen_socket);
+	cout << "[LOG] [Backend] Daemon stopped." << endl;
+
+	return 0;
+}
+#endif
+
+int main(int argc, char *argv[]) {
+	l0 = make_unique<L0>();
+	l1 = make_unique<L1>();
+
+#ifdef __linux__
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-daemon") == 0) {
+			return serve_gui_requests(daemon_port);
+		}
+	}
+#endif
+
+	return run_utility(argc, argv);
+}
@@ -11,6 +11,26 @@ int network(int listenPort){
 
 	cout << "[LOG] [Backend] GUI Socket Server started." << endl;
 
+	int s0 = listenForGUI(listenPort);
+	if (s0 < 0) {
+		return -1;
+	}
+
+	int s1 = acceptGUI(s0);
+
+	// Close listening socket
+	close(s0);
+
+	return s1;
+}
+
+/**
+ * This function creates the socket used to listen for connections of the GUI on the provided listenPort.
+ *
+ * returns: listening socket ID, -1 in case of error
+ */
+int listenForGUI(int listenPort){
+
 	// Create a socket:
 	int s0 = socket(AF_INET, SOCK_STREAM, 0);
 	if (s0 < 0) {
@@ -33,6 +53,7 @@ int network(int listenPort){
 	int res = bind(s0, (struct sockaddr*) &address, sizeof(address));
 	if (res < 0) {
 		cout << "[LOG] [Backend] Error binding socket! error number: " << errno << endl;
+		close(s0);
 		return -1;
 	}
 
@@ -40,24 +61,58 @@ int network(int listenPort){
 	res = listen(s0, 1); // "1" is the maximal length of the queue
 	if (res < 0) {
 		cout << "[LOG] [Backend] Error listening!" << endl;
+		close(s0);
 		return -1;
 	}
 
+	return s0;
+}
+
+/**
+ * This function waits for a connection of the GUI on a socket returned by listenForGUI.
+ *
+ * returns: socket ID, -1 in case of error
+ */
+int acceptGUI(int listenSock){
+
 	// Wait for connection
 	cout << "[LOG] [Backend] Waiting for connection..." << endl;
-	int s1 = accept(s0, NULL, NULL);
+	int s1 = accept(listenSock, NULL, NULL);
 	if (s1 < 0) {
 		cout << "[LOG] [Backend] accept failed: %d\n" << errno << endl;
 		return -1;
 	}
 	cout << "[LOG] [Backend] Connected to GUI." << endl;
 
-	// Close listening socket
-	close(s0);
-
 	return s1;
 }
 
+/**
+ * This function receives a Request Struct sent by the GUI to the Backend running in daemon mode.
+ *
+ * returns: 0 if the request was received, -1 in case of error
+ */
+int receiveRequestFromGUI(int sock, Request_DAEMON& req) {
+
+	char request[sizeof(req.cmd)];
+
+	// The serialized Request Struct has a fixed size, wait for all of it:
+	int res = recv(sock, request, sizeof(request), MSG_WAITALL);
+	if (res != (int)sizeof(request)) {
+		cout << "[LOG] [Backend] Error reading request from GUI!" << endl;
+		return -1;
+	}
+
+	// Deserialize the Request using Cereal:
+	std::stringstream ss;
+	ss.write(request, res);
+	cereal::BinaryInputArchive iarchive(ss);
+	iarchive(req); // Read the data from the archive
+	req.cmd[sizeof(req.cmd) - 1] = '\0';
+
+	return 0;
+}
+
 /**
  * This functions closes and cleans the socket connection.
  *
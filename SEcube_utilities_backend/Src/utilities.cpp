@@ -11,6 +11,11 @@
 extern unique_ptr<L0> l0;
 extern unique_ptr<L1> l1;
 
+// Session kept open in daemon mode, used to check if the next request can reuse it:
+static array<uint8_t, L1Parameters::Size::PIN> session_pin;
+static array<uint8_t, L0Communication::Size::SERIAL> session_sn = { 0 }; // serial number of the SEcube, all zeros if no session is open
+static bool sekey_on = false; // true if SEkey has been started with sekey_acquire() and is still running
+
 /**
  * Computes and prints on console the digest of the specified input file using the specified algorithm and keyID
  * algorithms: 0) SHA-256 (no key required) - 1) HMAC-SHA-256 (key required)
@@ -48,23 +53,9 @@ int digest(int sock, string filename, uint32_t keyID, string algo, bool usenonce
 		return -1;
 	}
 
-	char* digest_input;
-	vector<pair<uint32_t, uint16_t>> keys;
-	streampos size; // pointer to a point in the streambuf
-
-	// Get the string from file, to compute digest:
-	ifstream fileP((char*)filename.c_str(), ios::binary|ios::in|ios::ate);
-	if (fileP.is_open()) {
-		char * memblock;
-		size = fileP.tellg();
-		memblock = new char [size];
-		memset(memblock,'\0', size);
-		fileP.seekg (0, ios::beg);
-		fileP.read (memblock, size);
-		fileP.close();
-		digest_input = memblock;
-	}
-	else {
+	// Open the file to compute digest; it is read and sent to the SEcube a piece at a time, so it is never loaded entirely in RAM:
+	ifstream fileP((char*)filename.c_str(), ios::binary|ios::in);
+	if (!fileP.is_open()) {
 		cout << "Error opening file! Quit." << endl;
 
 		// For GUI interfacing:
@@ -75,22 +66,11 @@ int digest(int sock, string filename, uint32_t keyID, string algo, bool usenonce
 		return -1;
 	}
 
-	// Now the file to compute digest is in RAM in variable "digest_input".
-	// Let's calculate the length:
-	int testsize = size;
-
-	//Time to do the digest:
-	shared_ptr<uint8_t[]> input_data(new uint8_t[testsize]); // to be sent to digest API
-	memcpy(input_data.get(), digest_input, testsize);
-
-
-	cout << "Starting digest computation..." << endl;
 	SEcube_digest data_digest;
 	switch(algo_number){
 		case 0: // SHA-256
 			// When using SHA-256, you don't need to set anything else than the algorithm
 			data_digest.algorithm = L1Algorithms::Algorithms::SHA256;
-			l1->L1Digest(testsize, input_data, data_digest);
 			break;
 		case 1: // HMAC-SHA-256
 			/* When using HMAC-SHA-256, we also need to provide other details. this type of digest is
@@ -109,11 +89,7 @@ int digest(int sock, string filename, uint32_t keyID, string algo, bool usenonce
 				data_digest.usenonce = true; //  We want to provide a specific nonce manually
 				data_digest.digest_nonce = nonce;
 			}
-
-			l1->L1Digest(testsize, input_data, data_digest);
-
 			break;
-		// notice that, after calling the L1Digest() function, our digest will be stored inside the Digest object
 		default:
 			cout << "Input error! Quit." << endl;
 
@@ -126,6 +102,44 @@ int digest(int sock, string filename, uint32_t keyID, string algo, bool usenonce
 			return -1;
 	}
 
+	cout << "Starting digest computation..." << endl;
+	vector<uint8_t> file_chunk(1 << 16); // Fixed size read buffer, L1DigestUpdate() groups the data in CRYPTO_UPDATE requests
+	SEcube_digest_context digest_ctx;
+	bool read_error = false;
+	try {
+		l1->L1DigestInit(data_digest, digest_ctx);
+		while (fileP) {
+			fileP.read((char*)file_chunk.data(), file_chunk.size());
+			l1->L1DigestUpdate(digest_ctx, (size_t)fileP.gcount(), file_chunk.data());
+		}
+		read_error = fileP.bad();
+		// notice that, after calling the L1DigestFinal() function, our digest will be stored inside the Digest object
+		// (after a read error it is called only to close the crypto session on the SEcube, and the digest is discarded)
+		l1->L1DigestFinal(digest_ctx, data_digest);
+	} catch (...) {
+		if (!read_error) {
+			cout << "Error computing the digest! Quit." << endl;
+
+			// For GUI interfacing:
+			if(gui_server_on) {
+				sendErrorToGUI<Response_GENERIC>(sock, resp, -1, "Error computing the digest!");
+			}
+
+			return -1;
+		}
+	}
+	fileP.close();
+	if (read_error) {
+		cout << "Error reading file! Quit." << endl;
+
+		// For GUI interfacing:
+		if(gui_server_on) {
+			sendErrorToGUI<Response_GENERIC>(sock, resp, -1, "Error reading file!");
+		}
+
+		return -1;
+	}
+
 	string digest; // String that will store the digest in hex format
 	string nonce_hex; // String that will store the nonce in hex format
 	string nonce_str; // String that will store the nonce in ASCII format
@@ -517,8 +531,8 @@ int login(array<uint8_t, L1Parameters::Size::PIN> pin, int device) {
 		return -1;
 	}
 
+	std::array<uint8_t, L0Communication::Size::SERIAL> sn = { 0 };
 	if ((device >= 0) && (device < numdevices)) {
-		std::array<uint8_t, L0Communication::Size::SERIAL> sn = { 0 };
 		if (devices.at(device).second.length() > L0Communication::Size::SERIAL) {
 			cout << "Unexpected error! Quit." << endl;
 			return -1;
@@ -526,7 +540,29 @@ int login(array<uint8_t, L1Parameters::Size::PIN> pin, int device) {
 			memcpy(sn.data(), devices.at(device).second.data(),
 					devices.at(device).second.length());
 		}
-		l1->L1SelectSEcube(sn);
+	}
+
+	if (daemon_on) {
+		// The session of the previous request is reused if it was opened with the same pin on the same SEcube:
+		if (l1 && l1->L1GetSessionLoggedIn() && (session_sn == sn) && (session_pin == pin)) {
+			cout << "SEcube login OK! (session reused)" << endl;
+			return 0;
+		}
+		close_session();
+		// l1 knows only the SEcube devices connected when it was created, it is created again to see the current ones:
+		if (reopen_devices() != 0) {
+			cout << "Error opening the SEcube devices! Quit." << endl;
+			return -1;
+		}
+	}
+
+	if ((device >= 0) && (device < numdevices)) {
+		try {
+			l1->L1SelectSEcube(sn);
+		} catch (...) {
+			cout << "Error selecting the SEcube device! Quit." << endl;
+			return -1;
+		}
 		cout << "Selected device:" << devices.at(device).first << " - "
 				<< devices.at(device).second << endl;
 
@@ -545,6 +581,8 @@ int login(array<uint8_t, L1Parameters::Size::PIN> pin, int device) {
 			cout << "SEcube login OK!" << endl;
 		}
 
+		session_pin = pin;
+		session_sn = sn;
 	}
 	return 0;
 }
@@ -556,6 +594,10 @@ int login(array<uint8_t, L1Parameters::Size::PIN> pin, int device) {
  */
 int logout() {
 
+	if (daemon_on) { // The session is kept open for the next request
+		return 0;
+	}
+
 	cout << "Logging out..." << endl;
 	try {
 		l1->L1Logout();
@@ -572,6 +614,80 @@ int logout() {
 	return 0;
 }
 
+/**
+ * Stops SEkey (if running) and logs out from the SECube device, also in daemon mode.
+ *
+ * returns: 0 if the logout is successful, -1 in case of error
+ */
+int close_session() {
+
+	if (sekey_on) {
+		sekey_stop();
+		sekey_on = false;
+	}
+	session_sn.fill(0);
+	if (!l1 || !l1->L1GetSessionLoggedIn()) {
+		return 0;
+	}
+
+	int saved_daemon_on = daemon_on;
+	daemon_on = false;
+	int ret = logout();
+	daemon_on = saved_daemon_on;
+
+	return ret;
+}
+
+/**
+ * Creates l1 again, so that it opens the SEcube devices connected now (l1 finds the devices only when it is created).
+ * Used in daemon mode, where devices can be connected or removed between two requests; the session must be closed
+ * with close_session() before.
+ *
+ * returns: 0 if l1 is ready, -1 in case of error (l1 is empty)
+ */
+int reopen_devices() {
+
+	l1.reset(); // The devices are closed (and unlocked) before they are opened again
+	try {
+		l1 = make_unique<L1>();
+	} catch (...) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Starts SEkey on the logged-in SECube device. In daemon mode SEkey is started only once and then kept running,
+ * so that the SEkey database is not opened and checked again for each request.
+ *
+ * returns: 0 if SEkey is running, the SEkey error otherwise
+ */
+int sekey_acquire() {
+
+	if (sekey_on) {
+		return 0;
+	}
+	int ret = sekey_start(*l0, l1.get());
+	sekey_on = (ret == 0);
+
+	return ret;
+}
+
+/**
+ * Stops SEkey previously started with sekey_acquire(). In daemon mode SEkey is kept running (see close_session()).
+ *
+ * returns: void
+ */
+void sekey_release() {
+
+	if (daemon_on || !sekey_on) {
+		return;
+	}
+	sekey_stop();
+	sekey_on = false;
+}
+
 /**
  * Finds a key using SEKey that can be used for the specified users, or group.
  *
@@ -581,7 +697,7 @@ int find_key (uint32_t& keyID, string user, string group){
 	bool keyfound = false;
 	string chosen;
 	sekey_error rc;
-	if(sekey_start(*l0, l1.get()) != 0){
+	if(sekey_acquire() != 0){
 		cout << "Error starting SEkey!" << endl;
 	}
 	if (user.length() > 0){
@@ -628,10 +744,10 @@ int find_key (uint32_t& keyID, string user, string group){
 		key = chosen.substr(1,chosen.length()-1);
 
 		keyID = ((uint32_t)stoul(key));
-		sekey_stop();
+		sekey_release();
 		return 1;
 	} else {
-		sekey_stop();
+		sekey_release();
 		return 0;
 	}
 }
@@ -699,6 +815,9 @@ void print_command_line() {
 	cout << "\t-hmac HMAC-SHA-256 (digest only)" << endl;
     cout << "\t-nonce <nonce> (if specified, the nonce for the HMAC-SHA-256 is set manually - please insert it in hexadecimal notation, with spaces, like \"ab bc 00 12\")" << endl;
     cout << "\t-gui_server (must be specified by the GUI only!)" << endl;
+#ifdef __linux__
+    cout << "\t-daemon keeps running and serves the requests of the GUI, reusing the SEcube session and SEkey (send -quit to stop it)" << endl;
+#endif
 	cout
 			<< "************************************************************************"
 			<< endl;
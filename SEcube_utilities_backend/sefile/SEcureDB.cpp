@@ -92,8 +92,8 @@ uint16_t SEfile::securedb_secure_create(char *path_, std::shared_ptr<SEFILE_HAND
     memcpy(hFile->nonce_ctr, buff->header.nonce_ctr, 16);
     L0Support::Se3Rand(SEFILE_NONCE_LEN, buff->header.nonce_pbkdf2);
     memcpy(hFile->nonce_pbkdf2, buff->header.nonce_pbkdf2, SEFILE_NONCE_LEN);
-    buff->header.uid=0;
-    buff->header.uid_cnt=0;
+    buff->header.sector_size=0;
+    buff->header.length=0;
     buff->header.ver=0;
     buff->header.magic=0;
     buff->header.key_header.key_id = this->EnvKeyID; // assign the required value to the key ID attribute (the encryption key used for this file)
@@ -648,6 +648,7 @@ uint16_t securedb_secure_getfilesize(char *path, uint32_t * position){
 
 uint16_t SEfile::securedb_secure_close(){
     if(this->handleptr == nullptr){ return 0; }
+    this->sector_session_close();
 #if defined(__linux__) || defined(__APPLE__)
 	if(close(this->handleptr->fd) == -1 ){
 		//this->handleptr.reset();
@@ -42,6 +42,215 @@
 
 bool override_key_check = false;
 
+/* a data sector of sector_size bytes is laid out as SEFILE_SECTOR, with the data enlarged to fill it: these functions access the fields after the data */
+static uint16_t get_sector_len(const uint8_t *sector, size_t sector_size){
+	uint16_t len = 0;
+	memcpy(&len, sector + sector_size - SEFILE_SECTOR_OVERHEAD, sizeof(len));
+	return len;
+}
+
+static void set_sector_len(uint8_t *sector, size_t sector_size, uint16_t len){
+	memcpy(sector + sector_size - SEFILE_SECTOR_OVERHEAD, &len, sizeof(len));
+}
+
+static uint8_t* sector_signature(uint8_t *sector, size_t sector_size){
+	return sector + sector_size - B5_SHA256_DIGEST_SIZE;
+}
+
+/* reads from the disk the signature of the last data sector of a file of length valid bytes (zeros if there are no data sectors), without decrypting it;
+ * it fails if the file does not have exactly the sectors needed to hold length bytes */
+static uint16_t read_last_signature(SEFILE_HANDLE *hFile, uint32_t length, uint8_t *signature){
+	const uint32_t logic_data = hFile->sector_size - SEFILE_SECTOR_OVERHEAD;
+	const uint64_t file_size = SEFILE_SECTOR_SIZE + ((uint64_t)length + logic_data - 1) / logic_data * hFile->sector_size;
+	uint8_t tmp[B5_SHA256_DIGEST_SIZE] = { 0 };
+#if defined(__linux__) || defined(__APPLE__)
+	struct stat st;
+	if((fstat(hFile->fd, &st) != 0) || ((uint64_t)st.st_size != file_size)){
+		return SEFILE_FILESIZE_ERROR;
+	}
+	if((length > 0) && (pread(hFile->fd, tmp, B5_SHA256_DIGEST_SIZE, file_size - B5_SHA256_DIGEST_SIZE) != B5_SHA256_DIGEST_SIZE)){
+		return SEFILE_FILESIZE_ERROR;
+	}
+#elif _WIN32
+	LARGE_INTEGER st, pos;
+	DWORD nBytesRead = 0;
+	if(!GetFileSizeEx(hFile->fd, &st) || ((uint64_t)st.QuadPart != file_size)){
+		return SEFILE_FILESIZE_ERROR;
+	}
+	if(length > 0){
+		pos.QuadPart = file_size - B5_SHA256_DIGEST_SIZE;
+		bool ok = SetFilePointerEx(hFile->fd, pos, nullptr, FILE_BEGIN) && ReadFile(hFile->fd, tmp, B5_SHA256_DIGEST_SIZE, &nBytesRead, nullptr) &&
+				(nBytesRead == B5_SHA256_DIGEST_SIZE);
+		SetFilePointer(hFile->fd, hFile->log_offset, nullptr, FILE_BEGIN);
+		if(!ok){
+			return SEFILE_FILESIZE_ERROR;
+		}
+	}
+#endif
+	memcpy(signature, tmp, B5_SHA256_DIGEST_SIZE);
+	return 0;
+}
+
+SEFILE_PIPELINE::SEFILE_PIPELINE(){
+	this->started = false;
+	this->quit = false;
+	this->job = 0;
+	this->busy = 0;
+	this->n_chunks = 0;
+	this->n_stages = 0;
+	memset(this->stages, 0, sizeof(this->stages));
+	memset(this->worker_stage, 0, sizeof(this->worker_stage));
+	memset(this->done, 0, sizeof(this->done));
+	this->ret = 0;
+}
+
+SEFILE_PIPELINE::~SEFILE_PIPELINE(){
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->quit = true;
+	}
+	this->wake.notify_all();
+	for(std::thread& w : this->workers){
+		if(w.joinable()){
+			w.join();
+		}
+	}
+}
+
+bool SEFILE_PIPELINE::start(){
+	if(this->started){
+		return true;
+	}
+	try{
+		for(size_t w = 0; w < 2; w++){
+			this->workers[w] = std::thread(&SEFILE_PIPELINE::worker, this, w);
+		}
+	} catch(const std::system_error&){
+		{
+			std::lock_guard<std::mutex> guard(this->lock);
+			this->quit = true;
+		}
+		this->wake.notify_all();
+		for(std::thread& w : this->workers){
+			if(w.joinable()){
+				w.join();
+			}
+		}
+		this->quit = false; // try again at the next run()
+		return false;
+	}
+	this->started = true;
+	return true;
+}
+
+void SEFILE_PIPELINE::worker(size_t w){
+	uint64_t seen = 0;
+	std::unique_lock<std::mutex> guard(this->lock);
+	for(;;){
+		this->wake.wait(guard, [&]{ return this->quit || (this->job != seen); });
+		if(this->quit){
+			return;
+		}
+		seen = this->job;
+		size_t s = this->worker_stage[w];
+		if(s < this->n_stages){
+			guard.unlock();
+			this->stage(s);
+			guard.lock();
+		}
+		this->busy--;
+		this->progress.notify_all();
+	}
+}
+
+uint16_t SEFILE_PIPELINE::call(size_t s, size_t k){
+	try{
+		return (*this->stages[s])(k);
+	} catch(...){
+		return L1Error::Error::SE3_ERR_ACCESS; // no specific reason to return this error, just return non zero
+	}
+}
+
+void SEFILE_PIPELINE::stage(size_t s){
+	for(size_t k = 0; k < this->n_chunks; k++){
+		{
+			std::unique_lock<std::mutex> guard(this->lock);
+			this->progress.wait(guard, [&]{ return (this->ret != 0) || (((s == 0) || (this->done[s - 1] > k)) &&
+					((s != 0) || (k < this->done[this->n_stages - 1] + SEFILE_PIPELINE_DEPTH))); });
+			if(this->ret != 0){
+				return;
+			}
+		}
+		uint16_t rc = this->call(s, k);
+		{
+			std::lock_guard<std::mutex> guard(this->lock);
+			if((rc != 0) && (this->ret == 0)){
+				this->ret = rc;
+			}
+			this->done[s] = k + 1;
+		}
+		this->progress.notify_all();
+	}
+}
+
+uint16_t SEFILE_PIPELINE::run(size_t n_chunks, const SEFILE_STAGE& read_stage, const SEFILE_STAGE& crypt_stage, const SEFILE_STAGE& write_stage){
+	size_t crypt = 0;
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->n_chunks = n_chunks;
+		this->n_stages = 0;
+		if(read_stage){ this->stages[this->n_stages++] = &read_stage; }
+		crypt = this->n_stages;
+		this->stages[this->n_stages++] = &crypt_stage;
+		if(write_stage){ this->stages[this->n_stages++] = &write_stage; }
+		this->worker_stage[0] = (crypt > 0) ? 0 : this->n_stages;
+		this->worker_stage[1] = (crypt + 1 < this->n_stages) ? crypt + 1 : this->n_stages;
+		memset(this->done, 0, sizeof(this->done));
+		this->ret = 0;
+	}
+	if((n_chunks > 1) && (this->n_stages > 1) && this->start()){
+		{
+			std::lock_guard<std::mutex> guard(this->lock);
+			this->busy = 2;
+			this->job++;
+		}
+		this->wake.notify_all();
+		this->stage(crypt);
+		std::unique_lock<std::mutex> guard(this->lock);
+		this->progress.wait(guard, [&]{ return this->busy == 0; });
+		return this->ret;
+	}
+	for(size_t k = 0; k < n_chunks; k++){ // one stage after the other
+		for(size_t s = 0; s < this->n_stages; s++){
+			uint16_t rc = this->call(s, k);
+			if(rc != 0){
+				return rc;
+			}
+		}
+	}
+	return 0;
+}
+
+SEFILE_SESSION::SEFILE_SESSION(){
+	this->open = false;
+	this->sess_id = 0;
+	this->key_id = 0;
+	this->login_count = 0;
+	memset(this->nonce_pbkdf2, 0, SEFILE_NONCE_LEN);
+}
+
+SEFILE_CACHE::SEFILE_CACHE(){
+	this->sector_size = 0;
+	this->max_sectors = 0;
+	this->first_sector = 0;
+	this->n_sectors = 0;
+}
+
+SEFILE_READ_CACHE::SEFILE_READ_CACHE(){
+	this->sector_size = 0;
+	this->max_sectors = 0;
+}
+
 SEFILE_SECTOR::SEFILE_SECTOR(){
 	/* with this constructor we simply want to initialize to zeros the entire memory used by this structure */
 	this->len = 0;
@@ -59,12 +268,17 @@ SEFILE_HANDLE::SEFILE_HANDLE(){
 	memset(nonce_ctr, 0, 16);
 	memset(nonce_pbkdf2, 0, SEFILE_NONCE_LEN);
 	memset(name, '\0', MAX_PATHNAME);
+	sector_size = SEFILE_SECTOR_SIZE;
+	length = SEFILE_LENGTH_UNKNOWN;
+	changed = 0;
 	/* notice that we do not specify a destructor because we do not really need it. the constructor instead is useful to set initial values for the file descriptors
 	 * and to clear the buffer used to contain the name of the file (if it is a SQLite database file, otherwise it is not used) */
 }
 
 SEfile::SEfile(){
 	this->EnvCrypto = 0;
+	this->EnvBatch = 0;
+	this->ReadAhead = 0;
 	this->EnvKeyID = 0;
 	this->LastDecryptCheckTime = 0;
 	this->LastEncryptCheckTime = 0;
@@ -75,6 +289,8 @@ SEfile::SEfile(){
 
 SEfile::SEfile(L1* secube){
 	this->EnvCrypto = 0;
+	this->EnvBatch = 0;
+	this->ReadAhead = 0;
 	this->EnvKeyID = 0;
 	this->LastDecryptCheckTime = 0;
 	this->LastEncryptCheckTime = 0;
@@ -85,6 +301,8 @@ SEfile::SEfile(L1* secube){
 
 SEfile::SEfile(L1* secube, uint32_t keyID){
 	this->EnvCrypto = 0;
+	this->EnvBatch = 0;
+	this->ReadAhead = 0;
 	this->EnvKeyID = keyID;
 	this->LastDecryptCheckTime = 0;
 	this->LastEncryptCheckTime = 0;
@@ -95,6 +313,8 @@ SEfile::SEfile(L1* secube, uint32_t keyID){
 
 SEfile::SEfile(L1* secube, uint32_t keyID, uint16_t crypto){
 	this->EnvCrypto = crypto;
+	this->EnvBatch = 0;
+	this->ReadAhead = 0;
 	this->EnvKeyID = keyID;
 	this->LastDecryptCheckTime = 0;
 	this->LastEncryptCheckTime = 0;
@@ -258,6 +478,7 @@ uint16_t SEfile::secure_init(L1 *l1ptr, uint32_t keyID, uint16_t crypto){
         }
         if(/*count > 0 &&*/ algTable.size() > crypto && algTable.at(crypto).type == L1Crypto::CryptoTypes::SE3_CRYPTO_TYPE_BLOCKCIPHER_AUTH){
             EnvCrypto = crypto;
+            EnvBatch = sector_batch_size(algTable);
         } else {
         	secure_finit();
         	return SEFILE_ENV_INIT_ERROR;
@@ -270,15 +491,20 @@ uint16_t SEfile::secure_init(L1 *l1ptr, uint32_t keyID, uint16_t crypto){
 }
 
 void SEfile::secure_finit(){
+	this->sector_session_close();
 	this->EnvCrypto = 0;
+	this->EnvBatch = 0;
 	this->EnvKeyID = 0;
     this->l1 = nullptr;
 }
 
-uint16_t SEfile::secure_open(char *path, int32_t mode, int32_t creation){
+uint16_t SEfile::secure_open(char *path, int32_t mode, int32_t creation, uint32_t sector_size){
     if((path == nullptr) || (this->l1 == nullptr)){
     	return SEFILE_OPEN_ERROR;
     }
+    this->sector_cache_flush(true); // sectors of the file opened before, if any
+    this->ReadCache = SEFILE_READ_CACHE();
+    this->Header = SEFILE_SECTOR();
 	uint16_t commandError=0;
     char enc_filename[MAX_PATHNAME];
     uint16_t lenc=0;
@@ -290,6 +516,7 @@ uint16_t SEfile::secure_open(char *path, int32_t mode, int32_t creation){
 	#endif
     memset(enc_filename, 0, MAX_PATHNAME*sizeof(char));
     if(creation==(SEFILE_NEWFILE)){ // in this case the file must be created
+    	hTmp->sector_size = sector_size;
     	if((commandError = this->secure_create(path, hTmp, mode))!=0){
         	this->handleptr = std::move(hTmp);
         	this->secure_close();
@@ -355,6 +582,29 @@ uint16_t SEfile::secure_open(char *path, int32_t mode, int32_t creation){
     	this->secure_close();
     	return SEFILE_OPEN_ERROR;
     }
+    if (memcmp(buffEnc.signature, buffDec.signature, B5_SHA256_DIGEST_SIZE)){ // the header tells how the data sectors are laid out, check it
+    	this->handleptr = std::move(hTmp);
+    	this->secure_close();
+    	return SEFILE_SIGNATURE_MISMATCH;
+    }
+    if((buffDec.header.ver == SEFILE_VERSION_SECTOR_SIZE) || (buffDec.header.ver == SEFILE_VERSION_FILE_LENGTH)){
+    	hTmp->sector_size = buffDec.header.sector_size;
+    }
+    if((buffDec.header.ver < 0) || (buffDec.header.ver > SEFILE_VERSION_FILE_LENGTH) || !valid_sector_size(hTmp->sector_size)){ // written by a newer version of SEfile
+    	this->handleptr = std::move(hTmp);
+    	this->secure_close();
+    	return SEFILE_OPEN_ERROR;
+    }
+    if((buffDec.header.ver == SEFILE_VERSION_FILE_LENGTH) && (buffDec.header.length != SEFILE_LENGTH_UNKNOWN)){
+    	/* the length in the header is used only if the file has the sectors needed to hold it and the last one is still the sector the header was written with,
+    	 * otherwise (i.e. the file was changed by a release that does not update the length) it is computed from the last sector */
+    	uint8_t signature[B5_SHA256_DIGEST_SIZE];
+    	if((read_last_signature(hTmp.get(), buffDec.header.length, signature) == 0) &&
+    			(memcmp(signature, buffDec.data + SEFILE_HEADER_LAST_SIGNATURE, B5_SHA256_DIGEST_SIZE) == 0)){
+    		hTmp->length = buffDec.header.length;
+    	}
+    }
+    this->Header = buffDec;
     memcpy(hTmp->nonce_ctr, buffDec.header.nonce_ctr, 16);
     memcpy(hTmp->nonce_pbkdf2, buffDec.header.nonce_pbkdf2, SEFILE_NONCE_LEN);
     this->handleptr = std::move(hTmp);
@@ -365,7 +615,7 @@ uint16_t SEfile::secure_open(char *path, int32_t mode, int32_t creation){
 }
 
 uint16_t SEfile::secure_create(char *path, std::shared_ptr<SEFILE_HANDLE> hFile, int mode){
-    if((path == nullptr) || (hFile == nullptr) || (this->l1 == nullptr) || (this->EnvKeyID == 0) || (this->EnvCrypto != L1Algorithms::Algorithms::AES_HMACSHA256)){
+    if((path == nullptr) || (hFile == nullptr) || !valid_sector_size(hFile->sector_size) || (this->l1 == nullptr) || (this->EnvKeyID == 0) || (this->EnvCrypto != L1Algorithms::Algorithms::AES_HMACSHA256)){
     	return SEFILE_CREATE_ERROR;
     }
     uint16_t rc = this->secure_key_check(CryptoInitialisation::Direction::ENCRYPT); // check if the key is valid
@@ -411,9 +661,9 @@ uint16_t SEfile::secure_create(char *path, std::shared_ptr<SEFILE_HANDLE> hFile,
     memcpy(hFile->nonce_ctr, buff->header.nonce_ctr, 16);
     L0Support::Se3Rand(SEFILE_NONCE_LEN, buff->header.nonce_pbkdf2);
     memcpy(hFile->nonce_pbkdf2, buff->header.nonce_pbkdf2, SEFILE_NONCE_LEN);
-    buff->header.uid=0;
-    buff->header.uid_cnt=0;
-    buff->header.ver=0;
+    buff->header.sector_size=hFile->sector_size;
+    buff->header.ver=SEFILE_VERSION_FILE_LENGTH;
+    buff->header.length=0;
     buff->header.magic=0;
     buff->header.key_header.key_id = this->EnvKeyID; // assign the required value to the key ID attribute (the encryption key used for this file)
     buff->header.key_header.algorithm = this->EnvCrypto;
@@ -440,6 +690,7 @@ uint16_t SEfile::secure_create(char *path, std::shared_ptr<SEFILE_HANDLE> hFile,
     padding_ptr = (buff->data + sizeof(SEFILE_HEADER) + buff->header.fname_len);
     random_padding = (buff->data+SEFILE_LOGIC_DATA) - padding_ptr;
     L0Support::Se3Rand(random_padding, padding_ptr);
+    memset(buff->data + SEFILE_HEADER_LAST_SIGNATURE, 0, B5_SHA256_DIGEST_SIZE); // no data sectors yet
     if (this->crypt_header(buff.get(), buffEnc.get(), SEFILE_SECTOR_DATA_SIZE, CryptoInitialisation::Direction::ENCRYPT)){
     	return SEFILE_CREATE_ERROR;
     }
@@ -459,6 +710,8 @@ uint16_t SEfile::secure_create(char *path, std::shared_ptr<SEFILE_HANDLE> hFile,
 #elif _WIN32
     hFile->log_offset = SetFilePointer(hFile->fd, 0, nullptr, FILE_CURRENT);
 #endif
+    hFile->length = 0;
+    this->Header = *buff;
     if(commandError == 0){
     	this->IsOpen = true;
     }
@@ -474,116 +727,230 @@ uint16_t SEfile::secure_write(uint8_t * dataIn, uint32_t dataIn_len){
     if(rc){ return rc; } // return if the key is not valid
 	std::shared_ptr<SEFILE_HANDLE> hTmp = this->handleptr;
     int32_t absOffset=0, sectOffset=0;
-    std::unique_ptr<SEFILE_SECTOR> cryptBuff = std::make_unique<SEFILE_SECTOR>();
-    std::unique_ptr<SEFILE_SECTOR> decryptBuff = std::make_unique<SEFILE_SECTOR>();
+    const int32_t sector_size = hTmp->sector_size, logic_data = sector_size - SEFILE_SECTOR_OVERHEAD;
+    uint8_t *sector = nullptr;
+    uint16_t sector_len = 0;
     int length = 0;
-    size_t current_position = SEFILE_SECTOR_SIZE;
-    size_t random_padding = 0;
-    uint8_t *padding_ptr = nullptr;
-#if defined(__linux__) || defined(__APPLE__)
-    int nBytesRead=0;
-#elif _WIN32
-    DWORD nBytesWritten=0, nBytesRead=0;
-#endif
-    if((cryptBuff == nullptr) || (decryptBuff == nullptr)){
-        return SEFILE_WRITE_ERROR;
-    }
+    size_t sector_index = 0;
     //    if (secure_sync(hFile)){
     //        return SEFILE_WRITE_ERROR;
     //    }
-    //move the pointer to the begin of the sector
 #if defined(__linux__) || defined(__APPLE__)
     if((absOffset=lseek(hTmp->fd, 0, SEEK_CUR))<0 || absOffset!=hTmp->log_offset){
         return SEFILE_WRITE_ERROR;
     }
-    current_position = lseek(hTmp->fd,((int32_t)(absOffset/SEFILE_SECTOR_SIZE))*SEFILE_SECTOR_SIZE, SEEK_SET);
 #elif _WIN32
     if((absOffset=SetFilePointer(hTmp->fd, 0, nullptr, FILE_CURRENT))<0 || ((uint32_t)absOffset)!=hTmp->log_offset){
         return SEFILE_WRITE_ERROR;
     }
-    current_position = SetFilePointer(hTmp->fd,((int32_t)(absOffset/SEFILE_SECTOR_SIZE))*SEFILE_SECTOR_SIZE, nullptr, FILE_BEGIN);
-#endif
-    //save the relative position inside the sector
-    sectOffset = absOffset % SEFILE_SECTOR_SIZE;
-    //read the whole sector and move back the pointer
-#if defined(__linux__) || defined(__APPLE__)
-    nBytesRead=read(hTmp->fd, cryptBuff.get(), SEFILE_SECTOR_SIZE);
-#elif _WIN32
-    ReadFile(hTmp->fd, cryptBuff.get(), SEFILE_SECTOR_SIZE, &nBytesRead, nullptr);
 #endif
-    if(nBytesRead>0){
-        if (this->decrypt_sectors(cryptBuff.get(), decryptBuff.get(), SEFILE_SECTOR_DATA_SIZE, pos_to_cipher_block(current_position), hTmp->nonce_ctr, hTmp->nonce_pbkdf2)){
-            return SEFILE_WRITE_ERROR;
-        }
-        //sector integrity check
-        if (memcmp(cryptBuff->signature, decryptBuff->signature, B5_SHA256_DIGEST_SIZE)){
-            return SEFILE_SIGNATURE_MISMATCH;
-        }
-		#if defined(__linux__) || defined(__APPLE__)
-		lseek(hTmp->fd, (-1)*SEFILE_SECTOR_SIZE, SEEK_CUR);
-		#elif _WIN32
-		SetFilePointer(hTmp->fd, (-1)*SEFILE_SECTOR_SIZE, nullptr, FILE_CURRENT);
-		#endif
-    }else{
-        //sector empty
-        decryptBuff->len=0;
-    }
+    //index of the sector (the data sectors follow the header sector) and relative position inside it
+    sector_index = (absOffset - SEFILE_SECTOR_SIZE) / sector_size;
+    sectOffset = (absOffset - SEFILE_SECTOR_SIZE) % sector_size;
     do{
         //fill the sector with input data until datain are over or the sector is full
-        //length = dataIn_len < (SEFILE_LOGIC_DATA-sectOffset) ? dataIn_len : SEFILE_LOGIC_DATA-sectOffset;
-        if(dataIn_len < (SEFILE_LOGIC_DATA-sectOffset)){
+        //length = dataIn_len < (logic_data-sectOffset) ? dataIn_len : logic_data-sectOffset;
+        if(dataIn_len < (uint32_t)(logic_data-sectOffset)){
         	length = dataIn_len;
         } else {
-        	length = (SEFILE_LOGIC_DATA-sectOffset);
+        	length = (logic_data-sectOffset);
         }
-        memcpy(decryptBuff->data+sectOffset, dataIn, length);
-        //update sector data length if needed
-        if( (length + (sectOffset)) > decryptBuff->len){
-            decryptBuff->len = length + sectOffset;
-        }
-        /*Padding must be random! (known plaintext attack)*/
-        padding_ptr = decryptBuff->data + decryptBuff->len;
-        random_padding = decryptBuff->data + SEFILE_LOGIC_DATA - padding_ptr;
-        L0Support::Se3Rand(random_padding, padding_ptr);
-        //encrypt sector
-        if (this->crypt_sectors(decryptBuff.get(), cryptBuff.get(), SEFILE_SECTOR_DATA_SIZE, pos_to_cipher_block(current_position), hTmp->nonce_ctr, hTmp->nonce_pbkdf2)){
-            return SEFILE_WRITE_ERROR;
-        }
-        /* writeback sector into file phase start */
-		#if defined(__linux__) || defined (__APPLE__)
-        if(write(hTmp->fd, cryptBuff.get(), SEFILE_SECTOR_SIZE) != SEFILE_SECTOR_SIZE){
-            return SEFILE_WRITE_ERROR;
+        //the sector is read from the file only if the data do not overwrite all of it
+        if((sector = this->sector_cache_get(sector_index, (sectOffset == 0) && (length == logic_data), &rc)) == nullptr){
+            return rc;
         }
-		#elif _WIN32
-        if (WriteFile(hTmp->fd, cryptBuff.get(), SEFILE_SECTOR_SIZE, &nBytesWritten, nullptr) == FALSE){
-            return SEFILE_WRITE_ERROR;
-        }
-        if(nBytesWritten != (DWORD) SEFILE_SECTOR_SIZE){
-            return SEFILE_WRITE_ERROR;
+        sector_len = get_sector_len(sector, sector_size);
+        memcpy(sector+sectOffset, dataIn, length);
+        //update sector data length if needed
+        if( (length + (sectOffset)) > sector_len){
+            sector_len = length + sectOffset;
+            set_sector_len(sector, sector_size, sector_len);
         }
-		#endif
-        /* writeback sector into file phase end */
-        current_position += SEFILE_SECTOR_SIZE;
+        this->WriteCache.dirty[sector_index - this->WriteCache.first_sector] = true;
         dataIn_len-=length;
         dataIn+=length;
-        sectOffset = (sectOffset+length)%(SEFILE_LOGIC_DATA);
-        decryptBuff->len=0;
+        sectOffset = (sectOffset+length)%(logic_data);
+        if(sectOffset == 0){
+            sector_index++;
+        }
     } while(dataIn_len>0); //cycles unless all dataIn are processed
-    //move the pointer inside the last sector written
-    if(sectOffset!=0){
+    if((hTmp->length != SEFILE_LENGTH_UNKNOWN) && (sector_index * logic_data + sectOffset > hTmp->length)){ // the file grew
+        hTmp->length = sector_index * logic_data + sectOffset;
+    }
+    //move the pointer inside the last sector written, even if the sector is not in the file yet
 #if defined(__linux__) || defined(__APPLE__)
-        hTmp->log_offset=lseek(hTmp->fd, (sectOffset - SEFILE_SECTOR_SIZE), SEEK_CUR);
+    hTmp->log_offset=lseek(hTmp->fd, SEFILE_SECTOR_SIZE + sector_index * sector_size + sectOffset, SEEK_SET);
 #elif _WIN32
-        hTmp->log_offset = SetFilePointer(hTmp->fd, (LONG)(sectOffset - SEFILE_SECTOR_SIZE), nullptr, FILE_CURRENT);
+    hTmp->log_offset=SetFilePointer(hTmp->fd, (LONG)(SEFILE_SECTOR_SIZE + sector_index * sector_size + sectOffset), nullptr, FILE_BEGIN);
 #endif
-    }else{
+    return 0;
+}
+
+uint8_t* SEfile::sector_cache_get(size_t sector_index, bool overwrite, uint16_t *ret){
+	SEFILE_CACHE *cache = &this->WriteCache;
+	std::shared_ptr<SEFILE_HANDLE> hTmp = this->handleptr;
+	const size_t sector_size = hTmp->sector_size;
+	uint8_t *sector = nullptr;
 #if defined(__linux__) || defined(__APPLE__)
-        hTmp->log_offset=lseek(hTmp->fd, 0, SEEK_CUR);
+	ssize_t nBytesRead=0;
 #elif _WIN32
-        hTmp->log_offset=SetFilePointer(hTmp->fd, 0, nullptr, FILE_CURRENT);
+	DWORD nBytesRead=0;
 #endif
-    }
-    return 0;
+	*ret = 0;
+	if((cache->sectors == nullptr) || (cache->sector_size != sector_size)){ // first write since the file was opened
+		if((*ret = this->sector_cache_flush(true)) != 0){
+			return nullptr;
+		}
+		cache->sector_size = sector_size;
+		cache->max_sectors = (SEFILE_WRITE_CACHE_SIZE >= sector_size) ? (SEFILE_WRITE_CACHE_SIZE / sector_size) : 1;
+		cache->sectors = std::make_unique<uint8_t[]>(cache->max_sectors * sector_size);
+		cache->dirty.assign(cache->max_sectors, false);
+		if(cache->sectors == nullptr){
+			*ret = SEFILE_WRITE_ERROR;
+			return nullptr;
+		}
+	}
+	if((sector_index >= cache->first_sector) && (sector_index < cache->first_sector + cache->n_sectors)){ // already cached
+		return cache->sectors.get() + (sector_index - cache->first_sector) * sector_size;
+	}
+	if((cache->n_sectors > 0) && ((sector_index != cache->first_sector + cache->n_sectors) || (cache->n_sectors == cache->max_sectors))){
+		if((*ret = this->sector_cache_flush(false)) != 0){ // the sector does not follow the ones cached, start again from it
+			return nullptr;
+		}
+		cache->n_sectors = 0;
+	}
+	if(cache->n_sectors == 0){
+		cache->first_sector = sector_index;
+	}
+	sector = cache->sectors.get() + cache->n_sectors * sector_size;
+	uint8_t *cached = overwrite ? nullptr : this->sector_lru_get(sector_index);
+	if(overwrite){
+		set_sector_len(sector, sector_size, 0);
+	}else if(cached != nullptr){ // decrypted by secure_read()
+		memcpy(sector, cached, sector_size);
+	}else{
+		std::unique_ptr<uint8_t[]> cryptBuff = std::make_unique<uint8_t[]>(sector_size);
+		if(cryptBuff == nullptr){
+			*ret = SEFILE_WRITE_ERROR;
+			return nullptr;
+		}
+		//read the whole sector
+#if defined(__linux__) || defined(__APPLE__)
+		if(lseek(hTmp->fd, SEFILE_SECTOR_SIZE + sector_index * sector_size, SEEK_SET) < 0){
+			*ret = SEFILE_WRITE_ERROR;
+			return nullptr;
+		}
+		nBytesRead=read(hTmp->fd, cryptBuff.get(), sector_size);
+		lseek(hTmp->fd, hTmp->log_offset, SEEK_SET);
+#elif _WIN32
+		if(SetFilePointer(hTmp->fd, (LONG)(SEFILE_SECTOR_SIZE + sector_index * sector_size), nullptr, FILE_BEGIN) == INVALID_SET_FILE_POINTER){
+			*ret = SEFILE_WRITE_ERROR;
+			return nullptr;
+		}
+		if(ReadFile(hTmp->fd, cryptBuff.get(), (DWORD)sector_size, &nBytesRead, nullptr) == FALSE){
+			nBytesRead = 0;
+		}
+		SetFilePointer(hTmp->fd, hTmp->log_offset, nullptr, FILE_BEGIN);
+#endif
+		if(nBytesRead>0){
+			if (this->decrypt_sectors(cryptBuff.get(), sector, sector_size - B5_SHA256_DIGEST_SIZE, pos_to_cipher_block(SEFILE_SECTOR_SIZE + sector_index * sector_size, sector_size), hTmp->nonce_ctr, hTmp->nonce_pbkdf2)){
+				*ret = SEFILE_WRITE_ERROR;
+				return nullptr;
+			}
+			//sector integrity check
+			if (memcmp(sector_signature(cryptBuff.get(), sector_size), sector_signature(sector, sector_size), B5_SHA256_DIGEST_SIZE)){
+				*ret = SEFILE_SIGNATURE_MISMATCH;
+				return nullptr;
+			}
+		}else{
+			//sector beyond the end of the file
+			set_sector_len(sector, sector_size, 0);
+		}
+	}
+	cache->dirty[cache->n_sectors] = false;
+	cache->n_sectors++;
+	return sector;
+}
+
+uint16_t SEfile::sector_cache_flush(bool release){
+	SEFILE_CACHE *cache = &this->WriteCache;
+	std::shared_ptr<SEFILE_HANDLE> hTmp = this->handleptr;
+	const size_t sector_size = cache->sector_size;
+	const size_t logic_data = sector_size - SEFILE_SECTOR_OVERHEAD;
+	std::unique_ptr<uint8_t[]> cryptBuff;
+	uint16_t ret = 0;
+	size_t first = 0, last = 0;
+	for(first = 0; (hTmp != nullptr) && (ret == 0) && (first < cache->n_sectors); first = last){
+		if(!cache->dirty[first]){
+			last = first + 1;
+			continue;
+		}
+		for(last = first; (last < cache->n_sectors) && cache->dirty[last]; last++){
+			/*Padding must be random! (known plaintext attack)*/
+			uint8_t *sector = cache->sectors.get() + last * sector_size;
+			uint16_t sector_len = get_sector_len(sector, sector_size);
+			L0Support::Se3Rand(logic_data - sector_len, sector + sector_len);
+		}
+		if((ret = this->header_length_update(SEFILE_LENGTH_UNKNOWN)) != 0){ // the file is going to change
+			break;
+		}
+		//encrypt the consecutive sectors changed a chunk at a time, each chunk is written while the SEcube encrypts the next one
+		const size_t position = SEFILE_SECTOR_SIZE + (cache->first_sector + first) * sector_size;
+		const size_t chunk = sectors_per_batch(sector_size), n_sectors = last - first, n_chunks = (n_sectors + chunk - 1) / chunk;
+		if(cryptBuff == nullptr){
+			cryptBuff = std::make_unique<uint8_t[]>(cache->n_sectors * sector_size);
+			if(cryptBuff == nullptr){
+				ret = SEFILE_WRITE_ERROR;
+				break;
+			}
+		}
+		auto encrypt_chunk = [&](size_t k) -> uint16_t {
+			size_t count = ((k + 1) * chunk < n_sectors) ? chunk : (n_sectors - k * chunk);
+			if(this->crypt_sector_batch(cache->sectors.get() + (first + k * chunk) * sector_size, cryptBuff.get() + k * chunk * sector_size, count, sector_size,
+					pos_to_cipher_block(position + k * chunk * sector_size, sector_size), hTmp->nonce_ctr, hTmp->nonce_pbkdf2, CryptoInitialisation::Direction::ENCRYPT)){
+				return SEFILE_WRITE_ERROR;
+			}
+			return 0;
+		};
+		auto write_chunk = [&](size_t k) -> uint16_t {
+			size_t len = (((k + 1) * chunk < n_sectors) ? chunk : (n_sectors - k * chunk)) * sector_size;
+#if defined(__linux__) || defined (__APPLE__)
+			if(pwrite(hTmp->fd, cryptBuff.get() + k * chunk * sector_size, len, position + k * chunk * sector_size) != (ssize_t)len){
+				return SEFILE_WRITE_ERROR;
+			}
+#elif _WIN32
+			DWORD nBytesWritten = 0;
+			if((SetFilePointer(hTmp->fd, (LONG)(position + k * chunk * sector_size), nullptr, FILE_BEGIN) == INVALID_SET_FILE_POINTER) ||
+					(WriteFile(hTmp->fd, cryptBuff.get() + k * chunk * sector_size, (DWORD)len, &nBytesWritten, nullptr) == FALSE) || (nBytesWritten != (DWORD)len)){
+				return SEFILE_WRITE_ERROR;
+			}
+#endif
+			return 0;
+		};
+		if(this->Pipeline.run(n_chunks, SEFILE_STAGE(), encrypt_chunk, write_chunk)){
+			ret = SEFILE_WRITE_ERROR;
+		}
+		for(size_t i = first; (ret == 0) && (i < last); i++){
+			cache->dirty[i] = false;
+		}
+		this->sector_lru_drop(cache->first_sector + first, last - first); // changed in the file, even if the write failed
+	}
+	if((hTmp != nullptr) && (cryptBuff != nullptr)){ // restore the file pointer
+#if defined(__linux__) || defined (__APPLE__)
+		lseek(hTmp->fd, hTmp->log_offset, SEEK_SET);
+#elif _WIN32
+		SetFilePointer(hTmp->fd, hTmp->log_offset, nullptr, FILE_BEGIN);
+#endif
+	}
+	if(release){
+		cache->sectors.reset();
+		cache->dirty.clear();
+		cache->sector_size = 0;
+		cache->max_sectors = 0;
+		cache->first_sector = 0;
+		cache->n_sectors = 0;
+	}
+	return ret;
 }
 
 uint16_t SEfile::secure_read(uint8_t * dataOut, uint32_t dataOut_len, uint32_t *bytesRead){
@@ -593,87 +960,193 @@ uint16_t SEfile::secure_read(uint8_t * dataOut, uint32_t dataOut_len, uint32_t *
     if (dataOut_len == 0){ return 0; }
     uint16_t rc = this->secure_key_check(CryptoInitialisation::Direction::DECRYPT); // check if the key is valid
     if(rc){ return rc; } // return if the key is not valid
+    if(this->sector_cache_flush(false)){ // the sectors to read may still be in the cache
+        return SEFILE_READ_ERROR;
+    }
 	std::shared_ptr<SEFILE_HANDLE> hTmp = this->handleptr;
     int32_t absOffset=0, sectOffset=0;
     uint32_t dataRead=0;
-    std::unique_ptr<SEFILE_SECTOR> cryptBuff = std::make_unique<SEFILE_SECTOR>();
-    std::unique_ptr<SEFILE_SECTOR> decryptBuff = std::make_unique<SEFILE_SECTOR>();
+    const int32_t sector_size = hTmp->sector_size, logic_data = sector_size - SEFILE_SECTOR_OVERHEAD;
+    const size_t read_ahead = (this->ReadAhead > 0) ? this->ReadAhead : ((SEFILE_READ_AHEAD_SIZE > sector_size) ? (SEFILE_READ_AHEAD_SIZE / sector_size) : 1);
+    std::unique_ptr<uint8_t[]> cryptBuff, decryptBuff;
+    uint8_t *sector = nullptr;
     int length = 0;
-    size_t current_position = SEFILE_SECTOR_SIZE;
+    size_t sector_index = 0, n_sectors = 0;
     int32_t data_remaining = 0;
     *bytesRead = 0; // no bytes read yet
 #if defined(__linux__) || defined(__APPLE__)
-    int nBytesRead=0;
+    ssize_t nBytesRead=0;
 #elif _WIN32
     DWORD nBytesRead=0;
 #endif
-    if(cryptBuff==nullptr || decryptBuff==nullptr){
-        return SEFILE_READ_ERROR;
-    }
     //    if (secure_sync(hFile)){
     //        return SEFILE_WRITE_ERROR;
     //    }
-    //move the pointer to the begin of the sector
 #if defined(__linux__) || defined(__APPLE__)
     if((absOffset=lseek(hTmp->fd, 0, SEEK_CUR))<0 || absOffset!=hTmp->log_offset){
         return SEFILE_READ_ERROR;
     }
-    current_position = lseek(hTmp->fd,((int32_t)(absOffset/SEFILE_SECTOR_SIZE))*SEFILE_SECTOR_SIZE, SEEK_SET);
 #elif _WIN32
     if((absOffset=SetFilePointer(hTmp->fd, 0, nullptr, FILE_CURRENT))<0 || ((uint32_t)absOffset) !=hTmp->log_offset){
         return SEFILE_READ_ERROR;
     }
-    current_position = SetFilePointer(hTmp->fd, ((int32_t)(absOffset / SEFILE_SECTOR_SIZE))*SEFILE_SECTOR_SIZE, nullptr, FILE_BEGIN);
 #endif
-    //save the relative position inside the sector
-    sectOffset=absOffset%SEFILE_SECTOR_SIZE;
+    if((this->ReadCache.sector_size != (size_t)sector_size) || (this->ReadCache.max_sectors < read_ahead)){ // first read since the file was opened
+        size_t max_sectors = (SEFILE_READ_CACHE_SIZE > sector_size) ? (SEFILE_READ_CACHE_SIZE / sector_size) : 1;
+        this->ReadCache = SEFILE_READ_CACHE();
+        this->ReadCache.max_sectors = (max_sectors > read_ahead) ? max_sectors : read_ahead;
+        this->ReadCache.sector_size = sector_size;
+        this->ReadCache.sectors = std::make_unique<uint8_t[]>(this->ReadCache.max_sectors * sector_size);
+        for(size_t i = 0; (this->ReadCache.sectors != nullptr) && (i < this->ReadCache.max_sectors); i++){
+            this->ReadCache.free_slots.push_back(this->ReadCache.sectors.get() + i * sector_size);
+        }
+    }
+    if(this->ReadCache.sectors == nullptr){
+        return SEFILE_READ_ERROR;
+    }
+    //index of the sector (the data sectors follow the header sector) and relative position inside it
+    sector_index = (absOffset - SEFILE_SECTOR_SIZE) / sector_size;
+    sectOffset = (absOffset - SEFILE_SECTOR_SIZE) % sector_size;
     do{
-        //read the whole sector
+        if((sector = this->sector_lru_get(sector_index)) == nullptr){
+            //read the sector with the following ones, the sectors needed to return dataOut_len bytes if they are more than read_ahead
+            n_sectors = (sectOffset + dataOut_len + logic_data - 1) / logic_data;
+            if(n_sectors < read_ahead){
+                n_sectors = read_ahead;
+            }
+            if(n_sectors > this->ReadCache.max_sectors){
+                n_sectors = this->ReadCache.max_sectors;
+            }
+            for(size_t i = 1; i < n_sectors; i++){ // no need to decrypt again the sectors cached
+                if(this->sector_lru_get(sector_index + i) != nullptr){
+                    n_sectors = i;
+                }
+            }
+            if((cryptBuff == nullptr) || (decryptBuff == nullptr)){
+                cryptBuff = std::make_unique<uint8_t[]>(this->ReadCache.max_sectors * sector_size);
+                decryptBuff = std::make_unique<uint8_t[]>(this->ReadCache.max_sectors * sector_size);
+                if(cryptBuff==nullptr || decryptBuff==nullptr){
+                    return SEFILE_READ_ERROR;
+                }
+            }
+            //read the sectors a chunk at a time, the SEcube decrypts a chunk while the next ones are read
+            const size_t chunk = sectors_per_batch(sector_size), n_chunks = (n_sectors + chunk - 1) / chunk;
+            const size_t position = SEFILE_SECTOR_SIZE + sector_index * sector_size;
+            std::vector<size_t> chunk_bytes(n_chunks, 0);
+            auto read_chunk = [&](size_t k) -> uint16_t {
+                size_t len = (((k + 1) * chunk < n_sectors) ? chunk : (n_sectors - k * chunk)) * sector_size;
 #if defined(__linux__) || defined(__APPLE__)
-        nBytesRead=read(hTmp->fd, cryptBuff.get(), SEFILE_SECTOR_SIZE);
+                ssize_t n = pread(hTmp->fd, cryptBuff.get() + k * chunk * sector_size, len, position + k * chunk * sector_size);
 #elif _WIN32
-        ReadFile(hTmp->fd, cryptBuff.get(), SEFILE_SECTOR_SIZE, &nBytesRead, nullptr);
+                DWORD n = 0;
+                if((SetFilePointer(hTmp->fd, (LONG)(position + k * chunk * sector_size), nullptr, FILE_BEGIN) == INVALID_SET_FILE_POINTER) ||
+                        (ReadFile(hTmp->fd, cryptBuff.get() + k * chunk * sector_size, (DWORD)len, &n, nullptr) == FALSE)){
+                    n = 0;
+                }
 #endif
-        if(nBytesRead>0){
-            if(this->decrypt_sectors(cryptBuff.get(), decryptBuff.get(), SEFILE_SECTOR_DATA_SIZE, pos_to_cipher_block(current_position), hTmp->nonce_ctr, hTmp->nonce_pbkdf2)){
+                chunk_bytes[k] = (n > 0) ? (size_t)n : 0;
+                return 0;
+            };
+            auto decrypt_chunk = [&](size_t k) -> uint16_t {
+                size_t count = (chunk_bytes[k] + sector_size - 1) / sector_size; // 0 after the end of the file
+                if((count > 0) && this->crypt_sector_batch(cryptBuff.get() + k * chunk * sector_size, decryptBuff.get() + k * chunk * sector_size, count, sector_size,
+                        pos_to_cipher_block(position + k * chunk * sector_size, sector_size), hTmp->nonce_ctr, hTmp->nonce_pbkdf2, CryptoInitialisation::Direction::DECRYPT)){
+                    return SEFILE_READ_ERROR;
+                }
+                return 0;
+            };
+            if(this->Pipeline.run(n_chunks, read_chunk, decrypt_chunk, SEFILE_STAGE())){
                 return SEFILE_READ_ERROR;
             }
-            //sector integrity check
-            if(memcmp(cryptBuff->signature, decryptBuff->signature, B5_SHA256_DIGEST_SIZE)){
-                return SEFILE_SIGNATURE_MISMATCH;
+            nBytesRead = 0;
+            for(size_t k = 0; k < n_chunks; k++){ // only the last chunk of the file can be shorter
+                nBytesRead += chunk_bytes[k];
             }
-        }else{
-            break;
+            if(nBytesRead<=0){
+                break; // end of the file
+            }
+            n_sectors = (nBytesRead + sector_size - 1) / sector_size;
+            //sectors integrity check
+            for(size_t i = 0; i < n_sectors; i++){
+                if(memcmp(sector_signature(cryptBuff.get() + i * sector_size, sector_size), sector_signature(decryptBuff.get() + i * sector_size, sector_size), B5_SHA256_DIGEST_SIZE)){
+                    return SEFILE_SIGNATURE_MISMATCH;
+                }
+            }
+            for(size_t i = n_sectors; i > 0; i--){ // the first sector is the most recently used
+                this->sector_lru_put(sector_index + i - 1, decryptBuff.get() + (i - 1) * sector_size);
+            }
+            sector = this->sector_lru_get(sector_index);
         }
-        data_remaining = (decryptBuff->len) - sectOffset; //remaining data in THIS sector
-        length = dataOut_len < (SEFILE_LOGIC_DATA-sectOffset) ? dataOut_len : (SEFILE_LOGIC_DATA-sectOffset);
+        data_remaining = get_sector_len(sector, sector_size) - sectOffset; //remaining data in THIS sector
+        length = dataOut_len < (uint32_t)(logic_data-sectOffset) ? dataOut_len : (logic_data-sectOffset);
         if(data_remaining<length){
-            length = data_remaining;
+            length = (data_remaining > 0) ? data_remaining : 0;
         }
-        memcpy(dataOut+dataRead, decryptBuff->data+sectOffset, length);
-        current_position += SEFILE_SECTOR_SIZE;
+        memcpy(dataOut+dataRead, sector+sectOffset, length);
         dataOut_len-=length;
         dataRead+=length;
-        sectOffset=(sectOffset+length)%SEFILE_LOGIC_DATA;
+        sectOffset=(sectOffset+length)%logic_data;
+        if(sectOffset == 0){
+            sector_index++;
+        } else if(dataOut_len > 0){
+            break; // the data of the file end in this sector
+        }
     }while(dataOut_len>0); //cycles unless all data requested are read
     //move the pointer inside the last sector read
-    if(sectOffset!=0){
-#if defined(__linux__) || defined(__APPLE__)
-        hTmp->log_offset=lseek(hTmp->fd, (-1)*(SEFILE_SECTOR_SIZE-sectOffset), SEEK_CUR); //todo check sectoffset
-#elif _WIN32
-        hTmp->log_offset=SetFilePointer(hTmp->fd,(-1)*(SEFILE_SECTOR_SIZE-sectOffset), nullptr, FILE_CURRENT);
-#endif
-    }else{
 #if defined(__linux__) || defined(__APPLE__)
-        hTmp->log_offset=lseek(hTmp->fd, 0, SEEK_CUR); //todo check sectoffset
+    hTmp->log_offset=lseek(hTmp->fd, SEFILE_SECTOR_SIZE + sector_index * sector_size + sectOffset, SEEK_SET);
 #elif _WIN32
-        hTmp->log_offset=SetFilePointer(hTmp->fd, 0, nullptr, FILE_CURRENT);
+    hTmp->log_offset=SetFilePointer(hTmp->fd, (LONG)(SEFILE_SECTOR_SIZE + sector_index * sector_size + sectOffset), nullptr, FILE_BEGIN);
 #endif
-    }
     *bytesRead=dataRead;
     return 0;
 }
 
+uint8_t* SEfile::sector_lru_get(size_t sector_index){
+	SEFILE_READ_CACHE *cache = &this->ReadCache;
+	if((this->handleptr == nullptr) || (cache->sector_size != this->handleptr->sector_size)){
+		return nullptr;
+	}
+	auto it = cache->map.find(sector_index);
+	if(it == cache->map.end()){
+		return nullptr;
+	}
+	cache->lru.splice(cache->lru.begin(), cache->lru, it->second); // now the most recently used
+	return it->second->second;
+}
+
+void SEfile::sector_lru_put(size_t sector_index, const uint8_t *sector){
+	SEFILE_READ_CACHE *cache = &this->ReadCache;
+	uint8_t *slot = this->sector_lru_get(sector_index);
+	if(slot == nullptr){
+		if(cache->free_slots.empty()){ // replace the least recently used
+			if(cache->lru.empty()){
+				return;
+			}
+			cache->free_slots.push_back(cache->lru.back().second);
+			cache->map.erase(cache->lru.back().first);
+			cache->lru.pop_back();
+		}
+		slot = cache->free_slots.back();
+		cache->free_slots.pop_back();
+		cache->lru.emplace_front(sector_index, slot);
+		cache->map[sector_index] = cache->lru.begin();
+	}
+	memcpy(slot, sector, cache->sector_size);
+}
+
+void SEfile::sector_lru_drop(size_t first_sector, size_t n_sectors){
+	SEFILE_READ_CACHE *cache = &this->ReadCache;
+	for(size_t i = 0; i < n_sectors; i++){
+		auto it = cache->map.find(first_sector + i);
+		if(it != cache->map.end()){
+			cache->free_slots.push_back(it->second->second);
+			cache->lru.erase(it->second);
+			cache->map.erase(it);
+		}
+	}
+}
+
 uint16_t SEfile::secure_seek(int32_t offset, int32_t *position, uint8_t whence){
     if((this->l1 == nullptr) || (this->handleptr == nullptr) || (this->IsOpen == false)){
     	return SEFILE_SEEK_ERROR;
@@ -683,6 +1156,7 @@ uint16_t SEfile::secure_seek(int32_t offset, int32_t *position, uint8_t whence){
     std::unique_ptr<uint8_t[]> buffer;
     uint32_t file_length=0;
     std::shared_ptr<SEFILE_HANDLE> hTmp = this->handleptr;
+    const int32_t sector_size = hTmp->sector_size, logic_data = sector_size - SEFILE_SECTOR_OVERHEAD;
     /*	dest contains the ABSOLUTE final position (comprehensive of header and overhead
      * overhead represent the signature and length byte of each sector "jumped"
      * position contains the position as the number of user data byte from the begin of the file  */
@@ -701,14 +1175,14 @@ uint16_t SEfile::secure_seek(int32_t offset, int32_t *position, uint8_t whence){
     if(this->get_filesize(&file_length)){ // retrieve the size of the file (only the valid bytes)
         return SEFILE_SEEK_ERROR;
     }
-    sectOffset = absOffset % SEFILE_SECTOR_SIZE; // compute the current offset inside the current sector where the file pointer is positioned
+    sectOffset = (absOffset - SEFILE_SECTOR_SIZE) % sector_size; // compute the current offset inside the current sector where the file pointer is positioned
     if(whence==SEFILE_BEGIN){
         if(offset<0){			//backward jump not allowed from the file begin
             *position=-1;
             return SEFILE_SEEK_ERROR;
         }else{
         	/* overhead to be added because of seek: overhead in a single sector times how many sectors we should jump forward */
-            overhead = (offset / SEFILE_LOGIC_DATA) * SEFILE_SECTOR_OVERHEAD;
+            overhead = (offset / logic_data) * SEFILE_SECTOR_OVERHEAD;
             /* actual destination pointer inside SEfile ciphertext: offset requested + overhead + size of header sector */
             dest = offset + overhead + SEFILE_SECTOR_SIZE;
         }
@@ -720,8 +1194,8 @@ uint16_t SEfile::secure_seek(int32_t offset, int32_t *position, uint8_t whence){
             } else{ // outside the current sector (in a previous sector, need to add overhead)
                 tmp *= (-1); // change sign
                 /* overhead to be added because of seek: overhead in a single sector times how many sectors we should jump backward */
-                overhead = ((tmp)/(SEFILE_LOGIC_DATA)) * SEFILE_SECTOR_OVERHEAD;
-                if((tmp)%SEFILE_LOGIC_DATA){ // add spare overhead lost by previous division (which truncates to integer)
+                overhead = ((tmp)/(logic_data)) * SEFILE_SECTOR_OVERHEAD;
+                if((tmp)%logic_data){ // add spare overhead lost by previous division (which truncates to integer)
                 	overhead+=SEFILE_SECTOR_OVERHEAD;
                 }
                 /* actual destination inside SEfile ciphertext given by current pointer - overhead - offset */
@@ -729,26 +1203,26 @@ uint16_t SEfile::secure_seek(int32_t offset, int32_t *position, uint8_t whence){
             }
         }else {	// forward jump
         	/* overhead given by overhead in one sector times the number of sectors we should jump forward */
-            overhead = ((offset+sectOffset)/SEFILE_LOGIC_DATA) * SEFILE_SECTOR_OVERHEAD;
+            overhead = ((offset+sectOffset)/logic_data) * SEFILE_SECTOR_OVERHEAD;
             dest=absOffset+overhead+offset;
         }
     } else if(whence==SEFILE_END){
-        sectOffset = (file_length % SEFILE_LOGIC_DATA); // offset inside the last sector of the file (SEFILE_LOGIC_DATA because file_length is related only to valid bytes inside SEfile)
-        absOffset = ((file_length / SEFILE_LOGIC_DATA) + 1) * SEFILE_SECTOR_SIZE + sectOffset; // offset of the pointer of the file, considering entire file, header included
+        sectOffset = (file_length % logic_data); // offset inside the last sector of the file (logic_data because file_length is related only to valid bytes inside SEfile)
+        absOffset = SEFILE_SECTOR_SIZE + (file_length / logic_data) * sector_size + sectOffset; // offset of the pointer of the file, considering entire file, header included
         if(offset<0){			//backward jump
             tmp=(offset + sectOffset);
             if(tmp>=0){			//inside the sector
                 dest=absOffset+offset;
             } else{		//outside the current sector (need to add overheads)
                 tmp *= (-1);
-                overhead=((tmp)/(SEFILE_LOGIC_DATA))* SEFILE_SECTOR_OVERHEAD;
-                if((tmp)%SEFILE_LOGIC_DATA){
+                overhead=((tmp)/(logic_data))* SEFILE_SECTOR_OVERHEAD;
+                if((tmp)%logic_data){
                 	overhead+=SEFILE_SECTOR_OVERHEAD;
                 }
                 dest=absOffset + offset - overhead;
             }
         } else {				//forward jump
-            overhead=((offset+sectOffset)/SEFILE_LOGIC_DATA)*SEFILE_SECTOR_OVERHEAD;
+            overhead=((offset+sectOffset)/logic_data)*SEFILE_SECTOR_OVERHEAD;
             dest=absOffset+offset+overhead;
         }
     }
@@ -756,20 +1230,20 @@ uint16_t SEfile::secure_seek(int32_t offset, int32_t *position, uint8_t whence){
         *position = -1;
         return SEFILE_ILLEGAL_SEEK;
     }
-    *position = (dest % SEFILE_SECTOR_SIZE) + (((dest / SEFILE_SECTOR_SIZE) - 1) * SEFILE_LOGIC_DATA); // final position inside the file (only valid bytes)
+    *position = ((dest - SEFILE_SECTOR_SIZE) % sector_size) + (((dest - SEFILE_SECTOR_SIZE) / sector_size) * logic_data); // final position inside the file (only valid bytes)
     buffer_size = (*position) - file_length; // check if current position is ahead of the current valid bytes in the file
     if(buffer_size>0){ 			//if destination exceed the end of the file, empty sectors are inserted at the end of the file to keep the file consistency
         buffer = std::make_unique<uint8_t[]>(buffer_size);
     	if(buffer == nullptr){
             return SEFILE_SEEK_ERROR;
         }
-        if((file_length % SEFILE_LOGIC_DATA)){ // there is still space inside the last sector
+        if((file_length % logic_data)){ // there is still space inside the last sector
 #if defined(__linux__) || defined(__APPLE__)
             //hTmp->log_offset=lseek(hTmp->fd, ((file_length % SEFILE_LOGIC_DATA) - SEFILE_SECTOR_SIZE), SEEK_END); // wrong, bugfix at next line
-            hTmp->log_offset=lseek(hTmp->fd, ((((file_length/SEFILE_LOGIC_DATA)+1/* +1 for header */) * SEFILE_SECTOR_SIZE) + file_length%SEFILE_LOGIC_DATA), SEEK_SET); // move the pointer to the first unused byte that is still usable in the last sector
+            hTmp->log_offset=lseek(hTmp->fd, (SEFILE_SECTOR_SIZE/* header */ + ((file_length/logic_data) * sector_size) + file_length%logic_data), SEEK_SET); // move the pointer to the first unused byte that is still usable in the last sector
 #elif _WIN32
             //hTmp->log_offset=SetFilePointer(hTmp->fd, ((file_length%SEFILE_LOGIC_DATA)-SEFILE_SECTOR_SIZE), nullptr, FILE_END); // wrong, bugfix at next line
-            hTmp->log_offset=SetFilePointer(hTmp->fd, ((((file_length/SEFILE_LOGIC_DATA)+1/* +1 for header */) * SEFILE_SECTOR_SIZE) + file_length%SEFILE_LOGIC_DATA), nullptr, FILE_BEGIN); // move the pointer to the first unused byte that is still usable in the last sector
+            hTmp->log_offset=SetFilePointer(hTmp->fd, (SEFILE_SECTOR_SIZE/* header */ + ((file_length/logic_data) * sector_size) + file_length%logic_data), nullptr, FILE_BEGIN); // move the pointer to the first unused byte that is still usable in the last sector
 #endif
         }
         memset(buffer.get(), 0, buffer_size); // we insert empty bytes until the position is reached
@@ -800,54 +1274,73 @@ uint16_t SEfile::secure_truncate(uint32_t new_size){
 	uint32_t fPosition = 0;
     int rOffset = 0, nSector = 0; //New Relative offset & new number of sectors
     std::unique_ptr<uint8_t[]> buffer;
+    const int32_t sector_size = this->handleptr->sector_size, logic_data = sector_size - SEFILE_SECTOR_OVERHEAD;
     uint32_t original_size = 0, bytesRead = 0;
     /*if(this->secure_sync()){
         return SEFILE_WRITE_ERROR;
     }*/
+    if(this->sector_cache_flush(true)){ // the sectors cached may be cut by the truncation
+        return SEFILE_TRUNCATE_ERROR;
+    }
     if(this->get_filesize(&original_size)){
         return SEFILE_TRUNCATE_ERROR;
     }
     if(original_size == new_size){
     	return 0; // no need to do anything
     }
+    if(this->header_length_update(SEFILE_LENGTH_UNKNOWN)){ // the file is going to change
+        return SEFILE_TRUNCATE_ERROR;
+    }
     if(original_size < new_size){ // truncate to larger size
     	uint16_t rc = this->secure_seek((new_size-original_size), (int32_t*)&fPosition, SEFILE_END); // secure_seek adds 0s to the end of file if required
         if(rc || (fPosition != (new_size+original_size))){
             return SEFILE_TRUNCATE_ERROR;
         }
     } else {
-        rOffset = new_size % SEFILE_LOGIC_DATA; //Relative offset inside a sector
-        nSector = (new_size / SEFILE_LOGIC_DATA) + 1; //Number of sectors in a file (including header)
+        rOffset = new_size % logic_data; //Relative offset inside a sector
+        nSector = new_size / logic_data; //Number of sectors in a file (excluding header)
 #if defined(__linux__) || defined(__APPLE__)
-        this->handleptr->log_offset = lseek(this->handleptr->fd, nSector*SEFILE_SECTOR_SIZE, SEEK_SET); // move file pointer to the destination sector to truncate
+        this->handleptr->log_offset = lseek(this->handleptr->fd, SEFILE_SECTOR_SIZE + nSector*sector_size, SEEK_SET); // move file pointer to the destination sector to truncate
         if(this->handleptr->log_offset < 0){ return SEFILE_TRUNCATE_ERROR; }
 #elif _WIN32
-        this->handleptr->log_offset = SetFilePointer(this->handleptr->fd, nSector*SEFILE_SECTOR_SIZE, nullptr, FILE_BEGIN); // move file pointer to the destination sector to truncate
+        this->handleptr->log_offset = SetFilePointer(this->handleptr->fd, SEFILE_SECTOR_SIZE + nSector*sector_size, nullptr, FILE_BEGIN); // move file pointer to the destination sector to truncate
         if(this->handleptr->log_offset == INVALID_SET_FILE_POINTER){ return SEFILE_TRUNCATE_ERROR; }
 #endif
         buffer = std::make_unique<uint8_t[]>(rOffset);
         if(buffer == nullptr){ return SEFILE_TRUNCATE_ERROR; }
         if(this->secure_read(buffer.get(), rOffset, &bytesRead)){ return SEFILE_TRUNCATE_ERROR; } // read the sector at the truncate position
 #if defined(__linux__) || defined(__APPLE__)
-        this->handleptr->log_offset = lseek(this->handleptr->fd, nSector*SEFILE_SECTOR_SIZE, SEEK_SET); // move file pointer to the destination sector to truncate
+        this->handleptr->log_offset = lseek(this->handleptr->fd, SEFILE_SECTOR_SIZE + nSector*sector_size, SEEK_SET); // move file pointer to the destination sector to truncate
         if(this->handleptr->log_offset < 0){ return SEFILE_TRUNCATE_ERROR; }
-        if(ftruncate(this->handleptr->fd, nSector*SEFILE_SECTOR_SIZE)){	// truncate
+        if(ftruncate(this->handleptr->fd, SEFILE_SECTOR_SIZE + nSector*sector_size)){	// truncate
             return SEFILE_TRUNCATE_ERROR;
         }
 #elif _WIN32
-        this->handleptr->log_offset = SetFilePointer(this->handleptr->fd, nSector*SEFILE_SECTOR_SIZE, nullptr, FILE_BEGIN); // move file pointer to the destination sector to truncate
+        this->handleptr->log_offset = SetFilePointer(this->handleptr->fd, SEFILE_SECTOR_SIZE + nSector*sector_size, nullptr, FILE_BEGIN); // move file pointer to the destination sector to truncate
         if(this->handleptr->log_offset == INVALID_SET_FILE_POINTER){ return SEFILE_TRUNCATE_ERROR; }
         if(!SetEndOfFile(this->handleptr->fd)){	//truncate
             return SEFILE_TRUNCATE_ERROR;
         }
 #endif
+        this->ReadCache = SEFILE_READ_CACHE(); // the sectors cut are no longer in the file
         if(this->secure_write(buffer.get(), rOffset)){ return SEFILE_TRUNCATE_ERROR; } // write back last sector
     }
+    this->handleptr->length = new_size;
     return 0;
 }
 
 uint16_t SEfile::secure_close(){
     if(this->handleptr == nullptr){ return 0; }
+    uint16_t ret = this->sector_cache_flush(true); // the file is closed anyway, the error is returned at the end
+    uint32_t length = 0;
+    if((ret == 0) && this->handleptr->changed){ // record the length of the file in the header
+    	if((ret = this->get_filesize(&length)) == 0){
+    		ret = this->header_length_update(length);
+    	}
+    }
+    this->ReadCache = SEFILE_READ_CACHE();
+    this->Header = SEFILE_SECTOR();
+    this->sector_session_close();
 #if defined(__linux__) || defined(__APPLE__)
 	if(close(this->handleptr->fd) == -1 ){
 		this->handleptr.reset();
@@ -861,7 +1354,7 @@ uint16_t SEfile::secure_close(){
 #endif
 	this->handleptr.reset();
 	this->IsOpen = false;
-    return 0;
+    return ret;
 }
 
 uint16_t SEfile::crypt_header(void *buff1, void *buff2, size_t datain_len, uint16_t direction){
@@ -914,7 +1407,15 @@ uint16_t SEfile::crypt_sectors(void *buff_decrypt, void *buff_crypt, size_t data
     uint32_t enc_sess_id = 0;
     size_t curr_chunk = datain_len < MAX_DATA_IN ? datain_len : MAX_DATA_IN;
     uint8_t nonce_local[16];
-    uint16_t flag_reset_auth = datain_len < MAX_DATA_IN ? L1Crypto::UpdateFlags::RESET | L1Crypto::UpdateFlags::AUTH : L1Crypto::UpdateFlags::AUTH;
+    bool first = true;
+    if(((datain_len % SEFILE_BLOCK_SIZE) == 0) && (datain_len + SEFILE_BLOCK_SIZE + B5_SHA256_DIGEST_SIZE <= L1Crypto::UpdateSize::DATAIN) && this->sector_session_supported()){
+    	uint8_t sector[L1Crypto::UpdateSize::DATAIN]; // the request holds also the room for the signature, which follows the data
+    	memcpy(nonce_local, nonce_ctr, 16);
+    	compute_blk_offset(current_offset, nonce_local);
+    	memcpy(sector, buff_decrypt, datain_len);
+    	memset(sector + datain_len, 0, B5_SHA256_DIGEST_SIZE);
+    	return this->sector_update(CryptoInitialisation::Direction::ENCRYPT, nonce_pbkdf2, nonce_local, 1, datain_len + B5_SHA256_DIGEST_SIZE, sector, (uint8_t*)buff_crypt);
+    }
     try{
     	l1->L1CryptoInit(this->EnvCrypto, CryptoInitialisation::Modes::CTR | CryptoInitialisation::Direction::ENCRYPT, this->EnvKeyID, enc_sess_id);
     	l1->L1CryptoUpdate(enc_sess_id, L1Crypto::UpdateFlags::SETNONCE, SEFILE_NONCE_LEN, nonce_pbkdf2, 0, nullptr, nullptr, nullptr);
@@ -924,16 +1425,18 @@ uint16_t SEfile::crypt_sectors(void *buff_decrypt, void *buff_crypt, size_t data
     memcpy(nonce_local, nonce_ctr, 16);
     compute_blk_offset(current_offset, nonce_local);
     do {
+    	/* only the first chunk sets the counter, the following chunks of a sector larger than a request go on with the counter
+    	 * and the signature where the previous chunk left them, the last one gets the signature */
+    	uint16_t flags = first ? L1Crypto::UpdateFlags::RESET : 0;
+    	if(datain_len == curr_chunk){
+    		flags |= L1Crypto::UpdateFlags::AUTH | L1Crypto::UpdateFlags::FINIT;
+    	}
     	try{
-        	if (datain_len - curr_chunk){
-        		this->l1->L1CryptoUpdate(enc_sess_id, L1Crypto::UpdateFlags::RESET | CryptoInitialisation::Modes::CTR | CryptoInitialisation::Direction::ENCRYPT, SEFILE_BLOCK_SIZE, nonce_local, curr_chunk, sp, &curr_len, rp);
-        	} else {
-        		this->l1->L1CryptoUpdate(enc_sess_id, flag_reset_auth | L1Crypto::UpdateFlags::FINIT, SEFILE_BLOCK_SIZE, nonce_local, curr_chunk, sp, &curr_len, rp);
-        	}
+    		this->l1->L1CryptoUpdate(enc_sess_id, flags, first ? SEFILE_BLOCK_SIZE : 0, first ? nonce_local : nullptr, curr_chunk, sp, &curr_len, rp);
     	} catch(...){
     		return L1Error::Error::SE3_ERR_ACCESS; // no specific reason to return this error, just return non zero
     	}
-        compute_blk_offset(((curr_len - B5_SHA256_DIGEST_SIZE) / SEFILE_BLOCK_SIZE), nonce_local);
+        first = false;
         datain_len -= curr_chunk;
         sp += curr_chunk;
         rp += curr_chunk;
@@ -954,7 +1457,15 @@ uint16_t SEfile::decrypt_sectors(void *buff_crypt, void *buff_decrypt, size_t da
     uint32_t enc_sess_id = 0;
     size_t curr_chunk = datain_len < MAX_DATA_IN ? datain_len : MAX_DATA_IN;
     uint8_t nonce_local[16];
-    uint16_t flag_reset_auth = datain_len < MAX_DATA_IN ? L1Crypto::UpdateFlags::RESET | L1Crypto::UpdateFlags::AUTH : L1Crypto::UpdateFlags::AUTH;
+    bool first = true;
+    if(((datain_len % SEFILE_BLOCK_SIZE) == 0) && (datain_len + SEFILE_BLOCK_SIZE + B5_SHA256_DIGEST_SIZE <= L1Crypto::UpdateSize::DATAIN) && this->sector_session_supported()){
+    	uint8_t sector[L1Crypto::UpdateSize::DATAIN]; // the request holds also the room for the signature, which follows the data
+    	memcpy(nonce_local, nonce_ctr, 16);
+    	compute_blk_offset(current_offset, nonce_local);
+    	memcpy(sector, buff_crypt, datain_len);
+    	memset(sector + datain_len, 0, B5_SHA256_DIGEST_SIZE);
+    	return this->sector_update(CryptoInitialisation::Direction::DECRYPT, nonce_pbkdf2, nonce_local, 1, datain_len + B5_SHA256_DIGEST_SIZE, sector, (uint8_t*)buff_decrypt);
+    }
     try{
     	l1->L1CryptoInit(this->EnvCrypto, CryptoInitialisation::Modes::CTR | CryptoInitialisation::Direction::DECRYPT, this->EnvKeyID, enc_sess_id);
     	l1->L1CryptoUpdate(enc_sess_id, L1Crypto::UpdateFlags::SETNONCE, SEFILE_NONCE_LEN, nonce_pbkdf2, 0, nullptr, nullptr, nullptr);
@@ -964,16 +1475,17 @@ uint16_t SEfile::decrypt_sectors(void *buff_crypt, void *buff_decrypt, size_t da
     memcpy(nonce_local, nonce_ctr, 16);
     compute_blk_offset(current_offset, nonce_local);
     do {
+    	/* only the first chunk sets the counter, see crypt_sectors() */
+    	uint16_t flags = first ? L1Crypto::UpdateFlags::RESET : 0;
+    	if(datain_len == curr_chunk){
+    		flags |= L1Crypto::UpdateFlags::AUTH | L1Crypto::UpdateFlags::FINIT;
+    	}
     	try{
-    		if(datain_len - curr_chunk){
-    			this->l1->L1CryptoUpdate(enc_sess_id, L1Crypto::UpdateFlags::RESET | CryptoInitialisation::Modes::CTR | CryptoInitialisation::Direction::DECRYPT, SEFILE_BLOCK_SIZE, nonce_local, curr_chunk, sp, &curr_len, rp);
-			} else {
-				this->l1->L1CryptoUpdate(enc_sess_id, flag_reset_auth | L1Crypto::UpdateFlags::FINIT, SEFILE_BLOCK_SIZE, nonce_local, curr_chunk, sp, &curr_len, rp);
-			}
+    		this->l1->L1CryptoUpdate(enc_sess_id, flags, first ? SEFILE_BLOCK_SIZE : 0, first ? nonce_local : nullptr, curr_chunk, sp, &curr_len, rp);
     	} catch(...){
     		return L1Error::Error::SE3_ERR_ACCESS; // no specific reason to return this error, just return non zero
     	}
-        compute_blk_offset(((curr_len-B5_SHA256_DIGEST_SIZE) / SEFILE_BLOCK_SIZE), nonce_local);
+        first = false;
         datain_len -= curr_chunk;
         sp += curr_chunk;
         rp += curr_chunk;
@@ -982,16 +1494,169 @@ uint16_t SEfile::decrypt_sectors(void *buff_crypt, void *buff_decrypt, size_t da
     return L1Error::Error::OK;
 }
 
+uint16_t SEfile::crypt_sector_batch(void *buff_in, void *buff_out, size_t n_sectors, size_t sector_size, size_t current_offset, uint8_t* nonce_ctr, uint8_t* nonce_pbkdf2, uint16_t direction){
+    if((buff_in == nullptr) || (buff_out == nullptr) || (nonce_ctr == nullptr) || (nonce_pbkdf2 == nullptr) || (this->l1 == nullptr)){
+        return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+    }
+    uint8_t *sp = (uint8_t*)buff_in, *rp = (uint8_t*)buff_out;
+    size_t sector_blocks = (sector_size - B5_SHA256_DIGEST_SIZE) / SEFILE_BLOCK_SIZE; // cipher blocks of each sector
+    size_t per_update = SEFILE_SECTORS_PER_UPDATE(sector_size);
+    if((per_update == 0) || !this->sector_session_supported()){ // one sector at a time
+    	for(size_t i = 0; i < n_sectors; i++){
+    		uint16_t rc = (direction == CryptoInitialisation::Direction::ENCRYPT) ?
+    			this->crypt_sectors(sp + i * sector_size, rp + i * sector_size, sector_size - B5_SHA256_DIGEST_SIZE, current_offset + i * sector_blocks, nonce_ctr, nonce_pbkdf2) :
+    			this->decrypt_sectors(sp + i * sector_size, rp + i * sector_size, sector_size - B5_SHA256_DIGEST_SIZE, current_offset + i * sector_blocks, nonce_ctr, nonce_pbkdf2);
+    		if(rc){
+    			return rc;
+    		}
+    	}
+    	return L1Error::Error::OK;
+    }
+    if(per_update > this->EnvBatch){
+    	per_update = this->EnvBatch;
+    }
+    uint8_t nonces[SEFILE_BATCH_SECTORS * SEFILE_BLOCK_SIZE];
+    while(n_sectors > 0){
+    	size_t curr_sectors = n_sectors < per_update ? n_sectors : per_update;
+    	for(size_t i = 0; i < curr_sectors; i++){ // same CTR nonce that crypt_sectors() would use for each sector
+    		memcpy(nonces + i * SEFILE_BLOCK_SIZE, nonce_ctr, SEFILE_BLOCK_SIZE);
+    		compute_blk_offset(current_offset + i * sector_blocks, nonces + i * SEFILE_BLOCK_SIZE);
+    	}
+    	uint16_t rc = this->sector_update(direction, nonce_pbkdf2, nonces, curr_sectors, sector_size, sp, rp);
+    	if(rc){
+    		return rc;
+    	}
+    	n_sectors -= curr_sectors;
+    	sp += curr_sectors * sector_size;
+    	rp += curr_sectors * sector_size;
+    	current_offset += curr_sectors * sector_blocks;
+    }
+    return L1Error::Error::OK;
+}
+
+bool SEfile::sector_session_supported(){
+    if((this->l1 == nullptr) || (this->EnvCrypto != L1Algorithms::Algorithms::AES_HMACSHA256)){
+    	return false;
+    }
+    if(this->EnvBatch == 0){ // ask the SEcube only once if it can process more sectors at a time
+        std::vector<se3Algo> algTable;
+        try{
+        	this->l1->L1GetAlgorithms(algTable);
+        } catch(...){
+        	return false;
+        }
+        this->EnvBatch = sector_batch_size(algTable);
+    }
+    return this->EnvBatch > 1;
+}
+
+uint16_t SEfile::sector_update(uint16_t direction, uint8_t* nonce_pbkdf2, uint8_t* nonces, size_t n_sectors, size_t sector_len, uint8_t* buff_in, uint8_t* buff_out){
+    if((nonce_pbkdf2 == nullptr) || (nonces == nullptr) || (buff_in == nullptr) || (buff_out == nullptr) || (this->l1 == nullptr)){
+        return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+    }
+    SEFILE_SESSION& s = this->EnvSession[(direction == CryptoInitialisation::Direction::ENCRYPT) ? 0 : 1];
+    uint16_t curr_len = 0;
+    if(s.open && (s.login_count != this->l1->L1GetSessionLoginCount())){ // the logout closed the session on the SEcube
+    	s.open = false;
+    }
+    if(s.open && ((s.key_id != this->EnvKeyID) || memcmp(s.nonce_pbkdf2, nonce_pbkdf2, SEFILE_NONCE_LEN))){
+    	this->sector_session_close();
+    }
+    for(int attempt = 0; attempt < 2; attempt++){ // if the cached session does not work anymore, try once with a new one
+    	try{
+    		if(!s.open){
+    			this->l1->L1CryptoInit(L1Algorithms::Extensions::AES_HMACSHA256_SECTORS, CryptoInitialisation::Modes::CTR | direction, this->EnvKeyID, s.sess_id);
+    			s.open = true;
+    			s.key_id = this->EnvKeyID;
+    			s.login_count = this->l1->L1GetSessionLoginCount();
+    			memcpy(s.nonce_pbkdf2, nonce_pbkdf2, SEFILE_NONCE_LEN);
+    			this->l1->L1CryptoUpdate(s.sess_id, L1Crypto::UpdateFlags::SETNONCE, SEFILE_NONCE_LEN, nonce_pbkdf2, 0, nullptr, nullptr, nullptr);
+    		}
+    		this->l1->L1CryptoUpdate(s.sess_id, L1Crypto::UpdateFlags::RESET, n_sectors * SEFILE_BLOCK_SIZE, nonces, n_sectors * sector_len, buff_in, &curr_len, buff_out);
+    	} catch(...){
+    		this->sector_session_close();
+    		continue;
+    	}
+    	return (curr_len == n_sectors * sector_len) ? L1Error::Error::OK : L1Error::Error::SE3_ERR_ACCESS;
+    }
+    return L1Error::Error::SE3_ERR_ACCESS; // no specific reason to return this error, just return non zero
+}
+
+void SEfile::sector_session_close(){
+    uint8_t nonce[SEFILE_BLOCK_SIZE] = { 0 };
+    for(SEFILE_SESSION& s : this->EnvSession){
+    	if(s.open && (this->l1 != nullptr) && (s.login_count == this->l1->L1GetSessionLoginCount())){
+    		try{
+    			this->l1->L1CryptoUpdate(s.sess_id, L1Crypto::UpdateFlags::FINIT, SEFILE_BLOCK_SIZE, nonce, 0, nullptr, nullptr, nullptr);
+    		} catch(...){} // nothing to do, the session is dropped anyway
+    	}
+    	s.open = false;
+    }
+}
+
+uint16_t SEfile::header_length_update(uint32_t length){
+	std::shared_ptr<SEFILE_HANDLE> hTmp = this->handleptr;
+	SEFILE_SECTOR buffEnc;
+	uint32_t old_length = this->Header.header.length;
+	uint8_t *last_signature = this->Header.data + SEFILE_HEADER_LAST_SIGNATURE;
+	uint8_t signature[B5_SHA256_DIGEST_SIZE], old_signature[B5_SHA256_DIGEST_SIZE];
+#ifdef _WIN32
+	DWORD nBytesWritten = 0;
+#endif
+	if(hTmp == nullptr){
+		return SEFILE_WRITE_ERROR;
+	}
+	if((this->Header.header.ver != SEFILE_VERSION_FILE_LENGTH) || ((length == SEFILE_LENGTH_UNKNOWN) && hTmp->changed)){ // no length in the header, or already written
+		return 0;
+	}
+	memcpy(old_signature, last_signature, B5_SHA256_DIGEST_SIZE);
+	memcpy(signature, last_signature, B5_SHA256_DIGEST_SIZE);
+	if((length != SEFILE_LENGTH_UNKNOWN) && read_last_signature(hTmp.get(), length, signature)){
+		length = SEFILE_LENGTH_UNKNOWN; // the sectors do not hold exactly length bytes, the length is left to get_filesize()
+	}
+	if((old_length != length) || memcmp(old_signature, signature, B5_SHA256_DIGEST_SIZE)){
+		this->Header.header.length = length;
+		memcpy(last_signature, signature, B5_SHA256_DIGEST_SIZE);
+		uint16_t ret = this->crypt_header(&this->Header, &buffEnc, SEFILE_SECTOR_DATA_SIZE, CryptoInitialisation::Direction::ENCRYPT) ? SEFILE_WRITE_ERROR : 0;
+#if defined(__linux__) || defined(__APPLE__)
+		if((ret == 0) && (pwrite(hTmp->fd, &buffEnc, sizeof(SEFILE_SECTOR), 0) != sizeof(SEFILE_SECTOR))){
+			ret = SEFILE_WRITE_ERROR;
+		}
+#elif _WIN32
+		if((ret == 0) && ((SetFilePointer(hTmp->fd, 0, nullptr, FILE_BEGIN) == INVALID_SET_FILE_POINTER) ||
+				(WriteFile(hTmp->fd, &buffEnc, sizeof(SEFILE_SECTOR), &nBytesWritten, nullptr) == FALSE) || (nBytesWritten != sizeof(SEFILE_SECTOR)))){
+			ret = SEFILE_WRITE_ERROR;
+		}
+		SetFilePointer(hTmp->fd, hTmp->log_offset, nullptr, FILE_BEGIN);
+#endif
+		if(ret){
+			this->Header.header.length = old_length;
+			memcpy(last_signature, old_signature, B5_SHA256_DIGEST_SIZE);
+			return ret;
+		}
+	}
+	hTmp->changed = (length == SEFILE_LENGTH_UNKNOWN) ? 1 : 0;
+	return 0;
+}
+
 uint16_t SEfile::get_filesize(uint32_t * length){
     if((this->handleptr == nullptr) || (this->l1 == nullptr) || (this->IsOpen == false) || (length == nullptr)){
         return SEFILE_FILESIZE_ERROR;
     }
     uint16_t rc = this->secure_key_check(CryptoInitialisation::Direction::DECRYPT); // check if the key is valid for decryption
     if(rc){ return rc; } // return if the key is not valid
-	std::unique_ptr<SEFILE_SECTOR> crypt_buffer = std::make_unique<SEFILE_SECTOR>();
-    std::unique_ptr<SEFILE_SECTOR> decrypt_buffer = std::make_unique<SEFILE_SECTOR>();
-    int32_t total_size=0;
+    if(this->handleptr->length != SEFILE_LENGTH_UNKNOWN){ // from the header or kept updated since the last sector was read
+        *length = this->handleptr->length;
+        return 0;
+    }
+    if(this->sector_cache_flush(false)){ // the last sector may still be in the cache
+        return SEFILE_FILESIZE_ERROR;
+    }
     std::shared_ptr<SEFILE_HANDLE> hTmp = this->handleptr;
+    const int32_t sector_size = hTmp->sector_size;
+	std::unique_ptr<uint8_t[]> crypt_buffer = std::make_unique<uint8_t[]>(sector_size);
+    std::unique_ptr<uint8_t[]> decrypt_buffer = std::make_unique<uint8_t[]>(sector_size);
+    int32_t total_size=0;
 #if defined(__linux__) || defined(__APPLE__)
     off_t orig_off;
     size_t BytesRead = 0;
@@ -1004,16 +1669,17 @@ uint16_t SEfile::get_filesize(uint32_t * length){
     }
 #if defined(__linux__) || defined(__APPLE__)
     orig_off=lseek(hTmp->fd, 0, SEEK_CUR); // save current file offset
-    total_size=lseek(hTmp->fd, (-1)*(SEFILE_SECTOR_SIZE), SEEK_END); // move file offset to the beginning of the last sector
+    total_size=lseek(hTmp->fd, 0, SEEK_END);
     if(orig_off==-1 || total_size==-1){
         return SEFILE_SEEK_ERROR;
     }
-    if(!total_size) {
+    if(total_size <= SEFILE_SECTOR_SIZE) { // only the header
         lseek(hTmp->fd, orig_off, SEEK_SET);
         *length=0;
         return 0;
     }
-    if((BytesRead = read(hTmp->fd, crypt_buffer.get(), SEFILE_SECTOR_SIZE))!= SEFILE_SECTOR_SIZE){ // read last sector of the file
+    total_size=lseek(hTmp->fd, (-1)*sector_size, SEEK_END); // move file offset to the beginning of the last sector
+    if((total_size < SEFILE_SECTOR_SIZE) || (BytesRead = read(hTmp->fd, crypt_buffer.get(), sector_size))!= (size_t)sector_size){ // read last sector of the file
         lseek(hTmp->fd, orig_off, SEEK_SET);
         return SEFILE_READ_ERROR;
     }
@@ -1022,16 +1688,17 @@ uint16_t SEfile::get_filesize(uint32_t * length){
     }
 #elif _WIN32
     orig_off=SetFilePointer(hTmp->fd, 0, 0, FILE_CURRENT);
-    total_size=SetFilePointer(hTmp->fd, (-1)*(SEFILE_SECTOR_SIZE), nullptr, FILE_END);
+    total_size=SetFilePointer(hTmp->fd, 0, nullptr, FILE_END);
     if(((uint32_t)orig_off)==INVALID_SET_FILE_POINTER || ((uint32_t)total_size)==INVALID_SET_FILE_POINTER){
         return SEFILE_SEEK_ERROR;
     }
-    if(!total_size) {
+    if(total_size <= SEFILE_SECTOR_SIZE) { // only the header
         SetFilePointer(hTmp->fd, orig_off, nullptr, FILE_BEGIN);
         *length=0;
         return 0;
     }
-    if ((ReadFile(hTmp->fd, crypt_buffer.get(), SEFILE_SECTOR_SIZE, &BytesRead, nullptr))==0 || BytesRead!=SEFILE_SECTOR_SIZE){
+    total_size=SetFilePointer(hTmp->fd, (-1)*sector_size, nullptr, FILE_END); // move file offset to the beginning of the last sector
+    if ((total_size < SEFILE_SECTOR_SIZE) || (ReadFile(hTmp->fd, crypt_buffer.get(), sector_size, &BytesRead, nullptr))==0 || BytesRead!=(DWORD)sector_size){
         SetFilePointer(hTmp->fd, orig_off, nullptr, FILE_BEGIN);
         return SEFILE_READ_ERROR;
     }
@@ -1039,15 +1706,16 @@ uint16_t SEfile::get_filesize(uint32_t * length){
         return SEFILE_SEEK_ERROR;
     }
 #endif
-    if (this->decrypt_sectors(crypt_buffer.get(), decrypt_buffer.get(), SEFILE_SECTOR_DATA_SIZE, pos_to_cipher_block(total_size), hTmp->nonce_ctr, hTmp->nonce_pbkdf2)){
+    if (this->decrypt_sectors(crypt_buffer.get(), decrypt_buffer.get(), sector_size - B5_SHA256_DIGEST_SIZE, pos_to_cipher_block(total_size, sector_size), hTmp->nonce_ctr, hTmp->nonce_pbkdf2)){
         return SEFILE_FILESIZE_ERROR;
     }
-    if (memcmp(crypt_buffer->signature, decrypt_buffer->signature, B5_SHA256_DIGEST_SIZE)){
+    if (memcmp(sector_signature(crypt_buffer.get(), sector_size), sector_signature(decrypt_buffer.get(), sector_size), B5_SHA256_DIGEST_SIZE)){
         return SEFILE_SIGNATURE_MISMATCH;
     }
     /* the total size of the file (valid file content, excluding header, signature, len, overhead and any other content which is not part of the original plaintext file)
      * is equal to the valid bytes in all sectors but the header and the last sector, + the valid bytes in the last sector. */
-    *length=((total_size/SEFILE_SECTOR_SIZE)-1)*SEFILE_LOGIC_DATA + decrypt_buffer->len;
+    *length=((total_size-SEFILE_SECTOR_SIZE)/sector_size)*(sector_size-SEFILE_SECTOR_OVERHEAD) + get_sector_len(decrypt_buffer.get(), sector_size);
+    hTmp->length = *length;
     return 0;
 }
 
@@ -1057,6 +1725,13 @@ uint16_t SEfile::secure_sync(){
     }
     std::shared_ptr<SEFILE_HANDLE> hTmp = this->handleptr;
     uint16_t ret = 0;
+    uint32_t length = 0;
+    if(this->sector_cache_flush(false)){
+        return SEFILE_SYNC_ERR;
+    }
+    if(hTmp->changed && (this->get_filesize(&length) || this->header_length_update(length))){ // record the length of the file in the header
+        return SEFILE_SYNC_ERR;
+    }
 #if defined(__linux__) || defined(__APPLE__)
     if(fsync(hTmp->fd)){
         ret = SEFILE_SYNC_ERR;
@@ -1542,9 +2217,8 @@ uint16_t secure_recrypt(std::string path, uint32_t key, L1 *SEcubeptr){
 	char enc_filename_old[MAX_PATHNAME], enc_filename_new[MAX_PATHNAME];
 	try{
 		if(SEcubeptr == nullptr){ return SEFILE_RECRYPT_ERROR; }
-		int32_t pos;
-		uint32_t bytesread, bytesleft, oldsize, toread;
-		uint8_t buffer[1024];
+		uint32_t oldsize;
+		uint64_t physical_size = 0;
 		// generate the name (both cleartext and SHA-256) of the new file to be created, including the absolute path (if any)
 		std::string newfilename(path + ".reencryptedsefile");
 		memset(enc_filename_old, 0, MAX_PATHNAME*sizeof(char)); // SHA-256 of old file name
@@ -1557,37 +2231,82 @@ uint16_t secure_recrypt(std::string path, uint32_t key, L1 *SEcubeptr){
 		override_key_check = true;
 		if(secure_getfilesize((char*)path.c_str(), &oldsize, SEcubeptr) ||
 		   oldfile.secure_open((char*)path.c_str(), SEFILE_READ, SEFILE_OPEN) ||
-		   newfile.secure_open((char*)newfilename.c_str(), SEFILE_WRITE, SEFILE_NEWFILE) ||
-		   oldfile.secure_seek(0, &pos, SEFILE_BEGIN)){
+		   newfile.secure_open((char*)newfilename.c_str(), SEFILE_WRITE, SEFILE_NEWFILE, oldfile.handleptr->sector_size)){ // same sectors of the old file
 			override_key_check = false;
 			return SEFILE_RECRYPT_ERROR;
 		}
-		// copy the old file into the new file (basically the content of the old file will be encrypted in a new file, with a new key)
-		bytesleft = oldsize;
-		while(bytesleft > 0){
-			if(bytesleft > 1024){
-				toread = 1024;
-			} else {
-				toread = bytesleft;
+#if defined(__linux__) || defined(__APPLE__)
+		struct stat st;
+		if(fstat(oldfile.handleptr->fd, &st) == 0){
+			physical_size = st.st_size;
+		}
+#elif _WIN32
+		LARGE_INTEGER st;
+		if(GetFileSizeEx(oldfile.handleptr->fd, &st)){
+			physical_size = st.QuadPart;
+		}
+#endif
+		/* copy the sectors of the old file into the new file at the same positions (basically the content of the old file will be encrypted in a new file,
+		 * with a new key): each chunk of sectors is decrypted and encrypted again by the SEcube while the next chunks are read and the previous ones written */
+		const size_t sector_size = oldfile.handleptr->sector_size, chunk = sectors_per_batch(sector_size);
+		const size_t n_sectors = (physical_size > SEFILE_SECTOR_SIZE) ? (physical_size - SEFILE_SECTOR_SIZE) / sector_size : 0;
+		const size_t n_chunks = (n_sectors + chunk - 1) / chunk;
+		std::unique_ptr<uint8_t[]> ring = std::make_unique<uint8_t[]>(SEFILE_PIPELINE_DEPTH * chunk * sector_size), clear = std::make_unique<uint8_t[]>(chunk * sector_size);
+		auto chunk_len = [&](size_t k) -> size_t { return (((k + 1) * chunk < n_sectors) ? chunk : (n_sectors - k * chunk)) * sector_size; };
+		auto chunk_pos = [&](size_t k) -> size_t { return SEFILE_SECTOR_SIZE + k * chunk * sector_size; };
+		auto chunk_buff = [&](size_t k) -> uint8_t* { return ring.get() + (k % SEFILE_PIPELINE_DEPTH) * chunk * sector_size; };
+		auto read_chunk = [&](size_t k) -> uint16_t {
+#if defined(__linux__) || defined(__APPLE__)
+			if(pread(oldfile.handleptr->fd, chunk_buff(k), chunk_len(k), chunk_pos(k)) != (ssize_t)chunk_len(k)){
+				return SEFILE_RECRYPT_ERROR;
 			}
-			memset(buffer, 0, 1024);
-			bytesread = 0;
-			if(oldfile.secure_read(buffer, toread, &bytesread) == 0){
-				if(bytesread > 0){
-					if(newfile.secure_write(buffer, bytesread)){
-						remove(enc_filename_new); // error, remove new file
-						override_key_check = false;
-						return SEFILE_RECRYPT_ERROR;
-					} else {
-						bytesleft -= bytesread; // decrement bytes to be re-encrypted
-					}
+#elif _WIN32
+			DWORD nBytesRead = 0;
+			if((SetFilePointer(oldfile.handleptr->fd, (LONG)chunk_pos(k), nullptr, FILE_BEGIN) == INVALID_SET_FILE_POINTER) ||
+					(ReadFile(oldfile.handleptr->fd, chunk_buff(k), (DWORD)chunk_len(k), &nBytesRead, nullptr) == FALSE) || (nBytesRead != (DWORD)chunk_len(k))){
+				return SEFILE_RECRYPT_ERROR;
+			}
+#endif
+			return 0;
+		};
+		auto recrypt_chunk = [&](size_t k) -> uint16_t {
+			size_t count = chunk_len(k) / sector_size;
+			uint64_t offset = pos_to_cipher_block(chunk_pos(k), sector_size);
+			if(oldfile.crypt_sector_batch(chunk_buff(k), clear.get(), count, sector_size, offset, oldfile.handleptr->nonce_ctr, oldfile.handleptr->nonce_pbkdf2, CryptoInitialisation::Direction::DECRYPT)){
+				return SEFILE_RECRYPT_ERROR;
+			}
+			for(size_t i = 0; i < count; i++){ // sectors integrity check
+				if(memcmp(sector_signature(chunk_buff(k) + i * sector_size, sector_size), sector_signature(clear.get() + i * sector_size, sector_size), B5_SHA256_DIGEST_SIZE)){
+					return SEFILE_SIGNATURE_MISMATCH;
 				}
-			} else {
-				remove(enc_filename_new); // error, remove new file
-				override_key_check = false;
+			}
+			if(newfile.crypt_sector_batch(clear.get(), chunk_buff(k), count, sector_size, offset, newfile.handleptr->nonce_ctr, newfile.handleptr->nonce_pbkdf2, CryptoInitialisation::Direction::ENCRYPT)){
+				return SEFILE_RECRYPT_ERROR;
+			}
+			return 0;
+		};
+		auto write_chunk = [&](size_t k) -> uint16_t {
+#if defined(__linux__) || defined(__APPLE__)
+			if(pwrite(newfile.handleptr->fd, chunk_buff(k), chunk_len(k), chunk_pos(k)) != (ssize_t)chunk_len(k)){
+				return SEFILE_RECRYPT_ERROR;
+			}
+#elif _WIN32
+			DWORD nBytesWritten = 0;
+			if((SetFilePointer(newfile.handleptr->fd, (LONG)chunk_pos(k), nullptr, FILE_BEGIN) == INVALID_SET_FILE_POINTER) ||
+					(WriteFile(newfile.handleptr->fd, chunk_buff(k), (DWORD)chunk_len(k), &nBytesWritten, nullptr) == FALSE) || (nBytesWritten != (DWORD)chunk_len(k))){
 				return SEFILE_RECRYPT_ERROR;
 			}
+#endif
+			return 0;
+		};
+		if((physical_size == 0) || (ring == nullptr) || (clear == nullptr) || newfile.header_length_update(SEFILE_LENGTH_UNKNOWN) ||
+				newfile.Pipeline.run(n_chunks, read_chunk, recrypt_chunk, write_chunk)){
+			newfile.secure_close();
+			remove(enc_filename_new); // error, remove new file
+			override_key_check = false;
+			return SEFILE_RECRYPT_ERROR;
 		}
+		newfile.handleptr->length = oldsize; // recorded in the header by secure_close()
 		override_key_check = false;
 		oldfile.secure_close();
 		newfile.secure_close();
@@ -1654,10 +2373,34 @@ uint16_t valid_file_name(std::string& name){
     return 0;
 }
 
+uint16_t sector_batch_size(std::vector<se3Algo>& algTable){
+	static const char name[] = "AES_HMAC_SECTORS";
+	if(algTable.size() > L1Algorithms::Extensions::AES_HMACSHA256_SECTORS){
+		se3Algo& algo = algTable.at(L1Algorithms::Extensions::AES_HMACSHA256_SECTORS);
+		if((algo.type == L1Crypto::CryptoTypes::SE3_CRYPTO_TYPE_BLOCKCIPHER_AUTH) && (memcmp(algo.name, name, sizeof(name) - 1) == 0)){
+			return SEFILE_BATCH_SECTORS;
+		}
+	}
+	return 1;
+}
+
 size_t pos_to_cipher_block(size_t current_position){
 	return ((current_position / SEFILE_SECTOR_SIZE) - 1) * (SEFILE_SECTOR_DATA_SIZE / SEFILE_BLOCK_SIZE);
 }
 
+size_t pos_to_cipher_block(size_t current_position, size_t sector_size){
+	return ((current_position - SEFILE_SECTOR_SIZE) / sector_size) * ((sector_size - B5_SHA256_DIGEST_SIZE) / SEFILE_BLOCK_SIZE);
+}
+
+bool valid_sector_size(size_t sector_size){
+	return (sector_size >= SEFILE_SECTOR_SIZE) && (sector_size <= SEFILE_MAX_SECTOR_SIZE) && ((sector_size & (sector_size - 1)) == 0);
+}
+
+size_t sectors_per_batch(size_t sector_size){
+	size_t n = SEFILE_SECTORS_PER_UPDATE(sector_size);
+	return (n > 0) ? n : 1; // sectors larger than a request are processed one by one, see SEfile::crypt_sectors()
+}
+
 void get_path(char *full_path, char *path){
     if((full_path == nullptr) || (path == nullptr)){
     	return;
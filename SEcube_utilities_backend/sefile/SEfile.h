@@ -32,6 +32,12 @@
 
 #include "../sources/L1/L1.h"
 #include "SEfile_C_interface.h"
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 #define KEY_CHECK_INTERVAL 1 /**<  @brief Time interval (in seconds) used to check for the validity of the key used to encrypt the file. */
 #define SEFILE_NONCE_LEN 32
@@ -44,6 +50,44 @@ extern bool override_key_check; /**<  @brief Global flag that is used to bypass
  * first sector is 512 - SEFILE_NONCE_LEN - SEKEY_HDR_LEN and it must be a multiple of 16. */
 #define SEKEY_HDR_LEN 16
 
+/** @brief Maximum number of sectors of the given size encrypted or decrypted by a single CRYPTO_UPDATE, see SEfile::crypt_sector_batch().
+ * @details Each sector travels with its CTR nonce in the request and comes back with its signature in the response. It is 0 for sectors that do not fit in a request. */
+#define SEFILE_SECTORS_PER_UPDATE(size) ((L1Crypto::UpdateSize::DATAIN / (SEFILE_BLOCK_SIZE + (size))) < (L1Crypto::UpdateSize::DATAOUT / (size)) ? \
+										 (L1Crypto::UpdateSize::DATAIN / (SEFILE_BLOCK_SIZE + (size))) : (L1Crypto::UpdateSize::DATAOUT / (size)))
+#define SEFILE_BATCH_SECTORS SEFILE_SECTORS_PER_UPDATE(SEFILE_SECTOR_SIZE) /**< @brief Maximum number of sectors encrypted or decrypted by a single CRYPTO_UPDATE, reached with sectors of \ref SEFILE_SECTOR_SIZE. */
+
+/** @brief Bytes of decrypted sectors that secure_write() keeps in SEfile::WriteCache before encrypting and writing them, see SEfile::sector_cache_flush().
+ * @details At least one sector is kept when the sectors of the file are larger. */
+#define SEFILE_WRITE_CACHE_SIZE 65536
+
+/** @brief Bytes of sectors that secure_read() reads and decrypts together, when SEfile::ReadAhead is 0. */
+#define SEFILE_READ_AHEAD_SIZE 65536
+
+/** @brief Bytes of decrypted sectors kept by secure_read() in SEfile::ReadCache, enlarged if needed to hold the sectors read ahead. */
+#define SEFILE_READ_CACHE_SIZE 131072
+
+/** @brief Chunks of sectors that the disk read stage can read before the disk write stage has written them, when secure_read(), SEfile::sector_cache_flush()
+ * and secure_recrypt() overlap the disk and the SEcube, see SEFILE_PIPELINE::run(). Each chunk holds the sectors of one CRYPTO_UPDATE. */
+#define SEFILE_PIPELINE_DEPTH 4
+
+/** @brief Value of SEFILE_HEADER::ver for files whose data sectors are SEFILE_HEADER::sector_size bytes long.
+ * @details Files of version 0 (the only ones written by older releases) ignore SEFILE_HEADER::sector_size and have sectors of \ref SEFILE_SECTOR_SIZE bytes.
+ * The header sector is always \ref SEFILE_SECTOR_SIZE bytes long, the data sectors follow it. */
+#define SEFILE_VERSION_SECTOR_SIZE 1
+
+/** @brief Value of SEFILE_HEADER::ver for files that also record their length in SEFILE_HEADER::length, the version of the files created by SEfile::secure_create().
+ * @details The length of the files of the older versions is computed from the last sector. Releases that only know version 0 do not check the version: they
+ * open these files and can change them without updating the length, so the length is bound to the data by \ref SEFILE_HEADER_LAST_SIGNATURE. */
+#define SEFILE_VERSION_FILE_LENGTH 2
+
+/** @brief Offset, in the data of the header sector, of the copy of the signature of the last data sector taken when SEFILE_HEADER::length was written
+ * (zeros if the file has no data sectors), from version \ref SEFILE_VERSION_FILE_LENGTH.
+ * @details The length is used only if the last sector still has that signature. The file name (at most 255 bytes after SEFILE_HEADER) always ends before it. */
+#define SEFILE_HEADER_LAST_SIGNATURE (SEFILE_LOGIC_DATA - B5_SHA256_DIGEST_SIZE)
+
+/** @brief Value of SEFILE_HEADER::length while the file is being changed, and of SEFILE_HANDLE::length until the length of the file is known. */
+#define SEFILE_LENGTH_UNKNOWN 0xFFFFFFFF
+
 /** @brief The SEFILE_HANDLE struct
  * This abstract data type is used to hide from higher level of abstraction its implementation. The data stored in here are the current physical file pointer position and the file descriptor OS-dependent data type. */
 #pragma pack(push,1)
@@ -57,6 +101,9 @@ struct SEFILE_HANDLE {
     uint8_t nonce_ctr[16];  /**< Nonce used for the CTR feedback*/
     uint8_t nonce_pbkdf2[SEFILE_NONCE_LEN]; /**< Nonce used for the PBKDF2*/
     char name[MAX_PATHNAME]; /*< String that contains the name of the file. This is exploited only by the SEcure Database in order to run other databases apart from the one of SEkey. */
+    uint32_t sector_size;   /**< Size of the data sectors of the file, see SEFILE_HEADER::sector_size*/
+    uint32_t length;        /**< Valid bytes of the file, \ref SEFILE_LENGTH_UNKNOWN until they are known*/
+    uint8_t changed;        /**< 1 if the file was changed after the length in its header was last written*/
     SEFILE_HANDLE();
 };
 
@@ -77,9 +124,9 @@ struct SEFILE_HEADER {
 	SEKEY_HEADER key_header; /**< The header with the ID of the key and the algorithm. */
     uint8_t nonce_ctr[16];		            /**< 16 random bytes storing the IV for next sectors*/
     int32_t magic;				            /**< 4 bytes used to represent file type (not used yet)*/
-    int16_t ver;				            /**< 2 bytes used to represent current filesystem version (not used yet)*/
-    int32_t uid;				            /**< 4 bytes not used yet*/
-    int32_t uid_cnt;			            /**< 4 bytes not used yet*/
+    int16_t ver;				            /**< 2 bytes used to represent current filesystem version: 0, \ref SEFILE_VERSION_SECTOR_SIZE or \ref SEFILE_VERSION_FILE_LENGTH*/
+    uint32_t sector_size;		            /**< 4 bytes with the size of the data sectors, valid from version \ref SEFILE_VERSION_SECTOR_SIZE (0 before, when the sectors are \ref SEFILE_SECTOR_SIZE bytes long)*/
+    uint32_t length;			            /**< 4 bytes with the valid bytes of the file (\ref SEFILE_LENGTH_UNKNOWN while it is changed), valid from version \ref SEFILE_VERSION_FILE_LENGTH (0 before)*/
     uint8_t fname_len;			            /**< 1 byte to express how long is the filename.*/
 };
 
@@ -104,6 +151,80 @@ struct SEFILE_SECTOR {
 };
 #pragma pack(pop)
 
+/** @brief The SEFILE_SESSION struct
+ * A crypto session left open on the SEcube to encrypt or decrypt the sectors of a file without a new CRYPTO_INIT for each sector.
+ * The session is valid only for the key, the nonce_pbkdf2 and the login it was opened with. */
+struct SEFILE_SESSION {
+	bool open;								/**< True if sess_id is the ID of a session opened on the SEcube. */
+	uint32_t sess_id;						/**< The ID of the session. */
+	uint32_t key_id;						/**< The key used by the session. */
+	uint32_t login_count;					/**< Value of L1::L1GetSessionLoginCount() when the session was opened. */
+	uint8_t nonce_pbkdf2[SEFILE_NONCE_LEN];	/**< The nonce used to derive the key of the signatures, see \ref SEFILE_HEADER. */
+	SEFILE_SESSION(); /**< Constructor used to initialize all the fields of the struct to zero. */
+};
+
+/** @brief The SEFILE_CACHE struct
+ * Consecutive data sectors of the open file, decrypted, where secure_write() merges the data it is given.
+ * The sectors changed are encrypted and written to the file only by SEfile::sector_cache_flush(). */
+struct SEFILE_CACHE {
+	std::unique_ptr<uint8_t[]> sectors;	/**< Room for max_sectors sectors of sector_size bytes, laid out as in the file. */
+	std::vector<bool> dirty;				/**< True for the sectors changed since they were read from the file or written to it. */
+	size_t sector_size;						/**< Size of the sectors, see SEFILE_HANDLE::sector_size. */
+	size_t max_sectors;						/**< How many sectors fit in the cache. */
+	size_t first_sector;					/**< Index of the first sector cached, 0 being the first sector after the header. */
+	size_t n_sectors;						/**< How many sectors are cached, from first_sector on. */
+	SEFILE_CACHE(); /**< Constructor used to initialize all the fields of the struct to zero. */
+};
+
+/** @brief The SEFILE_READ_CACHE struct
+ * Decrypted data sectors of the open file, kept by secure_read() and replaced starting from the least recently used. */
+struct SEFILE_READ_CACHE {
+	typedef std::list<std::pair<size_t, uint8_t*>> lru_list; /**< Index of a sector, 0 being the first sector after the header, and its slot in sectors. */
+	std::unique_ptr<uint8_t[]> sectors;	/**< Room for max_sectors sectors of sector_size bytes. */
+	lru_list lru;							/**< The sectors cached, the most recently used first. */
+	std::unordered_map<size_t, lru_list::iterator> map; /**< Position in lru of each sector cached, by index. */
+	std::vector<uint8_t*> free_slots;		/**< Slots of sectors not used. */
+	size_t sector_size;						/**< Size of the sectors, see SEFILE_HANDLE::sector_size. */
+	size_t max_sectors;						/**< How many sectors fit in the cache. */
+	SEFILE_READ_CACHE(); /**< Constructor used to initialize all the fields of the struct to zero. */
+};
+
+/** @brief A stage of SEFILE_PIPELINE::run(), called with the index of the chunk of sectors to process; it returns 0 in case of success. */
+typedef std::function<uint16_t(size_t)> SEFILE_STAGE;
+
+/** @brief The SEFILE_PIPELINE struct
+ * Runs chunks of sectors through the disk read, SEcube crypto and disk write stages of secure_read(), SEfile::sector_cache_flush() and secure_recrypt().
+ * The disk stages run in two worker threads, started by the first run() that needs them and stopped when the struct is destroyed, that wait for the next run() in between. */
+struct SEFILE_PIPELINE {
+	std::mutex lock;						/**< Protects all the fields below. */
+	std::condition_variable wake;			/**< Notified when a job starts or the workers have to stop. */
+	std::condition_variable progress;		/**< Notified when a stage completes a chunk or a worker ends a job. */
+	std::thread workers[2];					/**< The first runs the stage before the crypto stage, the second the stage after it. */
+	bool started;							/**< True if the workers are running. */
+	bool quit;								/**< Tells the workers to stop. */
+	uint64_t job;							/**< Incremented by each run() given to the workers. */
+	size_t busy;							/**< Workers that have not ended the current job yet. */
+	size_t n_chunks;						/**< Chunks of the current job. */
+	size_t n_stages;						/**< Stages of the current job, the empty ones are skipped. */
+	const SEFILE_STAGE* stages[3];			/**< Stages of the current job, in order. */
+	size_t worker_stage[2];					/**< Index in stages of the stage run by each worker, n_stages if it has none. */
+	size_t done[3];							/**< Chunks completed by each stage. */
+	uint16_t ret;							/**< The first error of the current job. */
+	SEFILE_PIPELINE(); /**< Constructor used to initialize all the fields of the struct to zero, the workers are not started. */
+	~SEFILE_PIPELINE(); /**< Destructor, stops the workers. */
+	/** @brief Runs n_chunks chunks through the stages, in this order for each chunk (empty stages are skipped).
+	 * @details The crypto stage runs in the calling thread, the only one talking to the SEcube, while the workers read and write the disk; the first stage gets at most
+	 * SEFILE_PIPELINE_DEPTH chunks ahead of the last one (the buffers of the chunks can be reused after that). The first error stops all the stages and is returned.
+	 * The stages run one after the other if there is only one chunk, or if the workers cannot be started.
+	 * @return 0 in case of success. */
+	uint16_t run(size_t n_chunks, const SEFILE_STAGE& read_stage, const SEFILE_STAGE& crypt_stage, const SEFILE_STAGE& write_stage);
+private:
+	bool start(); /**< Starts the workers if they are not running, false if they cannot be started. */
+	void worker(size_t w); /**< Body of workers[w]. */
+	void stage(size_t s); /**< Runs stages[s] on all the chunks of the current job. */
+	uint16_t call(size_t s, size_t k); /**< Runs stages[s] on chunk k, turning an exception into an error. */
+};
+
 /* functions not related to SEfile objects that can be called by higher levels */
 /** @brief This function retrieves the key ID and the algorithm used to encrypt the file specified by filename.
 * @param [in] filename Absolute or relative path of the file.
@@ -175,6 +296,10 @@ uint16_t valid_directory_name(std::string& name);
  * minimum number of characters, etc.).*/
 uint16_t valid_file_name(std::string& name);
 size_t pos_to_cipher_block(size_t current_position); /**< @brief Internally used by SEfile functions. */
+size_t pos_to_cipher_block(size_t current_position, size_t sector_size); /**< @brief Same as pos_to_cipher_block() but for files with data sectors of sector_size bytes. */
+bool valid_sector_size(size_t sector_size); /**< @brief Internally used by SEfile functions, returns true if the data sectors of a file can be sector_size bytes long. */
+size_t sectors_per_batch(size_t sector_size); /**< @brief Internally used by SEfile functions, returns how many sectors of sector_size bytes secure_read() and secure_write() process together. */
+uint16_t sector_batch_size(std::vector<se3Algo>& algTable); /**< @brief Internally used by SEfile functions, returns the value of SEfile::EnvBatch for the algorithms of a SEcube. */
 void compute_blk_offset(size_t current_offset, uint8_t* nonce); /**< @brief Internally used by SEfile functions. */
 void get_filename(char *path, char *file_name); /**< @brief Extract the name of a file from its path. */
 void get_path(char *full_path, char *path); /**< @brief Extract the path of a file removing the file name. */
@@ -191,6 +316,13 @@ class SEfile{
 public:
 	 uint32_t EnvKeyID; /**< @brief The key ID used by this SEfile instance. This key will be used for encryption and decryption. */
 	 uint16_t EnvCrypto; /**<  @brief The algorithm to be used with the key. */
+	 uint16_t EnvBatch; /**<  @brief Sectors sent in each CRYPTO_UPDATE by crypt_sector_batch(): 0 until the SEcube is asked, 1 if it supports only one sector at a time. */
+	 SEFILE_SESSION EnvSession[2]; /**<  @brief Sessions used to encrypt ([0]) and to decrypt ([1]) the sectors, released by secure_close() and secure_finit(). */
+	 SEFILE_CACHE WriteCache; /**<  @brief Sectors written by secure_write() that may not be in the file yet, see sector_cache_flush(). */
+	 SEFILE_READ_CACHE ReadCache; /**<  @brief Sectors decrypted by secure_read(), see sector_lru_get(). */
+	 SEFILE_PIPELINE Pipeline; /**<  @brief Overlaps the disk and the SEcube in secure_read(), sector_cache_flush() and secure_recrypt(). */
+	 SEFILE_SECTOR Header; /**<  @brief Decrypted header of the open file, written again by header_length_update(). */
+	 uint32_t ReadAhead; /**<  @brief Sectors that secure_read() reads and decrypts at once when one is not in \ref ReadCache, 0 for SEFILE_READ_AHEAD_SIZE bytes. */
 	 time_t LastEncryptCheckTime; /**<  @brief The last time the validity of the key used by this file was checked, requiring write (encrypt, requires active key) privilege. */
 	 time_t LastDecryptCheckTime; /**<  @brief The last time the validity of the key used by this file was checked, requiring read (decrypt, does not require active key) privilege. */
 	 bool IsOpen; /**<  @brief Flag that is TRUE if the file is open, FALSE otherwise. */
@@ -227,28 +359,35 @@ public:
 			 * @param [in] path The absolute/relative path (plaintext, i.e. myfile.txt) where to open or create the file.
 			 * @param [in] mode The mode in which the file should be opened. See \ref Mode_Defines.
 			 * @param [in] creation Define if the file should be created or it should already exist. See \ref Creation_Defines.
+			 * @param [in] sector_size Size of the data sectors of a new file, a power of 2 from \ref SEFILE_SECTOR_SIZE to \ref SEFILE_MAX_SECTOR_SIZE.
+			 * Larger sectors need fewer requests to the SEcube and less space on disk for the signatures. An existing file keeps the size it was created with.
 			 * @return The function returns 0 in case of success. See \ref errorValues for error list.
 			 * @details Notice that you must specify if you want to open the file or if you want to create it. There is not the
 			 * possibility of "create if the file does not exist", therefore if you need such behaviour you must check in advance
 			 * if the file exists or not (i.e. computing the encrypted name of the file with crypto_filename() and then checking
 			 * with OS system calls if the file exists). */
-	 	 	 uint16_t secure_open(char *path, int32_t mode, int32_t creation);
+	 	 	 uint16_t secure_open(char *path, int32_t mode, int32_t creation, uint32_t sector_size = SEFILE_SECTOR_SIZE);
 
 			/** @brief This function releases the resources related to the underlying SEfile object (i.e. closes the file descriptor).
-			* @return The function returns 0 in case of success. See \ref errorValues for error list. */
+			* @return The function returns 0 in case of success. See \ref errorValues for error list.
+			* @details If the file was changed, its length is recorded in the header, see header_length_update(). */
 			 uint16_t secure_close();
 
 			 /** @brief This function reads dataOut_len bytes into dataOut from the file descriptor managed by the underlying SEfile object.
 			 * @param [out] dataOut An already allocated array of characters where to store data read.
 			 * @param [in] dataOut_len Number of characters we want to read.
 			 * @param [out] bytesRead Number of effective characters read, it cannot be NULL.
-			 * @return The function returns 0 in case of success. See \ref errorValues for error list. */
+			 * @return The function returns 0 in case of success. See \ref errorValues for error list.
+			 * @details The sectors are taken from \ref ReadCache. A sector not cached is read and decrypted together with the following ones,
+			 * up to \ref ReadAhead sectors or as many as the request needs if they are more, stopping at the first sector already cached. */
 			 uint16_t secure_read(uint8_t *dataOut, uint32_t dataOut_len, uint32_t *bytesRead);
 
 			 /** @brief This function writes the bytes stored at dataIn to the encrypted file managed by the SEfile object on which this method is called.
 			 * @param [in] dataIn The array of bytes that have to be written.
 			 * @param [in] dataIn_len The length, in bytes, of the data that have to be written.
-			 * @return The function returns a 0 in case of success. See \ref errorValues for error list. */
+			 * @return The function returns a 0 in case of success. See \ref errorValues for error list.
+			 * @details The data are merged into the sectors of \ref WriteCache: they reach the file when the cache is full, or with
+			 * secure_sync() and secure_close(). The other functions of SEfile flush the cache when they need the file to be up to date. */
 			 uint16_t secure_write(uint8_t *dataIn, uint32_t dataIn_len);
 
 			 /** @brief This function is used to move the file pointer of a file managed by a SEfile object.
@@ -263,7 +402,8 @@ public:
 			 * @return The function returns 0 in case of success. See \ref errorValues for error list. */
 			 uint16_t secure_truncate(uint32_t size);
 
-			 /** @brief This function is used in case we want to be sure that the physical file is synced with the OS buffers.
+			 /** @brief This function is used in case we want to be sure that the physical file is synced with the OS buffers, after writing the sectors still in \ref WriteCache
+			 * and the length of the file in the header.
 			 * @return The function returns 0 in case of success. See \ref errorValues for error list. */
 			 uint16_t secure_sync();
 		///@}
@@ -281,7 +421,7 @@ public:
 			 /** @brief This function creates a new secure file managed with SEfile. If the file already exists, it is overwritten
 			 *        with an empty one, all previous data are lost.
 			 * @param [in] path Specify the absolute/relative path where to create the file. No encrypted directory are allowed inside the path.
-			 * @param [out] hFile The pointer in which the file handle to the new opened file is placed after a success, NULL in case of failure.
+			 * @param [in,out] hFile The file handle where to store the new opened file, with SEFILE_HANDLE::sector_size already set to the size of the data sectors.
 			 * @param [in] mode The mode in which the file should be created. See \ref Mode_Defines.
 			 * @return The function returns 0 in case of success. See \ref errorValues for error list.
 			 * @details You do not need to call this function explicitly. Use secure_open() instead. */
@@ -294,7 +434,9 @@ public:
 
 			 /** @brief This function is used to compute the total logic size of a file that is already open within a SEfile object.
 			 * @param [out] length Where the logic size of the file is stored.
-			 * @return The function returns 0 in case of success. See \ref errorValues for error list. This function works as SEfile::secure_getfilesize(). */
+			 * @return The function returns 0 in case of success. See \ref errorValues for error list. This function works as SEfile::secure_getfilesize().
+			 * @details The size is SEFILE_HANDLE::length, read from the header by secure_open() and updated by secure_write() and secure_truncate(). Only when it is
+			 * not known (files of older versions, or whose header was not written again after a change) the last sector is read and decrypted. */
 			 uint16_t get_filesize(uint32_t * length);
 
 			 /** \brief This function encrypts a header buffer by exploiting the functions provided by \ref L1.h.
@@ -324,6 +466,73 @@ public:
 			 *  \param [in] nonce_pbkdf2 Initialization vector, see \ref SEFILE_HEADER
 			 *  \return The function returns 0 in case of success. See \ref errorValues for error list. */
 			 uint16_t decrypt_sectors(void *buff_crypt, void *buff_decrypt, size_t datain_len, size_t current_offset, uint8_t* nonce_ctr, uint8_t* nonce_pbkdf2);
+
+			 /** \brief This function encrypts or decrypts consecutive sectors of the file, packing up to \ref SEFILE_SECTORS_PER_UPDATE of them in each CRYPTO_UPDATE.
+			 *  \param [in] buff_in The sectors to be encrypted or decrypted.
+			 *  \param [out] buff_out The preallocated sectors where to store the result, each one with the signature computed by the SEcube.
+			 *  \param [in] n_sectors How many sectors are stored in buff_in.
+			 *  \param [in] sector_size The size of a sector, laid out as \ref SEFILE_SECTOR with SEFILE_SECTOR::data enlarged to fill it.
+			 *  \param [in] current_offset Position of the first sector inside the file expressed as number of cipher blocks
+			 *  \param [in] nonce_ctr Initialization vector, see \ref SEFILE_HEADER
+			 *  \param [in] nonce_pbkdf2 Initialization vector, see \ref SEFILE_HEADER
+			 *  \param [in] direction See \ref SE3_DIR.
+			 *  \return The function returns 0 in case of success. See \ref errorValues for error list.
+			 *  \details The result is the same of crypt_sectors() or decrypt_sectors() called on each sector, which is what this function does if the
+			 *  SEcube does not support L1Algorithms::Extensions::AES_HMACSHA256_SECTORS. */
+			 uint16_t crypt_sector_batch(void *buff_in, void *buff_out, size_t n_sectors, size_t sector_size, size_t current_offset, uint8_t* nonce_ctr, uint8_t* nonce_pbkdf2, uint16_t direction);
+
+			 /** \brief This function checks if the sectors can be processed by the sessions kept in \ref EnvSession, asking the SEcube the first time.
+			 *  \return True if the file uses AES-HMAC-SHA256 and the SEcube supports L1Algorithms::Extensions::AES_HMACSHA256_SECTORS. */
+			 bool sector_session_supported();
+
+			 /** \brief This function encrypts or decrypts sectors with a single CRYPTO_UPDATE on the session of \ref EnvSession for the direction, opening it if needed.
+			 *  \param [in] direction See \ref SE3_DIR.
+			 *  \param [in] nonce_pbkdf2 Initialization vector, see \ref SEFILE_HEADER
+			 *  \param [in] nonces The CTR nonce of each sector.
+			 *  \param [in] n_sectors How many sectors are stored in buff_in.
+			 *  \param [in] sector_len The size of a sector, including the signature.
+			 *  \param [in] buff_in The sectors to be encrypted or decrypted; their signatures are not read.
+			 *  \param [out] buff_out The preallocated buffer where to store the sectors, each one with the signature computed by the SEcube.
+			 *  \return The function returns 0 in case of success. See \ref errorValues for error list. */
+			 uint16_t sector_update(uint16_t direction, uint8_t* nonce_pbkdf2, uint8_t* nonces, size_t n_sectors, size_t sector_len, uint8_t* buff_in, uint8_t* buff_out);
+
+			 /** \brief This function closes the sessions of \ref EnvSession still open on the SEcube. */
+			 void sector_session_close();
+
+			 /** \brief This function returns a sector of \ref WriteCache, reading and decrypting it if it is not cached yet.
+			 *  \param [in] sector_index Index of the sector, 0 being the first sector after the header.
+			 *  \param [in] overwrite True if the caller is going to overwrite all the data of the sector, which then is not read.
+			 *  \param [out] ret 0 in case of success. See \ref errorValues for error list.
+			 *  \return The decrypted sector, nullptr in case of error.
+			 *  \details A sector that does not follow the ones cached, when the cache is full, makes the function flush the cache and start it again from that sector.
+			 *  Sectors beyond the end of the file are not read either, they are returned empty. */
+			 uint8_t* sector_cache_get(size_t sector_index, bool overwrite, uint16_t *ret);
+
+			 /** \brief This function encrypts the sectors changed in \ref WriteCache and writes them to the file, leaving the file pointer where it was.
+			 *  \param [in] release True to empty the cache after the sectors are written.
+			 *  \return The function returns 0 in case of success. See \ref errorValues for error list. */
+			 uint16_t sector_cache_flush(bool release);
+
+			 /** \brief This function looks for a sector in \ref ReadCache, marking it as the most recently used.
+			 *  \param [in] sector_index Index of the sector, 0 being the first sector after the header.
+			 *  \return The decrypted sector, nullptr if it is not cached. */
+			 uint8_t* sector_lru_get(size_t sector_index);
+
+			 /** \brief This function copies a decrypted sector in \ref ReadCache, in place of the least recently used one if the cache is full.
+			 *  \param [in] sector_index Index of the sector, 0 being the first sector after the header.
+			 *  \param [in] sector The decrypted sector, of SEFILE_HANDLE::sector_size bytes. */
+			 void sector_lru_put(size_t sector_index, const uint8_t *sector);
+
+			 /** \brief This function removes from \ref ReadCache the sectors that are going to change in the file.
+			 *  \param [in] first_sector Index of the first sector to remove.
+			 *  \param [in] n_sectors How many sectors to remove. */
+			 void sector_lru_drop(size_t first_sector, size_t n_sectors);
+
+			 /** \brief This function encrypts \ref Header with the given length and writes it to the file, if the file records its length and the header does not have that length already.
+			 *  The signature of the last sector is copied at \ref SEFILE_HEADER_LAST_SIGNATURE; if the sectors of the file do not hold exactly length bytes, \ref SEFILE_LENGTH_UNKNOWN is written instead.
+			 *  \param [in] length The valid bytes of the file, or \ref SEFILE_LENGTH_UNKNOWN before the file is changed.
+			 *  \return The function returns 0 in case of success. See \ref errorValues for error list. */
+			 uint16_t header_length_update(uint32_t length);
 		///@}
 	/** @}*/
 	 /**
@@ -182,6 +182,7 @@
 		#define SEFILE_SECTOR_DATA_SIZE		(SEFILE_SECTOR_SIZE - B5_SHA256_DIGEST_SIZE) /**< The actual valid data may be as much as this, since the signature is coded on 32 bytes. */
 		#define SEFILE_LOGIC_DATA			(SEFILE_SECTOR_DATA_SIZE-2) /**< The largest multiple of \ref SEFILE_BLOCK_SIZE that can fit in \ref SEFILE_SECTOR_DATA_SIZE */
 		#define SEFILE_SECTOR_OVERHEAD 		(SEFILE_SECTOR_SIZE-SEFILE_LOGIC_DATA) /**< The amount of Overhead created by \ref SEFILE_SECTOR::len and \ref SEFILE_SECTOR::signature */
+		#define SEFILE_MAX_SECTOR_SIZE		65536  /**< Largest size of the data sectors of a file, see SEFILE_HEADER::sector_size. Sectors of any power of 2 from \ref SEFILE_SECTOR_SIZE to this size are supported. */
 	///@}
 /** @}*/
 
@@ -46,6 +46,10 @@ public:
 	virtual void L0Close(uint8_t devPtr) = 0;
 	/** @brief Send command to SEcube, wait for reply, read reply (low level, used also by L1TXRX()). */
 	virtual void L0TXRX(uint16_t reqCmd, uint16_t reqCmdFlags, uint16_t reqLen, const uint8_t* reqData, uint16_t* respStatus, uint16_t* respLen, uint8_t* respData) = 0;
+	/** @brief Send command to SEcube without waiting for the reply (first half of L0TXRX()). Only one command at a time can be in flight. */
+	virtual void L0TXSubmit(uint16_t reqCmd, uint16_t reqCmdFlags, uint16_t reqLen, const uint8_t* reqData) = 0;
+	/** @brief Wait for and read the reply to the command sent with L0TXSubmit() (second half of L0TXRX()). */
+	virtual void L0RXReap(uint16_t* respStatus, uint16_t* respLen, uint8_t* respData) = 0;
 	/** @brief The SEcube echoes back any data it receives. */
 	virtual uint16_t L0Echo(const uint8_t* dataIn, uint16_t dataInLen, uint8_t* dataOut) = 0;
 };
@@ -31,9 +31,288 @@
  */
 
 #include "L0_base.h"
+#include "../L0 Emulator/L0_emulator.h"
 #include <memory>
 #include <time.h>
 #include <sstream>
+#ifndef _WIN32
+#include <algorithm>
+#include <atomic>
+#include <system_error>
+#include <thread>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#endif
+
+std::mutex L0BufferPool::lock;
+std::vector<uint8_t*> L0BufferPool::pool;
+
+uint8_t* L0BufferPool::Acquire() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (!pool.empty()) {
+			uint8_t* buf = pool.back();
+			pool.pop_back();
+			return buf;
+		}
+	}
+#ifdef _WIN32
+	return (uint8_t*)_aligned_malloc(SE3_IO_BUFFER_SIZE, SE3_IO_PAGE);
+#else
+	void* buf = NULL;
+	if (posix_memalign(&buf, SE3_IO_PAGE, SE3_IO_BUFFER_SIZE) != 0)
+		return NULL;
+	return (uint8_t*)buf;
+#endif
+}
+
+void L0BufferPool::Release(uint8_t* buf) {
+	if (buf == NULL)
+		return;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (pool.size() < SE3_IO_POOL_MAX) {
+			pool.push_back(buf);
+			return;
+		}
+	}
+#ifdef _WIN32
+	_aligned_free(buf);
+#else
+	free(buf);
+#endif
+}
+
+std::shared_ptr<uint8_t> L0BufferPool::AcquireShared() {
+	uint8_t* buf = Acquire();
+	if (buf == NULL)
+		throw std::bad_alloc();
+	return std::shared_ptr<uint8_t>(buf, Release);
+}
+
+bool L0BufferPool::IsAligned(const void* buf) {
+	return ((uintptr_t)buf % L0Communication::Parameter::COMM_BLOCK) == 0;
+}
+
+#ifndef _WIN32
+std::mutex L0Discovery::lock;
+std::map<std::string, L0Discovery::se3NegativeEntry> L0Discovery::negative;
+
+//decode the octal escapes (\040 for space...) used in the paths of /proc/self/mountinfo
+static std::string Se3MountUnescape(const char* s) {
+	std::string out;
+	for (; *s != '\0'; s++) {
+		if (s[0] == '\\' && s[1] >= '0' && s[1] <= '3' && s[2] >= '0' && s[2] <= '7' && s[3] >= '0' && s[3] <= '7') {
+			out.push_back((char)(((s[1] - '0') << 6) | ((s[2] - '0') << 3) | (s[3] - '0')));
+			s += 3;
+		}
+		else
+			out.push_back(*s);
+	}
+	return out;
+}
+
+bool L0Discovery::IsCandidate(const char* fsType, const char* source) {
+	//read-only images can not host the .se3magic file
+	static const char* const readOnly[] = { "squashfs", "iso9660", "udf", "erofs", "cramfs" };
+
+	//pseudo, memory and network filesystems are not backed by a block device
+	if (strncmp(source, "/dev/", 5) != 0)
+		return false;
+	for (const char* t : readOnly) {
+		if (strcmp(fsType, t) == 0)
+			return false;
+	}
+	return true;
+}
+
+void L0Discovery::ForgetNegative() {
+	std::lock_guard<std::mutex> guard(lock);
+	negative.clear();
+}
+
+bool L0Discovery::RetryDue() {
+	uint64_t now = L0Support::Se3ClockUs();
+	std::lock_guard<std::mutex> guard(lock);
+	for (const auto& entry : negative) {
+		if (now >= entry.second.retry)
+			return true;
+	}
+	return false;
+}
+
+void L0Discovery::Scan(std::vector<se3DiscoveredDrive>& found) {
+	std::vector<std::string> paths;
+	std::vector<se3MountId> ids;
+	uint64_t now = L0Support::Se3ClockUs();
+	found.clear();
+
+#ifdef SE3_WITH_EMULATOR
+	if (L0Emulator::Enabled()) {
+		//the emulated SEcubes replace the mounted devices, each one is attached while its directory exists
+		for (const std::string& root : L0Emulator::Roots()) {
+			struct stat st;
+			if (stat(root.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+				continue;
+			paths.push_back(root);
+			ids.push_back({ -1, 0 });
+		}
+	}
+	else
+#endif
+	{
+		FILE* fp = fopen("/proc/self/mountinfo", "r");
+		if (fp == NULL)
+			return;
+		char line[SE3_DRIVE_BUF_MAX];
+		char mountPoint[SE3_DRIVE_BUF_MAX], fsType[SE3_DRIVE_BUF_MAX], source[SE3_DRIVE_BUF_MAX];
+		std::vector<std::string> mounted;
+		std::lock_guard<std::mutex> guard(lock);
+		while (fgets(line, sizeof(line), fp) != NULL) {
+			se3MountId id;
+			unsigned int major, minor;
+			//mount id, parent id, major:minor, root, mount point, options, optional fields, "-", type, source, options
+			const char* sep = strstr(line, " - ");
+			if (sep == NULL || sscanf(line, "%d %*d %u:%u %*s %1023s", &id.mountId, &major, &minor, mountPoint) != 4 ||
+					sscanf(sep + 3, "%1023s %1023s", fsType, source) != 2)
+				continue;
+			if (!IsCandidate(fsType, source))
+				continue;
+			id.dev = makedev(major, minor);
+			std::string path = Se3MountUnescape(mountPoint);
+			if (path.size() >= L0Communication::Parameter::SE3_MAX_PATH - SE3_MAGIC_FILE_LEN - 1)
+				continue;
+			mounted.push_back(path);
+			auto it = negative.find(path);
+			if (it != negative.end()) {
+				if (it->second.id.mountId == id.mountId && it->second.id.dev == id.dev && now < it->second.retry)
+					continue;
+				if (it->second.id.mountId != id.mountId || it->second.id.dev != id.dev)
+					negative.erase(it); //mounted again, a new device
+			}
+			paths.push_back(path);
+			ids.push_back(id);
+		}
+		fclose(fp);
+		//forget the mount points that are gone, they would be due for a retry forever
+		for (auto it = negative.begin(); it != negative.end(); ) {
+			if (std::find(mounted.begin(), mounted.end(), it->first) == mounted.end())
+				it = negative.erase(it);
+			else
+				++it;
+		}
+	}
+
+	//probe the candidates, at most SE3_DISCOVERY_THREADS at a time
+	std::vector<se3DiscoveredDrive> drives(paths.size());
+	std::unique_ptr<bool[]> ok(new bool[paths.size()]());
+	std::atomic<size_t> next(0);
+	auto probe = [&]() {
+		size_t i;
+		while ((i = next++) < paths.size()) {
+			strcpy(drives[i].path, paths[i].c_str());
+			ok[i] = L0Support::Se3Probe(drives[i].path, L0Support::Se3Deadline(0), &drives[i].info);
+		}
+	};
+	size_t nThreads = std::min<size_t>(paths.size(), SE3_DISCOVERY_THREADS);
+	std::vector<std::thread> workers;
+	for (size_t t = 1; t < nThreads; t++) {
+		try {
+			workers.emplace_back(probe);
+		}
+		catch (const std::system_error&) {
+			break; //the calling thread probes what is left
+		}
+	}
+	probe();
+	for (std::thread& w : workers)
+		w.join();
+
+	std::lock_guard<std::mutex> guard(lock);
+	for (size_t i = 0; i < paths.size(); i++) {
+		if (ok[i]) {
+			found.push_back(drives[i]);
+			negative.erase(paths[i]);
+		}
+		else if (ids[i].mountId >= 0) {
+			se3NegativeEntry& entry = negative[paths[i]]; //a new entry has no failures
+			uint32_t failures = (entry.failures < 31) ? entry.failures : 31;
+			uint64_t delay = std::min<uint64_t>((uint64_t)SE3_DISCOVERY_RETRY_MS << failures, SE3_DISCOVERY_RETRY_MAX_MS);
+			entry.id = ids[i];
+			entry.failures++;
+			entry.retry = L0Support::Se3ClockUs() + delay * 1000;
+		}
+	}
+}
+
+std::mutex L0DeviceRegistry::lock;
+int L0DeviceRegistry::fd = -1;
+bool L0DeviceRegistry::valid = false;
+std::vector<se3DiscoveredDrive> L0DeviceRegistry::drives;
+
+//reading the whole file acknowledges the change of the mount table
+static void Se3MountsDrain(int fd) {
+	char buf[4096];
+	lseek(fd, 0, SEEK_SET);
+	while (read(fd, buf, sizeof(buf)) > 0)
+		;
+}
+
+bool L0DeviceRegistry::MountsChanged(int timeoutMs) {
+	if (fd < 0) {
+		fd = open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return true; //can not watch the mounts, always scan
+		Se3MountsDrain(fd);
+		return true;
+	}
+	struct pollfd p = { fd, POLLPRI, 0 };
+	if (poll(&p, 1, timeoutMs) <= 0 || !(p.revents & (POLLPRI | POLLERR)))
+		return false;
+	Se3MountsDrain(fd);
+	return true;
+}
+
+void L0DeviceRegistry::Snapshot(std::vector<se3DiscoveredDrive>& found) {
+	std::lock_guard<std::mutex> guard(lock);
+	//the directories of the emulated SEcubes are not in the mount table, they are always scanned again; the mount points
+	//that were not a SEcube are scanned again when their retry time expires
+#ifdef SE3_WITH_EMULATOR
+	bool emulated = L0Emulator::Enabled();
+#else
+	bool emulated = false;
+#endif
+	if (MountsChanged(0) || !valid || emulated || L0Discovery::RetryDue()) {
+		L0Discovery::Scan(drives);
+		valid = true;
+	}
+	found = drives;
+}
+
+bool L0DeviceRegistry::Wait(uint32_t timeoutMs) {
+	int watched;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (fd < 0 || !valid)
+			return true;
+		watched = fd;
+	}
+	struct pollfd p = { watched, POLLPRI, 0 };
+	if (poll(&p, 1, (int)timeoutMs) <= 0 || !(p.revents & (POLLPRI | POLLERR)))
+		return false;
+	std::lock_guard<std::mutex> guard(lock);
+	Se3MountsDrain(fd);
+	valid = false;
+	return true;
+}
+
+void L0DeviceRegistry::Invalidate() {
+	std::lock_guard<std::mutex> guard(lock);
+	valid = false;
+}
+#endif
 
 L0Base::L0Base() {
 	this->it = {};
@@ -55,7 +334,12 @@ void L0Base::AddDevice() {
 	L0Support::Se3PathCopy(_dev.info.path, this->it.deviceInfo.path);
 	_dev.info.status = this->it.deviceInfo.status;
 	_dev.opened = false;
-	_dev.f = {0};
+	_dev.f = {};
+#ifndef _WIN32
+	_dev.f.emu = -1;
+#endif
+	_dev.wait = {};
+	memset(_dev.latency, 0, sizeof(_dev.latency));
 
 	//add the device to the vector
 	this->dev.push_back(_dev);
@@ -70,6 +354,44 @@ void L0Base::ResetDeviceArray() {
 	this->dev.clear();
 }
 
+void L0Base::RemoveDevice(size_t pos) {
+	if (pos >= this->dev.size())
+		return;
+	this->dev.erase(this->dev.begin() + pos);
+	if (this->ptr >= this->dev.size())
+		this->ptr = 0;
+}
+
+int L0Base::FindDevice(const se3Char* path, const uint8_t* serialNo) {
+	std::basic_string<se3Char> p(path);
+	for (size_t i = 0; i < this->dev.size(); i++) {
+		if (p == this->dev[i].info.path && !memcmp(this->dev[i].info.serialno, serialNo, L0Communication::Size::SERIAL))
+			return (int)i;
+	}
+	return -1;
+}
+
+void L0Base::PushDeviceEvent(bool added, const se3DeviceInfo* info) {
+	se3DeviceEvent event;
+	event.added = added;
+	event.info = *info;
+	if (this->events.size() >= SE3_DEVICE_EVENTS_MAX)
+		this->events.pop_front(); //not read, i.e. by the utilities that only list the devices
+	this->events.push_back(event);
+}
+
+bool L0Base::HasDeviceEvents() {
+	return !this->events.empty();
+}
+
+bool L0Base::PopDeviceEvent(se3DeviceEvent* event) {
+	if (this->events.empty())
+		return false;
+	*event = this->events.front();
+	this->events.pop_front();
+	return true;
+}
+
 
 ///////////////
 //GET METHODS//
@@ -83,6 +405,10 @@ uint8_t* L0Base::GetDeviceHelloMsg() {
 	return this->dev[this->ptr].info.helloMsg;
 }
 
+const se3DeviceInfo* L0Base::GetDeviceInfo() {
+	return &this->dev[this->ptr].info;
+}
+
 se3Char* L0Base::GetDeviceInfoPath() {
 	return this->dev[this->ptr].info.path;
 }
@@ -107,6 +433,20 @@ uint8_t* L0Base::GetDeviceResponse() {
 	return this->dev[this->ptr].response.get();
 }
 
+se3Wait* L0Base::GetDeviceWait() {
+	return &(this->dev[this->ptr].wait);
+}
+
+se3LatencyHistogram* L0Base::GetDeviceLatency(size_t slot) {
+	if (slot >= SE3_LATENCY_SLOTS)
+		return NULL;
+	return &(this->dev[this->ptr].latency[slot]);
+}
+
+void L0Base::ResetDeviceLatency() {
+	memset(this->dev[this->ptr].latency, 0, sizeof(this->dev[this->ptr].latency));
+}
+
 //******************************//
 //Iterator GET methods
 uint8_t*	L0Base::GetDiscoDeviceHelloMsg() {
@@ -139,14 +479,14 @@ se3Char*	L0Base::GetDiscoDrivePath() {
 ///////////////
 //buffer allocation/deallocation
 void L0Base::AllocateDeviceRequest() {
-	std::shared_ptr<uint8_t> sp(new uint8_t[L0Communication::Parameter::COMM_N * L0Communication::Parameter::COMM_BLOCK], std::default_delete<uint8_t[]>());
+	std::shared_ptr<uint8_t> sp = L0BufferPool::AcquireShared();
 	memset(sp.get(), 0, L0Communication::Parameter::COMM_N * L0Communication::Parameter::COMM_BLOCK);
 	this->dev[this->ptr].request = std::move(sp);
 }
 
 //method to allocate the memory for the response buffer
 void L0Base::AllocateDeviceResponse() {
-	std::shared_ptr<uint8_t> sp(new uint8_t[L0Communication::Parameter::COMM_N * L0Communication::Parameter::COMM_BLOCK], std::default_delete<uint8_t[]>());
+	std::shared_ptr<uint8_t> sp = L0BufferPool::AcquireShared();
 	memset(sp.get(), 0, L0Communication::Parameter::COMM_N * L0Communication::Parameter::COMM_BLOCK);
 	this->dev[this->ptr].response = std::move(sp);
 }
@@ -201,12 +541,16 @@ void L0Base::SetDiscoDrivePath(se3Char* path) {
 void L0Base::SetDiscoDrivePath(se3Char* path){
 	this->it.driveIt.path = path;
 }
-void L0Base::SetDiscoDriveFile(FILE* fp) {
-	this->it.driveIt.fp = fp;
+std::vector<se3DiscoveredDrive>& L0Base::GetDiscoFound() {
+	return this->it.driveIt.found;
 }
 
-FILE* L0Base::GetDiscoDriveFile() {
-	return this->it.driveIt.fp;
+size_t L0Base::GetDiscoFoundNext() {
+	return this->it.driveIt.next;
+}
+
+void L0Base::SetDiscoFoundNext(size_t next) {
+	this->it.driveIt.next = next;
 }
 #endif
 
@@ -288,11 +632,108 @@ uint64_t L0Support::Se3Clock() {
 #endif
 }
 
+uint64_t L0Support::Se3ClockUs() {
+#ifdef _WIN32
+//WINDOWS
+	LARGE_INTEGER freq, count;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (uint64_t)((count.QuadPart / freq.QuadPart) * 1000000 + ((count.QuadPart % freq.QuadPart) * 1000000) / freq.QuadPart);
+#else
+//UNIX
+	uint64_t us;
+	struct timespec spec;
+	clock_gettime(CLOCK_MONOTONIC, &spec);
+	us = spec.tv_sec;
+	us *= 1000000;
+	us += (uint64_t)spec.tv_nsec / ((uint64_t)1000);
+	return us;
+#endif
+}
+
+void L0Support::Se3SleepUs(uint32_t us) {
+#ifdef _WIN32
+	Sleep((us + 999) / 1000); // round up, Sleep(0) only yields and the backoff of Se3WaitNext() would keep a core busy
+#else
+	usleep(us);
+#endif
+}
+
+//the request has been written, start waiting for the response
+void L0Support::Se3WaitStart(se3Wait* wait) {
+	wait->start = Se3ClockUs();
+	wait->spinStart = 0;
+	wait->backoff = 0;
+	wait->polls = 0;
+}
+
+/* called before each poll of block 0. The first poll is delayed until shortly before the expected
+ * turnaround of the device for the current command, then block 0 is polled without sleeping for SE3_WAIT_SPIN_US and finally
+ * the sleep between two polls is doubled at each poll, from SE3_WAIT_MIN_US up to SE3_WAIT_MAX_US. */
+void L0Support::Se3WaitNext(se3Wait* wait) {
+	uint64_t now = Se3ClockUs();
+	wait->polls++;
+	if (wait->spinStart == 0) {
+		uint64_t expected = wait->turnaround[wait->slot] - (wait->turnaround[wait->slot] >> 2);
+		if (now - wait->start < expected) {
+			Se3SleepUs((uint32_t)(expected - (now - wait->start)));
+			now = Se3ClockUs();
+		}
+		wait->spinStart = now;
+		return;
+	}
+	if (wait->backoff == 0) {
+		if (now - wait->spinStart < SE3_WAIT_SPIN_US)
+			return;
+		wait->backoff = SE3_WAIT_MIN_US;
+	}
+	else if (wait->backoff < SE3_WAIT_MAX_US) {
+		wait->backoff = (wait->backoff << 1) < SE3_WAIT_MAX_US ? (wait->backoff << 1) : SE3_WAIT_MAX_US;
+	}
+	Se3SleepUs(wait->backoff);
+}
+
+/* the response is ready, update the estimated turnaround and return the round trip time. If the
+ * response was already there at the first poll, the elapsed time only tells that the device was
+ * faster than expected (it includes the initial sleep), so the estimate is halved instead. */
+uint64_t L0Support::Se3WaitDone(se3Wait* wait) {
+	uint64_t elapsed = Se3ClockUs() - wait->start;
+	uint64_t* turnaround = &(wait->turnaround[wait->slot]);
+	if (wait->polls <= 1 && *turnaround != 0)
+		*turnaround >>= 1;
+	else if (*turnaround == 0)
+		*turnaround = elapsed;
+	else if (elapsed > *turnaround)
+		*turnaround += (elapsed - *turnaround) >> SE3_WAIT_EWMA_SHIFT;
+	else
+		*turnaround -= (*turnaround - elapsed) >> SE3_WAIT_EWMA_SHIFT;
+	return elapsed;
+}
+
+size_t L0Support::Se3LatencySlot(uint16_t cmd, uint16_t subCmd) {
+	if (cmd == L0Commands::Command::L1_CMD0)
+		return (SE3_LATENCY_SLOTS / 2) + (subCmd % (SE3_LATENCY_SLOTS / 2));
+	return cmd % (SE3_LATENCY_SLOTS / 2);
+}
+
+void L0Support::Se3LatencyRecord(se3LatencyHistogram* h, uint64_t us) {
+	size_t bucket = 0;
+	while ((bucket < SE3_LATENCY_BUCKETS - 1) && (us >> (bucket + 1)) != 0)
+		bucket++;
+	if (h->count == 0 || us < h->min)
+		h->min = us;
+	if (us > h->max)
+		h->max = us;
+	h->count++;
+	h->total += us;
+	h->buckets[bucket]++;
+}
+
 bool L0Support::Se3WriteMagic(se3File hFile) {
     size_t i;
     //MAGIC = 32
     //COMM = 512
-    uint8_t buf[L0Communication::Parameter::COMM_BLOCK];
+    alignas(L0Communication::Parameter::COMM_BLOCK) uint8_t buf[L0Communication::Parameter::COMM_BLOCK];
     //16 loop
     for (i = 0; i < L0Communication::Parameter::COMM_BLOCK; i += L0Communication::Size::MAGIC)
         memcpy(buf + i, se3Magic, L0Communication::Size::MAGIC);
@@ -335,9 +776,19 @@ bool L0Support::Se3Write(uint8_t* buf, se3File hfile, size_t block, size_t nBloc
 #else
 //UNIX
 bool L0Support::Se3Write(uint8_t* buf, se3File hfile, size_t block, size_t nBlocks, uint32_t timeout) {
-    memcpy(hfile.buf, buf, nBlocks * L0Communication::Parameter::COMM_BLOCK);
+#ifdef SE3_WITH_EMULATOR
+    if (hfile.emu >= 0) {
+    	return L0Emulator::Instance(hfile.emu).Write(buf, block, nBlocks);
+    }
+#endif
+    //buffers from L0BufferPool are written directly, the bounce buffer is used only for unaligned ones
+    void* src = buf;
+    if (!L0BufferPool::IsAligned(buf)) {
+    	memcpy(hfile.buf, buf, nBlocks * L0Communication::Parameter::COMM_BLOCK);
+    	src = hfile.buf;
+    }
     if (nBlocks * L0Communication::Parameter::COMM_BLOCK != pwrite(	hfile.fd,
-    																hfile.buf,
+    																src,
 																	nBlocks * L0Communication::Parameter::COMM_BLOCK,
 																	block * L0Communication::Parameter::COMM_BLOCK)) {
         return false;
@@ -380,14 +831,21 @@ bool L0Support::Se3Read(uint8_t* buf, se3File hFile, size_t block, size_t nBlock
 #else
 //UNIX
 bool L0Support::Se3Read(uint8_t* buf, se3File hFile, size_t block, size_t nBlocks, uint32_t timeout) {
+#ifdef SE3_WITH_EMULATOR
+    if (hFile.emu >= 0) {
+    	return L0Emulator::Instance(hFile.emu).Read(buf, block, nBlocks);
+    }
+#endif
+    bool aligned = L0BufferPool::IsAligned(buf);
     if (nBlocks * L0Communication::Parameter::COMM_BLOCK != pread(	hFile.fd,
-    																hFile.buf,
+    																aligned ? (void*)buf : hFile.buf,
 																	nBlocks * L0Communication::Parameter::COMM_BLOCK,
 																	block * L0Communication::Parameter::COMM_BLOCK))
     {
     	return false;
     }
-    memcpy(buf, hFile.buf, nBlocks * L0Communication::Parameter::COMM_BLOCK);
+    if (!aligned)
+    	memcpy(buf, hFile.buf, nBlocks * L0Communication::Parameter::COMM_BLOCK);
     return true;
 }
 #endif
@@ -404,6 +862,9 @@ void L0Support::Se3Close(se3File hFile) {
 #else
 //UNIX
 void L0Support::Se3Close(se3File hFile) {
+    if (hFile.emu >= 0) {
+    	return;
+    }
     if (hFile.fd >= 0) {
     	se3UnixUnlock(hFile.fd);
     	hFile.locked = false;
@@ -413,7 +874,7 @@ void L0Support::Se3Close(se3File hFile) {
         hFile.fd = -1;
     }
     if (hFile.buf != NULL) {
-    	free(hFile.buf);
+    	L0BufferPool::Release((uint8_t*)hFile.buf);
         hFile.buf = NULL;
     }
 }
@@ -475,6 +936,18 @@ uint16_t L0Support::Se3OpenExisting(se3Char* path, bool rw, uint64_t deadline, s
 	Se3MakePath(mfPath, path);
 //	Se3Trace(("se3c_open_existing %ls\n", mfPath));
 	phFile->locked = false;
+#ifdef SE3_WITH_EMULATOR
+	phFile->emu = L0Emulator::EmulatedIndex(path);
+#else
+	phFile->emu = -1;
+#endif
+	if (phFile->emu >= 0) {
+		//the emulated SEcube has no file on disk, its blocks are served by L0Emulator
+		phFile->fd = -1;
+		phFile->buf = NULL;
+		phFile->locked = true;
+		return ret;
+	}
 	if (rw)
 		fd = open (mfPath, O_RDWR | O_DIRECT | O_SYNC, S_IWUSR | S_IRUSR);
 	else
@@ -510,7 +983,7 @@ uint16_t L0Support::Se3OpenExisting(se3Char* path, bool rw, uint64_t deadline, s
 	if (ret == L0Communication::Error::OK) {
 		phFile->fd = fd;
 		phFile->locked = true;
-		phFile->buf = memalign(L0Communication::Parameter::COMM_BLOCK,L0Communication::Parameter::COMM_BLOCK * 16);
+		phFile->buf = L0BufferPool::Acquire();
 	} else {
 		phFile->fd = -1;
 	}
@@ -630,6 +1103,7 @@ bool L0Support::Se3MagicInit(se3Char* path, uint8_t* discoBuf, se3DiscoverInfo*
     // eclusive open r/w, create if not exists
 
     hFile.locked = false;
+    hFile.emu = -1;
     hFile.fd = open((char*)mfPath, O_SYNC | O_RDWR | O_CREAT | O_DIRECT | O_TRUNC, S_IWUSR | S_IRUSR);
 
     Se3Trace(("se3c_magic_init %s\n", mfPath));
@@ -638,9 +1112,9 @@ bool L0Support::Se3MagicInit(se3Char* path, uint8_t* discoBuf, se3DiscoverInfo*
         return false;
     }
 
-    hFile.buf = memalign(L0Communication::Parameter::COMM_BLOCK, L0Communication::Parameter::COMM_BLOCK);
+    hFile.buf = L0BufferPool::Acquire();
     if (hFile.buf == NULL) {
-        // memalign failed
+        // allocation failed
         close(hFile.fd);
         unlink(mfPath);
         return false;
@@ -649,6 +1123,7 @@ bool L0Support::Se3MagicInit(se3Char* path, uint8_t* discoBuf, se3DiscoverInfo*
     if (! se3UnixLock(hFile.fd)) {
         // cannot lock
         close(hFile.fd);
+        L0BufferPool::Release((uint8_t*)hFile.buf);
         return false;
     }
     hFile.locked = true;
@@ -704,8 +1179,107 @@ bool L0Support::Se3ReadInfo(uint8_t* buf, se3DiscoverInfo* info) {
 	return true;
 }
 
+bool L0Support::Se3Probe(se3Char* path, uint64_t deadline, se3DiscoverInfo* info) {
+	alignas(L0Communication::Parameter::COMM_BLOCK) uint8_t buf[L0Communication::Parameter::COMM_BLOCK];
+	se3File hFile;
+	uint16_t r;
+
+	r = Se3OpenExisting(path, false, deadline, &hFile);
+
+	if (r == L0Communication::Error::OK) {
+		if (!Se3Read(buf, hFile, 15, 1, SE3C_MAGIC_TIMEOUT)) {
+			Se3Close(hFile);
+			return false;
+		}
+
+		if (!Se3ReadInfo(buf, info)) {
+			Se3Close(hFile);
+			r = L0Communication::Error::ERR_NOT_FOUND;
+		}
+		else {
+			Se3Close(hFile);
+			return true;
+		}
+	}
+
+	//the magic file does not exist (or is not valid), try to create it
+	if (r == L0Communication::Error::ERR_NOT_FOUND)
+		return Se3MagicInit(path, buf, info);
+
+	return false;
+}
+
+#ifndef _WIN32
+std::mutex L0Random::lock;
+uint8_t L0Random::pool[SE3_RAND_POOL];
+size_t L0Random::pos = SE3_RAND_POOL;
+bool L0Random::atfork = false;
+
+bool L0Random::Fill(uint8_t* buf, size_t len) {
+	while (len > 0) {
+		ssize_t n = -1;
+		errno = ENOSYS;
+#ifdef SYS_getrandom
+		n = syscall(SYS_getrandom, buf, len, 0);
+#endif
+		if (n < 0 && errno == ENOSYS) {
+			int frnd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+			if (frnd < 0)
+				return false;
+			n = read(frnd, buf, len);
+			close(frnd);
+		}
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+void L0Random::ForkPrepare() {
+	lock.lock();
+}
+
+void L0Random::ForkParent() {
+	lock.unlock();
+}
+
+void L0Random::ForkChild() {
+	memset(pool, 0, sizeof(pool));
+	pos = SE3_RAND_POOL;
+	lock.unlock();
+}
+
+void L0Random::Draw(size_t len, uint8_t* buf) {
+	std::lock_guard<std::mutex> guard(lock);
+	if (!atfork)
+		atfork = (pthread_atfork(ForkPrepare, ForkParent, ForkChild) == 0);
+	while (len > 0) {
+		if (pos == SE3_RAND_POOL) {
+			//requests larger than the pool are served directly by the kernel
+			if (len >= SE3_RAND_POOL) {
+				Fill(buf, len);
+				return;
+			}
+			if (!Fill(pool, SE3_RAND_POOL))
+				return;
+			pos = 0;
+		}
+		size_t n = std::min(len, (size_t)(SE3_RAND_POOL - pos));
+		memcpy(buf, pool + pos, n);
+		memset(pool + pos, 0, n);
+		pos += n;
+		buf += n;
+		len -= n;
+	}
+}
+#endif
+
 void L0Support::Se3Rand(size_t len, uint8_t* buf) {
-//maybe change this
 #ifdef _WIN32
 //WINDOWS
 	static HMODULE hAdvapi32 = NULL;
@@ -743,9 +1317,7 @@ void L0Support::Se3Rand(size_t len, uint8_t* buf) {
 	}
 #else
 //UNIX
-	int frnd = open("/dev/urandom", O_RDONLY);
-	read(frnd, buf, len);
-	close(frnd);
+	L0Random::Draw(len, buf);
 #endif
 }
 
@@ -789,15 +1361,6 @@ uint16_t L0Support::Se3NBlocks(uint16_t len) {
 	return nBlocks;
 }
 
-uint16_t L0Support::Se3Crc16Update(size_t dataLen, const uint8_t* data, uint16_t crc) {
-	while (dataLen--) {
-		crc = (crc << 8) ^ se3Crc16Table[(crc >> 8) ^ *data];
-		data++;
-	}
-
-	return crc;
-}
-
 #ifndef _WIN32
 /* UNIX file operations */
 bool L0Support::se3UnixLock(int fd) {
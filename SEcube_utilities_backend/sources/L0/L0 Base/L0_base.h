@@ -31,7 +31,11 @@
 #define _L0_BASE_H
 
 #include <stdio.h>
+#include <deque>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 #include "../L0_enumerations.h"
 
@@ -51,6 +55,14 @@
 #define SE3_DRIVE_BUF_MAX 1024
 #define SE3_MAGIC_FILE_LEN 9
 #define SE3C_MAGIC_TIMEOUT 1000
+#define SE3_IO_PAGE 4096	/* Alignment of the buffers handed out by L0BufferPool. */
+#define SE3_IO_BUFFER_SIZE (L0Communication::Parameter::COMM_N * L0Communication::Parameter::COMM_BLOCK)
+#define SE3_IO_POOL_MAX 16	/* Maximum number of unused buffers kept by L0BufferPool, as many as the commands queued by L1PipelineSubmit(). */
+#define SE3_DISCOVERY_THREADS 8	/* Maximum number of mount points probed concurrently by L0Discovery. */
+#define SE3_DISCOVERY_RETRY_MS 1000	/* A mount point that is not a SEcube is probed again after this time, doubled after each failure... */
+#define SE3_DISCOVERY_RETRY_MAX_MS 60000	/* ...up to this time. */
+#define SE3_RAND_POOL 4096	/* Random bytes read from the kernel at once by L0Random. */
+#define SE3_DEVICE_EVENTS_MAX 64	/* Device events kept for L0::GetDeviceEvent(), the oldest ones are dropped. */
 
 #define SE3GET16(x, pos, val) do{ memcpy((void*)&(val), ((uint8_t*)(x))+pos, 2); }while(0)
 #define SE3GET32(x, pos, val) do{ memcpy((void*)&(val), ((uint8_t*)(x))+pos, 4); }while(0)
@@ -67,6 +79,14 @@
 	#define Se3Sleep() usleep(1000)
 #endif
 
+#define SE3_WAIT_SPIN_US 50		/* Time spent polling block 0 without sleeping, after the expected turnaround. */
+#define SE3_WAIT_MIN_US 10		/* First sleep of the exponential backoff. */
+#define SE3_WAIT_MAX_US 1000	/* Maximum sleep of the exponential backoff (the original polling period). */
+#define SE3_WAIT_EWMA_SHIFT 3	/* Weight (1/8) of the last sample in the estimated turnaround. */
+
+#define SE3_LATENCY_BUCKETS 24	/* Bucket i counts round trips in [2^i, 2^(i+1)) us, up to 16 s. */
+#define SE3_LATENCY_SLOTS 32	/* L0 commands in [0, 15], L1 commands carried by L1_CMD0 in [16, 31]. */
+
 #ifdef _DEBUG
 	#define Se3Trace(msg) printf msg
 #else
@@ -133,6 +153,18 @@ typedef struct se3DeviceInfo_ {
     uint16_t status;
 } se3DeviceInfo;
 
+/** Device connected or removed, reported by L0::GetDeviceEvent(). */
+typedef struct se3DeviceEvent_ {
+	bool added; /**< True if the device has been connected, false if it has been removed. */
+	se3DeviceInfo info;
+} se3DeviceEvent;
+
+/** Drive found (and already probed) by L0Discovery::Scan(). */
+typedef struct se3DiscoveredDrive_ {
+	se3Char path[L0Communication::Parameter::SE3_MAX_PATH];
+	se3DiscoverInfo info;
+} se3DiscoveredDrive;
+
 typedef struct se3DriveIt_ {
 	se3Char* path;
 	se3Char buf[SE3_DRIVE_BUF_MAX + 1];
@@ -140,7 +172,8 @@ typedef struct se3DriveIt_ {
 #ifdef _WIN32
 	size_t pos;
 #else
-	FILE* fp;
+	std::vector<se3DiscoveredDrive> found; /**< Drives found by L0Discovery::Scan(). */
+	size_t next; /**< Next drive of found to be returned by the discovery. */
 #endif
 } se3DriveIt;
 
@@ -157,15 +190,40 @@ typedef struct {
 	int fd;
 	void* buf;
 	bool locked;
+	int emu; /**< Index of the emulated SEcube the file belongs to (see L0Emulator), -1 for a real .se3magic file. */
 #endif
 }se3File;
 
+/** State of the adaptive wait for the response of the device. */
+typedef struct se3Wait_ {
+	uint64_t submitted; /**< Time at which the request was submitted (us), used for the latency histograms. */
+	uint64_t start; /**< Time at which the request was written (us). */
+	uint64_t spinStart; /**< Time at which the spin phase started (us), 0 if not started yet. */
+	uint32_t backoff; /**< Current sleep between two polls (us), 0 during the spin phase. */
+	uint32_t polls; /**< Number of polls of block 0 performed for the request being served. */
+	uint32_t token; /**< Command token of the request being served, echoed by the response. */
+	bool pending; /**< A request has been written and its response has not been read yet. */
+	size_t slot; /**< Latency slot (see L0Support::Se3LatencySlot()) of the request being served. */
+	uint64_t turnaround[SE3_LATENCY_SLOTS]; /**< Estimated turnaround of the device for each command (us), 0 until the first response is received. */
+} se3Wait;
+
+/** Histogram of the round trip time of a command. */
+typedef struct se3LatencyHistogram_ {
+	uint64_t count; /**< Number of samples. */
+	uint64_t total; /**< Sum of the samples (us). */
+	uint64_t min; /**< Fastest round trip (us). */
+	uint64_t max; /**< Slowest round trip (us). */
+	uint64_t buckets[SE3_LATENCY_BUCKETS]; /**< Bucket i counts the samples in [2^i, 2^(i+1)) us, bucket 0 also counts 0. */
+} se3LatencyHistogram;
+
 typedef struct se3Device_ {
 	se3DeviceInfo info;
 	std::shared_ptr<uint8_t> request;
 	std::shared_ptr<uint8_t> response;
 	se3File f;
 	bool opened;
+	se3Wait wait;
+	se3LatencyHistogram latency[SE3_LATENCY_SLOTS];
 } se3Device;
 
 class L0Base {
@@ -173,21 +231,31 @@ class L0Base {
 		se3DiscoIt it;
 		std::vector<se3Device> dev;
 		uint8_t ptr;
+		std::deque<se3DeviceEvent> events; /**< At most SE3_DEVICE_EVENTS_MAX, nobody may be reading them. */
 	public:
 		L0Base();
 		~L0Base();
 		void AddDevice(); /**< Add a device to the array. */
+		void RemoveDevice(size_t pos); /**< Remove a (closed) device from the array. */
+		int FindDevice(const se3Char* path, const uint8_t* serialNo); /**< Position of the device in the array, -1 if not found. */
+		void PushDeviceEvent(bool added, const se3DeviceInfo* info); /**< Queue a device event, dropping the oldest one if there are SE3_DEVICE_EVENTS_MAX. */
+		bool PopDeviceEvent(se3DeviceEvent* event); /**< Get the oldest device event, false if there is none. */
+		bool HasDeviceEvents(); /**< True if there are device events to be read. */
 		size_t GetNDevices(); /**< Get the number of connected devices. */
 		void ResetDeviceArray(); /**< Clear the content of the device array. */
 		//Device GET methods
 		se3File		GetDeviceFile();
 		uint8_t*	GetDeviceHelloMsg();
 		se3Char*	GetDeviceInfoPath();
+		const se3DeviceInfo* GetDeviceInfo();
 		uint8_t*	GetDeviceInfoSerialNo();
 		bool		GetDeviceOpened();
 		uint8_t		GetDevicePtr();
 		uint8_t*	GetDeviceRequest();
 		uint8_t*	GetDeviceResponse();
+		se3Wait*	GetDeviceWait();
+		se3LatencyHistogram* GetDeviceLatency(size_t slot);
+		void		ResetDeviceLatency();
 		//Iterator GET methods
 		uint8_t*	GetDiscoDeviceHelloMsg();
 		se3Char*	GetDiscoDevicePath();
@@ -195,7 +263,10 @@ class L0Base {
 		se3Char*	GetDiscoDriveBuf();
 		size_t		GetDiscoDriveBufLen();
 		se3Char*	GetDiscoDrivePath();
-		FILE * 		GetDiscoDriveFile();
+#ifndef _WIN32
+		std::vector<se3DiscoveredDrive>& GetDiscoFound();
+		size_t		GetDiscoFoundNext();
+#endif
 		//buffer allocation/deallocation
 		void	AllocateDeviceRequest();
 		void	AllocateDeviceResponse();
@@ -210,9 +281,90 @@ class L0Base {
 		void	SetDiscoDriveBufLen(size_t bufLen);
 		void	SetDiscoDriveBufTermination();
 		void	SetDiscoDrivePath(se3Char* path);
-		void 	SetDiscoDriveFile(FILE* fp);
+#ifndef _WIN32
+		void	SetDiscoFoundNext(size_t next);
+#endif
+};
+
+/** Pool of page aligned buffers of SE3_IO_BUFFER_SIZE bytes. The buffers satisfy the alignment
+ *  required by O_DIRECT (FILE_FLAG_NO_BUFFERING on Windows), so the request and response buffers
+ *  of the devices can be written to and read from the .se3magic file without any bounce copy. */
+class L0BufferPool {
+	private:
+		static std::mutex lock;
+		static std::vector<uint8_t*> pool;
+		L0BufferPool() {};
+	public:
+		static uint8_t* Acquire(); /**< Get a buffer from the pool, NULL if the allocation fails. */
+		static void Release(uint8_t* buf); /**< Give a buffer back to the pool (NULL is ignored). */
+		static std::shared_ptr<uint8_t> AcquireShared(); /**< Same as Acquire(), the buffer is released when the last owner goes away. */
+		static bool IsAligned(const void* buf); /**< True if buf can be used directly for the I/O on the .se3magic file. */
 };
 
+#ifndef _WIN32
+/** Discovery of the SEcube devices on UNIX. The mount points listed in /proc/self/mountinfo are filtered by
+ *  filesystem type (only block devices, no read-only images) and the remaining ones are probed concurrently,
+ *  at most SE3_DISCOVERY_THREADS at a time. The mount points that are not a SEcube are remembered together
+ *  with their mount id and device id, so they are not probed again until they are mounted again or until
+ *  their retry time (SE3_DISCOVERY_RETRY_MS, doubled after each failure) expires: a SEcube that was busy
+ *  during the probe is found again. */
+class L0Discovery {
+	private:
+		typedef struct {
+			int mountId;
+			dev_t dev;
+		} se3MountId;
+		typedef struct {
+			se3MountId id;
+			uint32_t failures; /**< Consecutive failed probes of this mount. */
+			uint64_t retry; /**< Time (Se3ClockUs()) of the next probe. */
+		} se3NegativeEntry;
+		static std::mutex lock;
+		static std::map<std::string, se3NegativeEntry> negative; /**< Mount points that are not a SEcube. */
+		L0Discovery() {};
+	public:
+		static void Scan(std::vector<se3DiscoveredDrive>& found); /**< Find the SEcube devices, in the order of /proc/self/mountinfo. */
+		static bool IsCandidate(const char* fsType, const char* source); /**< True if a mount point of this type may be a SEcube. */
+		static void ForgetNegative(); /**< Probe again all the mount points at the next Scan(). */
+		static bool RetryDue(); /**< True if a mount point that is not a SEcube must be probed again. */
+};
+
+/** Registry of the SEcube devices on UNIX. The devices found by L0Discovery are cached until the mount table
+ *  changes: /proc/self/mountinfo is polled (POLLPRI is raised by the kernel when a filesystem is mounted or
+ *  unmounted), so getting the device list does not scan the mount points again on the hot path. */
+class L0DeviceRegistry {
+	private:
+		static std::mutex lock;
+		static int fd; /**< /proc/self/mountinfo, watched for changes. */
+		static bool valid; /**< drives is up to date. */
+		static std::vector<se3DiscoveredDrive> drives;
+		static bool MountsChanged(int timeoutMs);
+		L0DeviceRegistry() {};
+	public:
+		static void Snapshot(std::vector<se3DiscoveredDrive>& found); /**< The current devices, scanned again only if the mounts changed. */
+		static bool Wait(uint32_t timeoutMs); /**< Wait until the mounts change, false on timeout. */
+		static void Invalidate(); /**< Scan again at the next Snapshot(). */
+};
+
+/** Random numbers on UNIX. A pool is filled in bulk from the kernel (getrandom(), /dev/urandom if the syscall is
+ *  missing) and drained by Se3Rand(), so most calls do not need any system call. The bytes handed out are wiped
+ *  from the pool, and the child of a fork() discards the pool, so parent and child never get the same bytes. */
+class L0Random {
+	private:
+		static std::mutex lock;
+		static uint8_t pool[SE3_RAND_POOL];
+		static size_t pos; /**< First byte of pool not handed out yet. */
+		static bool atfork; /**< The fork handlers are installed. */
+		static bool Fill(uint8_t* buf, size_t len);
+		static void ForkPrepare();
+		static void ForkParent();
+		static void ForkChild();
+		L0Random() {};
+	public:
+		static void Draw(size_t len, uint8_t* buf); /**< Fill buf with len random bytes. */
+};
+#endif
+
 class L0Support {
 	private:
 		L0Support() {};
@@ -221,6 +373,13 @@ class L0Support {
 		static bool Se3Win32DiskInDrive(wchar_t* path);
 		static uint64_t Se3Deadline(uint32_t timeout);
 		static uint64_t Se3Clock();
+		static uint64_t Se3ClockUs();
+		static void Se3SleepUs(uint32_t us);
+		static void Se3WaitStart(se3Wait* wait);
+		static void Se3WaitNext(se3Wait* wait);
+		static uint64_t Se3WaitDone(se3Wait* wait);
+		static size_t Se3LatencySlot(uint16_t cmd, uint16_t subCmd);
+		static void Se3LatencyRecord(se3LatencyHistogram* h, uint64_t us);
 		static bool Se3WriteMagic(se3File hFile);
 		static bool Se3Write(uint8_t* buf, se3File hfile, size_t block, size_t nBlocks, uint32_t timeout);
 		static bool Se3Read(uint8_t* buf, se3File hFile, size_t block, size_t nBlocks, uint32_t timeout);
@@ -229,11 +388,16 @@ class L0Support {
 		static void Se3MakePath(se3Char* dest, se3Char* src);
 		static bool Se3MagicInit(se3Char* path, uint8_t* discoBuf, se3DiscoverInfo* info);
 		static bool Se3ReadInfo(uint8_t* buf, se3DiscoverInfo* info);
+		static bool Se3Probe(se3Char* path, uint64_t deadline, se3DiscoverInfo* info);
 		static void Se3Rand(size_t len, uint8_t* buf);
 		static uint16_t Se3ReqLenDataAndHeaders(uint16_t dataLen);
 		static uint16_t Se3RespLenData(uint16_t lenDataAndHeaders);
 		static uint16_t Se3NBlocks(uint16_t len);
-		static uint16_t Se3Crc16Update(size_t dataLen, const uint8_t* data, uint16_t crc);
+		static uint16_t Se3Crc16Update(size_t dataLen, const uint8_t* data, uint16_t crc); /**< CRC16-CCITT with the fastest kernel supported by the CPU (see L0_crc16.cpp). */
+		static uint16_t Se3Crc16Bytewise(size_t dataLen, const uint8_t* data, uint16_t crc); /**< Reference kernel, one byte at a time. */
+		static uint16_t Se3Crc16Slice8(size_t dataLen, const uint8_t* data, uint16_t crc); /**< Portable kernel, eight bytes at a time. */
+		static uint16_t Se3Crc16Clmul(size_t dataLen, const uint8_t* data, uint16_t crc); /**< Carry-less multiplication kernel, use only if Se3Crc16ClmulSupported(). */
+		static bool Se3Crc16ClmulSupported(); /**< True if the CPU supports PCLMULQDQ and SSSE3. */
 		static bool se3UnixLock(int fd);
 		static void se3UnixUnlock(int fd);
 		static void DebugFileCreation();
@@ -0,0 +1,175 @@
+/**
+  ******************************************************************************
+  * File Name          : L0_crc16.cpp
+  * Description        : CRC16 kernels of the L0Base library.
+  ******************************************************************************
+  *
+  * Copyright � 2016-present Blu5 Group <https://www.blu5group.com>
+  *
+  * This library is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU Lesser General Public
+  * License as published by the Free Software Foundation; either
+  * version 3 of the License, or (at your option) any later version.
+  *
+  * This library is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  * Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+  *
+  ******************************************************************************
+  */
+
+/**
+ * @file	L0_crc16.cpp
+ * @date	October, 2026
+ * @brief	CRC16-CCITT of the L0 requests and responses
+ *
+ * Three kernels compute the same CRC (polynomial 0x1021, no reflection, see se3Crc16Table): the reference
+ * byte-at-a-time loop, slice-by-8 (eight lookups in tables derived from se3Crc16Table per 8 bytes) and,
+ * on x86 CPUs with PCLMULQDQ, carry-less multiplication folding 64 bytes per iteration. Se3Crc16Update()
+ * picks the fastest kernel supported by the CPU the first time it is called.
+ */
+
+#include "L0_base.h"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SE3_CRC16_CLMUL
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace {
+	/* t[k][b] is the CRC of byte b followed by k zero bytes (t[0] is se3Crc16Table) */
+	typedef struct {
+		uint16_t t[8][0x100];
+	} se3Crc16Slices;
+
+	const se3Crc16Slices& Crc16Slices() {
+		static const se3Crc16Slices slices = []() {
+			se3Crc16Slices s;
+			for (int b = 0; b < 0x100; b++) {
+				s.t[0][b] = se3Crc16Table[b];
+			}
+			for (int k = 1; k < 8; k++) {
+				for (int b = 0; b < 0x100; b++) {
+					uint16_t prev = s.t[k - 1][b];
+					s.t[k][b] = (uint16_t)((prev << 8) ^ se3Crc16Table[prev >> 8]);
+				}
+			}
+			return s;
+		}();
+		return slices;
+	}
+
+#ifdef SE3_CRC16_CLMUL
+	/* x^n mod 0x11021 */
+	uint64_t Crc16XPow(unsigned n) {
+		uint32_t r = 1;
+		while (n--) {
+			r <<= 1;
+			if (r & 0x10000)
+				r ^= 0x11021;
+		}
+		return r;
+	}
+
+	/* value congruent to x * x^d: the high half of x is multiplied by x^(d + 64) (high lane of k), the low half by x^d (low lane of k) */
+	__attribute__((target("pclmul,ssse3")))
+	inline __m128i Crc16Fold(__m128i x, __m128i k) {
+		return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x11), _mm_clmulepi64_si128(x, k, 0x00));
+	}
+#endif
+}
+
+uint16_t L0Support::Se3Crc16Bytewise(size_t dataLen, const uint8_t* data, uint16_t crc) {
+	while (dataLen--) {
+		crc = (crc << 8) ^ se3Crc16Table[(crc >> 8) ^ *data];
+		data++;
+	}
+
+	return crc;
+}
+
+uint16_t L0Support::Se3Crc16Slice8(size_t dataLen, const uint8_t* data, uint16_t crc) {
+	const se3Crc16Slices& s = Crc16Slices();
+	while (dataLen >= 8) {
+		uint16_t c = crc ^ (uint16_t)((data[0] << 8) | data[1]);
+		crc = s.t[7][c >> 8] ^ s.t[6][c & 0xFF] ^ s.t[5][data[2]] ^ s.t[4][data[3]] ^
+			  s.t[3][data[4]] ^ s.t[2][data[5]] ^ s.t[1][data[6]] ^ s.t[0][data[7]];
+		data += 8;
+		dataLen -= 8;
+	}
+
+	return Se3Crc16Bytewise(dataLen, data, crc);
+}
+
+bool L0Support::Se3Crc16ClmulSupported() {
+#ifdef SE3_CRC16_CLMUL
+	static const bool supported = []() {
+		unsigned int eax, ebx, ecx, edx;
+		if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+			return false;
+		return (ecx & bit_PCLMUL) && (ecx & bit_SSSE3);
+	}();
+	return supported;
+#else
+	return false;
+#endif
+}
+
+#ifdef SE3_CRC16_CLMUL
+__attribute__((target("pclmul,ssse3")))
+uint16_t L0Support::Se3Crc16Clmul(size_t dataLen, const uint8_t* data, uint16_t crc) {
+	if (dataLen < 128)
+		return Se3Crc16Slice8(dataLen, data, crc);
+
+	/* blocks are big endian polynomials: reverse the bytes so that bit 127 is the first bit of the block */
+	const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	/* folding constants (x^(d + 64) mod P in the high lane, x^d mod P in the low one) for d = 512, 384, 256, 128 */
+	static const uint64_t kx[4][2] = {
+		{ Crc16XPow(512 + 64), Crc16XPow(512) },
+		{ Crc16XPow(384 + 64), Crc16XPow(384) },
+		{ Crc16XPow(256 + 64), Crc16XPow(256) },
+		{ Crc16XPow(128 + 64), Crc16XPow(128) }
+	};
+	const __m128i k512 = _mm_set_epi64x(kx[0][0], kx[0][1]);
+	__m128i x[4];
+	uint8_t rest[16];
+
+	for (int i = 0; i < 4; i++)
+		x[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * i)), bswap);
+	x[0] = _mm_xor_si128(x[0], _mm_set_epi64x((int64_t)((uint64_t)crc << 48), 0));
+	data += 64;
+	dataLen -= 64;
+
+	while (dataLen >= 64) {
+		for (int i = 0; i < 4; i++) {
+			__m128i y = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * i)), bswap);
+			x[i] = _mm_xor_si128(Crc16Fold(x[i], k512), y);
+		}
+		data += 64;
+		dataLen -= 64;
+	}
+
+	/* x[0] * x^384 + x[1] * x^256 + x[2] * x^128 + x[3] */
+	__m128i r = x[3];
+	for (int i = 0; i < 3; i++)
+		r = _mm_xor_si128(r, Crc16Fold(x[i], _mm_set_epi64x(kx[i + 1][0], kx[i + 1][1])));
+
+	/* r has the same remainder of the data folded so far: finish with r followed by the tail */
+	_mm_storeu_si128((__m128i*)rest, _mm_shuffle_epi8(r, bswap));
+	crc = Se3Crc16Slice8(sizeof(rest), rest, 0);
+	return Se3Crc16Slice8(dataLen, data, crc);
+}
+#else
+uint16_t L0Support::Se3Crc16Clmul(size_t dataLen, const uint8_t* data, uint16_t crc) {
+	return Se3Crc16Slice8(dataLen, data, crc);
+}
+#endif
+
+uint16_t L0Support::Se3Crc16Update(size_t dataLen, const uint8_t* data, uint16_t crc) {
+	static uint16_t (*const kernel)(size_t, const uint8_t*, uint16_t) = Se3Crc16ClmulSupported() ? Se3Crc16Clmul : Se3Crc16Slice8;
+	return kernel(dataLen, data, crc);
+}
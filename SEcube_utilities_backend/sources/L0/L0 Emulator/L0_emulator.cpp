@@ -0,0 +1,1074 @@
+/**
+  ******************************************************************************
+  * File Name          : L0_emulator.cpp
+  * Description        : Implementation of the L0Emulator library.
+  ******************************************************************************
+  *
+  * Copyright � 2016-present Blu5 Group <https://www.blu5group.com>
+  *
+  * This library is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU Lesser General Public
+  * License as published by the Free Software Foundation; either
+  * version 3 of the License, or (at your option) any later version.
+  *
+  * This library is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  * Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+  *
+  ******************************************************************************
+  */
+
+/**
+ * @file	L0_emulator.cpp
+ * @date	October, 2026
+ * @brief	Implementation of the L0Emulator library
+ *
+ * The file contains the software SEcube used by L0 in place of the .se3magic file of a real device.
+ * Requests written to block 0 are decoded, executed and the response is made available for reading
+ * once the configured latency has elapsed, exactly as the firmware does on the USB mass storage.
+ */
+
+#if defined(SE3_WITH_EMULATOR) && !defined(_WIN32)
+
+#include "L0_emulator.h"
+#include "../../L1/L1_enumerations.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+namespace {
+	//access levels, same values of se3_access_type
+	enum {
+		EMU_ACCESS_USER = 100,
+		EMU_ACCESS_ADMIN = 1000
+	};
+
+	const char emuStateMagic[8] = { 'S', 'E', '3', 'E', 'M', 'U', '1', '\0' };
+	const char emuHello[L0Communication::Size::HELLO] = "SEcube emulator";
+
+	//names used in SE3_EMULATOR_LATENCY_US, indexed by L1Commands::Codes
+	const char* emuL1CmdNames[] = { "", "challenge", "login", "logout", "config", "key_edit", "key_find", "key_list",
+									"crypto_init", "crypto_update", "crypto_list", "forced_logout", "sekey" };
+
+	uint64_t EmuNow() {
+		return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	uint16_t EmuPad16(uint16_t len) {
+		return (len % 16) ? (len + 16 - (len % 16)) : len;
+	}
+
+	std::string EmuTrim(std::string path) {
+		while (path.length() > 1 && path.back() == SE3_OSSEP) {
+			path.pop_back();
+		}
+		return path;
+	}
+
+	std::vector<std::string> EmuRoots() {
+		std::vector<std::string> roots;
+		const char* env = getenv(SE3_EMULATOR_ENV);
+		std::string list = (env != NULL) ? env : "";
+		size_t begin = 0;
+		while (begin <= list.length()) {
+			size_t end = list.find(':', begin);
+			if (end == std::string::npos) {
+				end = list.length();
+			}
+			std::string root = EmuTrim(list.substr(begin, end - begin));
+			if (!root.empty() && std::find(roots.begin(), roots.end(), root) == roots.end()) {
+				roots.push_back(root);
+			}
+			begin = end + 1;
+		}
+		return roots;
+	}
+
+	//true if the key id belongs to the ranges managed by SEkey
+	bool EmuSekeyId(uint32_t id) {
+		return (id >= L1Key::Id::SEKEY_ID_BEGIN) && (id <= L1Key::Id::RESERVED_ID_SEKEY_END);
+	}
+}
+
+//////////////////
+//STATIC METHODS//
+//////////////////
+
+bool L0Emulator::Enabled() {
+	const char* env = getenv(SE3_EMULATOR_ENV);
+	return (env != NULL) && (env[0] != '\0');
+}
+
+const std::vector<std::string>& L0Emulator::Roots() {
+	static const std::vector<std::string> roots = EmuRoots();
+	return roots;
+}
+
+int L0Emulator::EmulatedIndex(const se3Char* path) {
+	if (!Enabled() || path == NULL) {
+		return -1;
+	}
+	const std::vector<std::string>& roots = Roots();
+	std::vector<std::string>::const_iterator it = std::find(roots.begin(), roots.end(), EmuTrim(path));
+	return (it == roots.end()) ? -1 : (int)(it - roots.begin());
+}
+
+L0Emulator& L0Emulator::Instance(size_t index) {
+	//each emulated SEcube is created the first time one of its blocks is accessed
+	static std::mutex instancesLock;
+	static std::vector<std::unique_ptr<L0Emulator>> instances(Roots().size());
+	std::lock_guard<std::mutex> guard(instancesLock);
+	if (!instances[index]) {
+		instances[index].reset(new L0Emulator(Roots()[index]));
+	}
+	return *instances[index];
+}
+
+L0Emulator::L0Emulator(const std::string& root) {
+	uint8_t keys[2 * B5_AES_256];
+
+	this->root = root;
+	this->initialized = false;
+	memset(this->serialno, 0, sizeof(this->serialno));
+	memset(this->pin, 0, sizeof(this->pin));
+	this->sekeyInfo = false;
+	this->loggedIn = false;
+	this->access = 0;
+	memset(this->token, 0, sizeof(this->token));
+	memset(this->challengeCresp, 0, sizeof(this->challengeCresp));
+	this->challengeAccess = 0;
+	this->challengePending = false;
+	this->keyListCursor = 0;
+	this->nextSessionId = 1;
+	memset(this->response, 0, sizeof(this->response));
+	this->readyAt = 0;
+	const char* batch = getenv(SE3_EMULATOR_SECTOR_BATCH_ENV);
+	this->sectorBatch = (batch == NULL) || (strcmp(batch, "0") != 0);
+	const char* resetMac = getenv(SE3_EMULATOR_RESET_MAC_ENV);
+	this->resetMac = (resetMac != NULL) && (strcmp(resetMac, "1") == 0);
+
+	mkdir(this->root.c_str(), S_IRWXU);
+	LoadLatency();
+	LoadState();
+
+	//the host protects the L1 payload with keys derived from the initial session key (se3Magic)
+	PBKDF2HmacSha256(se3Magic, B5_AES_256, NULL, 0, 1, keys, 2 * B5_AES_256);
+	B5_Aes256_Init(&this->payloadEnc, keys, B5_AES_256, B5_AES256_CBC_ENC);
+	B5_Aes256_Init(&this->payloadDec, keys, B5_AES_256, B5_AES256_CBC_DEC);
+	B5_HmacSha256_KeyInit(&this->payloadHmacKey, keys + B5_AES_256, B5_AES_256);
+}
+
+///////////////////
+//PRIVATE METHODS//
+///////////////////
+
+void L0Emulator::LoadLatency() {
+	const char* env = getenv(SE3_EMULATOR_LATENCY_ENV);
+	if (env == NULL) {
+		return;
+	}
+	std::stringstream ss(env);
+	std::string item;
+	while (std::getline(ss, item, ',')) {
+		size_t eq = item.find('=');
+		std::string name = (eq == std::string::npos) ? "default" : item.substr(0, eq);
+		std::string value = (eq == std::string::npos) ? item : item.substr(eq + 1);
+		if (!value.empty()) {
+			this->latency[name] = (uint32_t)strtoul(value.c_str(), NULL, 10);
+		}
+	}
+}
+
+uint32_t L0Emulator::Latency(uint16_t cmd, uint16_t l1Cmd) {
+	std::map<std::string, uint32_t>::iterator it = this->latency.end();
+	if (cmd == L0Commands::Command::ECHO) {
+		it = this->latency.find("echo");
+	} else if (cmd == L0Commands::Command::FACTORY_INIT) {
+		it = this->latency.find("factory_init");
+	} else if (cmd == L0Commands::Command::L1_CMD0 && l1Cmd > 0 && l1Cmd <= L1Commands::Codes::SEKEY) {
+		it = this->latency.find(emuL1CmdNames[l1Cmd]);
+	}
+	if (it == this->latency.end()) {
+		it = this->latency.find("default");
+	}
+	return (it == this->latency.end()) ? 0 : it->second;
+}
+
+bool L0Emulator::LoadState() {
+	std::string path = this->root + SE3_OSSEP + SE3_EMULATOR_STATE_FILE;
+	FILE* fp = fopen(path.c_str(), "rb");
+	char magic[sizeof(emuStateMagic)];
+	uint8_t u8tmp = 0;
+	uint32_t nKeys = 0;
+	bool ok = true;
+
+	if (fp == NULL) {
+		return false;
+	}
+	ok = ok && fread(magic, sizeof(magic), 1, fp) == 1 && !memcmp(magic, emuStateMagic, sizeof(magic));
+	ok = ok && fread(&u8tmp, 1, 1, fp) == 1;
+	this->initialized = (u8tmp != 0);
+	ok = ok && fread(this->serialno, sizeof(this->serialno), 1, fp) == 1;
+	ok = ok && fread(this->pin, sizeof(this->pin), 1, fp) == 1;
+	ok = ok && fread(&u8tmp, 1, 1, fp) == 1;
+	this->sekeyInfo = (u8tmp != 0);
+	for (int i = 0; ok && i < 2; i++) {
+		char buf[UINT8_MAX];
+		ok = fread(&u8tmp, 1, 1, fp) == 1 && (u8tmp == 0 || fread(buf, u8tmp, 1, fp) == 1);
+		if (ok) {
+			((i == 0) ? this->sekeyId : this->sekeyName).assign(buf, u8tmp);
+		}
+	}
+	ok = ok && fread(&nKeys, 4, 1, fp) == 1;
+	for (uint32_t i = 0; ok && i < nKeys; i++) {
+		uint32_t id = 0;
+		uint16_t len = 0;
+		ok = fread(&id, 4, 1, fp) == 1 && fread(&len, 2, 1, fp) == 1 && len <= L1Key::Size::MAX_DATA;
+		if (ok) {
+			std::vector<uint8_t> data(len);
+			ok = (len == 0) || fread(data.data(), len, 1, fp) == 1;
+			this->keys[id] = data;
+		}
+	}
+	fclose(fp);
+	return ok;
+}
+
+bool L0Emulator::SaveState() {
+	std::string path = this->root + SE3_OSSEP + SE3_EMULATOR_STATE_FILE;
+	std::string tmpPath = path + ".tmp";
+	FILE* fp = fopen(tmpPath.c_str(), "wb");
+	uint8_t u8tmp;
+	uint32_t nKeys = (uint32_t)this->keys.size();
+	bool ok = true;
+
+	if (fp == NULL) {
+		return false;
+	}
+	ok = ok && fwrite(emuStateMagic, sizeof(emuStateMagic), 1, fp) == 1;
+	u8tmp = this->initialized ? 1 : 0;
+	ok = ok && fwrite(&u8tmp, 1, 1, fp) == 1;
+	ok = ok && fwrite(this->serialno, sizeof(this->serialno), 1, fp) == 1;
+	ok = ok && fwrite(this->pin, sizeof(this->pin), 1, fp) == 1;
+	u8tmp = this->sekeyInfo ? 1 : 0;
+	ok = ok && fwrite(&u8tmp, 1, 1, fp) == 1;
+	for (const std::string* s : { &this->sekeyId, &this->sekeyName }) {
+		u8tmp = (uint8_t)s->length();
+		ok = ok && fwrite(&u8tmp, 1, 1, fp) == 1 && (u8tmp == 0 || fwrite(s->data(), u8tmp, 1, fp) == 1);
+	}
+	ok = ok && fwrite(&nKeys, 4, 1, fp) == 1;
+	for (const auto& k : this->keys) {
+		uint16_t len = (uint16_t)k.second.size();
+		ok = ok && fwrite(&k.first, 4, 1, fp) == 1 && fwrite(&len, 2, 1, fp) == 1;
+		ok = ok && (len == 0 || fwrite(k.second.data(), len, 1, fp) == 1);
+	}
+	if (fclose(fp) != 0 || !ok) {
+		unlink(tmpPath.c_str());
+		return false;
+	}
+	return rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+void L0Emulator::Process(const uint8_t* req, size_t nBlocks) {
+	uint16_t cmd = 0, flags = 0, lenDataAndHeaders = 0, status = L0ErrorCodes::Error::OK, l1Cmd = 0;
+	uint32_t cmdToken = 0, u32tmp = 0;
+	size_t n = 0;
+	std::vector<uint8_t> data, resp;
+
+	SE3GET16(req, L0Request::Offset::CMD, cmd);
+	SE3GET16(req, L0Request::Offset::CMD_FLAGS, flags);
+	SE3GET16(req, L0Request::Offset::LEN, lenDataAndHeaders);
+	SE3GET32(req, L0Request::Offset::CMD_TOKEN, cmdToken);
+	n = L0Support::Se3NBlocks(lenDataAndHeaders);
+
+	if (lenDataAndHeaders < L0Request::Size::HEADER || n > nBlocks || n > L0Communication::Parameter::COMM_N - 1) {
+		status = L0ErrorCodes::Error::COMMUNICATION;
+	}
+	else {
+		//requests use the same framing of the responses
+		uint16_t len = L0Support::Se3RespLenData(lenDataAndHeaders);
+		uint16_t chunk = (len < L0Request::Size::SE3_REQ_SIZE_DATA) ? len : (uint16_t)L0Request::Size::SE3_REQ_SIZE_DATA;
+		data.reserve(len);
+		data.insert(data.end(), req + L0Request::Size::HEADER, req + L0Request::Size::HEADER + chunk);
+		for (size_t i = 1; i < n; i++) {
+			const uint8_t* blk = req + i * L0Communication::Parameter::COMM_BLOCK;
+			SE3GET32(blk, L0Request::Offset::DATA_CMD_TOKEN, u32tmp);
+			if (u32tmp != cmdToken + i) {
+				status = L0ErrorCodes::Error::COMMUNICATION;
+				break;
+			}
+			chunk = (len - data.size() < L0Request::Size::SE3_REQDATA_SIZE_DATA) ? (uint16_t)(len - data.size()) : (uint16_t)L0Request::Size::SE3_REQDATA_SIZE_DATA;
+			data.insert(data.end(), blk + L0Request::Offset::SE3_REQDATA_OFFSET_DATA, blk + L0Request::Offset::SE3_REQDATA_OFFSET_DATA + chunk);
+		}
+	}
+
+	if (status == L0ErrorCodes::Error::OK) {
+		switch (cmd) {
+			case L0Commands::Command::ECHO:
+				resp = data;
+				break;
+			case L0Commands::Command::FACTORY_INIT:
+				if (this->initialized) {
+					status = L0ErrorCodes::Error::SE3_ERR_STATE;
+				}
+				else if (data.size() < L0Communication::Size::SERIAL) {
+					status = L0ErrorCodes::Error::SE3_ERR_PARAMS;
+				}
+				else {
+					memcpy(this->serialno, data.data(), L0Communication::Size::SERIAL);
+					this->initialized = true;
+					if (!SaveState()) {
+						status = L0ErrorCodes::Error::SE3_ERR_HW;
+					}
+				}
+				break;
+			case L0Commands::Command::L1_CMD0:
+				status = L1Dispatch(flags, data, resp, &l1Cmd);
+				break;
+			case L0Commands::Command::SE3_CMD0_BOOT_MODE_RESET:
+				break;
+			default:
+				status = L0ErrorCodes::Error::SE3_ERR_CMD;
+				break;
+		}
+	}
+
+	//build the response in the same blocks of the request
+	lenDataAndHeaders = L0Support::Se3ReqLenDataAndHeaders((uint16_t)resp.size());
+	n = L0Support::Se3NBlocks(lenDataAndHeaders);
+	memset(this->response, 0, n * L0Communication::Parameter::COMM_BLOCK);
+	uint16_t ready = 1;
+	SE3SET16(this->response, L0Response::Offset::SE3_RESP_OFFSET_READY, ready);
+	SE3SET16(this->response, L0Response::Offset::STATUS, status);
+	SE3SET16(this->response, L0Response::Offset::LEN, lenDataAndHeaders);
+	SE3SET32(this->response, L0Response::Offset::CMD_TOKEN, cmdToken);
+	size_t offset = (resp.size() < L0Response::Size::SE3_RESP_SIZE_DATA) ? resp.size() : (size_t)L0Response::Size::SE3_RESP_SIZE_DATA;
+	if (offset > 0) {
+		memcpy(this->response + L0Response::Size::HEADER, resp.data(), offset);
+	}
+	for (size_t i = 1; i < n; i++) {
+		uint8_t* blk = this->response + i * L0Communication::Parameter::COMM_BLOCK;
+		size_t chunk = resp.size() - offset;
+		if (chunk > L0Communication::Parameter::COMM_BLOCK - L0Response::Size::DATA_HEADER) {
+			chunk = L0Communication::Parameter::COMM_BLOCK - L0Response::Size::DATA_HEADER;
+		}
+		u32tmp = cmdToken + (uint32_t)i;
+		SE3SET32(blk, L0Response::Offset::DATA_CMD_TOKEN, u32tmp);
+		memcpy(blk + L0Response::Offset::SE3_RESPDATA_OFFSET_DATA, resp.data() + offset, chunk);
+		offset += chunk;
+	}
+	this->readyAt = EmuNow() + Latency(cmd, l1Cmd);
+}
+
+uint16_t L0Emulator::L1Dispatch(uint16_t flags, std::vector<uint8_t>& req, std::vector<uint8_t>& resp, uint16_t* l1Cmd) {
+	uint16_t status = L1Error::Error::OK;
+	uint16_t cmd = 0, len = 0;
+	std::vector<uint8_t> data, out;
+	B5_tHmacSha256Ctx hmac;
+	uint8_t auth[B5_SHA256_DIGEST_SIZE];
+
+	if (req.size() < L1Request::Offset::DATA || (req.size() % L1Parameters::Size::CRYPTO_BLOCK) != 0) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	uint16_t nBlocks = (uint16_t)((req.size() - L1Request::Offset::TOKEN) / L1Parameters::Size::CRYPTO_BLOCK);
+
+	//verify and decrypt the payload (same scheme of L1::Se3PayloadEncrypt)
+	if (flags & L1Commands::Flags::SIGN) {
+		B5_HmacSha256_InitKey(&hmac, &this->payloadHmacKey);
+		B5_HmacSha256_Update(&hmac, req.data() + L1Request::Offset::IV, B5_AES_IV_SIZE);
+		B5_HmacSha256_Update(&hmac, req.data() + L1Request::Offset::TOKEN, nBlocks * B5_AES_BLK_SIZE);
+		B5_HmacSha256_Finit(&hmac, auth);
+		if (memcmp(auth, req.data() + L1Request::Offset::AUTH, L1Parameters::Size::AUTH)) {
+			return L1Error::Error::SE3_ERR_AUTH;
+		}
+	}
+	if (flags & L1Commands::Flags::ENCRYPT) {
+		std::vector<uint8_t> enc(req.begin() + L1Request::Offset::TOKEN, req.end());
+		B5_Aes256_SetIV(&this->payloadDec, req.data() + L1Request::Offset::IV);
+		B5_Aes256_Update(&this->payloadDec, enc.data(), req.data() + L1Request::Offset::TOKEN, nBlocks);
+	}
+
+	SE3GET16(req.data(), L1Request::Offset::LEN, len);
+	SE3GET16(req.data(), L1Request::Offset::CMD, cmd);
+	*l1Cmd = cmd;
+	if (len > req.size() - L1Request::Offset::DATA) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	data.assign(req.begin() + L1Request::Offset::DATA, req.begin() + L1Request::Offset::DATA + len);
+
+	//every command but the login sequence requires a valid token
+	if (cmd != L1Commands::Codes::CHALLENGE && cmd != L1Commands::Codes::LOGIN && cmd != L1Commands::Codes::FORCED_LOGOUT) {
+		if (!this->loggedIn || memcmp(this->token, req.data() + L1Request::Offset::TOKEN, L1Parameters::Size::TOKEN)) {
+			status = L1Error::Error::SE3_ERR_ACCESS;
+		}
+	}
+
+	if (status == L1Error::Error::OK) {
+		switch (cmd) {
+			case L1Commands::Codes::CHALLENGE:		status = CmdChallenge(data, out); break;
+			case L1Commands::Codes::LOGIN:			status = CmdLogin(data, out); break;
+			case L1Commands::Codes::LOGOUT:
+			case L1Commands::Codes::FORCED_LOGOUT:	Logout(); break;
+			case L1Commands::Codes::CONFIG:			status = CmdConfig(data, out); break;
+			case L1Commands::Codes::KEY_EDIT:		status = CmdKeyEdit(data, out); break;
+			case L1Commands::Codes::KEY_FIND:		status = CmdKeyFind(data, out); break;
+			case L1Commands::Codes::KEY_LIST:		status = CmdKeyList(data, out); break;
+			case L1Commands::Codes::CRYPTO_INIT:	status = CmdCryptoInit(data, out); break;
+			case L1Commands::Codes::CRYPTO_UPDATE:	status = CmdCryptoUpdate(data, out); break;
+			case L1Commands::Codes::CRYPTO_LIST:	status = CmdCryptoList(data, out); break;
+			case L1Commands::Codes::SEKEY:			status = CmdSekey(data, out); break;
+			default:								status = L0ErrorCodes::Error::SE3_ERR_CMD; break;
+		}
+	}
+	if (status != L1Error::Error::OK) {
+		out.clear();
+	}
+
+	//build the L1 response, the status is reported both in L0 and L1 headers
+	len = (uint16_t)out.size();
+	resp.assign(L1Response::Offset::DATA + EmuPad16(len), 0);
+	if (len > 0) {
+		memcpy(resp.data() + L1Response::Offset::DATA, out.data(), len);
+	}
+	if (this->loggedIn) {
+		memcpy(resp.data() + L1Response::Offset::TOKEN, this->token, L1Parameters::Size::TOKEN);
+	}
+	SE3SET16(resp.data(), L1Response::Offset::LEN, len);
+	SE3SET16(resp.data(), L1Response::Offset::STATUS, status);
+	nBlocks = (uint16_t)((resp.size() - L1Response::Offset::TOKEN) / L1Parameters::Size::CRYPTO_BLOCK);
+	if (flags & L1Commands::Flags::ENCRYPT) {
+		std::vector<uint8_t> clr(resp.begin() + L1Response::Offset::TOKEN, resp.end());
+		L0Support::Se3Rand(L1Parameters::Size::IV, resp.data() + L1Response::Offset::IV);
+		B5_Aes256_SetIV(&this->payloadEnc, resp.data() + L1Response::Offset::IV);
+		B5_Aes256_Update(&this->payloadEnc, resp.data() + L1Response::Offset::TOKEN, clr.data(), nBlocks);
+	}
+	if (flags & L1Commands::Flags::SIGN) {
+		B5_HmacSha256_InitKey(&hmac, &this->payloadHmacKey);
+		B5_HmacSha256_Update(&hmac, resp.data() + L1Response::Offset::IV, B5_AES_IV_SIZE);
+		B5_HmacSha256_Update(&hmac, resp.data() + L1Response::Offset::TOKEN, nBlocks * B5_AES_BLK_SIZE);
+		B5_HmacSha256_Finit(&hmac, auth);
+		memcpy(resp.data() + L1Response::Offset::AUTH, auth, L1Parameters::Size::AUTH);
+	}
+	return status;
+}
+
+uint16_t L0Emulator::CmdChallenge(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp) {
+	uint16_t access = 0;
+	const uint8_t* p = NULL;
+
+	if (this->loggedIn) {
+		return L1Error::Error::SE3_ERR_OPENED;
+	}
+	if (req.size() < L1ChallengeRequest::Size::SIZE) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	SE3GET16(req.data(), L1ChallengeRequest::Offset::ACCESS, access);
+	if (access == EMU_ACCESS_ADMIN) {
+		p = this->pin[L1Configuration::RecordType::ADMINPIN];
+	}
+	else if (access == EMU_ACCESS_USER) {
+		p = this->pin[L1Configuration::RecordType::USERPIN];
+	}
+	else {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+
+	resp.assign(L1ChallengeResponse::Size::SIZE, 0);
+	L0Support::Se3Rand(L1Parameters::Size::CHALLENGE, resp.data() + L1ChallengeResponse::Offset::SC);
+	PBKDF2HmacSha256(p, L1Parameters::Size::PIN, req.data() + L1ChallengeRequest::Offset::CC1, L1Parameters::Size::CHALLENGE,
+					 L1Parameters::Parameter::ITERATIONS, resp.data() + L1ChallengeResponse::Offset::SRESP, L1Parameters::Size::CHALLENGE);
+	PBKDF2HmacSha256(p, L1Parameters::Size::PIN, resp.data() + L1ChallengeResponse::Offset::SC, L1Parameters::Size::CHALLENGE,
+					 L1Parameters::Parameter::ITERATIONS, this->challengeCresp, L1Parameters::Size::CHALLENGE);
+	this->challengeAccess = access;
+	this->challengePending = true;
+	return L1Error::Error::OK;
+}
+
+uint16_t L0Emulator::CmdLogin(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp) {
+	if (this->loggedIn) {
+		return L1Error::Error::SE3_ERR_OPENED;
+	}
+	if (!this->challengePending || req.size() < L1Login::RequestSize::SIZE) {
+		return L1Error::Error::SE3_ERR_ACCESS;
+	}
+	this->challengePending = false;
+	if (memcmp(req.data() + L1Login::RequestOffset::CRESP, this->challengeCresp, L1Parameters::Size::CHALLENGE)) {
+		return L1Error::Error::SE3_ERR_PIN;
+	}
+	this->loggedIn = true;
+	this->access = this->challengeAccess;
+	L0Support::Se3Rand(L1Parameters::Size::TOKEN, this->token);
+	resp.assign(this->token, this->token + L1Login::ResponseSize::SIZE);
+	return L1Error::Error::OK;
+}
+
+uint16_t L0Emulator::CmdConfig(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp) {
+	uint16_t type = 0, op = 0;
+
+	if (req.size() < L1Configuration::RequestOffset::CONFIG_VALUE + L1Configuration::RecordSize::RECORD_SIZE) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	SE3GET16(req.data(), L1Configuration::RequestOffset::CONFIG_ID, type);
+	SE3GET16(req.data(), L1Configuration::RequestOffset::CONFIG_OP, op);
+	if (type >= L1Configuration::RecordSize::RECORD_MAX) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	if (this->access != EMU_ACCESS_ADMIN) {
+		return L1Error::Error::SE3_ERR_ACCESS;
+	}
+	if (op == L1Configuration::Operation::SET) {
+		memcpy(this->pin[type], req.data() + L1Configuration::RequestOffset::CONFIG_VALUE, L1Configuration::RecordSize::RECORD_SIZE);
+		return SaveState() ? (uint16_t)L1Error::Error::OK : (uint16_t)L0ErrorCodes::Error::SE3_ERR_HW;
+	}
+	if (op == L1Configuration::Operation::GET) {
+		resp.assign(this->pin[type], this->pin[type] + L1Configuration::RecordSize::RECORD_SIZE);
+		return L1Error::Error::OK;
+	}
+	return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+}
+
+uint16_t L0Emulator::CmdKeyEdit(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp) {
+	(void)resp; // no response data
+	uint16_t op = 0, len = 0;
+	uint32_t id = 0;
+
+	if (req.size() < L1Request::KeyOffset::DATA) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	SE3GET16(req.data(), L1Request::KeyOffset::OP, op);
+	SE3GET32(req.data(), L1Request::KeyOffset::ID, id);
+	SE3GET16(req.data(), L1Request::KeyOffset::DATA_LEN, len);
+	if (id == L1Key::Id::ZERO_ID || id == L1Key::Id::NULL_ID || len > L1Key::Size::MAX_DATA) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	switch (op) {
+		case L1Commands::KeyOpEdit::SE3_KEY_OP_ADD:
+			if (req.size() < (size_t)L1Request::KeyOffset::DATA + len) {
+				return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+			}
+			this->keys[id].assign(req.begin() + L1Request::KeyOffset::DATA, req.begin() + L1Request::KeyOffset::DATA + len);
+			break;
+		case L1Commands::KeyOpEdit::SE3_KEY_OP_ADD_TRNG:
+			this->keys[id].assign(len, 0);
+			L0Support::Se3Rand(len, this->keys[id].data());
+			break;
+		case L1Commands::KeyOpEdit::SE3_KEY_OP_DELETE:
+			if (this->keys.erase(id) == 0) {
+				return L1Error::Error::SE3_ERR_RESOURCE;
+			}
+			break;
+		default:
+			return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	return SaveState() ? (uint16_t)L1Error::Error::OK : (uint16_t)L0ErrorCodes::Error::SE3_ERR_HW;
+}
+
+uint16_t L0Emulator::CmdKeyFind(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp) {
+	uint32_t id = 0;
+
+	if (req.size() < 4) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	SE3GET32(req.data(), 0, id);
+	resp.assign(1, (this->keys.count(id) != 0) ? 1 : 0);
+	return L1Error::Error::OK;
+}
+
+void L0Emulator::ListKeys(uint8_t filter, size_t maxEntries, std::vector<uint8_t>& resp) {
+	size_t count = 0;
+	uint8_t entry[6];
+	std::map<uint32_t, std::vector<uint8_t>>::iterator it = this->keys.lower_bound(this->keyListCursor);
+
+	//entries are 4B key id and 2B key length, id 0 marks the end of the list
+	for (; it != this->keys.end() && count + 1 < maxEntries; ++it) {
+		if (filter != 0 && EmuSekeyId(it->first)) {
+			continue;
+		}
+		uint16_t len = (uint16_t)it->second.size();
+		SE3SET32(entry, 0, it->first);
+		SE3SET16(entry, 4, len);
+		resp.insert(resp.end(), entry, entry + sizeof(entry));
+		count++;
+	}
+	if (it == this->keys.end()) {
+		memset(entry, 0, sizeof(entry));
+		resp.insert(resp.end(), entry, entry + sizeof(entry));
+		this->keyListCursor = 0;
+	}
+	else {
+		this->keyListCursor = it->first;
+	}
+}
+
+uint16_t L0Emulator::CmdKeyList(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp) {
+	uint8_t filter = (req.size() > 2) ? req[2] : 0;
+	ListKeys(filter, L1Response::Size::MAX_DATA / 6, resp);
+	return L1Error::Error::OK;
+}
+
+uint16_t L0Emulator::CmdCryptoList(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp) {
+	(void)req; // no request data
+	struct {
+		const char* name;
+		uint16_t type;
+		uint16_t blockSize;
+		uint16_t keySize[3];
+	} algo[] = {
+		{ "AES",			L1Crypto::CryptoTypes::SE3_CRYPTO_TYPE_BLOCKCIPHER,			B5_AES_BLK_SIZE,		{ B5_AES_128, B5_AES_192, B5_AES_256 } },
+		{ "SHA256",			L1Crypto::CryptoTypes::SE3_CRYPTO_TYPE_DIGEST,				B5_SHA256_BLOCK_SIZE,	{ 0, 0, 0 } },
+		{ "HMACSHA256",		L1Crypto::CryptoTypes::SE3_CRYPTO_TYPE_DIGEST,				B5_SHA256_BLOCK_SIZE,	{ B5_AES_256, 0, 0 } },
+		{ "AES_HMACSHA256",	L1Crypto::CryptoTypes::SE3_CRYPTO_TYPE_BLOCKCIPHER_AUTH,	B5_AES_BLK_SIZE,		{ B5_AES_256, 0, 0 } },
+		{ "AES_HMAC_SECTORS", L1Crypto::CryptoTypes::SE3_CRYPTO_TYPE_BLOCKCIPHER_AUTH,	B5_AES_BLK_SIZE,		{ B5_AES_256, 0, 0 } }
+	};
+	uint16_t count = this->sectorBatch ? L1Algorithms::Extensions::AES_HMACSHA256_SECTORS + 1 : L1Algorithms::Algorithms::ALGORITHM_MAX;
+
+	resp.assign(L1Crypto::ListResponseOffset::ALGORITHM_INFO + count * L1Crypto::AlgorithmInfoSize::SIZE, 0);
+	SE3SET16(resp.data(), L1Crypto::ListResponseOffset::COUNT, count);
+	for (uint16_t i = 0; i < count; i++) {
+		uint8_t* p = resp.data() + L1Crypto::ListResponseOffset::ALGORITHM_INFO + i * L1Crypto::AlgorithmInfoSize::SIZE;
+		memcpy(p + L1Crypto::AlgorithmInfoOffset::NAME, algo[i].name, strlen(algo[i].name));
+		SE3SET16(p, L1Crypto::AlgorithmInfoOffset::TYPE, algo[i].type);
+		SE3SET16(p, L1Crypto::AlgorithmInfoOffset::BLOCK_SIZE, algo[i].blockSize);
+		memcpy(p + L1Crypto::AlgorithmInfoOffset::KEY_SIZE, algo[i].keySize, sizeof(algo[i].keySize));
+	}
+	return L1Error::Error::OK;
+}
+
+uint16_t L0Emulator::CmdCryptoInit(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp) {
+	uint16_t algorithm = 0, mode = 0;
+	uint32_t keyId = 0, sid = 0;
+	uint8_t aesMode = 0;
+	std::vector<uint8_t> key;
+
+	if (req.size() < L1Crypto::InitRequestSize::SIZE) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	SE3GET16(req.data(), L1Crypto::InitRequestOffset::ALGO, algorithm);
+	SE3GET16(req.data(), L1Crypto::InitRequestOffset::MODE, mode);
+	SE3GET32(req.data(), L1Crypto::InitRequestOffset::KEY_ID, keyId);
+	if (algorithm >= L1Algorithms::Algorithms::ALGORITHM_MAX &&
+		!(this->sectorBatch && algorithm == L1Algorithms::Extensions::AES_HMACSHA256_SECTORS)) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	//the sectors are independent, so only CTR makes sense
+	if (algorithm == L1Algorithms::Extensions::AES_HMACSHA256_SECTORS && (mode & 0x00FF) != CryptoInitialisation::Modes::CTR) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	if (this->sessions.size() >= SE3_EMULATOR_MAX_SESSIONS) {
+		return L1Error::Error::SE3_ERR_MEMORY;
+	}
+	if (algorithm != L1Algorithms::Algorithms::SHA256) {
+		std::map<uint32_t, std::vector<uint8_t>>::iterator it = this->keys.find(keyId);
+		if (it == this->keys.end()) {
+			return L1Error::Error::SE3_ERR_RESOURCE;
+		}
+		key = it->second;
+	}
+	if (algorithm == L1Algorithms::Algorithms::AES || algorithm == L1Algorithms::Algorithms::AES_HMACSHA256 ||
+		algorithm == L1Algorithms::Extensions::AES_HMACSHA256_SECTORS) {
+		bool enc = (mode & 0xFF00) == CryptoInitialisation::Direction::ENCRYPT;
+		bool dec = (mode & 0xFF00) == CryptoInitialisation::Direction::DECRYPT;
+		switch (mode & 0x00FF) {
+			case CryptoInitialisation::Modes::ECB: aesMode = enc ? B5_AES256_ECB_ENC : B5_AES256_ECB_DEC; break;
+			case CryptoInitialisation::Modes::CBC: aesMode = enc ? B5_AES256_CBC_ENC : B5_AES256_CBC_DEC; break;
+			case CryptoInitialisation::Modes::CFB: aesMode = enc ? B5_AES256_CFB_ENC : B5_AES256_CFB_DEC; break;
+			case CryptoInitialisation::Modes::OFB: aesMode = B5_AES256_OFB; break;
+			case CryptoInitialisation::Modes::CTR: aesMode = B5_AES256_CTR; break;
+			default: return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+		}
+		if (!enc && !dec) {
+			return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+		}
+	}
+
+	//find a free session id
+	while (this->nextSessionId == 0 || this->sessions.count(this->nextSessionId) != 0) {
+		this->nextSessionId++;
+	}
+	sid = this->nextSessionId++;
+	se3EmuSession& s = this->sessions[sid];
+	s.algorithm = algorithm;
+	s.mode = mode & 0x00FF;
+	s.direction = mode & 0xFF00;
+	s.key = key;
+	switch (algorithm) {
+		case L1Algorithms::Algorithms::AES_HMACSHA256:
+		case L1Algorithms::Extensions::AES_HMACSHA256_SECTORS:
+			B5_HmacSha256_Init(&s.hmac, s.key.data(), (int16_t)s.key.size());
+			s.hmacStart = s.hmac;
+			// fall through
+		case L1Algorithms::Algorithms::AES:
+			if (B5_Aes256_Init(&s.aes, s.key.data(), (int16_t)s.key.size(), aesMode) != B5_AES256_RES_OK) {
+				this->sessions.erase(sid);
+				return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+			}
+			break;
+		case L1Algorithms::Algorithms::SHA256:
+			B5_Sha256_Init(&s.sha);
+			break;
+		case L1Algorithms::Algorithms::HMACSHA256:
+			B5_HmacSha256_Init(&s.hmac, s.key.data(), (int16_t)s.key.size());
+			break;
+	}
+	resp.assign(L1Crypto::InitResponseSize::SIZE, 0);
+	SE3SET32(resp.data(), L1Crypto::InitResponseOffset::SID, sid);
+	return L1Error::Error::OK;
+}
+
+uint16_t L0Emulator::CmdCryptoUpdate(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp) {
+	uint32_t sid = 0;
+	uint16_t flags = 0, data1Len = 0, data2Len = 0, dataOutLen = 0;
+	const uint8_t* data1 = NULL;
+	const uint8_t* data2 = NULL;
+	std::vector<uint8_t> out;
+
+	if (req.size() < L1Crypto::UpdateRequestOffset::DATA) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	SE3GET32(req.data(), L1Crypto::UpdateRequestOffset::SID, sid);
+	SE3GET16(req.data(), L1Crypto::UpdateRequestOffset::FLAGS, flags);
+	SE3GET16(req.data(), L1Crypto::UpdateRequestOffset::DATAIN1_LEN, data1Len);
+	SE3GET16(req.data(), L1Crypto::UpdateRequestOffset::DATAIN2_LEN, data2Len);
+	if ((size_t)L1Crypto::UpdateRequestOffset::DATA + EmuPad16(data1Len) + data2Len > req.size()) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	data1 = req.data() + L1Crypto::UpdateRequestOffset::DATA;
+	data2 = data1 + EmuPad16(data1Len);
+
+	std::map<uint32_t, se3EmuSession>::iterator it = this->sessions.find(sid);
+	if (it == this->sessions.end()) {
+		return L1Error::Error::SE3_ERR_RESOURCE;
+	}
+	se3EmuSession& s = it->second;
+
+	//the key used for the authentication is derived from the session key and the nonce
+	if ((flags & L1Crypto::UpdateFlags::SETNONCE) &&
+		(s.algorithm == L1Algorithms::Algorithms::HMACSHA256 || s.algorithm == L1Algorithms::Algorithms::AES_HMACSHA256 ||
+		 s.algorithm == L1Algorithms::Extensions::AES_HMACSHA256_SECTORS)) {
+		uint8_t authKey[B5_SHA256_DIGEST_SIZE];
+		PBKDF2HmacSha256(s.key.data(), s.key.size(), data1, data1Len, 1, authKey, sizeof(authKey));
+		B5_HmacSha256_Init(&s.hmac, authKey, sizeof(authKey));
+		s.hmacStart = s.hmac;
+	}
+
+	switch (s.algorithm) {
+		case L1Algorithms::Algorithms::SHA256:
+			if (data1Len > 0) {
+				B5_Sha256_Update(&s.sha, data1, data1Len);
+			}
+			if (flags & L1Crypto::UpdateFlags::FINIT) {
+				out.resize(B5_SHA256_DIGEST_SIZE);
+				B5_Sha256_Finit(&s.sha, out.data());
+			}
+			break;
+		case L1Algorithms::Algorithms::HMACSHA256:
+			if (data1Len > 0 && !(flags & L1Crypto::UpdateFlags::SETNONCE)) {
+				B5_HmacSha256_Update(&s.hmac, data1, data1Len);
+			}
+			if (flags & L1Crypto::UpdateFlags::FINIT) {
+				out.resize(B5_SHA256_DIGEST_SIZE);
+				B5_HmacSha256_Finit(&s.hmac, out.data());
+			}
+			break;
+		case L1Algorithms::Algorithms::AES:
+		case L1Algorithms::Algorithms::AES_HMACSHA256:
+			if ((flags & L1Crypto::UpdateFlags::RESET) && !(flags & L1Crypto::UpdateFlags::SETNONCE) &&
+				data1Len == B5_AES_IV_SIZE && s.mode != CryptoInitialisation::Modes::ECB) {
+				B5_Aes256_SetIV(&s.aes, data1);
+			}
+			if ((flags & L1Crypto::UpdateFlags::RESET) && !(flags & L1Crypto::UpdateFlags::SETNONCE) &&
+				this->resetMac && s.algorithm == L1Algorithms::Algorithms::AES_HMACSHA256) {
+				s.hmac = s.hmacStart;
+			}
+			if (data2Len > 0) {
+				if (data2Len % B5_AES_BLK_SIZE) {
+					return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+				}
+				std::vector<uint8_t> in(data2, data2 + data2Len);
+				out.resize(data2Len);
+				//decryption modes read encData and write clrData, all the others the opposite
+				bool decMode = (s.direction == CryptoInitialisation::Direction::DECRYPT) &&
+							   (s.mode == CryptoInitialisation::Modes::ECB || s.mode == CryptoInitialisation::Modes::CBC || s.mode == CryptoInitialisation::Modes::CFB);
+				if (decMode) {
+					B5_Aes256_Update(&s.aes, in.data(), out.data(), data2Len / B5_AES_BLK_SIZE);
+				}
+				else {
+					B5_Aes256_Update(&s.aes, out.data(), in.data(), data2Len / B5_AES_BLK_SIZE);
+				}
+				//encrypt-then-MAC: the digest always covers the ciphertext
+				if (s.algorithm == L1Algorithms::Algorithms::AES_HMACSHA256) {
+					const std::vector<uint8_t>& cipher = (s.direction == CryptoInitialisation::Direction::ENCRYPT) ? out : in;
+					B5_HmacSha256_Update(&s.hmac, cipher.data(), (int32_t)cipher.size());
+				}
+			}
+			if ((flags & L1Crypto::UpdateFlags::FINIT) && (flags & L1Crypto::UpdateFlags::AUTH) && s.algorithm == L1Algorithms::Algorithms::AES_HMACSHA256) {
+				out.resize(out.size() + B5_SHA256_DIGEST_SIZE);
+				B5_HmacSha256_Finit(&s.hmac, out.data() + out.size() - B5_SHA256_DIGEST_SIZE);
+			}
+			break;
+		case L1Algorithms::Extensions::AES_HMACSHA256_SECTORS:
+			if (data2Len > 0 && !(flags & L1Crypto::UpdateFlags::SETNONCE)) {
+				uint16_t status = CryptoSectors(s, data1, data1Len, data2, data2Len, out);
+				if (status != L1Error::Error::OK) {
+					return status;
+				}
+			}
+			break;
+	}
+	if (flags & L1Crypto::UpdateFlags::FINIT) {
+		this->sessions.erase(it);
+	}
+	if (out.size() > L1Crypto::UpdateSize::DATAOUT) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+
+	dataOutLen = (uint16_t)out.size();
+	resp.assign(L1Crypto::UpdateResponseOffset::DATA + dataOutLen, 0);
+	SE3SET16(resp.data(), L1Crypto::UpdateResponseOffset::DATAOUT_LEN, dataOutLen);
+	if (dataOutLen > 0) {
+		memcpy(resp.data() + L1Crypto::UpdateResponseOffset::DATA, out.data(), dataOutLen);
+	}
+	return L1Error::Error::OK;
+}
+
+uint16_t L0Emulator::CryptoSectors(se3EmuSession& s, const uint8_t* nonces, uint16_t noncesLen, const uint8_t* sectors, uint16_t sectorsLen, std::vector<uint8_t>& out) {
+	size_t count = noncesLen / B5_AES_IV_SIZE;
+	if (count == 0 || (noncesLen % B5_AES_IV_SIZE) != 0 || (sectorsLen % count) != 0) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	size_t sectorLen = sectorsLen / count;
+	if (sectorLen <= B5_SHA256_DIGEST_SIZE || ((sectorLen - B5_SHA256_DIGEST_SIZE) % B5_AES_BLK_SIZE) != 0) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	size_t dataLen = sectorLen - B5_SHA256_DIGEST_SIZE;
+	out.resize(sectorsLen);
+	for (size_t i = 0; i < count; i++) {
+		const uint8_t* in = sectors + i * sectorLen;
+		uint8_t* p = out.data() + i * sectorLen;
+		//each sector has its own counter and its own HMAC, all keyed as the session
+		B5_tHmacSha256Ctx hmac = s.hmac;
+		B5_Aes256_SetIV(&s.aes, nonces + i * B5_AES_IV_SIZE);
+		B5_Aes256_Update(&s.aes, p, (uint8_t*)in, (int16_t)(dataLen / B5_AES_BLK_SIZE));
+		B5_HmacSha256_Update(&hmac, (s.direction == CryptoInitialisation::Direction::ENCRYPT) ? p : in, (int32_t)dataLen);
+		B5_HmacSha256_Finit(&hmac, p + dataLen);
+	}
+	return L1Error::Error::OK;
+}
+
+uint16_t L0Emulator::CmdSekey(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp) {
+	static const char ok[] = "OK";
+	static const char sekeyOk[] = "SEKEY_OK";
+	uint16_t op = 0;
+	size_t offset = 2;
+
+	if (req.size() < 2) {
+		return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	SE3GET16(req.data(), 0, op);
+
+	switch (op) {
+		case L1Commands::Options::SE3_SEKEY_OP_SETINFO: {
+			//1B id length, id, 1B name length, name
+			std::string s[2];
+			for (int i = 0; i < 2; i++) {
+				if (offset >= req.size() || offset + 1 + req[offset] > req.size()) {
+					return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+				}
+				s[i].assign((const char*)req.data() + offset + 1, req[offset]);
+				offset += 1 + req[offset];
+			}
+			this->sekeyId = s[0];
+			this->sekeyName = s[1];
+			this->sekeyInfo = true;
+			if (!SaveState()) {
+				return L0ErrorCodes::Error::SE3_ERR_HW;
+			}
+			resp.assign(sekeyOk, sekeyOk + 8);
+			break;
+		}
+		case L1Commands::Options::SE3_SEKEY_OP_GETINFO:
+			if (this->sekeyInfo) {
+				resp.push_back((uint8_t)this->sekeyId.length());
+				resp.insert(resp.end(), this->sekeyId.begin(), this->sekeyId.end());
+				resp.push_back((uint8_t)this->sekeyName.length());
+				resp.insert(resp.end(), this->sekeyName.begin(), this->sekeyName.end());
+			}
+			break;
+		case L1Commands::Options::SE3_SEKEY_OP_GET_KEY_IDS: {
+			uint32_t cursor = this->keyListCursor;
+			this->keyListCursor = 0;
+			ListKeys((req.size() > 2) ? req[2] : 0, L1Response::Size::MAX_DATA / 6, resp);
+			this->keyListCursor = cursor;
+			break;
+		}
+		case L1Commands::Options::SE3_SEKEY_DELETEALL: {
+			std::vector<uint32_t> keep;
+			for (; offset + 4 <= req.size(); offset += 4) {
+				uint32_t id;
+				SE3GET32(req.data(), offset, id);
+				keep.push_back(id);
+			}
+			for (std::map<uint32_t, std::vector<uint8_t>>::iterator it = this->keys.begin(); it != this->keys.end();) {
+				if (EmuSekeyId(it->first) && std::find(keep.begin(), keep.end(), it->first) == keep.end()) {
+					it = this->keys.erase(it);
+				}
+				else {
+					++it;
+				}
+			}
+			if (!SaveState()) {
+				return L0ErrorCodes::Error::SE3_ERR_HW;
+			}
+			resp.assign(ok, ok + 2);
+			break;
+		}
+		case L1Commands::Options::SE3_SEKEY_DELETEKEY: {
+			uint32_t id = 0;
+			if (req.size() < offset + 4) {
+				return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+			}
+			SE3GET32(req.data(), offset, id);
+			if (this->keys.erase(id) == 0) {
+				return L1Error::Error::SE3_ERR_RESOURCE;
+			}
+			if (!SaveState()) {
+				return L0ErrorCodes::Error::SE3_ERR_HW;
+			}
+			resp.assign(ok, ok + 2);
+			break;
+		}
+		case L1Commands::Options::SE3_SEKEY_OP_GETKEYENC: {
+			//the exported key is wrapped with AES-256-ECB under the wrapping key
+			uint32_t exportId = 0, wrapId = 0;
+			B5_tAesCtx aes;
+			if (req.size() < offset + 8) {
+				return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+			}
+			SE3GET32(req.data(), offset, exportId);
+			SE3GET32(req.data(), offset + 4, wrapId);
+			if (this->keys.count(exportId) == 0 || this->keys.count(wrapId) == 0) {
+				return L1Error::Error::SE3_ERR_RESOURCE;
+			}
+			std::vector<uint8_t> clr = this->keys[exportId];
+			std::vector<uint8_t>& wrap = this->keys[wrapId];
+			if (clr.empty() || (clr.size() % B5_AES_BLK_SIZE) != 0 ||
+				B5_Aes256_Init(&aes, wrap.data(), (int16_t)wrap.size(), B5_AES256_ECB_ENC) != B5_AES256_RES_OK) {
+				return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+			}
+			resp.resize(clr.size());
+			B5_Aes256_Update(&aes, resp.data(), clr.data(), (int16_t)(clr.size() / B5_AES_BLK_SIZE));
+			break;
+		}
+		case L1Commands::Options::SE3_SEKEY_INSERTKEY: {
+			//key id, key length and, optionally, the id of the wrapping key (0 if plain) and the key
+			uint32_t id = 0, decId = 0;
+			uint16_t len = 0;
+			std::vector<uint8_t> key;
+			if (req.size() < offset + 6) {
+				return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+			}
+			SE3GET32(req.data(), offset, id);
+			SE3GET16(req.data(), offset + 4, len);
+			offset += 6;
+			if (id == L1Key::Id::ZERO_ID || id == L1Key::Id::NULL_ID || len == 0 || len > L1Key::Size::MAX_DATA) {
+				return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+			}
+			if (req.size() < offset + 4 + len) {
+				key.resize(len);
+				L0Support::Se3Rand(len, key.data());
+			}
+			else {
+				SE3GET32(req.data(), offset, decId);
+				key.assign(req.begin() + offset + 4, req.begin() + offset + 4 + len);
+				if (decId != 0) {
+					B5_tAesCtx aes;
+					std::map<uint32_t, std::vector<uint8_t>>::iterator it = this->keys.find(decId);
+					if (it == this->keys.end()) {
+						return L1Error::Error::SE3_ERR_RESOURCE;
+					}
+					if ((len % B5_AES_BLK_SIZE) != 0 ||
+						B5_Aes256_Init(&aes, it->second.data(), (int16_t)it->second.size(), B5_AES256_ECB_DEC) != B5_AES256_RES_OK) {
+						return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+					}
+					std::vector<uint8_t> enc(key);
+					B5_Aes256_Update(&aes, enc.data(), key.data(), (int16_t)(len / B5_AES_BLK_SIZE));
+				}
+			}
+			this->keys[id] = key;
+			if (!SaveState()) {
+				return L0ErrorCodes::Error::SE3_ERR_HW;
+			}
+			resp.assign(ok, ok + 2);
+			break;
+		}
+		case L1Commands::Options::SE3_SEKEY_ISREADY:
+			resp.assign(ok, ok + 2);
+			break;
+		default:
+			return L0ErrorCodes::Error::SE3_ERR_PARAMS;
+	}
+	return L1Error::Error::OK;
+}
+
+void L0Emulator::Logout() {
+	this->loggedIn = false;
+	this->access = 0;
+	this->challengePending = false;
+	this->keyListCursor = 0;
+	memset(this->token, 0, sizeof(this->token));
+	this->sessions.clear();
+}
+
+//////////////////
+//PUBLIC METHODS//
+//////////////////
+
+bool L0Emulator::Write(const uint8_t* buf, size_t block, size_t nBlocks) {
+	std::lock_guard<std::mutex> guard(this->lock);
+
+	if (nBlocks == 0 || block + nBlocks > L0Communication::Parameter::COMM_N) {
+		return false;
+	}
+	//only requests written to the first block are executed, magic blocks are ignored
+	if (block != 0 || !memcmp(buf, se3Magic, L0Communication::Size::MAGIC)) {
+		return true;
+	}
+	Process(buf, nBlocks);
+	return true;
+}
+
+bool L0Emulator::Read(uint8_t* buf, size_t block, size_t nBlocks) {
+	std::lock_guard<std::mutex> guard(this->lock);
+
+	if (block + nBlocks > L0Communication::Parameter::COMM_N) {
+		return false;
+	}
+	for (size_t i = 0; i < nBlocks; i++) {
+		uint8_t* dst = buf + i * L0Communication::Parameter::COMM_BLOCK;
+		size_t b = block + i;
+		if (b == L0Communication::Parameter::COMM_N - 1) {
+			//discovery block: magic with swapped halves, serial number, hello message and status
+			uint16_t status = this->initialized ? 1 : 0;
+			memset(dst, 0, L0Communication::Parameter::COMM_BLOCK);
+			memcpy(dst, se3Magic + L0Communication::Size::MAGIC / 2, L0Communication::Size::MAGIC / 2);
+			memcpy(dst + L0Communication::Size::MAGIC / 2, se3Magic, L0Communication::Size::MAGIC / 2);
+			memcpy(dst + L0DiscoverParameters::Offset::SERIAL, this->serialno, L0Communication::Size::SERIAL);
+			memcpy(dst + L0DiscoverParameters::Offset::HELLO, emuHello, L0Communication::Size::HELLO);
+			SE3SET16(dst, L0DiscoverParameters::Offset::STATUS, status);
+		}
+		else if (b == 0 && EmuNow() < this->readyAt) {
+			//response not ready yet
+			memset(dst, 0, L0Communication::Parameter::COMM_BLOCK);
+		}
+		else {
+			memcpy(dst, this->response + b * L0Communication::Parameter::COMM_BLOCK, L0Communication::Parameter::COMM_BLOCK);
+		}
+	}
+	return true;
+}
+
+#endif
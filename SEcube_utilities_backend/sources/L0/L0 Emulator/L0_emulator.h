@@ -0,0 +1,151 @@
+/**
+  ******************************************************************************
+  * File Name          : L0_emulator.h
+  * Description        : Prototypes of the L0Emulator library.
+  ******************************************************************************
+  *
+  * Copyright � 2016-present Blu5 Group <https://www.blu5group.com>
+  *
+  * This library is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU Lesser General Public
+  * License as published by the Free Software Foundation; either
+  * version 3 of the License, or (at your option) any later version.
+  *
+  * This library is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  * Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+  *
+  ******************************************************************************
+  */
+
+/*! \file  L0_emulator.h
+ *  \brief Prototypes of the L0Emulator library.
+ *  \version SEcube Open Source SDK 1.5.1
+ *
+ *  The emulator is a software SEcube that speaks the same COMM_BLOCK protocol of the
+ *  .se3magic file, so that L0, L1, SEfile and SEkey can run (and be benchmarked) without
+ *  any device attached. It is enabled by setting the environment variable SE3_EMULATOR to
+ *  a directory, or to a ':' separated list of directories to emulate more than one SEcube:
+ *  each directory is reported by the discovery as a SEcube mount point and the persistent
+ *  state of that emulated device (serial number, PINs, keys, SEkey info) is stored inside it.
+ *  Only the directories that exist are reported, so an emulated SEcube is connected and removed
+ *  by creating and deleting its directory. The emulated devices live inside the process that uses them.
+ *
+ *  The service time of each command can be configured with SE3_EMULATOR_LATENCY_US, a
+ *  comma separated list of name=microseconds pairs (i.e. "default=200,crypto_update=350").
+ *  Valid names are default, echo, factory_init and the lowercase names of L1Commands::Codes.
+ *  A single number is the same as default=number.
+ *
+ *  Setting SE3_EMULATOR_SECTOR_BATCH to 0 hides L1Algorithms::Extensions::AES_HMACSHA256_SECTORS,
+ *  to emulate a firmware that encrypts only one SEfile sector per CRYPTO_UPDATE.
+ *  Setting SE3_EMULATOR_RESET_MAC to 1 makes L1Crypto::UpdateFlags::RESET restart the HMAC of AES-HMAC-SHA256 sessions
+ *  together with the counter, to emulate a firmware that re-initialises the whole context.
+ *
+ *  The emulator is compiled only when SE3_WITH_EMULATOR is defined, which only the benchmark and test builds do;
+ *  without it SE3_EMULATOR is ignored and L0 talks to real devices only.
+ */
+
+#ifndef _L0_EMULATOR_H
+#define _L0_EMULATOR_H
+
+#if defined(SE3_WITH_EMULATOR) && !defined(_WIN32)
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../L0 Base/L0_base.h"
+#include "../../L1/Crypto Libraries/aes256.h"
+#include "../../L1/Crypto Libraries/pbkdf2.h"
+
+#define SE3_EMULATOR_ENV "SE3_EMULATOR"
+#define SE3_EMULATOR_LATENCY_ENV "SE3_EMULATOR_LATENCY_US"
+#define SE3_EMULATOR_SECTOR_BATCH_ENV "SE3_EMULATOR_SECTOR_BATCH"
+#define SE3_EMULATOR_RESET_MAC_ENV "SE3_EMULATOR_RESET_MAC"
+#define SE3_EMULATOR_STATE_FILE ".se3emu"
+#define SE3_EMULATOR_MAX_SESSIONS 100
+
+/** Crypto session opened by CRYPTO_INIT, released when FINIT is received. */
+typedef struct se3EmuSession_ {
+	uint16_t algorithm;
+	uint16_t mode;
+	uint16_t direction;
+	std::vector<uint8_t> key;
+	B5_tAesCtx aes;
+	B5_tSha256Ctx sha;
+	B5_tHmacSha256Ctx hmac;
+	B5_tHmacSha256Ctx hmacStart; // hmac as it was keyed, restored by RESET with SE3_EMULATOR_RESET_MAC
+} se3EmuSession;
+
+class L0Emulator {
+	private:
+		std::mutex lock;
+		std::string root;
+		//device state (persistent)
+		bool initialized;
+		uint8_t serialno[L0Communication::Size::SERIAL];
+		uint8_t pin[2][L0Communication::Size::MAGIC];
+		std::map<uint32_t, std::vector<uint8_t>> keys;
+		std::string sekeyId;
+		std::string sekeyName;
+		bool sekeyInfo;
+		//session state (volatile)
+		bool loggedIn;
+		uint16_t access;
+		uint8_t token[16];
+		uint8_t challengeCresp[32];
+		uint16_t challengeAccess;
+		bool challengePending;
+		uint32_t keyListCursor;
+		uint32_t nextSessionId;
+		std::map<uint32_t, se3EmuSession> sessions;
+		//payload protection, same keys as L1::Se3PayloadCryptoInit()
+		B5_tAesCtx payloadEnc;
+		B5_tAesCtx payloadDec;
+		B5_tHmacSha256Key payloadHmacKey;
+		//transport
+		uint8_t response[L0Communication::Parameter::COMM_N * L0Communication::Parameter::COMM_BLOCK];
+		uint64_t readyAt;
+		std::map<std::string, uint32_t> latency;
+		bool sectorBatch;
+		bool resetMac;
+
+		L0Emulator(const std::string& root);
+		void LoadLatency();
+		uint32_t Latency(uint16_t cmd, uint16_t l1Cmd);
+		bool LoadState();
+		bool SaveState();
+		void Process(const uint8_t* req, size_t nBlocks);
+		uint16_t L1Dispatch(uint16_t flags, std::vector<uint8_t>& req, std::vector<uint8_t>& resp, uint16_t* l1Cmd);
+		uint16_t CmdChallenge(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp);
+		uint16_t CmdLogin(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp);
+		uint16_t CmdConfig(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp);
+		uint16_t CmdKeyEdit(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp);
+		uint16_t CmdKeyFind(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp);
+		uint16_t CmdKeyList(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp);
+		uint16_t CmdCryptoList(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp);
+		uint16_t CmdCryptoInit(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp);
+		uint16_t CmdCryptoUpdate(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp);
+		uint16_t CryptoSectors(se3EmuSession& s, const uint8_t* nonces, uint16_t noncesLen, const uint8_t* sectors, uint16_t sectorsLen, std::vector<uint8_t>& out);
+		uint16_t CmdSekey(const std::vector<uint8_t>& req, std::vector<uint8_t>& resp);
+		void ListKeys(uint8_t filter, size_t maxEntries, std::vector<uint8_t>& resp);
+		void Logout();
+	public:
+		L0Emulator(const L0Emulator&) = delete;
+		L0Emulator& operator=(const L0Emulator&) = delete;
+		static bool Enabled(); /**< True if SE3_EMULATOR is set. */
+		static const std::vector<std::string>& Roots(); /**< Directories reported as mount points of the emulated SEcubes. */
+		static int EmulatedIndex(const se3Char* path); /**< Index in Roots() of the emulated SEcube mounted on path, -1 if path is not emulated. */
+		static L0Emulator& Instance(size_t index);
+		bool Write(const uint8_t* buf, size_t block, size_t nBlocks);
+		bool Read(uint8_t* buf, size_t block, size_t nBlocks);
+};
+
+#endif
+
+#endif
@@ -31,6 +31,7 @@
  */
 
 #include "L0.h"
+#include <algorithm>
 #include <string>
 
 int L0::GetDeviceList(std::vector<std::pair<std::string, std::string>>& devicelist){
@@ -66,6 +67,7 @@ int L0::GetDeviceList(std::vector<std::pair<std::string, std::string>>& deviceli
 }
 
 L0::L0() {
+	this->latencySubCmd = 0;
 	//initialize the secube discover
 	L0DiscoverInit();
 	//scan all the seCubes connected
@@ -97,20 +99,74 @@ L0::~L0() {
 }
 
 void L0::L0Restart() {
-	//close all the devices
-	for (uint8_t i = 0; i < this->nDevices; i++)
-		L0Close(i);
-	//clear all the secube devices found
-	this->base.ResetDeviceArray();
+	std::vector<std::pair<std::basic_string<se3Char>, std::string>> found;
+	uint8_t current = this->base.GetDevicePtr();
+	bool currentRemoved = false;
 
-	//re-initialise the devices as done in the ctor
 	L0DiscoverInit();
+	while(L0DiscoverNext()){
+		found.push_back(std::make_pair(std::basic_string<se3Char>(this->base.GetDiscoDevicePath()),
+				std::string((char*)this->base.GetDiscoDeviceSerialNo(), L0Communication::Size::SERIAL)));
+	}
+
+	//close and remove the devices that are gone, the others (and their state) are kept
+	for (int i = (int)this->base.GetNDevices() - 1; i >= 0; i--) {
+		this->base.SetDevicePtr(i);
+		se3DeviceInfo info = *this->base.GetDeviceInfo();
+		std::pair<std::basic_string<se3Char>, std::string> id(info.path, std::string((char*)info.serialno, L0Communication::Size::SERIAL));
+		if (std::find(found.begin(), found.end(), id) == found.end()) {
+			L0Close(i);
+			this->base.RemoveDevice(i);
+			this->base.PushDeviceEvent(false, &info);
+			if (i == current)
+				currentRemoved = true;
+			else if (i < current)
+				current--;
+		}
+	}
 
+	//add the new devices
+	L0DiscoverInit();
 	while(L0DiscoverNext()){
-		this->base.AddDevice();
+		if (this->base.FindDevice(this->base.GetDiscoDevicePath(), this->base.GetDiscoDeviceSerialNo()) < 0) {
+			this->base.AddDevice();
+			this->base.SetDevicePtr(this->base.GetNDevices() - 1);
+			this->base.PushDeviceEvent(true, this->base.GetDeviceInfo());
+		}
 	}
 
 	this->nDevices = this->base.GetNDevices();
+	this->base.SetDevicePtr(currentRemoved ? 0 : current);
+}
+
+bool L0::GetDeviceEvent(se3DeviceEvent& event) {
+	return this->base.PopDeviceEvent(&event);
+}
+
+bool L0::WaitDeviceEvent(uint32_t timeoutMs) {
+#ifdef _WIN32
+	//no notification of the drives, just rescan after the timeout
+	Sleep(timeoutMs);
+#else
+	L0DeviceRegistry::Wait(timeoutMs);
+#endif
+	L0Restart();
+	return this->base.HasDeviceEvents();
+}
+
+void L0::SetLatencySubCommand(uint16_t subCmd) {
+	this->latencySubCmd = subCmd;
+}
+
+const se3LatencyHistogram* L0::GetLatencyHistogram(uint16_t cmd, uint16_t subCmd) {
+	if (this->base.GetNDevices() == 0)
+		return NULL;
+	return this->base.GetDeviceLatency(L0Support::Se3LatencySlot(cmd, subCmd));
+}
+
+void L0::ResetLatencyHistograms() {
+	if (this->base.GetNDevices() > 0)
+		this->base.ResetDeviceLatency();
 }
 
 uint8_t L0::GetNumberDevices() {
@@ -51,6 +51,7 @@ private:
 	uint16_t L0RX(uint16_t* respStatus, uint16_t* respLen, uint8_t* respData) override ;
 	//CLASS ATTRIBUTES
 	int nDevices;
+	uint16_t latencySubCmd; // L1 command carried by the next L1_CMD0 request, used only for the latency histograms
 public:
 	L0();
 	~L0();
@@ -64,6 +65,8 @@ public:
 	void L0Open(uint8_t devPtr) override ;
 	void L0Close(uint8_t devPtr) override ;
 	void L0TXRX(uint16_t reqCmd, uint16_t reqCmdFlags, uint16_t reqLen, const uint8_t* reqData, uint16_t* respStatus, uint16_t* respLen, uint8_t* respData) override ;
+	void L0TXSubmit(uint16_t reqCmd, uint16_t reqCmdFlags, uint16_t reqLen, const uint8_t* reqData) override ;
+	void L0RXReap(uint16_t* respStatus, uint16_t* respLen, uint8_t* respData) override ;
 	uint16_t L0Echo(const uint8_t* dataIn, uint16_t dataInLen, uint8_t* dataOut) override ;
 
 	//PROVISION
@@ -79,6 +82,24 @@ public:
 	se3Char* GetDevicePath(){return this->base.GetDeviceInfoPath();}
 	uint8_t* GetDeviceSn(){return this->base.GetDeviceInfoSerialNo();}
 	int GetDeviceList(std::vector<std::pair<std::string, std::string>>& devicelist);
+	//DEVICE EVENTS
+	/** @brief Get the oldest device connected or removed since the device list was last updated (by L0Restart(), GetDeviceList() or WaitDeviceEvent()).
+	 * Only the last SE3_DEVICE_EVENTS_MAX events are kept.
+	 * @return false if there is no event. */
+	bool GetDeviceEvent(se3DeviceEvent& event);
+	/** @brief Wait at most timeoutMs for a filesystem to be mounted or unmounted, then update the device list.
+	 * @return true if there are device events to be read with GetDeviceEvent(). */
+	bool WaitDeviceEvent(uint32_t timeoutMs);
+	//LATENCY STATISTICS
+	/** @brief Tag the next L1_CMD0 request with the L1 command it carries, so that its round trip is accounted to that command. */
+	void SetLatencySubCommand(uint16_t subCmd);
+	/** @brief Histogram of the round trip times (request written to response read) of a command sent to the current device.
+	 * @param cmd L0 command (L0Commands::Command).
+	 * @param subCmd L1 command (L1Commands::Codes), used only if cmd is L1_CMD0.
+	 * @return The histogram, NULL if there is no device. */
+	const se3LatencyHistogram* GetLatencyHistogram(uint16_t cmd, uint16_t subCmd);
+	/** @brief Clear all the latency histograms of the current device. */
+	void ResetLatencyHistograms();
 	//LOGFILE MANAGING
 	bool Se3CreateLogFile(char* path, uint32_t file_dim);
 	char* Se3CreateLogFilePath(char *name);
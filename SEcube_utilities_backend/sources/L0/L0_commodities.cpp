@@ -67,60 +67,27 @@ bool L0::Se3DriveNext() {
 #else
 //UNIX
 bool L0::Se3DriveNext() {
-    char buf[SE3_DRIVE_BUF_MAX];
-    memset(buf, '\0', SE3_DRIVE_BUF_MAX);
-    if(this->base.GetDiscoDriveFile() == nullptr){
-    	return false;
-    }
-    if(fgets(this->base.GetDiscoDriveBuf(), SE3_DRIVE_BUF_MAX, this->base.GetDiscoDriveFile()) != nullptr) {
-    	/* this->base.GetDiscoDriveBuf() is se3Char buf[SE3_DRIVE_BUF_MAX + 1] but it is filled by fgets() with SE3_DRIVE_BUF_MAX limit, including NULL terminator character
-    	 * buf is char buf[SE3_DRIVE_BUF_MAX], including NULL terminator
-    	 * sscanf automatically adds a NULL terminator, which is OK because this->base.GetDiscoDriveBuf() has been initialized by fgets() with SE3_DRIVE_BUF_MAX including NULL terminator, and buf is char buf[SE3_DRIVE_BUF_MAX] */
-        sscanf(this->base.GetDiscoDriveBuf(), "%*s%s", buf);
-        strcpy(this->base.GetDiscoDriveBuf(), buf);
-        this->base.SetDiscoDrivePath(this->base.GetDiscoDriveBuf());
-        return true;
-    }
-    fclose(this->base.GetDiscoDriveFile());
-    this->base.SetDiscoDriveFile(nullptr);
-    return false;
+	//the drives have already been found and probed by L0DiscoverInit(), see L0DeviceRegistry
+	size_t next = this->base.GetDiscoFoundNext();
+	if (next >= this->base.GetDiscoFound().size())
+		return false;
+	strncpy(this->base.GetDiscoDriveBuf(), this->base.GetDiscoFound()[next].path, SE3_DRIVE_BUF_MAX);
+	this->base.SetDiscoDrivePath(this->base.GetDiscoDriveBuf());
+	this->base.SetDiscoFoundNext(next + 1);
+	return true;
 }
 #endif
 
 bool L0::Se3Info(uint64_t deadline, se3DiscoverInfo* info) {
-	uint8_t buf[L0Communication::Parameter::COMM_BLOCK];
-	se3File hFile;
-	int r;
-
-	r = L0Support::Se3OpenExisting(this->base.GetDiscoDrivePath(), false, deadline, &hFile);
-
-	if (r == L0Communication::Error::OK) {
-		if (!L0Support::Se3Read(buf, hFile, 15, 1, SE3C_MAGIC_TIMEOUT)) {
-			L0Support::Se3Close(hFile);
-			return false;
-		}
-
-		if (!L0Support::Se3ReadInfo(buf, info)) {
-			L0Support::Se3Close(hFile);
-			r = L0Communication::Error::ERR_NOT_FOUND;
-		}
-		else {
-			L0Support::Se3Close(hFile);
-			return true;
-		}
-	}
-
-	if (r == L0Communication::Error::ERR_NOT_FOUND) {
-		if (L0Support::Se3MagicInit(this->base.GetDiscoDrivePath(), buf, info))
-			return true;
-		else
-			return false;
+#ifndef _WIN32
+	//UNIX: the drive returned by Se3DriveNext() has already been probed by L0Discovery
+	size_t next = this->base.GetDiscoFoundNext();
+	if (next > 0 && next <= this->base.GetDiscoFound().size()) {
+		*info = this->base.GetDiscoFound()[next - 1].info;
+		return true;
 	}
-	//this else can be canceled, since the method returns false anyway
-	else
-		return false;
-
-	return false;
+#endif
+	return L0Support::Se3Probe(this->base.GetDiscoDrivePath(), deadline, info);
 }
 
 #ifdef _WIN32
@@ -133,7 +100,8 @@ void L0::L0DiscoverInit() {
 #else
 //UNIX
 void L0::L0DiscoverInit() {
-	this->base.SetDiscoDriveFile(fopen("/proc/mounts", "r"));
+	L0DeviceRegistry::Snapshot(this->base.GetDiscoFound());
+	this->base.SetDiscoFoundNext(0);
 }
 #endif
 
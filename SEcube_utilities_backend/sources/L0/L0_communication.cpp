@@ -40,7 +40,7 @@ using namespace std;
 ///////////////////
 
 bool L0::Se3Open(uint64_t deadline, se3File* phFile, se3DiscoverInfo* disco) {
-	uint8_t buf[L0Communication::Parameter::COMM_BLOCK];
+	alignas(L0Communication::Parameter::COMM_BLOCK) uint8_t buf[L0Communication::Parameter::COMM_BLOCK];
 	se3File hFile;
 	int r;
 	bool discoverInfoRead = false;
@@ -128,6 +128,8 @@ uint16_t L0::L0TX(uint16_t cmd, uint16_t cmdFlags, uint16_t len, const uint8_t*
 	//send the data by writing inside the file
 	if (!L0Support::Se3Write(this->base.GetDeviceRequest(), this->base.GetDeviceFile(), 0, nBlocks, SE3_TIMEOUT))
 		return L0ErrorCodes::Error::COMMUNICATION;
+	L0Support::Se3WaitStart(this->base.GetDeviceWait());
+	SE3GET32(this->base.GetDeviceRequest(), L0Request::Offset::CMD_TOKEN, this->base.GetDeviceWait()->token);
 
 	return L0ErrorCodes::Error::OK;
 }
@@ -152,7 +154,7 @@ uint16_t L0::L0RX(uint16_t* respStatus, uint16_t* respLen, uint8_t* respData) {
 	uint16_t offsetDst;
 
 	while (!ready) {
-		Se3Sleep();
+		L0Support::Se3WaitNext(this->base.GetDeviceWait());
 
 		if (!L0Support::Se3Read(this->base.GetDeviceResponse(), this->base.GetDeviceFile(), 0, 1, SE3_TIMEOUT)) {
 			success = false;
@@ -170,6 +172,7 @@ uint16_t L0::L0RX(uint16_t* respStatus, uint16_t* respLen, uint8_t* respData) {
 
 	if (!success)
 		return L0ErrorCodes::Error::COMMUNICATION;
+	L0Support::Se3WaitDone(this->base.GetDeviceWait());
 
 	SE3GET16(this->base.GetDeviceResponse(), L0Response::Offset::LEN, lenDataAndHeaders);
 	len = L0Support::Se3RespLenData(lenDataAndHeaders);
@@ -183,8 +186,10 @@ uint16_t L0::L0RX(uint16_t* respStatus, uint16_t* respLen, uint8_t* respData) {
 		if (!L0Support::Se3Read(this->base.GetDeviceResponse() + L0Communication::Parameter::COMM_BLOCK, this->base.GetDeviceFile(), 1, nBlocks - 1, SE3_TIMEOUT))
 			return L0ErrorCodes::Error::COMMUNICATION;
 
-	//check cmdtokens
+	//check cmdtokens, the response must belong to the request that was sent
 	SE3GET32(this->base.GetDeviceResponse(), L0Response::Offset::CMD_TOKEN, cmdtok0);
+	if (cmdtok0 != this->base.GetDeviceWait()->token)
+		return L0ErrorCodes::Error::COMMUNICATION;
 
 	for (i = 1; i < nBlocks; i++) {
 		cmdtok0++;
@@ -302,6 +307,7 @@ void L0::L0Close(uint8_t devPtr) {
 
 	if (this->base.GetDeviceOpened()) {
 		this->base.SetDeviceOpened(false);
+		this->base.GetDeviceWait()->pending = false;
 		if (this->base.GetDeviceRequest() != NULL){
 			this->base.FreeDeviceRequest();
 		}
@@ -313,12 +319,18 @@ void L0::L0Close(uint8_t devPtr) {
 }
 
 void L0::L0TXRX(uint16_t reqCmd, uint16_t reqCmdFlags, uint16_t reqLen, const uint8_t* reqData, uint16_t* respStatus, uint16_t* respLen, uint8_t* respData) {
+	L0TXSubmit(reqCmd, reqCmdFlags, reqLen, reqData);
+	L0RXReap(respStatus, respLen, respData);
+}
+
+void L0::L0TXSubmit(uint16_t reqCmd, uint16_t reqCmdFlags, uint16_t reqLen, const uint8_t* reqData) {
 	uint16_t error = 0;	//error value
+	size_t slot = L0Support::Se3LatencySlot(reqCmd, this->latencySubCmd);
+	se3Wait* wait = NULL;
 
 	L0NoDeviceOpenedException noDevExc;
 	L0ParametersErrorException paramEcx;
 	L0TXException txExc;
-	L0RXException rxExc;
 
 	if (!this->base.GetDeviceOpened())
 		throw noDevExc;
@@ -329,15 +341,42 @@ void L0::L0TXRX(uint16_t reqCmd, uint16_t reqCmdFlags, uint16_t reqLen, const ui
 	//if (this->base.GetDevice() == NULL || reqLen > SE3_REQ_MAX_DATA)
 		//return SE3_ERR_PARAMS;
 
+	//the device serves one request at a time, the previous response must be read first
+	wait = this->base.GetDeviceWait();
+	if (wait->pending)
+		throw txExc;
+
+	this->latencySubCmd = 0;
+	wait->slot = slot;
+	wait->submitted = L0Support::Se3ClockUs();
 	error = L0TX(reqCmd, reqCmdFlags, reqLen, reqData);
 
 	if (error != L0ErrorCodes::Error::OK)
 		throw txExc;
+	wait->pending = true;
+}
+
+void L0::L0RXReap(uint16_t* respStatus, uint16_t* respLen, uint8_t* respData) {
+	uint16_t error = 0;	//error value
+	se3Wait* wait = NULL;
+
+	L0NoDeviceOpenedException noDevExc;
+	L0RXException rxExc;
+
+	if (!this->base.GetDeviceOpened())
+		throw noDevExc;
+
+	wait = this->base.GetDeviceWait();
+	if (!wait->pending)
+		throw rxExc;
+	wait->pending = false;
 
 	error = L0RX(respStatus, respLen, respData);
 
 	if (error != L0ErrorCodes::Error::OK)
 		throw rxExc;
+
+	L0Support::Se3LatencyRecord(this->base.GetDeviceLatency(wait->slot), L0Support::Se3ClockUs() - wait->submitted);
 }
 
 uint16_t L0::L0Echo(const uint8_t* dataIn, uint16_t dataInLen, uint8_t* dataOut) {
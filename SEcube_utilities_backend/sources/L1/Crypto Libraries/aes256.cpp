@@ -30,6 +30,7 @@
  */
 
 #include "aes256.h"
+#include "aes256_ni.h"
 
 
 
@@ -1212,6 +1213,64 @@ void B5_rijndaelDecrypt (B5_tAesCtx *ctx, uint32_t *rk, int16_t Nr, const uint8_
 
 
 
+#define B5_AES256_CTR_LANES     8   /* counter blocks encrypted before the XOR with the data, in CTR mode */
+
+/**
+ * @brief Convert the 128 bit big endian counter of CTR mode into two 64 bit words.
+ * @param iv Counter block.
+ * @param hi Most significant word.
+ * @param lo Least significant word.
+ */
+static void B5_Aes256_CtrLoad (const uint8_t *iv, uint64_t *hi, uint64_t *lo)
+{
+    *hi = ((uint64_t)B5_AES256_GETUINT32(iv) << 32) | B5_AES256_GETUINT32(iv + 4);
+    *lo = ((uint64_t)B5_AES256_GETUINT32(iv + 8) << 32) | B5_AES256_GETUINT32(iv + 12);
+}
+
+/**
+ * @brief Convert two 64 bit words into the 128 bit big endian counter of CTR mode.
+ * @param hi Most significant word.
+ * @param lo Least significant word.
+ * @param iv Counter block.
+ */
+static void B5_Aes256_CtrStore (uint64_t hi, uint64_t lo, uint8_t *iv)
+{
+    int k;
+
+    for (k = 7; k >= 0; k--)
+    {
+        iv[k] = (uint8_t)hi;
+        iv[k + 8] = (uint8_t)lo;
+        hi >>= 8;
+        lo >>= 8;
+    }
+}
+
+/**
+ * @brief XOR two buffers, 64 bits at a time.
+ * @param out Output buffer (it may be one of the inputs).
+ * @param a First input buffer.
+ * @param b Second input buffer.
+ * @param len Length of the buffers, multiple of B5_AES_BLK_SIZE.
+ */
+static void B5_Aes256_Xor (uint8_t *out, const uint8_t *a, const uint8_t *b, size_t len)
+{
+    uint64_t wa, wb;
+    size_t   i;
+
+    for (i = 0; i < len; i += sizeof(uint64_t))
+    {
+        memcpy(&wa, a + i, sizeof(wa));
+        memcpy(&wb, b + i, sizeof(wb));
+        wa ^= wb;
+        memcpy(out + i, &wa, sizeof(wa));
+    }
+}
+
+
+
+
+
 int32_t B5_Aes256_Init (B5_tAesCtx *ctx, const uint8_t *Key, int16_t keySize, uint8_t aesMode)
 {
     if(Key == NULL)
@@ -1302,30 +1361,37 @@ int32_t B5_Aes256_Update (B5_tAesCtx	*ctx, uint8_t *encData, uint8_t *clrData, i
         return B5_AES256_RES_INVALID_ARGUMENT;
 
 
+    if(B5_Aes256_GetImpl() != B5_AES256_IMPL_TABLES)
+        return B5_Aes256Ni_Update(ctx, encData, clrData, nBlk, B5_Aes256_GetImpl());
+
+
     switch(ctx->mode) {
 
 
         case B5_AES256_CTR:
         {
-            for (i = 0; i < nBlk; i++)
+            /* the keystream of up to B5_AES256_CTR_LANES blocks is generated first, then XORed with the data a word at a time */
+            uint8_t  ks[B5_AES256_CTR_LANES * B5_AES_BLK_SIZE];
+            uint64_t ctrHi, ctrLo;
+
+            B5_Aes256_CtrLoad(ctx->InitVector, &ctrHi, &ctrLo);
+            memcpy(tmp, ctx->InitVector, B5_AES_BLK_SIZE);
+            for (i = 0; i < nBlk; i += cb)
             {
-                B5_rijndaelEncrypt(ctx, ctx->rk, ctx->Nr, ctx->InitVector, encData);
-                for (j = 0; j < B5_AES_BLK_SIZE; j++)
+                cb = ((nBlk - i) < B5_AES256_CTR_LANES) ? (nBlk - i) : B5_AES256_CTR_LANES;
+                for (j = 0; j < cb; j++)
                 {
-                    //*encData = *clrData++ ^ encData[j];
-                    //*encData++;
-                    /*Working*/
-					*encData = *encData ^ *clrData;
-					encData++;
-					clrData++;
+                    B5_rijndaelEncrypt(ctx, ctx->rk, ctx->Nr, tmp, ks + j * B5_AES_BLK_SIZE);
+                    if (++ctrLo == 0)
+                        ctrHi++;    /* 128 bit carry */
+                    B5_Aes256_CtrStore(ctrHi, ctrLo, tmp);
                 }
-
-                j = 15;
-                do {
-                    ctx->InitVector[j]++;
-                    cb = ctx->InitVector[j] == 0;
-                } while( j-- && cb );
+                B5_Aes256_Xor(encData, clrData, ks, cb * B5_AES_BLK_SIZE);
+                encData += cb * B5_AES_BLK_SIZE;
+                clrData += cb * B5_AES_BLK_SIZE;
             }
+            memcpy(ctx->InitVector, tmp, B5_AES_BLK_SIZE);
+            memset(ks, 0, sizeof(ks));
 
             break;
         }
@@ -1482,6 +1548,30 @@ int32_t B5_Aes256_Finit (B5_tAesCtx    *ctx)
 
 
 
+static int32_t *B5_Aes256_Impl (void)
+{
+    static int32_t impl = B5_Aes256Ni_MaxImpl();
+    return &impl;
+}
+
+int32_t B5_Aes256_GetImpl (void)
+{
+    return *B5_Aes256_Impl();
+}
+
+int32_t B5_Aes256_SetImpl (int32_t impl)
+{
+    if((impl < B5_AES256_IMPL_TABLES) || (impl > B5_Aes256Ni_MaxImpl()))
+        return B5_AES256_RES_INVALID_ARGUMENT;
+
+    *B5_Aes256_Impl() = impl;
+
+    return B5_AES256_RES_OK;
+}
+
+
+
+
 
 
 
@@ -80,6 +80,17 @@ extern "C" {
 ///@}
 /** @} */
 
+/** \defgroup aesImpl AES implementations
+ * @{
+ */
+/** \name AES implementations */
+///@{
+#define B5_AES256_IMPL_TABLES   0       /**< Portable table based implementation */
+#define B5_AES256_IMPL_AESNI    1       /**< x86 AES-NI instructions, 8 blocks at a time in CTR, ECB, CBC and CFB decryption */
+#define B5_AES256_IMPL_VAES     2       /**< x86 VAES and AVX2 instructions, 16 blocks at a time in CTR, ECB, CBC and CFB decryption (not on Windows) */
+///@}
+/** @} */
+
 /** \defgroup aesStr AES data structures
  * @{
  */
@@ -149,6 +160,21 @@ int32_t    B5_Aes256_Update (B5_tAesCtx *ctx, uint8_t *encData, uint8_t *clrData
  */
 int32_t    B5_Aes256_Finit  (B5_tAesCtx *ctx);
 
+/**
+ *
+ * @brief Get the implementation used by B5_Aes256_Update().
+ * @return See \ref aesImpl . By default, the best implementation supported by the CPU.
+ */
+int32_t    B5_Aes256_GetImpl (void);
+
+/**
+ *
+ * @brief Select the implementation used by B5_Aes256_Update() (i.e. to compare them). Not thread safe, call it before using AES.
+ * @param impl See \ref aesImpl .
+ * @return See \ref aesReturn . B5_AES256_RES_INVALID_ARGUMENT if the CPU does not support impl.
+ */
+int32_t    B5_Aes256_SetImpl (int32_t impl);
+
 ///@}
 /** @} */
 
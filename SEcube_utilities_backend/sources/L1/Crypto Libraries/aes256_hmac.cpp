@@ -0,0 +1,231 @@
+/**
+  ******************************************************************************
+  * File Name          : aes256_hmac.cpp
+  * Description        : AES-CBC with HMAC-SHA256 (encrypt-then-MAC) implementation.
+  ******************************************************************************
+  *
+  * Copyright  2016-present Blu5 Group <https://www.blu5group.com>
+  *
+  * This library is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU Lesser General Public
+  * License as published by the Free Software Foundation; either
+  * version 3 of the License, or (at your option) any later version.
+  *
+  * This library is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  * Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+  *
+  ******************************************************************************
+  */
+
+/**
+ * @file aes256_hmac.cpp
+ * @date 17/10/2026
+ * @brief This file includes AES-CBC combined with HMAC-SHA256. See \ref aes256_hmac.h .
+ *
+ * Encryption interleaves AES-NI and SHA-NI rounds when both are selected; otherwise, and always when decrypting,
+ * the two algorithms run one after the other with the implementations selected by B5_Aes256_SetImpl() and
+ * B5_Sha256_SetImpl(). CBC decryption has no serial chain to hide SHA-NI behind: the AES-NI/VAES code decrypts
+ * 8 or 16 blocks in parallel and is faster as a separate pass.
+ */
+
+#include "aes256_hmac.h"
+#include "sha256_ni_rounds.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+/* AES-CBC stitched with SHA-NI (AES-256 only, Nr = 14): a CBC chain is bound by the latency of AESENC, SHA-256 by
+ * the latency of SHA256RNDS2, so the two chains run side by side on the same cache resident data.
+ * The hashed stream is the ciphertext after the bytes already in the SHA buffer (left of them): the SHA block c is
+ * made of the last left bytes of the chunk c - 1 (or the SHA buffer) and the first 64 - left bytes of the chunk c */
+
+#define B5_STITCH_TARGET __attribute__((target("aes,sha,sse4.1")))
+#define B5_STITCH_NR 14
+
+B5_STITCH_TARGET static inline void B5_StitchLoadKeys (const B5_tAesCtx *ctx, __m128i *k)
+{
+    const __m128i bswap32 = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    for (int r = 0; r <= B5_STITCH_NR; r++)
+        k[r] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(ctx->rk + 4 * r)), bswap32);
+}
+
+/* step s (0 to 55) of the encryption of a chunk: round s % 14 of its block s / 14 */
+B5_STITCH_TARGET static inline __attribute__((always_inline)) void B5_StitchEncStep (int s, const __m128i *k, __m128i &x, __m128i &prev, uint8_t *chunk)
+{
+    int b = s / B5_STITCH_NR, r = s % B5_STITCH_NR;
+
+    if (r == 0)
+        x = _mm_aesenc_si128(_mm_xor_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i*)(chunk + 16 * b)), prev), k[0]), k[1]);
+    else if (r < B5_STITCH_NR - 1)
+        x = _mm_aesenc_si128(x, k[r + 1]);
+    else
+    {
+        x = _mm_aesenclast_si128(x, k[B5_STITCH_NR]);
+        _mm_storeu_si128((__m128i*)(chunk + 16 * b), x);
+        prev = x;
+    }
+}
+
+/* 64 rounds of SHA-256 over blk, 4 by 4, with the AES steps of a chunk in between */
+#define B5_STITCH_ROUNDS(STEP)                                                          \
+    do {                                                                                \
+        __m128i abefSave = abef, cdghSave = cdgh;                                       \
+        B5_ShaNiRounds<0>(abef, cdgh, m, blk);  STEP(0);                                \
+        B5_ShaNiRounds<1>(abef, cdgh, m, blk);  STEP(1);                                \
+        B5_ShaNiRounds<2>(abef, cdgh, m, blk);  STEP(2);                                \
+        B5_ShaNiRounds<3>(abef, cdgh, m, blk);  STEP(3);                                \
+        B5_ShaNiRounds<4>(abef, cdgh, m, blk);  STEP(4);                                \
+        B5_ShaNiRounds<5>(abef, cdgh, m, blk);  STEP(5);                                \
+        B5_ShaNiRounds<6>(abef, cdgh, m, blk);  STEP(6);                                \
+        B5_ShaNiRounds<7>(abef, cdgh, m, blk);  STEP(7);                                \
+        B5_ShaNiRounds<8>(abef, cdgh, m, blk);  STEP(8);                                \
+        B5_ShaNiRounds<9>(abef, cdgh, m, blk);  STEP(9);                                \
+        B5_ShaNiRounds<10>(abef, cdgh, m, blk); STEP(10);                               \
+        B5_ShaNiRounds<11>(abef, cdgh, m, blk); STEP(11);                               \
+        B5_ShaNiRounds<12>(abef, cdgh, m, blk); STEP(12);                               \
+        B5_ShaNiRounds<13>(abef, cdgh, m, blk); STEP(13);                               \
+        B5_ShaNiRounds<14>(abef, cdgh, m, blk); STEP(14);                               \
+        B5_ShaNiRounds<15>(abef, cdgh, m, blk); STEP(15);                               \
+        abef = _mm_add_epi32(abef, abefSave);                                           \
+        cdgh = _mm_add_epi32(cdgh, cdghSave);                                           \
+    } while (0)
+
+/* 56 encryption steps spread over the 16 quarters of a SHA block: 3 or 4 each */
+#define B5_STITCH_ENC(Q)    for (int s = (Q) * 7 / 2; s < ((Q) + 1) * 7 / 2; s++) B5_StitchEncStep(s, k, x, prev, chunk)
+#define B5_STITCH_NONE(Q)
+
+B5_STITCH_TARGET static inline void B5_StitchShaLoad (const B5_tSha256Ctx *shaCtx, __m128i &abef, __m128i &cdgh)
+{
+    __m128i t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)shaCtx->state), 0xB1);
+    cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(shaCtx->state + 4)), 0x1B);
+    abef = _mm_alignr_epi8(t, cdgh, 8);
+    cdgh = _mm_blend_epi16(cdgh, t, 0xF0);
+}
+
+/* the SHA state is stored back, with the count of the bytes hashed: after them the SHA buffer is empty */
+B5_STITCH_TARGET static inline void B5_StitchShaStore (B5_tSha256Ctx *shaCtx, __m128i abef, __m128i cdgh, uint32_t hashed)
+{
+    __m128i t = _mm_shuffle_epi32(abef, 0x1B);
+    cdgh = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128((__m128i*)shaCtx->state, _mm_blend_epi16(t, cdgh, 0xF0));
+    _mm_storeu_si128((__m128i*)(shaCtx->state + 4), _mm_alignr_epi8(cdgh, t, 8));
+
+    shaCtx->total[0] += hashed;
+    if (shaCtx->total[0] < hashed)
+        shaCtx->total[1]++;
+}
+
+/* AES-CBC encryption in place, then SHA-256 of the ciphertext: the AES rounds of the chunk c are interleaved with the SHA rounds of the chunk c - 1 */
+B5_STITCH_TARGET static void B5_StitchCbcEncrypt (B5_tAesCtx *aesCtx, B5_tSha256Ctx *shaCtx, uint8_t *data, int32_t nBlk)
+{
+    int32_t nChunk = nBlk / 4, c;
+    uint32_t left = shaCtx->total[0] & 0x3F;
+    uint8_t first[B5_SHA256_BLOCK_SIZE];
+    const uint8_t *blk;
+    uint8_t *chunk;
+    __m128i k[B5_STITCH_NR + 1], x, prev, abef, cdgh, m[4];
+
+    if ((aesCtx->Nr != B5_STITCH_NR) || (nChunk == 0))
+    {
+        B5_Aes256_Update(aesCtx, data, data, (int16_t)nBlk);
+        B5_Sha256_Update(shaCtx, data, nBlk * B5_AES_BLK_SIZE);
+        return;
+    }
+
+    B5_StitchLoadKeys(aesCtx, k);
+    B5_StitchShaLoad(shaCtx, abef, cdgh);
+    prev = _mm_loadu_si128((const __m128i*)aesCtx->InitVector);
+    x = prev;
+
+    /* the first chunk has no ciphertext to hash yet */
+    chunk = data;
+    for (int s = 0; s < 4 * B5_STITCH_NR; s++)
+        B5_StitchEncStep(s, k, x, prev, chunk);
+    memcpy(first, shaCtx->buffer, left);
+    memcpy(first + left, data, B5_SHA256_BLOCK_SIZE - left);
+
+    for (c = 1; c < nChunk; c++)
+    {
+        blk = (c == 1) ? first : (data + B5_SHA256_BLOCK_SIZE * (c - 1) - left);
+        chunk = data + B5_SHA256_BLOCK_SIZE * c;
+        B5_STITCH_ROUNDS(B5_STITCH_ENC);
+    }
+    blk = (nChunk == 1) ? first : (data + B5_SHA256_BLOCK_SIZE * (nChunk - 1) - left);
+    B5_STITCH_ROUNDS(B5_STITCH_NONE);
+
+    B5_StitchShaStore(shaCtx, abef, cdgh, B5_SHA256_BLOCK_SIZE * nChunk - left);
+    _mm_storeu_si128((__m128i*)aesCtx->InitVector, prev);
+    memset(k, 0, sizeof(k));
+
+    /* blocks after the last chunk */
+    data += B5_SHA256_BLOCK_SIZE * nChunk;
+    nBlk -= 4 * nChunk;
+    if (nBlk > 0)
+        B5_Aes256_Update(aesCtx, data, data, (int16_t)nBlk);
+    B5_Sha256_Update(shaCtx, data - left, nBlk * B5_AES_BLK_SIZE + left);
+}
+
+#else
+
+static void B5_StitchCbcEncrypt (B5_tAesCtx *aesCtx, B5_tSha256Ctx *shaCtx, uint8_t *data, int32_t nBlk)
+{
+}
+
+#endif
+
+int32_t B5_Aes256HmacSha256_Stitched (void)
+{
+    return ((B5_Aes256_GetImpl() != B5_AES256_IMPL_TABLES) && (B5_Sha256_GetImpl() == B5_SHA256_IMPL_SHANI)) ? 1 : 0;
+}
+
+int32_t B5_Aes256HmacSha256_Encrypt (B5_tAesCtx *aesCtx, B5_tHmacSha256Ctx *hmacCtx, const uint8_t *iv, uint8_t *data, int16_t nBlk)
+{
+    int32_t ret;
+
+    if ((aesCtx == NULL) || (hmacCtx == NULL))
+        return B5_AES256_RES_INVALID_CONTEXT;
+    if (aesCtx->mode != B5_AES256_CBC_ENC)
+        return B5_AES256_RES_INVALID_MODE;
+    if ((data == NULL) || (nBlk <= 0))
+        return B5_AES256_RES_INVALID_ARGUMENT;
+
+    ret = B5_Aes256_SetIV(aesCtx, iv);
+    if (ret != B5_AES256_RES_OK)
+        return ret;
+    B5_HmacSha256_Update(hmacCtx, iv, B5_AES_IV_SIZE);
+
+    if (B5_Aes256HmacSha256_Stitched())
+    {
+        B5_StitchCbcEncrypt(aesCtx, &hmacCtx->shaCtx, data, nBlk);
+        return B5_AES256_RES_OK;
+    }
+
+    ret = B5_Aes256_Update(aesCtx, data, data, nBlk);
+    B5_HmacSha256_Update(hmacCtx, data, nBlk * B5_AES_BLK_SIZE);
+
+    return ret;
+}
+
+int32_t B5_Aes256HmacSha256_Decrypt (B5_tAesCtx *aesCtx, B5_tHmacSha256Ctx *hmacCtx, const uint8_t *iv, uint8_t *data, int16_t nBlk)
+{
+    int32_t ret;
+
+    if ((aesCtx == NULL) || (hmacCtx == NULL))
+        return B5_AES256_RES_INVALID_CONTEXT;
+    if (aesCtx->mode != B5_AES256_CBC_DEC)
+        return B5_AES256_RES_INVALID_MODE;
+    if ((data == NULL) || (nBlk <= 0))
+        return B5_AES256_RES_INVALID_ARGUMENT;
+
+    ret = B5_Aes256_SetIV(aesCtx, iv);
+    if (ret != B5_AES256_RES_OK)
+        return ret;
+    B5_HmacSha256_Update(hmacCtx, iv, B5_AES_IV_SIZE);
+
+    B5_HmacSha256_Update(hmacCtx, data, nBlk * B5_AES_BLK_SIZE);
+    return B5_Aes256_Update(aesCtx, data, data, nBlk);
+}
@@ -0,0 +1,80 @@
+/**
+  ******************************************************************************
+  * File Name          : aes256_hmac.h
+  * Description        : AES-CBC with HMAC-SHA256 (encrypt-then-MAC) header file.
+  ******************************************************************************
+  *
+  * Copyright  2016-present Blu5 Group <https://www.blu5group.com>
+  *
+  * This library is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU Lesser General Public
+  * License as published by the Free Software Foundation; either
+  * version 3 of the License, or (at your option) any later version.
+  *
+  * This library is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  * Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+  *
+  ******************************************************************************
+  */
+
+/*! \file  aes256_hmac.h
+ *  \brief This file defines AES-CBC encryption combined with HMAC-SHA256 of the IV and of the ciphertext, as done on the L1 payload.
+ *  \version SEcube Open Source SDK 1.5.1
+ *  \detail The result is the same of B5_Aes256_Update() followed (or preceded, when decrypting) by B5_HmacSha256_Update(). When
+ *  encrypting with AES-NI and SHA-NI the data is read once: the rounds of the two algorithms are interleaved on the same 64 byte chunks.
+ */
+
+#pragma once
+
+#include "aes256.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "sha256.h"
+
+/** \defgroup aesHmacFunc AES-CBC with HMAC-SHA256 functions
+ * @{
+ */
+/** \name AES-CBC with HMAC-SHA256 functions */
+///@{
+
+/**
+ * @brief Encrypt the data in place with AES-CBC, then add the IV and the ciphertext to the HMAC.
+ * @param aesCtx AES context initialized in B5_AES256_CBC_ENC mode.
+ * @param hmacCtx HMAC-SHA256 context, already initialized: the caller computes the MAC with B5_HmacSha256_Finit().
+ * @param iv Initialization vector (B5_AES_IV_SIZE bytes).
+ * @param data Clear data on input, encrypted data on output.
+ * @param nBlk Number of AES blocks.
+ * @return See \ref aesReturn .
+ */
+int32_t B5_Aes256HmacSha256_Encrypt (B5_tAesCtx *aesCtx, B5_tHmacSha256Ctx *hmacCtx, const uint8_t *iv, uint8_t *data, int16_t nBlk);
+
+/**
+ * @brief Add the IV and the ciphertext to the HMAC, then decrypt the data in place with AES-CBC.
+ * @param aesCtx AES context initialized in B5_AES256_CBC_DEC mode.
+ * @param hmacCtx HMAC-SHA256 context, already initialized: the caller computes the MAC with B5_HmacSha256_Finit() and must discard the data if it does not match.
+ * @param iv Initialization vector (B5_AES_IV_SIZE bytes).
+ * @param data Encrypted data on input, clear data on output.
+ * @param nBlk Number of AES blocks.
+ * @return See \ref aesReturn .
+ */
+int32_t B5_Aes256HmacSha256_Decrypt (B5_tAesCtx *aesCtx, B5_tHmacSha256Ctx *hmacCtx, const uint8_t *iv, uint8_t *data, int16_t nBlk);
+
+/**
+ * @brief Check if the AES and SHA implementations selected allow interleaving the two algorithms.
+ * @return 1 if B5_Aes256HmacSha256_Encrypt() uses the stitched AES-NI and SHA-NI code, 0 otherwise.
+ */
+int32_t B5_Aes256HmacSha256_Stitched (void);
+///@}
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,484 @@
+/**
+  ******************************************************************************
+  * File Name          : aes256_ni.cpp
+  * Description        : AES-NI and VAES implementation of AES.
+  ******************************************************************************
+  *
+  * Copyright  2016-present Blu5 Group <https://www.blu5group.com>
+  *
+  * This library is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU Lesser General Public
+  * License as published by the Free Software Foundation; either
+  * version 3 of the License, or (at your option) any later version.
+  *
+  * This library is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  * Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+  *
+  ******************************************************************************
+  */
+
+/**
+ * @file aes256_ni.cpp
+ * @date 17/10/2026
+ * @brief This file includes the implementation of AES with the x86 AES-NI and VAES instructions. See \ref aes256_ni.h .
+ *
+ * The round keys are the ones computed by B5_Aes256_Init() for the portable implementation: they are only
+ * converted to the byte order of the instructions, so the output is the same of the table based code.
+ * Modes without dependencies between blocks (CTR, ECB, CBC and CFB decryption) process 8 blocks at a time
+ * with AES-NI and 16 blocks at a time (two per register) with VAES; the other modes one block at a time.
+ */
+
+#include "aes256_ni.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define B5_AESNI_TARGET __attribute__((target("aes,ssse3")))
+#define B5_VAES_TARGET __attribute__((target("aes,ssse3,avx2,vaes")))
+#define B5_AESNI_LANES 8
+
+int32_t B5_Aes256Ni_MaxImpl (void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    int32_t impl = B5_AES256_IMPL_TABLES;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return impl;
+    if ((ecx & bit_AES) && (ecx & bit_SSSE3))
+        impl = B5_AES256_IMPL_AESNI;
+
+#ifndef _WIN32
+    /* VAES also needs the OS to save the AVX state; not used on Windows, where GCC (MinGW-w64) does not
+     * align the stack to 32 bytes (GCC bug 54412) and the __m256i locals and spills of B5_VaesUpdate() could fault */
+    if ((impl == B5_AES256_IMPL_AESNI) && (ecx & bit_OSXSAVE) && (ecx & bit_AVX) && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    {
+        unsigned int xcr0_lo, xcr0_hi;
+        __asm__ ("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        if (((xcr0_lo & 0x6) == 0x6) && (ebx & bit_AVX2) && (ecx & bit_VAES))
+            impl = B5_AES256_IMPL_VAES;
+    }
+#endif
+
+    return impl;
+}
+
+/* round keys of the context, in the byte order of AESENC/AESDEC */
+B5_AESNI_TARGET static inline void B5_AesNiLoadKeys (const B5_tAesCtx *ctx, __m128i *k)
+{
+    const __m128i bswap32 = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    for (int r = 0; r <= ctx->Nr; r++)
+        k[r] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(ctx->rk + 4 * r)), bswap32);
+}
+
+template <int N>
+B5_AESNI_TARGET static inline void B5_AesNiEncrypt (__m128i *b, const __m128i *k, int Nr)
+{
+    for (int i = 0; i < N; i++)
+        b[i] = _mm_xor_si128(b[i], k[0]);
+    for (int r = 1; r < Nr; r++)
+        for (int i = 0; i < N; i++)
+            b[i] = _mm_aesenc_si128(b[i], k[r]);
+    for (int i = 0; i < N; i++)
+        b[i] = _mm_aesenclast_si128(b[i], k[Nr]);
+}
+
+template <int N>
+B5_AESNI_TARGET static inline void B5_AesNiDecrypt (__m128i *b, const __m128i *k, int Nr)
+{
+    for (int i = 0; i < N; i++)
+        b[i] = _mm_xor_si128(b[i], k[0]);
+    for (int r = 1; r < Nr; r++)
+        for (int i = 0; i < N; i++)
+            b[i] = _mm_aesdec_si128(b[i], k[r]);
+    for (int i = 0; i < N; i++)
+        b[i] = _mm_aesdeclast_si128(b[i], k[Nr]);
+}
+
+template <int N>
+B5_VAES_TARGET static inline void B5_VaesEncrypt (__m256i *b, const __m256i *k, int Nr)
+{
+    for (int i = 0; i < N; i++)
+        b[i] = _mm256_xor_si256(b[i], k[0]);
+    for (int r = 1; r < Nr; r++)
+        for (int i = 0; i < N; i++)
+            b[i] = _mm256_aesenc_epi128(b[i], k[r]);
+    for (int i = 0; i < N; i++)
+        b[i] = _mm256_aesenclast_epi128(b[i], k[Nr]);
+}
+
+template <int N>
+B5_VAES_TARGET static inline void B5_VaesDecrypt (__m256i *b, const __m256i *k, int Nr)
+{
+    for (int i = 0; i < N; i++)
+        b[i] = _mm256_xor_si256(b[i], k[0]);
+    for (int r = 1; r < Nr; r++)
+        for (int i = 0; i < N; i++)
+            b[i] = _mm256_aesdec_epi128(b[i], k[r]);
+    for (int i = 0; i < N; i++)
+        b[i] = _mm256_aesdeclast_epi128(b[i], k[Nr]);
+}
+
+/* CTR counter: the IV is a 128 bit big endian integer, kept as two host integers */
+typedef struct {
+    uint64_t hi;
+    uint64_t lo;
+} B5_tAesNiCounter;
+
+static inline void B5_AesNiCounterLoad (B5_tAesNiCounter *c, const uint8_t *iv)
+{
+    c->hi = 0;
+    c->lo = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        c->hi = (c->hi << 8) | iv[i];
+        c->lo = (c->lo << 8) | iv[8 + i];
+    }
+}
+
+static inline void B5_AesNiCounterStore (const B5_tAesNiCounter *c, uint8_t *iv)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        iv[7 - i] = (uint8_t)(c->hi >> (8 * i));
+        iv[15 - i] = (uint8_t)(c->lo >> (8 * i));
+    }
+}
+
+/* current value of the counter as a block, then the counter is incremented */
+B5_AESNI_TARGET static inline __m128i B5_AesNiCounterNext (B5_tAesNiCounter *c)
+{
+    __m128i b = _mm_set_epi64x((long long)__builtin_bswap64(c->lo), (long long)__builtin_bswap64(c->hi));
+    if (++c->lo == 0)
+        c->hi++;
+    return b;
+}
+
+/* next N counter blocks: unless the low word wraps, the counter is kept as a little endian 128 bit register,
+ * incremented with a vector addition and byte reversed, otherwise the carry is propagated one block at a time */
+template <int N>
+B5_AESNI_TARGET static inline void B5_AesNiCounterBlocks (B5_tAesNiCounter *c, __m128i *b)
+{
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    if (c->lo > UINT64_MAX - N)
+    {
+        for (int j = 0; j < N; j++)
+            b[j] = B5_AesNiCounterNext(c);
+        return;
+    }
+    __m128i v = _mm_set_epi64x((long long)c->hi, (long long)c->lo);
+    for (int j = 0; j < N; j++)
+        b[j] = _mm_shuffle_epi8(_mm_add_epi64(v, _mm_set_epi64x(0, j)), bswap);
+    c->lo += N;
+}
+
+/* same as B5_AesNiCounterBlocks(), two counter blocks per register */
+template <int N>
+B5_VAES_TARGET static inline void B5_VaesCounterBlocks (B5_tAesNiCounter *c, __m256i *b)
+{
+    const __m256i bswap = _mm256_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                          0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    if (c->lo > UINT64_MAX - 2 * N)
+    {
+        for (int j = 0; j < N; j++)
+        {
+            __m128i lo = B5_AesNiCounterNext(c);
+            b[j] = _mm256_set_m128i(B5_AesNiCounterNext(c), lo);
+        }
+        return;
+    }
+    __m256i v = _mm256_set_epi64x((long long)c->hi, (long long)c->lo, (long long)c->hi, (long long)c->lo);
+    for (int j = 0; j < N; j++)
+        b[j] = _mm256_shuffle_epi8(_mm256_add_epi64(v, _mm256_set_epi64x(0, 2 * j + 1, 0, 2 * j)), bswap);
+    c->lo += 2 * N;
+}
+
+/* blocks processed one at a time (serial modes and the tail of the parallel ones), nBlk blocks from index i */
+B5_AESNI_TARGET static void B5_AesNiUpdate (B5_tAesCtx *ctx, const __m128i *k, uint8_t *encData, uint8_t *clrData, int32_t i, int32_t nBlk)
+{
+    int Nr = ctx->Nr;
+    __m128i iv = _mm_loadu_si128((const __m128i*)ctx->InitVector);
+    B5_tAesNiCounter ctr;
+    __m128i b[B5_AESNI_LANES], c[B5_AESNI_LANES];
+
+    switch (ctx->mode) {
+        case B5_AES256_CTR:
+        {
+            B5_AesNiCounterLoad(&ctr, ctx->InitVector);
+            for (; i + B5_AESNI_LANES <= nBlk; i += B5_AESNI_LANES)
+            {
+                B5_AesNiCounterBlocks<B5_AESNI_LANES>(&ctr, b);
+                B5_AesNiEncrypt<B5_AESNI_LANES>(b, k, Nr);
+                for (int j = 0; j < B5_AESNI_LANES; j++)
+                    _mm_storeu_si128((__m128i*)(encData + 16 * (i + j)), _mm_xor_si128(b[j], _mm_loadu_si128((const __m128i*)(clrData + 16 * (i + j)))));
+            }
+            for (; i < nBlk; i++)
+            {
+                b[0] = B5_AesNiCounterNext(&ctr);
+                B5_AesNiEncrypt<1>(b, k, Nr);
+                _mm_storeu_si128((__m128i*)(encData + 16 * i), _mm_xor_si128(b[0], _mm_loadu_si128((const __m128i*)(clrData + 16 * i))));
+            }
+            B5_AesNiCounterStore(&ctr, ctx->InitVector);
+            return;
+        }
+
+        case B5_AES256_OFB:
+        {
+            for (; i < nBlk; i++)
+            {
+                B5_AesNiEncrypt<1>(&iv, k, Nr);
+                _mm_storeu_si128((__m128i*)(encData + 16 * i), _mm_xor_si128(iv, _mm_loadu_si128((const __m128i*)(clrData + 16 * i))));
+            }
+            break;
+        }
+
+        case B5_AES256_ECB_ENC:
+        {
+            for (; i + B5_AESNI_LANES <= nBlk; i += B5_AESNI_LANES)
+            {
+                for (int j = 0; j < B5_AESNI_LANES; j++)
+                    b[j] = _mm_loadu_si128((const __m128i*)(clrData + 16 * (i + j)));
+                B5_AesNiEncrypt<B5_AESNI_LANES>(b, k, Nr);
+                for (int j = 0; j < B5_AESNI_LANES; j++)
+                    _mm_storeu_si128((__m128i*)(encData + 16 * (i + j)), b[j]);
+            }
+            for (; i < nBlk; i++)
+            {
+                b[0] = _mm_loadu_si128((const __m128i*)(clrData + 16 * i));
+                B5_AesNiEncrypt<1>(b, k, Nr);
+                _mm_storeu_si128((__m128i*)(encData + 16 * i), b[0]);
+            }
+            return;
+        }
+
+        case B5_AES256_ECB_DEC:
+        {
+            for (; i + B5_AESNI_LANES <= nBlk; i += B5_AESNI_LANES)
+            {
+                for (int j = 0; j < B5_AESNI_LANES; j++)
+                    b[j] = _mm_loadu_si128((const __m128i*)(encData + 16 * (i + j)));
+                B5_AesNiDecrypt<B5_AESNI_LANES>(b, k, Nr);
+                for (int j = 0; j < B5_AESNI_LANES; j++)
+                    _mm_storeu_si128((__m128i*)(clrData + 16 * (i + j)), b[j]);
+            }
+            for (; i < nBlk; i++)
+            {
+                b[0] = _mm_loadu_si128((const __m128i*)(encData + 16 * i));
+                B5_AesNiDecrypt<1>(b, k, Nr);
+                _mm_storeu_si128((__m128i*)(clrData + 16 * i), b[0]);
+            }
+            return;
+        }
+
+        case B5_AES256_CBC_ENC:
+        {
+            for (; i < nBlk; i++)
+            {
+                iv = _mm_xor_si128(iv, _mm_loadu_si128((const __m128i*)(clrData + 16 * i)));
+                B5_AesNiEncrypt<1>(&iv, k, Nr);
+                _mm_storeu_si128((__m128i*)(encData + 16 * i), iv);
+            }
+            break;
+        }
+
+        case B5_AES256_CBC_DEC:
+        {
+            /* the ciphertext is loaded before the plaintext is stored, so encData and clrData may be the same buffer */
+            for (; i + B5_AESNI_LANES <= nBlk; i += B5_AESNI_LANES)
+            {
+                for (int j = 0; j < B5_AESNI_LANES; j++)
+                    b[j] = c[j] = _mm_loadu_si128((const __m128i*)(encData + 16 * (i + j)));
+                B5_AesNiDecrypt<B5_AESNI_LANES>(b, k, Nr);
+                _mm_storeu_si128((__m128i*)(clrData + 16 * i), _mm_xor_si128(b[0], iv));
+                for (int j = 1; j < B5_AESNI_LANES; j++)
+                    _mm_storeu_si128((__m128i*)(clrData + 16 * (i + j)), _mm_xor_si128(b[j], c[j - 1]));
+                iv = c[B5_AESNI_LANES - 1];
+            }
+            for (; i < nBlk; i++)
+            {
+                b[0] = c[0] = _mm_loadu_si128((const __m128i*)(encData + 16 * i));
+                B5_AesNiDecrypt<1>(b, k, Nr);
+                _mm_storeu_si128((__m128i*)(clrData + 16 * i), _mm_xor_si128(b[0], iv));
+                iv = c[0];
+            }
+            break;
+        }
+
+        case B5_AES256_CFB_ENC:
+        {
+            for (; i < nBlk; i++)
+            {
+                B5_AesNiEncrypt<1>(&iv, k, Nr);
+                iv = _mm_xor_si128(iv, _mm_loadu_si128((const __m128i*)(clrData + 16 * i)));
+                _mm_storeu_si128((__m128i*)(encData + 16 * i), iv);
+            }
+            break;
+        }
+
+        case B5_AES256_CFB_DEC:
+        {
+            for (; i + B5_AESNI_LANES <= nBlk; i += B5_AESNI_LANES)
+            {
+                b[0] = iv;
+                for (int j = 0; j < B5_AESNI_LANES; j++)
+                {
+                    c[j] = _mm_loadu_si128((const __m128i*)(encData + 16 * (i + j)));
+                    if (j + 1 < B5_AESNI_LANES)
+                        b[j + 1] = c[j];
+                }
+                B5_AesNiEncrypt<B5_AESNI_LANES>(b, k, Nr);
+                for (int j = 0; j < B5_AESNI_LANES; j++)
+                    _mm_storeu_si128((__m128i*)(clrData + 16 * (i + j)), _mm_xor_si128(b[j], c[j]));
+                iv = c[B5_AESNI_LANES - 1];
+            }
+            for (; i < nBlk; i++)
+            {
+                b[0] = iv;
+                c[0] = _mm_loadu_si128((const __m128i*)(encData + 16 * i));
+                B5_AesNiEncrypt<1>(b, k, Nr);
+                _mm_storeu_si128((__m128i*)(clrData + 16 * i), _mm_xor_si128(b[0], c[0]));
+                iv = c[0];
+            }
+            break;
+        }
+
+        default:
+            return;
+    }
+
+    _mm_storeu_si128((__m128i*)ctx->InitVector, iv);
+}
+
+/* two blocks per register: 16 blocks at a time in the parallel modes, returns the number of blocks processed */
+B5_VAES_TARGET static int32_t B5_VaesUpdate (B5_tAesCtx *ctx, const __m128i *k, uint8_t *encData, uint8_t *clrData, int32_t nBlk)
+{
+    enum { LANES = B5_AESNI_LANES, BLOCKS = 2 * B5_AESNI_LANES };
+    int Nr = ctx->Nr;
+    int32_t i = 0;
+    __m256i k2[15], b[LANES], c[LANES];
+    B5_tAesNiCounter ctr;
+
+    for (int r = 0; r <= Nr; r++)
+        k2[r] = _mm256_broadcastsi128_si256(k[r]);
+
+    switch (ctx->mode) {
+        case B5_AES256_CTR:
+        {
+            B5_AesNiCounterLoad(&ctr, ctx->InitVector);
+            for (; i + BLOCKS <= nBlk; i += BLOCKS)
+            {
+                B5_VaesCounterBlocks<LANES>(&ctr, b);
+                B5_VaesEncrypt<LANES>(b, k2, Nr);
+                for (int j = 0; j < LANES; j++)
+                    _mm256_storeu_si256((__m256i*)(encData + 32 * j + 16 * i), _mm256_xor_si256(b[j], _mm256_loadu_si256((const __m256i*)(clrData + 32 * j + 16 * i))));
+            }
+            B5_AesNiCounterStore(&ctr, ctx->InitVector);
+            break;
+        }
+
+        case B5_AES256_ECB_ENC:
+        {
+            for (; i + BLOCKS <= nBlk; i += BLOCKS)
+            {
+                for (int j = 0; j < LANES; j++)
+                    b[j] = _mm256_loadu_si256((const __m256i*)(clrData + 32 * j + 16 * i));
+                B5_VaesEncrypt<LANES>(b, k2, Nr);
+                for (int j = 0; j < LANES; j++)
+                    _mm256_storeu_si256((__m256i*)(encData + 32 * j + 16 * i), b[j]);
+            }
+            break;
+        }
+
+        case B5_AES256_ECB_DEC:
+        {
+            for (; i + BLOCKS <= nBlk; i += BLOCKS)
+            {
+                for (int j = 0; j < LANES; j++)
+                    b[j] = _mm256_loadu_si256((const __m256i*)(encData + 32 * j + 16 * i));
+                B5_VaesDecrypt<LANES>(b, k2, Nr);
+                for (int j = 0; j < LANES; j++)
+                    _mm256_storeu_si256((__m256i*)(clrData + 32 * j + 16 * i), b[j]);
+            }
+            break;
+        }
+
+        case B5_AES256_CBC_DEC:
+        case B5_AES256_CFB_DEC:
+        {
+            /* c[j] holds blocks 2j, 2j+1 of the ciphertext, p[j] the blocks before them (2j-1, 2j) */
+            __m256i p[LANES];
+            __m128i iv = _mm_loadu_si128((const __m128i*)ctx->InitVector);
+            for (; i + BLOCKS <= nBlk; i += BLOCKS)
+            {
+                const uint8_t *in = encData + 16 * i;
+                for (int j = 0; j < LANES; j++)
+                    c[j] = _mm256_loadu_si256((const __m256i*)(in + 32 * j));
+                p[0] = _mm256_set_m128i(_mm_loadu_si128((const __m128i*)in), iv);
+                for (int j = 1; j < LANES; j++)
+                    p[j] = _mm256_loadu_si256((const __m256i*)(in + 32 * j - 16));
+                iv = _mm_loadu_si128((const __m128i*)(in + 16 * (BLOCKS - 1)));
+                if (ctx->mode == B5_AES256_CBC_DEC)
+                {
+                    for (int j = 0; j < LANES; j++)
+                        b[j] = c[j];
+                    B5_VaesDecrypt<LANES>(b, k2, Nr);
+                    for (int j = 0; j < LANES; j++)
+                        _mm256_storeu_si256((__m256i*)(clrData + 32 * j + 16 * i), _mm256_xor_si256(b[j], p[j]));
+                }
+                else
+                {
+                    B5_VaesEncrypt<LANES>(p, k2, Nr);
+                    for (int j = 0; j < LANES; j++)
+                        _mm256_storeu_si256((__m256i*)(clrData + 32 * j + 16 * i), _mm256_xor_si256(p[j], c[j]));
+                }
+            }
+            _mm_storeu_si128((__m128i*)ctx->InitVector, iv);
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    _mm256_zeroupper();
+    return i;
+}
+
+int32_t B5_Aes256Ni_Update (B5_tAesCtx *ctx, uint8_t *encData, uint8_t *clrData, int16_t nBlk, int32_t impl)
+{
+    __m128i k[15];
+    int32_t done = 0;
+
+    if ((impl != B5_AES256_IMPL_AESNI) && (impl != B5_AES256_IMPL_VAES))
+        return B5_AES256_RES_INVALID_ARGUMENT;
+    if ((ctx->mode < B5_AES256_OFB) || (ctx->mode > B5_AES256_CTR))
+        return B5_AES256_RES_INVALID_MODE;
+
+    B5_AesNiLoadKeys(ctx, k);
+    if (impl == B5_AES256_IMPL_VAES)
+        done = B5_VaesUpdate(ctx, k, encData, clrData, nBlk);
+    B5_AesNiUpdate(ctx, k, encData, clrData, done, nBlk);
+    memset(k, 0, sizeof(k));
+
+    return B5_AES256_RES_OK;
+}
+
+#else
+
+int32_t B5_Aes256Ni_MaxImpl (void)
+{
+    return B5_AES256_IMPL_TABLES;
+}
+
+int32_t B5_Aes256Ni_Update (B5_tAesCtx *ctx, uint8_t *encData, uint8_t *clrData, int16_t nBlk, int32_t impl)
+{
+    return B5_AES256_RES_INVALID_ARGUMENT;
+}
+
+#endif
@@ -0,0 +1,58 @@
+/**
+  ******************************************************************************
+  * File Name          : aes256_ni.h
+  * Description        : AES-NI and VAES header file.
+  ******************************************************************************
+  *
+  * Copyright  2016-present Blu5 Group <https://www.blu5group.com>
+  *
+  * This library is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU Lesser General Public
+  * License as published by the Free Software Foundation; either
+  * version 3 of the License, or (at your option) any later version.
+  *
+  * This library is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  * Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+  *
+  ******************************************************************************
+  */
+
+/*! \file  aes256_ni.h
+ *  \brief This file includes the prototypes of the AES implementation based on the x86 AES-NI and VAES instructions.
+ *  \version SEcube Open Source SDK 1.5.1
+ *  \detail These functions are used by B5_Aes256_Update() according to B5_Aes256_GetImpl(), do not call them directly.
+ */
+
+#pragma once
+
+#include "aes256.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Best AES implementation supported by the CPU.
+ * @return See \ref aesImpl .
+ */
+int32_t    B5_Aes256Ni_MaxImpl (void);
+
+/**
+ * @brief Same as B5_Aes256_Update(), with the AES-NI or VAES instructions.
+ * @param ctx Pointer to the current AES context, initialized by B5_Aes256_Init().
+ * @param encData Encrypted data.
+ * @param clrData Clear data.
+ * @param nBlk Number of AES blocks to process.
+ * @param impl B5_AES256_IMPL_AESNI or B5_AES256_IMPL_VAES, supported by the CPU.
+ * @return See \ref aesReturn .
+ */
+int32_t    B5_Aes256Ni_Update (B5_tAesCtx *ctx, uint8_t *encData, uint8_t *clrData, int16_t nBlk, int32_t impl);
+
+#ifdef __cplusplus
+}
+#endif
@@ -24,6 +24,9 @@
 
 #include "pbkdf2.h"
 
+// Implementation selected by PBKDF2HmacSha256_SetImpl()
+static int32_t PBKDF2_Impl = PBKDF2_IMPL_LANES;
+
 /** out = x ^ y.
 *  out, x and y may alias. */
 static  void xor_bb(uint8_t *out, const uint8_t *x, const uint8_t *y, size_t len)
@@ -33,14 +36,14 @@ static  void xor_bb(uint8_t *out, const uint8_t *x, const uint8_t *y, size_t len
 		out[i] = x[i] ^ y[i];
 }
 
-static void F(const B5_tHmacSha256Ctx *startctx,
+static void F(const B5_tHmacSha256Key *key,
 	uint32_t counter,
 	const uint8_t *salt, size_t nsalt,
 	uint32_t iterations,
 	uint8_t *out)
 {
 	uint8_t U[B5_SHA256_DIGEST_SIZE];
-	B5_tHmacSha256Ctx ctx = *startctx;
+	B5_tHmacSha256Ctx ctx;
 	uint8_t countbuf[4];
 	uint32_t i;
 	countbuf[0] = ((counter >> 3 * 8) & 0xFF);
@@ -52,6 +55,7 @@ static void F(const B5_tHmacSha256Ctx *startctx,
 	*   U_1 = PRF(P, S || INT_32_BE(i))
 	*/
 
+	B5_HmacSha256_InitKey(&ctx, key);
 	B5_HmacSha256_Update(&ctx, salt, nsalt);
 	B5_HmacSha256_Update(&ctx, countbuf, sizeof(countbuf));
 	B5_HmacSha256_Finit(&ctx, U);
@@ -62,13 +66,155 @@ static void F(const B5_tHmacSha256Ctx *startctx,
 	*/
 	for (i = 1; i < iterations; i++)
 	{
-		ctx = *startctx;
+		B5_HmacSha256_InitKey(&ctx, key);
 		B5_HmacSha256_Update(&ctx, U, B5_SHA256_DIGEST_SIZE);
 		B5_HmacSha256_Finit(&ctx, U);
 		xor_bb(out, out, U, B5_SHA256_DIGEST_SIZE);
 	}
 }
 
+/** out = big endian SHA-256 state. */
+static void put_state(uint8_t *out, const uint32_t *state)
+{
+	int32_t i;
+	for (i = 0; i < 8; i++)
+	{
+		out[4 * i] = (uint8_t)(state[i] >> 24);
+		out[4 * i + 1] = (uint8_t)(state[i] >> 16);
+		out[4 * i + 2] = (uint8_t)(state[i] >> 8);
+		out[4 * i + 3] = (uint8_t)(state[i]);
+	}
+}
+
+/** Same as F() on n lanes, each one with its own salt and counter.
+*  After the first iteration U holds the digest followed by its SHA-256 padding, so each
+*  pass of the following HMACs is a single compression from the state after the pad. */
+static void F_lanes(const B5_tHmacSha256Key *key,
+	const uint32_t *counter,
+	const uint8_t **salt, size_t nsalt,
+	uint32_t iterations,
+	uint8_t **out, int32_t n)
+{
+	uint8_t U[B5_SHA256_LANES][B5_SHA256_BLOCK_SIZE];
+	uint8_t countbuf[B5_SHA256_LANES][4];
+	B5_tHmacSha256Ctx ctx[B5_SHA256_LANES];
+	B5_tHmacSha256Ctx *hmac[B5_SHA256_LANES];
+	B5_tSha256Ctx *sha[B5_SHA256_LANES];
+	const uint8_t *data[B5_SHA256_LANES];
+	uint8_t *digest[B5_SHA256_LANES];
+	uint32_t i;
+	int32_t j;
+
+	/* First iteration:
+	*   U_1 = PRF(P, S || INT_32_BE(i))
+	*/
+	for (j = 0; j < n; j++)
+	{
+		countbuf[j][0] = ((counter[j] >> 3 * 8) & 0xFF);
+		countbuf[j][1] = ((counter[j] >> 2 * 8) & 0xFF);
+		countbuf[j][2] = ((counter[j] >> 1 * 8) & 0xFF);
+		countbuf[j][3] = (counter[j] & 0xFF);
+		B5_HmacSha256_InitKey(&ctx[j], key);
+		hmac[j] = &ctx[j];
+		sha[j] = &ctx[j].shaCtx;
+		data[j] = countbuf[j];
+		digest[j] = U[j];
+	}
+	if (nsalt > 0)
+		B5_HmacSha256_UpdateMulti(hmac, salt, (int32_t)nsalt, n);
+	B5_HmacSha256_UpdateMulti(hmac, data, sizeof(countbuf[0]), n);
+	B5_HmacSha256_FinitMulti(hmac, digest, n);
+
+	for (j = 0; j < n; j++)
+	{
+		memcpy(out[j], U[j], B5_SHA256_DIGEST_SIZE);
+		if (iterations > 1)
+		{
+			/* padding of a digest hashed after a pad: 0x80, zeros, then 768 bits */
+			memset(U[j] + B5_SHA256_DIGEST_SIZE, 0, B5_SHA256_BLOCK_SIZE - B5_SHA256_DIGEST_SIZE);
+			U[j][B5_SHA256_DIGEST_SIZE] = 0x80;
+			U[j][B5_SHA256_BLOCK_SIZE - 2] = 0x03;
+			data[j] = U[j];
+		}
+	}
+
+	/* Subsequent iterations:
+	*   U_c = PRF(P, U_{c-1})
+	*  total is left growing by whole blocks, the lanes stay aligned for B5_Sha256_UpdateMulti().
+	*/
+	for (i = 1; i < iterations; i++)
+	{
+		for (j = 0; j < n; j++)
+			memcpy(sha[j]->state, key->iState, sizeof(key->iState));
+		B5_Sha256_UpdateMulti(sha, data, B5_SHA256_BLOCK_SIZE, n);
+		for (j = 0; j < n; j++)
+		{
+			put_state(U[j], sha[j]->state);
+			memcpy(sha[j]->state, key->oState, sizeof(key->oState));
+		}
+		B5_Sha256_UpdateMulti(sha, data, B5_SHA256_BLOCK_SIZE, n);
+		for (j = 0; j < n; j++)
+		{
+			put_state(U[j], sha[j]->state);
+			xor_bb(out[j], out[j], U[j], B5_SHA256_DIGEST_SIZE);
+		}
+	}
+
+	memset(U, 0, n * sizeof(U[0]));
+	memset(ctx, 0, n * sizeof(ctx[0]));
+}
+
+void PBKDF2HmacSha256Multi(	const B5_tHmacSha256Key *key,
+							const uint8_t *salt[],
+							size_t nsalt,
+							uint32_t iterations,
+							uint8_t *out[],
+							size_t nout,
+							int32_t n)
+{
+	uint8_t block[B5_SHA256_LANES][B5_SHA256_DIGEST_SIZE];
+	uint8_t *blocks[B5_SHA256_LANES];
+	const uint8_t *s[B5_SHA256_LANES];
+	uint32_t counter[B5_SHA256_LANES];
+	size_t perOut = (nout + B5_SHA256_DIGEST_SIZE - 1) / B5_SHA256_DIGEST_SIZE;
+	size_t total = (n > 0) ? (perOut * (size_t)n) : 0;
+	size_t first, k, offset, taken;
+	int32_t j, lanes;
+
+	for (j = 0; j < B5_SHA256_LANES; j++)
+		blocks[j] = block[j];
+
+	/* The output blocks of all the derivations are independent: they are computed B5_SHA256_LANES at a time */
+	for (first = 0; first < total; first += lanes)
+	{
+		lanes = ((total - first) < B5_SHA256_LANES) ? (int32_t)(total - first) : B5_SHA256_LANES;
+		if (PBKDF2_Impl == PBKDF2_IMPL_SERIAL)
+			lanes = 1;
+
+		for (j = 0; j < lanes; j++)
+		{
+			k = first + j;
+			s[j] = salt[k / perOut];
+			counter[j] = (uint32_t)(k % perOut) + 1;
+		}
+
+		if (PBKDF2_Impl == PBKDF2_IMPL_SERIAL)
+			F(key, counter[0], s[0], nsalt, iterations, block[0]);
+		else
+			F_lanes(key, counter, s, nsalt, iterations, blocks, lanes);
+
+		for (j = 0; j < lanes; j++)
+		{
+			k = first + j;
+			offset = (k % perOut) * B5_SHA256_DIGEST_SIZE;
+			taken = ((nout - offset) < B5_SHA256_DIGEST_SIZE)?(nout - offset):(B5_SHA256_DIGEST_SIZE);
+			memcpy(out[k / perOut] + offset, block[j], taken);
+		}
+	}
+
+	memset(block, 0, sizeof(block));
+}
+
 void PBKDF2HmacSha256(	const uint8_t *pw,
 									size_t npw,
 									const uint8_t *salt,
@@ -77,21 +223,26 @@ void PBKDF2HmacSha256(	const uint8_t *pw,
 									uint8_t *out,
 									size_t nout)
 {
-	uint32_t counter = 1;
-	uint8_t block[B5_SHA256_DIGEST_SIZE];
-	size_t taken;
+	/* Starting point for inner loop: the pads of the password are hashed only once. */
+	B5_tHmacSha256Key key;
+	B5_HmacSha256_KeyInit(&key, pw, (int16_t)npw);
 
-	/* Starting point for inner loop. */
-	B5_tHmacSha256Ctx ctx;
-	B5_HmacSha256_Init(&ctx, pw, (int16_t)npw);
+	PBKDF2HmacSha256Multi(&key, &salt, nsalt, iterations, &out, nout, 1);
 
-	while(nout)
-	{
-		F(&ctx, counter, salt, nsalt, iterations, block);
-		taken = (nout < B5_SHA256_DIGEST_SIZE)?(nout):(B5_SHA256_DIGEST_SIZE);
-		memcpy(out, block, taken);
-		out += taken;
-		nout -= taken;
-		counter++;
-	}
+	memset(&key, 0, sizeof(key));
+}
+
+int32_t PBKDF2HmacSha256_GetImpl(void)
+{
+	return PBKDF2_Impl;
+}
+
+int32_t PBKDF2HmacSha256_SetImpl(int32_t impl)
+{
+	if ((impl != PBKDF2_IMPL_SERIAL) && (impl != PBKDF2_IMPL_LANES))
+		return B5_SHA256_RES_INVALID_ARGUMENT;
+
+	PBKDF2_Impl = impl;
+
+	return B5_SHA256_RES_OK;
 }
@@ -37,6 +37,16 @@ extern "C" {
 #include <stddef.h>
 #include "sha256.h"
 
+/** \defgroup pbkdf2Impl PBKDF2 implementations
+ * @{
+ */
+/** \name PBKDF2 implementations */
+///@{
+#define PBKDF2_IMPL_SERIAL          0       /**< One output block after the other, a full HMAC-SHA256 for each iteration */
+#define PBKDF2_IMPL_LANES           1       /**< Up to B5_SHA256_LANES independent output blocks at once through B5_HmacSha256_UpdateMulti(), each iteration hashes one pre-padded block after each pad */
+///@}
+/** @} */
+
 void PBKDF2HmacSha256(	const uint8_t *pw,
 						size_t npw,
 						const uint8_t *salt,
@@ -45,6 +55,37 @@ void PBKDF2HmacSha256(	const uint8_t *pw,
 						uint8_t *out,
 						size_t nout);
 
+/**
+ * @brief Same as PBKDF2HmacSha256() for n derivations with the same password, each one with its own salt and output.
+ * @param key Password, with the pads already hashed by B5_HmacSha256_KeyInit().
+ * @param salt Salts of each derivation, nsalt bytes each.
+ * @param nsalt Salt size.
+ * @param iterations Number of iterations, the same for all the derivations.
+ * @param out Outputs of each derivation, nout bytes each.
+ * @param nout Output size.
+ * @param n Number of derivations: their output blocks are computed together, up to B5_SHA256_LANES at a time.
+ */
+void PBKDF2HmacSha256Multi(	const B5_tHmacSha256Key *key,
+							const uint8_t *salt[],
+							size_t nsalt,
+							uint32_t iterations,
+							uint8_t *out[],
+							size_t nout,
+							int32_t n);
+
+/**
+ * @brief Get the implementation used by PBKDF2HmacSha256() and PBKDF2HmacSha256Multi().
+ * @return See \ref pbkdf2Impl . By default PBKDF2_IMPL_LANES.
+ */
+int32_t PBKDF2HmacSha256_GetImpl(void);
+
+/**
+ * @brief Select the implementation used by PBKDF2HmacSha256() and PBKDF2HmacSha256Multi() (i.e. to compare them). Not thread safe.
+ * @param impl See \ref pbkdf2Impl .
+ * @return See \ref shaReturn .
+ */
+int32_t PBKDF2HmacSha256_SetImpl(int32_t impl);
+
 #ifdef __cplusplus
 }
 #endif
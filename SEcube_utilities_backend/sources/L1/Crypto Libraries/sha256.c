@@ -31,9 +31,10 @@
 
 
 #include "sha256.h"
+#include "sha256_ni.h"
 
 
-void B5_SHA256_GETUINT32(uint32_t *n,const uint8_t *b, int32_t i)
+static inline void B5_SHA256_GETUINT32(uint32_t *n,const uint8_t *b, int32_t i)
 {
     *n =      ( (uint32_t) b[i    ] << 24 )
             | ( (uint32_t) b[i + 1] << 16 )
@@ -41,7 +42,7 @@ void B5_SHA256_GETUINT32(uint32_t *n,const uint8_t *b, int32_t i)
             | ( (uint32_t) b[i + 3]       );
 }
 
-void B5_SHA256_PUTUINT32(uint32_t n,uint8_t *b, int32_t i)
+static inline void B5_SHA256_PUTUINT32(uint32_t n,uint8_t *b, int32_t i)
 {
     b[i    ] = (uint8_t) ( n >> 24 );
     b[i + 1] = (uint8_t) ( n >> 16 );
@@ -73,7 +74,7 @@ void B5_SHA256_R(uint32_t t, B5_tSha256Ctx* ctx) {
     ctx->W[t] = B5_SHA256_S1(ctx->W[t -  2]) + ctx->W[t -  7] + B5_SHA256_S0(ctx->W[t - 15]) + ctx->W[t - 16];
 }*/
 
-void B5_SHA256_P(uint32_t a,uint32_t b,uint32_t c,uint32_t *d,uint32_t e,uint32_t f,uint32_t g,uint32_t *h,uint32_t x,uint32_t K)
+static inline void B5_SHA256_P(uint32_t a,uint32_t b,uint32_t c,uint32_t *d,uint32_t e,uint32_t f,uint32_t g,uint32_t *h,uint32_t x,uint32_t K)
 {
 uint32_t temp1, temp2;
     temp1 = *h + B5_SHA256_S3(e) + B5_SHA256_F1(e,f,g) + K + x;
@@ -200,6 +201,29 @@ static void B5_Sha256ProcessBlock(B5_tSha256Ctx *ctx, const uint8_t *data)
     ctx->state[7] += H;
 }
 
+static void B5_Sha256ProcessBlocks(B5_tSha256Ctx *ctx, const uint8_t *data, int32_t nBlk)
+{
+    if(B5_Sha256_GetImpl() == B5_SHA256_IMPL_SHANI)
+    {
+        B5_Sha256Ni_ProcessBlocks(ctx->state, data, nBlk);
+        return;
+    }
+
+    for( ; nBlk > 0; nBlk--, data += 64 )
+        B5_Sha256ProcessBlock( ctx, data );
+}
+
+static void B5_Sha256ProcessBlocksMulti(B5_tSha256Ctx *ctx[], const uint8_t *data[], int32_t nBlk, int32_t n)
+{
+    uint32_t   *state[B5_SHA256_LANES];
+    int32_t    j;
+
+    for( j = 0; j < n; j++ )
+        state[j] = ctx[j]->state;
+
+    B5_Sha256Avx2_ProcessBlocks( state, data, nBlk, n );
+}
+
 
 
 
@@ -259,17 +283,17 @@ int32_t B5_Sha256_Update (B5_tSha256Ctx *ctx, const uint8_t* data, int32_t dataL
     {
         memcpy( (void *) (ctx->buffer + left),
                 (void *) data, fill );
-        B5_Sha256ProcessBlock( ctx, ctx->buffer );
+        B5_Sha256ProcessBlocks( ctx, ctx->buffer, 1 );
         dataLen -= fill;
         data  += fill;
         left = 0;
     }
 
-    while( dataLen >= 64 )
+    if( dataLen >= 64 )
     {
-        B5_Sha256ProcessBlock( ctx, data );
-        dataLen -= 64;
-        data  += 64;
+        B5_Sha256ProcessBlocks( ctx, data, dataLen / 64 );
+        data  += dataLen & ~0x3F;
+        dataLen &= 0x3F;
     }
 
     if( dataLen )
@@ -340,51 +364,220 @@ int32_t B5_Sha256_Finit (B5_tSha256Ctx *ctx, uint8_t* rDigest)
 
 
 
-int32_t B5_HmacSha256_Init (B5_tHmacSha256Ctx *ctx, const uint8_t *Key, int16_t keySize)
+int32_t B5_Sha256_UpdateMulti (B5_tSha256Ctx *ctx[], const uint8_t *data[], int32_t dataLen, int32_t n)
+{
+    const uint8_t  *blk[B5_SHA256_LANES];
+    uint32_t       left, fill, off;
+    int32_t        j;
+
+    if((ctx == NULL) || (n < 1) || (n > B5_SHA256_LANES))
+        return  B5_SHA256_RES_INVALID_CONTEXT;
+
+    if((data == NULL) || (dataLen < 0))
+        return B5_SHA256_RES_INVALID_ARGUMENT;
+
+    for( j = 0; j < n; j++ )
+    {
+        if(ctx[j] == NULL)
+            return  B5_SHA256_RES_INVALID_CONTEXT;
+        if(data[j] == NULL)
+            return B5_SHA256_RES_INVALID_ARGUMENT;
+    }
+
+
+    // The lanes must be at the same offset in their block, and AVX2 pays off only with more than one message
+    left = ctx[0]->total[0] & 0x3F;
+    for( j = 1; (j < n) && ((ctx[j]->total[0] & 0x3F) == left); j++ );
+
+    if((B5_Sha256_GetImpl() != B5_SHA256_IMPL_AVX2) || (n == 1) || (j < n))
+    {
+        for( j = 0; j < n; j++ )
+            B5_Sha256_Update( ctx[j], data[j], dataLen );
+        return B5_SHA256_RES_OK;
+    }
+
+    fill = 64 - left;
+    off = 0;
+
+    for( j = 0; j < n; j++ )
+    {
+        ctx[j]->total[0] += dataLen;
+        if( ctx[j]->total[0] < (uint32_t) dataLen )
+            ctx[j]->total[1]++;
+    }
+
+    if( left && ((uint32_t) dataLen >= fill) )
+    {
+        for( j = 0; j < n; j++ )
+        {
+            memcpy( (void *) (ctx[j]->buffer + left), (void *) data[j], fill );
+            blk[j] = ctx[j]->buffer;
+        }
+        B5_Sha256ProcessBlocksMulti( ctx, blk, 1, n );
+        dataLen -= fill;
+        off = fill;
+        left = 0;
+    }
+
+    if( dataLen >= 64 )
+    {
+        for( j = 0; j < n; j++ )
+            blk[j] = data[j] + off;
+        B5_Sha256ProcessBlocksMulti( ctx, blk, dataLen / 64, n );
+        off += dataLen & ~0x3F;
+        dataLen &= 0x3F;
+    }
+
+    if( dataLen )
+    {
+        for( j = 0; j < n; j++ )
+            memcpy( (void *) (ctx[j]->buffer + left), (void *) (data[j] + off), dataLen );
+    }
+
+
+    return B5_SHA256_RES_OK;
+}
+
+
+
+
+
+int32_t B5_Sha256_FinitMulti (B5_tSha256Ctx *ctx[], uint8_t *rDigest[], int32_t n)
+{
+    uint8_t        sha2_padding[B5_SHA256_LANES][72];
+    const uint8_t  *pad[B5_SHA256_LANES];
+    uint32_t       last, padn;
+    uint32_t       high, low;
+    int32_t        i, j;
+
+
+    if((ctx == NULL) || (n < 1) || (n > B5_SHA256_LANES))
+        return B5_SHA256_RES_INVALID_CONTEXT;
+
+    if(rDigest == NULL)
+        return B5_SHA256_RES_INVALID_ARGUMENT;
+
+    for( j = 0; j < n; j++ )
+    {
+        if(ctx[j] == NULL)
+            return  B5_SHA256_RES_INVALID_CONTEXT;
+        if(rDigest[j] == NULL)
+            return B5_SHA256_RES_INVALID_ARGUMENT;
+    }
+
+
+    // The padding has the same length in all the lanes only if they are at the same offset in their block,
+    // and it is worth building it for all of them only with AVX2
+    last = ctx[0]->total[0] & 0x3F;
+    for( j = 1; (j < n) && ((ctx[j]->total[0] & 0x3F) == last); j++ );
+
+    if((B5_Sha256_GetImpl() != B5_SHA256_IMPL_AVX2) || (n == 1) || (j < n))
+    {
+        for( j = 0; j < n; j++ )
+            B5_Sha256_Finit( ctx[j], rDigest[j] );
+        return B5_SHA256_RES_OK;
+    }
+
+    padn = ( last < 56 ) ? ( 56 - last ) : ( 120 - last );
+
+    for( j = 0; j < n; j++ )
+    {
+        high = ( ctx[j]->total[0] >> 29 )
+             | ( ctx[j]->total[1] <<  3 );
+        low  = ( ctx[j]->total[0] <<  3 );
+
+        memset( sha2_padding[j], 0x00, padn );
+        sha2_padding[j][0] = 0x80;
+        B5_SHA256_PUTUINT32( high, sha2_padding[j], padn );
+        B5_SHA256_PUTUINT32( low,  sha2_padding[j], padn + 4 );
+        pad[j] = sha2_padding[j];
+    }
+
+    B5_Sha256_UpdateMulti( ctx, pad, padn + 8, n );
+
+
+    for( j = 0; j < n; j++ )
+        for( i = 0; i < 8; i++ )
+            B5_SHA256_PUTUINT32( ctx[j]->state[i], rDigest[j], 4 * i );
+
+
+
+    return B5_SHA256_RES_OK;
+}
+
+
+
+
+
+
+
+// Start a pass of HMAC from the state after the (inner or outer) pad, i.e. one block already hashed
+static void B5_HmacSha256StartPass(B5_tSha256Ctx *shaCtx, const uint32_t *state)
+{
+    shaCtx->total[0] = B5_SHA256_BLOCK_SIZE;
+    shaCtx->total[1] = 0;
+    memcpy(shaCtx->state, state, sizeof(shaCtx->state));
+}
+
+
+
+
+
+int32_t B5_HmacSha256_KeyInit (B5_tHmacSha256Key *key, const uint8_t *Key, int16_t keySize)
 {
     int32_t   i;
     uint8_t    digest[B5_SHA256_DIGEST_SIZE];
+    uint8_t    iPad[B5_SHA256_BLOCK_SIZE];
+    uint8_t    oPad[B5_SHA256_BLOCK_SIZE];
+    B5_tSha256Ctx shaCtx;
 
 
     if(Key == NULL)
         return B5_HMAC_SHA256_RES_INVALID_ARGUMENT;
 
-    if(ctx == NULL)
+    if(key == NULL)
         return  B5_HMAC_SHA256_RES_INVALID_CONTEXT;
 
-    memset(ctx, 0, sizeof(B5_tHmacSha256Ctx));
-
     //The key is longer than the block size?
     if(keySize > B5_SHA256_BLOCK_SIZE)
     {
         // Initialize the hash function context
-        B5_Sha256_Init(&ctx->shaCtx);
+        B5_Sha256_Init(&shaCtx);
         // Digest the original key
-        B5_Sha256_Update(&ctx->shaCtx, Key, keySize);
+        B5_Sha256_Update(&shaCtx, Key, keySize);
         // Finalize the message digest computation
-        B5_Sha256_Finit(&ctx->shaCtx, digest);
+        B5_Sha256_Finit(&shaCtx, digest);
 
         Key = digest;
         keySize = B5_SHA256_DIGEST_SIZE;
     }
 
 
-    memset( ctx->iPad, B5_HMAC_IPAD, 64 );
-    memset( ctx->oPad, B5_HMAC_OPAD, 64 );
+    memset( iPad, B5_HMAC_IPAD, 64 );
+    memset( oPad, B5_HMAC_OPAD, 64 );
 
 
     for( i = 0; i < keySize; i++ )
     {
-        ctx->iPad[i] = (unsigned char)( ctx->iPad[i] ^ Key[i] );
-        ctx->oPad[i] = (unsigned char)( ctx->oPad[i] ^ Key[i] );
+        iPad[i] = (unsigned char)( iPad[i] ^ Key[i] );
+        oPad[i] = (unsigned char)( oPad[i] ^ Key[i] );
     }
 
 
-    // Initialize context for the first pass
-		B5_Sha256_Init(&ctx->shaCtx);
+    // State after the inner pad (first pass)
+    B5_Sha256_Init(&shaCtx);
+    B5_Sha256_Update(&shaCtx, iPad, B5_SHA256_BLOCK_SIZE);
+    memcpy(key->iState, shaCtx.state, sizeof(key->iState));
 
-    // Start with the inner pad
-    B5_Sha256_Update(&ctx->shaCtx, ctx->iPad, B5_SHA256_BLOCK_SIZE);
+    // State after the outer pad (second pass)
+    B5_Sha256_Init(&shaCtx);
+    B5_Sha256_Update(&shaCtx, oPad, B5_SHA256_BLOCK_SIZE);
+    memcpy(key->oState, shaCtx.state, sizeof(key->oState));
+
+    memset(iPad, 0, sizeof(iPad));
+    memset(oPad, 0, sizeof(oPad));
+    memset(digest, 0, sizeof(digest));
+    memset(&shaCtx, 0, sizeof(shaCtx));
 
     return B5_HMAC_SHA256_RES_OK;
 }
@@ -393,6 +586,51 @@ int32_t B5_HmacSha256_Init (B5_tHmacSha256Ctx *ctx, const uint8_t *Key, int16_t
 
 
 
+int32_t B5_HmacSha256_InitKey (B5_tHmacSha256Ctx *ctx, const B5_tHmacSha256Key *key)
+{
+    if(key == NULL)
+        return B5_HMAC_SHA256_RES_INVALID_ARGUMENT;
+
+    if(ctx == NULL)
+        return  B5_HMAC_SHA256_RES_INVALID_CONTEXT;
+
+    // Start from the inner pad, only the fields read by B5_Sha256_Update() are set
+    B5_HmacSha256StartPass(&ctx->shaCtx, key->iState);
+    memcpy(ctx->oState, key->oState, sizeof(ctx->oState));
+
+    return B5_HMAC_SHA256_RES_OK;
+}
+
+
+
+
+
+int32_t B5_HmacSha256_Init (B5_tHmacSha256Ctx *ctx, const uint8_t *Key, int16_t keySize)
+{
+    B5_tHmacSha256Key key;
+    int32_t   ret;
+
+
+    if(Key == NULL)
+        return B5_HMAC_SHA256_RES_INVALID_ARGUMENT;
+
+    if(ctx == NULL)
+        return  B5_HMAC_SHA256_RES_INVALID_CONTEXT;
+
+    memset(ctx, 0, sizeof(B5_tHmacSha256Ctx));
+
+    ret = B5_HmacSha256_KeyInit(&key, Key, keySize);
+    if(ret == B5_HMAC_SHA256_RES_OK)
+        ret = B5_HmacSha256_InitKey(ctx, &key);
+    memset(&key, 0, sizeof(key));
+
+    return ret;
+}
+
+
+
+
+
 int32_t B5_HmacSha256_Update (B5_tHmacSha256Ctx *ctx, const uint8_t *data, int32_t dataLen)
 {
     if(ctx == NULL)
@@ -431,10 +669,8 @@ int32_t B5_HmacSha256_Finit (B5_tHmacSha256Ctx *ctx, uint8_t *rDigest)
     // Finish the first pass
 		B5_Sha256_Finit(&ctx->shaCtx, digest);
 
-    // Initialize context for the second pass
-		B5_Sha256_Init(&ctx->shaCtx);
-    // Start with outer pad
-    B5_Sha256_Update(&ctx->shaCtx, ctx->oPad, B5_SHA256_BLOCK_SIZE);
+    // Initialize context for the second pass, after the outer pad
+    B5_HmacSha256StartPass(&ctx->shaCtx, ctx->oState);
     // Then digest the result of the first hash
     B5_Sha256_Update(&ctx->shaCtx, digest, B5_SHA256_DIGEST_SIZE);
     // Finish the second pass
@@ -446,3 +682,114 @@ int32_t B5_HmacSha256_Finit (B5_tHmacSha256Ctx *ctx, uint8_t *rDigest)
 }
 
 
+
+
+
+int32_t B5_HmacSha256_UpdateMulti (B5_tHmacSha256Ctx *ctx[], const uint8_t *data[], int32_t dataLen, int32_t n)
+{
+    B5_tSha256Ctx  *shaCtx[B5_SHA256_LANES];
+    int32_t        j;
+
+    if((ctx == NULL) || (n < 1) || (n > B5_SHA256_LANES))
+        return  B5_HMAC_SHA256_RES_INVALID_CONTEXT;
+
+    for( j = 0; j < n; j++ )
+    {
+        if(ctx[j] == NULL)
+            return  B5_HMAC_SHA256_RES_INVALID_CONTEXT;
+        shaCtx[j] = &ctx[j]->shaCtx;
+    }
+
+
+    // Digest the messages (first pass)
+    if(B5_Sha256_UpdateMulti(shaCtx, data, dataLen, n) != B5_SHA256_RES_OK)
+        return B5_HMAC_SHA256_RES_INVALID_ARGUMENT;
+
+    return B5_HMAC_SHA256_RES_OK;
+}
+
+
+
+
+
+int32_t B5_HmacSha256_FinitMulti (B5_tHmacSha256Ctx *ctx[], uint8_t *rDigest[], int32_t n)
+{
+    uint8_t        digest[B5_SHA256_LANES][B5_SHA256_DIGEST_SIZE];
+    uint8_t        *inner[B5_SHA256_LANES];
+    const uint8_t  *innerIn[B5_SHA256_LANES];
+    B5_tSha256Ctx  *shaCtx[B5_SHA256_LANES];
+    int32_t        j;
+
+    if((ctx == NULL) || (n < 1) || (n > B5_SHA256_LANES))
+        return  B5_HMAC_SHA256_RES_INVALID_CONTEXT;
+
+    if(rDigest == NULL)
+        return B5_HMAC_SHA256_RES_INVALID_ARGUMENT;
+
+    for( j = 0; j < n; j++ )
+    {
+        if(ctx[j] == NULL)
+            return  B5_HMAC_SHA256_RES_INVALID_CONTEXT;
+        if(rDigest[j] == NULL)
+            return B5_HMAC_SHA256_RES_INVALID_ARGUMENT;
+        shaCtx[j] = &ctx[j]->shaCtx;
+        inner[j] = digest[j];
+        innerIn[j] = digest[j];
+    }
+
+    // Without AVX2 the lanes are finished one after the other
+    if((B5_Sha256_GetImpl() != B5_SHA256_IMPL_AVX2) || (n == 1))
+    {
+        for( j = 0; j < n; j++ )
+            B5_HmacSha256_Finit( ctx[j], rDigest[j] );
+        return B5_HMAC_SHA256_RES_OK;
+    }
+
+
+    // Finish the first pass
+    B5_Sha256_FinitMulti(shaCtx, inner, n);
+
+    // Second pass: after the outer pad, digest the result of the first hash
+    for( j = 0; j < n; j++ )
+        B5_HmacSha256StartPass(shaCtx[j], ctx[j]->oState);
+    B5_Sha256_UpdateMulti(shaCtx, innerIn, B5_SHA256_DIGEST_SIZE, n);
+    B5_Sha256_FinitMulti(shaCtx, rDigest, n);
+
+
+
+    return B5_HMAC_SHA256_RES_OK;
+}
+
+
+
+
+
+// Implementation selected by B5_Sha256_SetImpl(), or -1 until the CPU is checked
+static int32_t B5_Sha256_Impl = -1;
+
+int32_t B5_Sha256_GetImpl (void)
+{
+    if(B5_Sha256_Impl < 0)
+    {
+        if(B5_Sha256Ni_Supported(B5_SHA256_IMPL_SHANI))
+            B5_Sha256_Impl = B5_SHA256_IMPL_SHANI;
+        else if(B5_Sha256Ni_Supported(B5_SHA256_IMPL_AVX2))
+            B5_Sha256_Impl = B5_SHA256_IMPL_AVX2;
+        else
+            B5_Sha256_Impl = B5_SHA256_IMPL_SCALAR;
+    }
+
+    return B5_Sha256_Impl;
+}
+
+int32_t B5_Sha256_SetImpl (int32_t impl)
+{
+    if(!B5_Sha256Ni_Supported(impl))
+        return B5_SHA256_RES_INVALID_ARGUMENT;
+
+    B5_Sha256_Impl = impl;
+
+    return B5_SHA256_RES_OK;
+}
+
+
@@ -52,6 +52,18 @@
 ///@{
 #define B5_SHA256_DIGEST_SIZE       32
 #define B5_SHA256_BLOCK_SIZE 		64
+#define B5_SHA256_LANES             8       /**< Maximum number of messages hashed at once by B5_Sha256_UpdateMulti() */
+///@}
+/** @} */
+
+/** \defgroup shaImpl SHA256 implementations
+ * @{
+ */
+/** \name SHA256 implementations */
+///@{
+#define B5_SHA256_IMPL_SCALAR       0       /**< Portable implementation */
+#define B5_SHA256_IMPL_AVX2         1       /**< Portable implementation, x86 AVX2 instructions for up to 8 messages at a time in the multi-buffer functions (not on Windows) */
+#define B5_SHA256_IMPL_SHANI        2       /**< x86 SHA-NI instructions, one message at a time */
 ///@}
 /** @} */
 
@@ -99,6 +111,38 @@ int32_t B5_Sha256_Update (B5_tSha256Ctx *ctx, const uint8_t *data, int32_t dataL
  * @return See \ref shaReturn .
  */
 int32_t B5_Sha256_Finit (B5_tSha256Ctx *ctx, uint8_t *rDigest);
+
+/**
+ * @brief Same as B5_Sha256_Update() on independent contexts, each one with its own input data of the same length.
+ * @param ctx Pointers to the SHA contexts.
+ * @param data Pointers to the input data of each context.
+ * @param dataLen Bytes to be processed for each context.
+ * @param n Number of contexts, from 1 to B5_SHA256_LANES.
+ * @return See \ref shaReturn .
+ */
+int32_t B5_Sha256_UpdateMulti (B5_tSha256Ctx *ctx[], const uint8_t *data[], int32_t dataLen, int32_t n);
+
+/**
+ * @brief Same as B5_Sha256_Finit() on independent contexts.
+ * @param ctx Pointers to the SHA contexts.
+ * @param rDigest Pointers to the output digests of each context.
+ * @param n Number of contexts, from 1 to B5_SHA256_LANES.
+ * @return See \ref shaReturn .
+ */
+int32_t B5_Sha256_FinitMulti (B5_tSha256Ctx *ctx[], uint8_t *rDigest[], int32_t n);
+
+/**
+ * @brief Get the implementation used by the SHA256 and HMAC-SHA256 functions.
+ * @return See \ref shaImpl . By default, the best implementation supported by the CPU.
+ */
+int32_t B5_Sha256_GetImpl (void);
+
+/**
+ * @brief Select the implementation used by the SHA256 and HMAC-SHA256 functions (i.e. to compare them). Not thread safe, call it before using SHA256.
+ * @param impl See \ref shaImpl .
+ * @return See \ref shaReturn . B5_SHA256_RES_INVALID_ARGUMENT if the CPU does not support impl.
+ */
+int32_t B5_Sha256_SetImpl (int32_t impl);
 ///@}
 /** @} */
 
@@ -122,9 +166,14 @@ int32_t B5_Sha256_Finit (B5_tSha256Ctx *ctx, uint8_t *rDigest);
 typedef struct
 {
    B5_tSha256Ctx        shaCtx;
-   uint8_t     		iPad[64];
-   uint8_t     		oPad[64];
+   uint32_t    		oState[8];      /**< SHA256 state after the outer pad */
 } B5_tHmacSha256Ctx;
+
+typedef struct
+{
+   uint32_t    		iState[8];      /**< SHA256 state after the inner pad */
+   uint32_t    		oState[8];      /**< SHA256 state after the outer pad */
+} B5_tHmacSha256Key;
 ///@}
 /** @} */
 
@@ -143,6 +192,23 @@ typedef struct
  */
 int32_t B5_HmacSha256_Init (B5_tHmacSha256Ctx *ctx, const uint8_t *Key, int16_t keySize);
 
+/**
+ * @brief Hash the inner and outer pads of a key once, to start many HMAC-SHA256 computations with B5_HmacSha256_InitKey().
+ * @param key Pointer to the precomputed key to be initialized.
+ * @param Key Pointer to the Key that must be used.
+ * @param keySize Key size.
+ * @return See \ref hmacshaReturn .
+ */
+int32_t B5_HmacSha256_KeyInit (B5_tHmacSha256Key *key, const uint8_t *Key, int16_t keySize);
+
+/**
+ * @brief Initialize the HMAC-SHA256 context from a precomputed key, without hashing the pads again. Same as B5_HmacSha256_Init() with the original key.
+ * @param ctx Pointer to the HMAC-SHA256 data structure to be initialized.
+ * @param key Pointer to the key precomputed by B5_HmacSha256_KeyInit().
+ * @return See \ref hmacshaReturn .
+ */
+int32_t B5_HmacSha256_InitKey (B5_tHmacSha256Ctx *ctx, const B5_tHmacSha256Key *key);
+
 /**
  * @brief Compute the HMAC-SHA256 algorithm on input data depending on the current status of the HMAC-SHA256 context.
  * @param ctx Pointer to the current HMAC-SHA256 context.
@@ -159,3 +225,22 @@ int32_t B5_HmacSha256_Update (B5_tHmacSha256Ctx *ctx, const uint8_t *data, int32
  * @return See \ref hmacshaReturn .
  */
 int32_t B5_HmacSha256_Finit (B5_tHmacSha256Ctx *ctx, uint8_t *rDigest);
+
+/**
+ * @brief Same as B5_HmacSha256_Update() on independent contexts, each one with its own input data of the same length.
+ * @param ctx Pointers to the HMAC-SHA256 contexts.
+ * @param data Pointers to the input data of each context.
+ * @param dataLen Bytes to be processed for each context.
+ * @param n Number of contexts, from 1 to B5_SHA256_LANES.
+ * @return See \ref hmacshaReturn .
+ */
+int32_t B5_HmacSha256_UpdateMulti (B5_tHmacSha256Ctx *ctx[], const uint8_t *data[], int32_t dataLen, int32_t n);
+
+/**
+ * @brief Same as B5_HmacSha256_Finit() on independent contexts.
+ * @param ctx Pointers to the HMAC-SHA256 contexts.
+ * @param rDigest Pointers to the output digests of each context.
+ * @param n Number of contexts, from 1 to B5_SHA256_LANES.
+ * @return See \ref hmacshaReturn .
+ */
+int32_t B5_HmacSha256_FinitMulti (B5_tHmacSha256Ctx *ctx[], uint8_t *rDigest[], int32_t n);
@@ -0,0 +1,238 @@
+/**
+  ******************************************************************************
+  * File Name          : sha256_ni.cpp
+  * Description        : SHA-NI and AVX2 implementation of SHA-256.
+  ******************************************************************************
+  *
+  * Copyright  2016-present Blu5 Group <https://www.blu5group.com>
+  *
+  * This library is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU Lesser General Public
+  * License as published by the Free Software Foundation; either
+  * version 3 of the License, or (at your option) any later version.
+  *
+  * This library is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  * Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+  *
+  ******************************************************************************
+  */
+
+/**
+ * @file sha256_ni.cpp
+ * @date 17/10/2026
+ * @brief This file includes the SHA-256 compression function with the x86 SHA-NI and AVX2 instructions. See \ref sha256_ni.h .
+ *
+ * SHA-NI compresses one message, four rounds per pair of SHA256RNDS2 instructions, with the state kept in
+ * registers across consecutive blocks. AVX2 runs the portable rounds on 8 independent messages at once, one
+ * per 32 bit lane: it is used for multi-buffer hashing (e.g. the iterations of PBKDF2) on CPUs without SHA-NI.
+ */
+
+#include "sha256_ni_rounds.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <cpuid.h>
+
+#define B5_SHA256_AVX2_TARGET __attribute__((target("avx2")))
+
+int32_t B5_Sha256Ni_Supported (int32_t impl)
+{
+    unsigned int eax, ebx, ecx, edx, ecx1;
+
+    if (impl == B5_SHA256_IMPL_SCALAR)
+        return 1;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx1, &edx) || !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return 0;
+
+    if (impl == B5_SHA256_IMPL_SHANI)
+        return ((ebx & bit_SHA) && (ecx1 & bit_SSE4_1)) ? 1 : 0;
+
+    if (impl == B5_SHA256_IMPL_AVX2)
+    {
+#ifdef _WIN32
+        /* GCC for Windows (MinGW-w64) does not align the stack to 32 bytes (GCC bug 54412),
+         * the __m256i locals and spills of B5_Sha256Avx2_ProcessBlocks() could fault */
+        return 0;
+#endif
+        /* AVX2 also needs the OS to save the AVX state */
+        unsigned int xcr0_lo, xcr0_hi;
+        if (!(ecx1 & bit_OSXSAVE) || !(ecx1 & bit_AVX) || !(ebx & bit_AVX2))
+            return 0;
+        __asm__ ("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        return ((xcr0_lo & 0x6) == 0x6) ? 1 : 0;
+    }
+
+    return 0;
+}
+
+B5_SHANI_TARGET void B5_Sha256Ni_ProcessBlocks (uint32_t *state, const uint8_t *data, int32_t nBlk)
+{
+    __m128i abef, cdgh, abefSave, cdghSave, t, m[4];
+
+    /* the instructions want the state as ABEF and CDGH */
+    t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0xB1);
+    cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(state + 4)), 0x1B);
+    abef = _mm_alignr_epi8(t, cdgh, 8);
+    cdgh = _mm_blend_epi16(cdgh, t, 0xF0);
+
+    for (; nBlk > 0; nBlk--, data += B5_SHA256_BLOCK_SIZE)
+    {
+        abefSave = abef;
+        cdghSave = cdgh;
+        B5_ShaNiRounds<0>(abef, cdgh, m, data);
+        B5_ShaNiRounds<1>(abef, cdgh, m, data);
+        B5_ShaNiRounds<2>(abef, cdgh, m, data);
+        B5_ShaNiRounds<3>(abef, cdgh, m, data);
+        B5_ShaNiRounds<4>(abef, cdgh, m, data);
+        B5_ShaNiRounds<5>(abef, cdgh, m, data);
+        B5_ShaNiRounds<6>(abef, cdgh, m, data);
+        B5_ShaNiRounds<7>(abef, cdgh, m, data);
+        B5_ShaNiRounds<8>(abef, cdgh, m, data);
+        B5_ShaNiRounds<9>(abef, cdgh, m, data);
+        B5_ShaNiRounds<10>(abef, cdgh, m, data);
+        B5_ShaNiRounds<11>(abef, cdgh, m, data);
+        B5_ShaNiRounds<12>(abef, cdgh, m, data);
+        B5_ShaNiRounds<13>(abef, cdgh, m, data);
+        B5_ShaNiRounds<14>(abef, cdgh, m, data);
+        B5_ShaNiRounds<15>(abef, cdgh, m, data);
+        abef = _mm_add_epi32(abef, abefSave);
+        cdgh = _mm_add_epi32(cdgh, cdghSave);
+    }
+
+    t = _mm_shuffle_epi32(abef, 0x1B);
+    cdgh = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128((__m128i*)state, _mm_blend_epi16(t, cdgh, 0xF0));
+    _mm_storeu_si128((__m128i*)(state + 4), _mm_alignr_epi8(cdgh, t, 8));
+}
+
+template <int N>
+B5_SHA256_AVX2_TARGET static inline __m256i B5_Sha256Avx2Rotr (__m256i x)
+{
+    return _mm256_or_si256(_mm256_srli_epi32(x, N), _mm256_slli_epi32(x, 32 - N));
+}
+
+/* 8x8 transpose of 32 bit words: r[j] holds 8 words of message j, on return r[i] holds word i of the 8 messages */
+B5_SHA256_AVX2_TARGET static inline void B5_Sha256Avx2Transpose (__m256i *r)
+{
+    __m256i t[8], u[8];
+
+    for (int j = 0; j < 8; j += 2)
+    {
+        t[j] = _mm256_unpacklo_epi32(r[j], r[j + 1]);
+        t[j + 1] = _mm256_unpackhi_epi32(r[j], r[j + 1]);
+    }
+    for (int j = 0; j < 8; j += 4)
+    {
+        u[j] = _mm256_unpacklo_epi64(t[j], t[j + 2]);
+        u[j + 1] = _mm256_unpackhi_epi64(t[j], t[j + 2]);
+        u[j + 2] = _mm256_unpacklo_epi64(t[j + 1], t[j + 3]);
+        u[j + 3] = _mm256_unpackhi_epi64(t[j + 1], t[j + 3]);
+    }
+    for (int j = 0; j < 4; j++)
+    {
+        r[j] = _mm256_permute2x128_si256(u[j], u[j + 4], 0x20);
+        r[j + 4] = _mm256_permute2x128_si256(u[j], u[j + 4], 0x31);
+    }
+}
+
+B5_SHA256_AVX2_TARGET void B5_Sha256Avx2_ProcessBlocks (uint32_t *state[], const uint8_t *data[], int32_t nBlk, int32_t n)
+{
+    const __m256i bswap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                          12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    alignas(32) uint32_t s[8][8];
+    const uint8_t *d[8];
+    __m256i v[8], w[16];
+
+    /* unused lanes hash a copy of the first message, their result is dropped */
+    for (int j = 0; j < 8; j++)
+    {
+        d[j] = data[(j < n) ? j : 0];
+        for (int i = 0; i < 8; i++)
+            s[i][j] = state[(j < n) ? j : 0][i];
+    }
+    for (int i = 0; i < 8; i++)
+        v[i] = _mm256_load_si256((const __m256i*)s[i]);
+
+    for (int32_t blk = 0; blk < nBlk; blk++)
+    {
+        __m256i a = v[0], b = v[1], c = v[2], dd = v[3], e = v[4], f = v[5], g = v[6], h = v[7];
+
+        for (int half = 0; half < 2; half++)
+        {
+            for (int j = 0; j < 8; j++)
+                w[8 * half + j] = _mm256_loadu_si256((const __m256i*)(d[j] + B5_SHA256_BLOCK_SIZE * blk + 32 * half));
+            B5_Sha256Avx2Transpose(w + 8 * half);
+            for (int j = 0; j < 8; j++)
+                w[8 * half + j] = _mm256_shuffle_epi8(w[8 * half + j], bswap);
+        }
+
+        for (int t = 0; t < 64; t++)
+        {
+            __m256i x, t1, t2;
+
+            if (t >= 16)
+            {
+                /* W[t] = S1(W[t - 2]) + W[t - 7] + S0(W[t - 15]) + W[t - 16], in place over W[t - 16] */
+                __m256i w2 = w[(t - 2) & 15], w15 = w[(t - 15) & 15];
+                __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(B5_Sha256Avx2Rotr<7>(w15), B5_Sha256Avx2Rotr<18>(w15)), _mm256_srli_epi32(w15, 3));
+                __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(B5_Sha256Avx2Rotr<17>(w2), B5_Sha256Avx2Rotr<19>(w2)), _mm256_srli_epi32(w2, 10));
+                w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+            }
+            x = _mm256_add_epi32(w[t & 15], _mm256_set1_epi32((int)B5_Sha256Ni_K[t]));
+
+            t1 = _mm256_xor_si256(_mm256_xor_si256(B5_Sha256Avx2Rotr<6>(e), B5_Sha256Avx2Rotr<11>(e)), B5_Sha256Avx2Rotr<25>(e));
+            t1 = _mm256_add_epi32(_mm256_add_epi32(h, t1), _mm256_add_epi32(_mm256_xor_si256(g, _mm256_and_si256(e, _mm256_xor_si256(f, g))), x));
+            t2 = _mm256_xor_si256(_mm256_xor_si256(B5_Sha256Avx2Rotr<2>(a), B5_Sha256Avx2Rotr<13>(a)), B5_Sha256Avx2Rotr<22>(a));
+            t2 = _mm256_add_epi32(t2, _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b))));
+
+            h = g;
+            g = f;
+            f = e;
+            e = _mm256_add_epi32(dd, t1);
+            dd = c;
+            c = b;
+            b = a;
+            a = _mm256_add_epi32(t1, t2);
+        }
+
+        v[0] = _mm256_add_epi32(v[0], a);
+        v[1] = _mm256_add_epi32(v[1], b);
+        v[2] = _mm256_add_epi32(v[2], c);
+        v[3] = _mm256_add_epi32(v[3], dd);
+        v[4] = _mm256_add_epi32(v[4], e);
+        v[5] = _mm256_add_epi32(v[5], f);
+        v[6] = _mm256_add_epi32(v[6], g);
+        v[7] = _mm256_add_epi32(v[7], h);
+    }
+
+    for (int i = 0; i < 8; i++)
+        _mm256_store_si256((__m256i*)s[i], v[i]);
+    for (int j = 0; j < n; j++)
+        for (int i = 0; i < 8; i++)
+            state[j][i] = s[i][j];
+
+    memset(w, 0, sizeof(w));
+    _mm256_zeroupper();
+}
+
+#else
+
+int32_t B5_Sha256Ni_Supported (int32_t impl)
+{
+    return (impl == B5_SHA256_IMPL_SCALAR) ? 1 : 0;
+}
+
+void B5_Sha256Ni_ProcessBlocks (uint32_t *state, const uint8_t *data, int32_t nBlk)
+{
+}
+
+void B5_Sha256Avx2_ProcessBlocks (uint32_t *state[], const uint8_t *data[], int32_t nBlk, int32_t n)
+{
+}
+
+#endif
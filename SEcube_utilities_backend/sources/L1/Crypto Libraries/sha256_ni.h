@@ -0,0 +1,65 @@
+/**
+  ******************************************************************************
+  * File Name          : sha256_ni.h
+  * Description        : SHA-NI and AVX2 SHA-256 header file.
+  ******************************************************************************
+  *
+  * Copyright  2016-present Blu5 Group <https://www.blu5group.com>
+  *
+  * This library is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU Lesser General Public
+  * License as published by the Free Software Foundation; either
+  * version 3 of the License, or (at your option) any later version.
+  *
+  * This library is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  * Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+  *
+  ******************************************************************************
+  */
+
+/*! \file  sha256_ni.h
+ *  \brief This file includes the prototypes of the SHA-256 compression functions based on the x86 SHA-NI and AVX2 instructions.
+ *  \version SEcube Open Source SDK 1.5.1
+ *  \detail These functions are used by sha256.c according to B5_Sha256_GetImpl(), do not call them directly.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "sha256.h"
+
+/**
+ * @brief Check if the CPU supports a SHA-256 implementation.
+ * @param impl See \ref shaImpl .
+ * @return 1 if impl is supported, 0 otherwise.
+ */
+int32_t    B5_Sha256Ni_Supported (int32_t impl);
+
+/**
+ * @brief Compress consecutive blocks of one message with the SHA-NI instructions.
+ * @param state Hash state (8 words), updated in place.
+ * @param data Input blocks.
+ * @param nBlk Number of blocks of B5_SHA256_BLOCK_SIZE bytes.
+ */
+void       B5_Sha256Ni_ProcessBlocks (uint32_t *state, const uint8_t *data, int32_t nBlk);
+
+/**
+ * @brief Compress consecutive blocks of up to B5_SHA256_LANES independent messages at once, one per 32 bit lane of the AVX2 registers.
+ * @param state Hash states (8 words each), updated in place.
+ * @param data Input blocks of each message.
+ * @param nBlk Number of blocks of B5_SHA256_BLOCK_SIZE bytes, the same for all the messages.
+ * @param n Number of messages, from 1 to B5_SHA256_LANES.
+ */
+void       B5_Sha256Avx2_ProcessBlocks (uint32_t *state[], const uint8_t *data[], int32_t nBlk, int32_t n);
+
+#ifdef __cplusplus
+}
+#endif
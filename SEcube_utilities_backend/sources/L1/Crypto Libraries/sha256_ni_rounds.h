@@ -0,0 +1,73 @@
+/**
+  ******************************************************************************
+  * File Name          : sha256_ni_rounds.h
+  * Description        : SHA-NI rounds shared by the SHA-256 units.
+  ******************************************************************************
+  *
+  * Copyright  2016-present Blu5 Group <https://www.blu5group.com>
+  *
+  * This library is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU Lesser General Public
+  * License as published by the Free Software Foundation; either
+  * version 3 of the License, or (at your option) any later version.
+  *
+  * This library is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  * Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+  *
+  ******************************************************************************
+  */
+
+/*! \file  sha256_ni_rounds.h
+ *  \brief This file defines the SHA-256 round constants and the inline SHA-NI rounds, for the C++ units that compress SHA-256 blocks with SHA-NI.
+ *  \version SEcube Open Source SDK 1.5.1
+ *  \detail Used by sha256_ni.cpp and by the AES-CBC code stitched with SHA-NI in aes256_hmac.cpp, do not include it elsewhere.
+ */
+
+#pragma once
+
+#include "sha256_ni.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <immintrin.h>
+
+#define B5_SHANI_TARGET __attribute__((target("sha,sse4.1")))
+
+alignas(32) static const uint32_t B5_Sha256Ni_K[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+/* rounds 4I..4I+3: m[I % 4] holds W[4I..4I+3], the message schedule computes the words of the next rounds in the other entries */
+template <int I>
+B5_SHANI_TARGET static inline __attribute__((always_inline)) void B5_ShaNiRounds (__m128i &abef, __m128i &cdgh, __m128i *m, const uint8_t *data)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+    __m128i w;
+
+    if (I < 4)
+        m[I] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * I)), bswap);
+    w = _mm_add_epi32(m[I % 4], _mm_load_si128((const __m128i*)(B5_Sha256Ni_K + 4 * I)));
+    cdgh = _mm_sha256rnds2_epu32(cdgh, abef, w);
+    if ((I >= 3) && (I <= 14))
+    {
+        __m128i t = _mm_alignr_epi8(m[I % 4], m[(I + 3) % 4], 4);
+        m[(I + 1) % 4] = _mm_sha256msg2_epu32(_mm_add_epi32(m[(I + 1) % 4], t), m[I % 4]);
+    }
+    abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(w, 0x0E));
+    if ((I >= 1) && (I <= 12))
+        m[(I + 3) % 4] = _mm_sha256msg1_epu32(m[(I + 3) % 4], m[I % 4]);
+}
+
+#endif
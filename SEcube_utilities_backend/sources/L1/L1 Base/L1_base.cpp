@@ -74,6 +74,13 @@ bool L1Base::GetSessionLoggedIn() {
 
 void L1Base::SetSessionLoggedIn(bool logged) {
 	this->s[this->ptr].logged_in = logged;
+	if (logged) {
+		this->s[this->ptr].login_count++;
+	}
+}
+
+uint32_t L1Base::GetSessionLoginCount() {
+	return this->s[this->ptr].login_count;
 }
 
 se3_access_type L1Base::GetSessionAccessType(){
@@ -118,12 +125,18 @@ void L1Base::SetSessionCryptoctxHmacKey(uint8_t* keys, size_t offset, size_t len
 
 	for (size_t i = offset; i < offset + len; i++)
 		this->s[this->ptr].cryptoctx.hmacKey[i] = *(keys + i);
+	//the pads are hashed here once instead of at every HMAC of the payload
+	B5_HmacSha256_KeyInit(&this->s[this->ptr].cryptoctx.hmacKeyPads, this->s[this->ptr].cryptoctx.hmacKey, B5_AES_256);
 }
 
 uint8_t* L1Base::GetSessionCryptoctxHmacKey() {
 	return this->s[this->ptr].cryptoctx.hmacKey;
 }
 
+const B5_tHmacSha256Key* L1Base::GetSessionCryptoctxHmacKeyPads() {
+	return &this->s[this->ptr].cryptoctx.hmacKeyPads;
+}
+
 void L1Base::SetCryptoctxInizialized(bool init) {
 	this->s[this->ptr].cryptoctx_initialized = init;
 }
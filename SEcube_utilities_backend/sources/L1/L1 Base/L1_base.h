@@ -34,6 +34,7 @@
 
 #include "../../L0/L0 Base/L0_base.h"
 #include "../Crypto Libraries/aes256.h"
+#include "../Crypto Libraries/aes256_hmac.h"
 #include "../../L0/L0_error_manager.h"
 #include "../Crypto Libraries/pbkdf2.h"
 #include "../L1_error_manager.h"
@@ -74,6 +75,7 @@ typedef struct se3PayloadCryptoctx_ {
     B5_tAesCtx aesdec;
 	B5_tHmacSha256Ctx hmac;
 	uint8_t hmacKey[B5_AES_256];
+	B5_tHmacSha256Key hmacKeyPads; //hmacKey with the inner and outer pads already hashed
     uint8_t auth[B5_SHA256_DIGEST_SIZE];
 } se3PayloadCryptoctx;
 
@@ -84,6 +86,7 @@ typedef struct se3Session_ {
 	uint8_t buf[L0Communication::Parameter::COMM_N * L0Communication::Parameter::COMM_BLOCK];
 	bool locked;
 	bool logged_in;
+	uint32_t login_count;
 	uint32_t timeout;
 	se3File hfile;
 	se3PayloadCryptoctx cryptoctx;
@@ -128,6 +131,7 @@ public:
 	uint8_t* GetSessionBuffer();
 	bool GetSessionLoggedIn();
 	void SetSessionLoggedIn(bool logged);
+	uint32_t GetSessionLoginCount();
 	se3_access_type GetSessionAccessType();
 	void SetSessionAccessType(se3_access_type access);
 	bool GetSessionCryptoInitialized();
@@ -135,6 +139,7 @@ public:
 	B5_tAesCtx* GetSessionCryptoctxAesdec();
 	void SetSessionCryptoctxHmacKey(uint8_t* keys, size_t offset, size_t len);
 	uint8_t* GetSessionCryptoctxHmacKey();
+	const B5_tHmacSha256Key* GetSessionCryptoctxHmacKeyPads();
 	B5_tHmacSha256Ctx* GetSessionCryptoctxHmac();
 	void SetCryptoctxInizialized(bool init);
 	uint8_t* GetSessionKey();
@@ -61,14 +61,13 @@ L1::L1() { // default constructor
 
 void L1::L1SelectSEcube(array<uint8_t, L0Communication::Size::SERIAL>& sn){
 	uint8_t indx = 0;
-	for(uint8_t i = 0; i < this->GetNumberDevices(); i++){
-		if(memcmp(this->GetDeviceSn(), sn.data(), L0Communication::Size::SERIAL) == 0){
-			indx = i;
+	L1SelectDeviceException selectDevExc;
+	for(indx = 0; indx < this->GetNumberDevices(); indx++){
+		if(this->SwitchToDevice(indx) && (memcmp(this->GetDeviceSn(), sn.data(), L0Communication::Size::SERIAL) == 0)){
 			break;
 		}
 	}
-	L1SelectDeviceException selectDevExc;
-	if (!this->SwitchToDevice(indx)){
+	if ((indx == this->GetNumberDevices()) || !this->SwitchToDevice(indx)){ // no SEcube with this serial number
 		throw selectDevExc;
 	}
 	this->base.SwitchToSession(indx);
@@ -117,27 +116,58 @@ void L1::PrepareSessionBufferForChallenge(uint8_t* cc1, uint8_t* cc2, uint16_t a
 //public
 
 void L1::TXRXData(uint16_t cmd, uint16_t reqLen, uint16_t cmdFlags, uint16_t* respLen) {
+	L1TXRXException commExc;
+	//a pipelined command would steal the response
+	if (!this->pipeline.empty())
+		throw commExc;
+
+	uint16_t req0Len = PreparePacket(cmd, reqLen, cmdFlags, this->base.GetSessionBuffer());
+	uint16_t resp0Len = L0Communication::Parameter::COMM_N * L0Communication::Parameter::COMM_BLOCK;
+
+	uint16_t respStatus;
+	bool dataSent = false;
+
+	while(!dataSent) {
+		try {
+			L0::SetLatencySubCommand(cmd);
+			L0::L0TXRX(L0Commands::Command::L1_CMD0, cmdFlags, req0Len, this->base.GetSessionBuffer(), &respStatus, &resp0Len, this->base.GetSessionBuffer());
+			dataSent = true;
+		}
+		catch(const L0NoDeviceOpenedException& e) {
+//			printf("The device was closed!!!\n");
+			L0Open();
+		}
+		catch (const std::exception& e){
+			cout << e.what() << endl;
+			throw commExc;
+		}
+		catch(...) {
+//			printf("Other exception\n");
+			throw commExc;
+		}
+	}
+
+	ParseResponse(cmdFlags, this->base.GetSessionBuffer(), respStatus, resp0Len, respLen);
+}
+
+uint16_t L1::PreparePacket(uint16_t cmd, uint16_t reqLen, uint16_t cmdFlags, uint8_t* buf) {
 	//SET THE HEADERS
 	if (this->base.GetSessionLoggedIn()){ // fill the buffer with the token
-		this->base.FillSessionBuffer(this->base.GetSessionToken(), L1Request::Offset::TOKEN, L1Parameters::Size::TOKEN);
+		memcpy(buf + L1Request::Offset::TOKEN, this->base.GetSessionToken(), L1Parameters::Size::TOKEN);
 	} else {
-		this->base.FillSessionBuffer(L1Request::Offset::TOKEN, L1Parameters::Size::TOKEN); // fill the buffer with 0s
+		memset(buf + L1Request::Offset::TOKEN, 0, L1Parameters::Size::TOKEN); // fill the buffer with 0s
 	}
 
-	uint8_t* _cmd = (uint8_t*)&cmd;
-	uint8_t* _reqLen = (uint8_t*)&reqLen;
+	uint8_t* reqIv = buf + L1Request::Offset::IV;
 
-	uint8_t* reqIv = this->base.GetSessionBuffer() + L1Request::Offset::IV;
-
-	this->base.FillSessionBuffer(_cmd, L1Request::Offset::CMD, 2);
-	this->base.FillSessionBuffer(_reqLen, L1Request::Offset::LEN, 2);
+	memcpy(buf + L1Request::Offset::CMD, &cmd, 2);
+	memcpy(buf + L1Request::Offset::LEN, &reqLen, 2);
 
 	uint16_t reqLenPadded = reqLen;
 	if (reqLenPadded % L1Parameters::Size::CRYPTO_BLOCK != 0) {
 		//fill the buffer with 0s in the request length pat
-		this->base.FillSessionBuffer(	reqLenPadded + L1Response::Offset::DATA,
-										L1Parameters::Size::CRYPTO_BLOCK - (reqLenPadded % L1Parameters::Size::CRYPTO_BLOCK));
-										reqLenPadded += L1Parameters::Size::CRYPTO_BLOCK - (reqLenPadded % L1Parameters::Size::CRYPTO_BLOCK);
+		memset(buf + reqLenPadded + L1Response::Offset::DATA, 0, L1Parameters::Size::CRYPTO_BLOCK - (reqLenPadded % L1Parameters::Size::CRYPTO_BLOCK));
+		reqLenPadded += L1Parameters::Size::CRYPTO_BLOCK - (reqLenPadded % L1Parameters::Size::CRYPTO_BLOCK);
 	}
 
 	//ENCRYPT
@@ -151,65 +181,44 @@ void L1::TXRXData(uint16_t cmd, uint16_t reqLen, uint16_t cmdFlags, uint16_t* re
 	if (cmdFlags & L1Commands::Flags::ENCRYPT){
 		L0Support::Se3Rand(L1Parameters::Size::CRYPTO_BLOCK, reqIv);
 	} else {
-		this->base.FillSessionBuffer(L1Request::Offset::IV, L1Parameters::Size::CRYPTO_BLOCK);
+		memset(reqIv, 0, L1Parameters::Size::CRYPTO_BLOCK);
 	}
 
 	uint16_t req0Len = L1Request::Offset::DATA + reqLenPadded;
-	uint8_t* reqAuth = this->base.GetSessionBuffer() + L1Request::Offset::AUTH;
+	uint8_t* reqAuth = buf + L1Request::Offset::AUTH;
 
 	Se3PayloadEncrypt(	cmdFlags,
-						this->base.GetSessionBuffer() + L1Request::Offset::IV,
-						this->base.GetSessionBuffer() + L1Parameters::Size::AUTH + L1Parameters::Size::IV,
+						buf + L1Request::Offset::IV,
+						buf + L1Parameters::Size::AUTH + L1Parameters::Size::IV,
 						(req0Len - L1Parameters::Size::AUTH - L1Parameters::Size::IV) / L1Parameters::Size::CRYPTO_BLOCK,
 						reqAuth);
+	return req0Len;
+}
 
-	uint16_t resp0Len = L0Communication::Parameter::COMM_N * L0Communication::Parameter::COMM_BLOCK;
-
-	uint16_t respStatus;
+void L1::ParseResponse(uint16_t cmdFlags, uint8_t* buf, uint16_t respStatus, uint16_t resp0Len, uint16_t* respLen) {
 	L1TXRXException commExc;
-	bool dataSent = false;
-
-	while(!dataSent) {
-		try {
-			L0::L0TXRX(L0Commands::Command::L1_CMD0, cmdFlags, req0Len, this->base.GetSessionBuffer(), &respStatus, &resp0Len, this->base.GetSessionBuffer());
-			dataSent = true;
-		}
-		catch(const L0NoDeviceOpenedException& e) {
-//			printf("The device was closed!!!\n");
-			L0Open();
-		}
-		catch (const std::exception& e){
-			cout << e.what() << endl;
-			throw commExc;
-		}
-		catch(...) {
-//			printf("Other exception\n");
-			throw commExc;
-		}
 
-        if(respStatus == L1Error::Error::SE3_ERR_OPENED)
-        {
-            L1AlreadyOpenException alreadyOpenExc;
-            throw alreadyOpenExc;
-        }
-        else if(respStatus != L1Error::Error::OK)
-        {
-            cout << "[L1.cpp - L1::TXRXData] Debug: Response status from L0::L0TXRX -> " << respStatus <<endl;
-            L0TXRXException l0TxRxExc;
-            throw l0TxRxExc;
-
-        }
+	if(respStatus == L1Error::Error::SE3_ERR_OPENED)
+	{
+		L1AlreadyOpenException alreadyOpenExc;
+		throw alreadyOpenExc;
+	}
+	else if(respStatus != L1Error::Error::OK)
+	{
+		cout << "[L1.cpp - L1::TXRXData] Debug: Response status from L0::L0TXRX -> " << respStatus <<endl;
+		L0TXRXException l0TxRxExc;
+		throw l0TxRxExc;
 	}
 
 	//DECRYPT
-	uint8_t* respIv = this->base.GetSessionBuffer() + L1Response::Offset::IV;
-	uint8_t* resp_auth = this->base.GetSessionBuffer() + L1Response::Offset::AUTH;
+	uint8_t* respIv = buf + L1Response::Offset::IV;
+	uint8_t* resp_auth = buf + L1Response::Offset::AUTH;
 	L1CommunicationError payloadDecryptExc;
 
 	try {
 	Se3PayloadDecrypt(	cmdFlags,
 						respIv,
-						this->base.GetSessionBuffer() + L1Parameters::Size::AUTH + L1Parameters::Size::IV,
+						buf + L1Parameters::Size::AUTH + L1Parameters::Size::IV,
 						(resp0Len - L1Parameters::Size::AUTH - L1Parameters::Size::IV) / L1Parameters::Size::CRYPTO_BLOCK,
 						resp_auth);
 	}
@@ -219,14 +228,98 @@ void L1::TXRXData(uint16_t cmd, uint16_t reqLen, uint16_t cmdFlags, uint16_t* re
 
 	uint16_t u16tmp;
 
-	memcpy((void*)&u16tmp, (const void*)(this->base.GetSessionBuffer() + L1Response::Offset::LEN), 2);
+	memcpy((void*)&u16tmp, (const void*)(buf + L1Response::Offset::LEN), 2);
 	*respLen = u16tmp;
-	memcpy((void*)&u16tmp, (const void*)(this->base.GetSessionBuffer() + L1Response::Offset::STATUS), 2);
+	memcpy((void*)&u16tmp, (const void*)(buf + L1Response::Offset::STATUS), 2);
 
 	if (u16tmp != L0ErrorCodes::Error::OK)
 		throw commExc;
 }
 
+void L1::L1PipelineSubmit(uint16_t cmd, uint16_t cmdFlags, uint16_t reqLen, const uint8_t* reqData) {
+	L1TXRXException commExc;
+	if ((reqLen > L1Request::Size::MAX_DATA) || (reqLen > 0 && reqData == nullptr) || (this->pipeline.size() >= SE3_L1_PIPELINE_MAX))
+		throw commExc;
+
+	//the packet is prepared (and encrypted) while the SEcube is still busy with the previous command
+	se3PipelineEntry entry;
+	entry.cmd = cmd;
+	entry.flags = cmdFlags;
+	entry.buf.reset(L0BufferPool::Acquire());
+	if (entry.buf == nullptr)
+		throw std::bad_alloc();
+	if (reqLen > 0)
+		memcpy(entry.buf.get() + L1Request::Offset::DATA, reqData, reqLen);
+	entry.len = PreparePacket(cmd, reqLen, cmdFlags, entry.buf.get());
+	this->pipeline.push_back(std::move(entry));
+
+	if (this->pipeline.size() == 1)
+		PipelineSend();
+}
+
+void L1::PipelineSend() {
+	L1TXRXException commExc;
+	se3PipelineEntry& head = this->pipeline.front();
+	for (;;) {
+		try {
+			L0::SetLatencySubCommand(head.cmd);
+			L0::L0TXSubmit(L0Commands::Command::L1_CMD0, head.flags, head.len, head.buf.get());
+			return;
+		}
+		catch(const L0NoDeviceOpenedException& e) {
+			L0Open();
+		}
+		catch(...) {
+			this->pipeline.clear();
+			throw commExc;
+		}
+	}
+}
+
+void L1::L1PipelineReap(uint16_t* respLen, uint8_t* respData) {
+	L1TXRXException commExc;
+	uint16_t respStatus = 0;
+	uint16_t resp0Len = L0Communication::Parameter::COMM_N * L0Communication::Parameter::COMM_BLOCK;
+	if (this->pipeline.empty())
+		throw commExc;
+
+	se3PipelineEntry entry = std::move(this->pipeline.front());
+	this->pipeline.pop_front();
+	try {
+		L0::L0RXReap(&respStatus, &resp0Len, entry.buf.get());
+	}
+	catch(...) {
+		this->pipeline.clear();
+		throw commExc;
+	}
+	//keep the SEcube busy with the next command while this response is decrypted
+	if (!this->pipeline.empty())
+		PipelineSend();
+
+	try {
+		ParseResponse(entry.flags, entry.buf.get(), respStatus, resp0Len, respLen);
+	}
+	catch(...) {
+		//the command sent above is still in flight: wait for it, so that nothing is left outstanding on the SEcube, then drop the queue
+		if (!this->pipeline.empty()) {
+			try {
+				resp0Len = L0Communication::Parameter::COMM_N * L0Communication::Parameter::COMM_BLOCK;
+				L0::L0RXReap(&respStatus, &resp0Len, this->pipeline.front().buf.get());
+			}
+			catch(...) {
+			}
+			this->pipeline.clear();
+		}
+		throw;
+	}
+	if (respData != nullptr && *respLen > 0)
+		memcpy(respData, entry.buf.get() + L1Response::Offset::DATA, *respLen);
+}
+
+size_t L1::L1PipelinePending() {
+	return this->pipeline.size();
+}
+
 void L1::Se3PayloadCryptoInit() {
 	uint8_t keys[2 * B5_AES_256];
 	PBKDF2HmacSha256(this->base.GetSessionKey(), B5_AES_256, NULL, 0, 1, keys, 2 * B5_AES_256);
@@ -237,13 +330,22 @@ void L1::Se3PayloadCryptoInit() {
 
 void L1::Se3PayloadEncrypt(uint16_t flags, uint8_t* iv, uint8_t* data, uint16_t nBlocks, uint8_t* auth) {
 
+    if ((flags & L1Commands::Flags::ENCRYPT) && (flags & L1Commands::Flags::SIGN) && (nBlocks > 0)) {
+        // encrypt-then-MAC in a single pass over the payload
+        B5_HmacSha256_InitKey(this->base.GetSessionCryptoctxHmac(), this->base.GetSessionCryptoctxHmacKeyPads());
+        B5_Aes256HmacSha256_Encrypt(this->base.GetSessionCryptoctxAesenc(), this->base.GetSessionCryptoctxHmac(), iv, data, nBlocks);
+        B5_HmacSha256_Finit(this->base.GetSessionCryptoctxHmac(), this->base.GetSessionCryptoctxAuth());
+        memcpy(auth, this->base.GetSessionCryptoctxAuth(), 16);
+        return;
+    }
+
     if (flags & L1Commands::Flags::ENCRYPT) {
         B5_Aes256_SetIV(this->base.GetSessionCryptoctxAesenc(), iv);
         B5_Aes256_Update(this->base.GetSessionCryptoctxAesenc(), data, data, nBlocks);
     }
 
     if (flags & L1Commands::Flags::SIGN) {
-        B5_HmacSha256_Init(this->base.GetSessionCryptoctxHmac(), this->base.GetSessionCryptoctxHmacKey(), B5_AES_256);
+        B5_HmacSha256_InitKey(this->base.GetSessionCryptoctxHmac(), this->base.GetSessionCryptoctxHmacKeyPads());
         B5_HmacSha256_Update(this->base.GetSessionCryptoctxHmac(), iv, B5_AES_IV_SIZE);
         B5_HmacSha256_Update(this->base.GetSessionCryptoctxHmac(), data, nBlocks * B5_AES_BLK_SIZE);
         B5_HmacSha256_Finit(this->base.GetSessionCryptoctxHmac(), this->base.GetSessionCryptoctxAuth());
@@ -257,8 +359,20 @@ void L1::Se3PayloadEncrypt(uint16_t flags, uint8_t* iv, uint8_t* data, uint16_t
 void L1::Se3PayloadDecrypt(uint16_t flags, const uint8_t* iv, uint8_t* data, uint16_t nBlocks, const uint8_t* auth) {
 	L1PayloadDecryptionException PayloadDecExc;
 
+    if ((flags & L1Commands::Flags::ENCRYPT) && (flags & L1Commands::Flags::SIGN) && (nBlocks > 0)) {
+        // MAC and decryption in a single pass: the clear data is wiped if the MAC does not match
+        B5_HmacSha256_InitKey(this->base.GetSessionCryptoctxHmac(), this->base.GetSessionCryptoctxHmacKeyPads());
+        B5_Aes256HmacSha256_Decrypt(this->base.GetSessionCryptoctxAesdec(), this->base.GetSessionCryptoctxHmac(), iv, data, nBlocks);
+        B5_HmacSha256_Finit(this->base.GetSessionCryptoctxHmac(), this->base.GetSessionCryptoctxAuth());
+        if (memcmp(auth, this->base.GetSessionCryptoctxAuth(), 16)) {
+            memset(data, 0, nBlocks * B5_AES_BLK_SIZE);
+            throw PayloadDecExc;
+        }
+        return;
+    }
+
     if (flags & L1Commands::Flags::SIGN) {
-        B5_HmacSha256_Init(this->base.GetSessionCryptoctxHmac(), this->base.GetSessionCryptoctxHmacKey(), B5_AES_256);
+        B5_HmacSha256_InitKey(this->base.GetSessionCryptoctxHmac(), this->base.GetSessionCryptoctxHmacKeyPads());
         B5_HmacSha256_Update(this->base.GetSessionCryptoctxHmac(), iv, B5_AES_IV_SIZE);
         B5_HmacSha256_Update(this->base.GetSessionCryptoctxHmac(), data, nBlocks * B5_AES_BLK_SIZE);
         B5_HmacSha256_Finit(this->base.GetSessionCryptoctxHmac(), this->base.GetSessionCryptoctxAuth());
@@ -314,10 +428,22 @@ void L1::GetDeviceSerialNumber(string& sn){
 	sn = string(buf, L0Communication::Size::SERIAL);
 }
 
+const se3LatencyHistogram* L1::L1GetLatencyHistogram(uint16_t cmd){
+	return this->GetLatencyHistogram(L0Commands::Command::L1_CMD0, cmd);
+}
+
+void L1::L1ResetLatencyHistograms(){
+	this->ResetLatencyHistograms();
+}
+
 bool L1::L1GetSessionLoggedIn(){
 	return this->base.GetSessionLoggedIn();
 }
 
+uint32_t L1::L1GetSessionLoginCount(){
+	return this->base.GetSessionLoginCount();
+}
+
 se3_access_type L1::L1GetAccessType(){
 	return this->base.GetSessionAccessType();
 }
@@ -30,6 +30,8 @@
 #ifndef L1_H_
 #define L1_H_
 
+#include <deque>
+#include <memory>
 #include "../L0/L0.h"
 #include "L1 Base/L1_base.h"
 #include "Login-Logout API/login_logout_api.h"
@@ -45,22 +47,45 @@
  *  to perform even more complex operations, such as working on an encrypted file) then the libraries belonging to the L2
  *  level can be used (although it should be noted that a corresponding L2 object does not exist, since these libraries
  *  offer specific APIs to the developers).  */
+/** Maximum number of commands queued with L1PipelineSubmit(). */
+#define SE3_L1_PIPELINE_MAX 16
+
+/** Gives the buffer of a se3PipelineEntry back to L0BufferPool. */
+struct se3PipelineRelease {
+	void operator()(uint8_t* buf) const { L0BufferPool::Release(buf); }
+};
+
+/** L1 command queued by L1PipelineSubmit(): the packet is ready to be sent and receives the response in place. */
+typedef struct se3PipelineEntry_ {
+	uint16_t cmd;
+	uint16_t flags;
+	uint16_t len;
+	std::unique_ptr<uint8_t, se3PipelineRelease> buf; // taken from L0BufferPool
+} se3PipelineEntry;
+
 class L1 : private L0, public LoginLogoutApi, public SecurityApi, public UtilityApi {
 private:
 	L1Base base;
 	uint8_t index; // this is used only by SEkey to support multiple SEcube connected to the same host computer (default value 255)
+	std::deque<se3PipelineEntry> pipeline; // commands queued by L1PipelineSubmit(), the first one is in flight
 	/* these are private methods that are used exclusively for internal and low level purposes. */
 	void SessionInit();
 	void PrepareSessionBufferForChallenge(uint8_t* cc1, uint8_t* cc2, uint16_t access);
 	void TXRXData(uint16_t cmd, uint16_t reqLen, uint16_t cmdFlags, uint16_t* respLen);
+	uint16_t PreparePacket(uint16_t cmd, uint16_t reqLen, uint16_t cmdFlags, uint8_t* buf);
+	void ParseResponse(uint16_t cmdFlags, uint8_t* buf, uint16_t respStatus, uint16_t resp0Len, uint16_t* respLen);
+	void PipelineSend();
 	void Se3PayloadCryptoInit();
 	void Se3PayloadEncrypt(uint16_t flags, uint8_t* iv, uint8_t* data, uint16_t nBlocks, uint8_t* auth);
 	void Se3PayloadDecrypt(uint16_t flags, const uint8_t* iv, uint8_t* data, uint16_t nBlocks, const uint8_t* auth);
 	void L1Config(uint16_t type, uint16_t op, std::array<uint8_t, L1Parameters::Size::PIN>& value);
 	void KeyList(uint16_t maxKeys, uint16_t skip, se3Key* keyArray, uint16_t* count);
+	void CryptoStreamChunk(SEcube_crypto_context& ctx, uint8_t* data, uint16_t dataLen, bool last, uint8_t* dataOut);
+	void DigestAbort(SEcube_digest_context& ctx);
+	void CryptoAbort(SEcube_crypto_context& ctx);
 public:
 	L1(); /**< Default constructor. */
-	L1(uint8_t index); /**< Custom constructor used only in a very specific case by the APIs of the SEkey library (L2). Do not use elsewhere. */
+	L1(uint8_t index); /**< Custom constructor that opens only the SEcube with the given index, used by the APIs of the SEkey library (L2) and by L1MultiDevice. Do not use elsewhere. */
 	~L1(); /**< Destructor. Automatic logout implemented. */
 
 	//LOGIN-LOGOUT API
@@ -80,6 +105,9 @@ public:
 	/** @brief Returns true if logged in, false otherwise.
 	 *  @detail The returned value does not depend on the privilege associated to the login (i.e. administrator or user). */
 	bool L1GetSessionLoggedIn();
+	/** @brief Returns the number of logins performed on the SEcube by this object.
+	 *  @detail The crypto sessions opened on the SEcube are closed by the logout, so a session ID is valid only while this value does not change. */
+	uint32_t L1GetSessionLoginCount();
 	/** @brief Returns the privilege level obtained with the login operation. */
 	se3_access_type L1GetAccessType();
 
@@ -100,7 +128,8 @@ public:
 	 * @param [in] data2 The second buffer to be processed by this crypto operation (can be NULL).
 	 * @param [out] dataOutLen The length of the output of the crypto operation.
 	 * @param [in] dataOut The buffer filled with the result of the crypto operation.
-	 * @detail This is a low level function to exploit the crypto features of the SEcube. It can be ignored, we suggest using L1Encrypt(), L1Decrypt() and L1Digest() instead. */
+	 * @detail Both buffers can be empty only together with L1Crypto::UpdateFlags::FINIT.
+	 * This is a low level function to exploit the crypto features of the SEcube. It can be ignored, we suggest using L1Encrypt(), L1Decrypt() and L1Digest() instead. */
 	void L1CryptoUpdate(uint32_t sessId, uint16_t flags, uint16_t data1Len, uint8_t* data1, uint16_t data2Len, uint8_t* data2, uint16_t* dataOutLen, uint8_t* dataOut) override ;
 	/** @brief Encrypt some data according to a specific algorithm and mode (i.e. AES-256-CBC), using a specific key.
 	 * @param [in] plaintext_size The length of the buffer to be encrypted.
@@ -120,6 +149,59 @@ public:
 	 * must be encapsulated into a L1Ciphertext object; then the object must be configured with the required parameters (i.e. algorithm, mode, nonce, iv, etc...) so that
 	 * the L1Decrypt() can perform its task. */
 	void L1Decrypt(SEcube_ciphertext& encrypted_data, size_t& plaintext_size, std::shared_ptr<uint8_t[]>& plaintext) override ;
+	/** @brief Start an encryption whose data is passed later, in pieces, with L1EncryptUpdate().
+	 * @param [out] encrypted_data The L1Ciphertext object where the metadata of the encryption (algorithm, mode, key, nonces, IV) is stored. Its ciphertext buffer is not used.
+	 * @param [in] algorithm The algorithm to be used (see L1Algorithms::Algorithms).
+	 * @param [in] algorithm_mode The mode of the algorithm (i.e. CBC, CTR, etc.). See CryptoInitialisation::Feedback.
+	 * @param [in] key_id The ID of the key to be used to perform the operation.
+	 * @param [out] ctx The context of the encryption, to be passed to L1EncryptUpdate() and L1EncryptFinal().
+	 * @detail Throws exception in case of errors. The ciphertext is the same that L1Encrypt() would produce with the same metadata. */
+	void L1EncryptInit(SEcube_ciphertext& encrypted_data, uint16_t algorithm, uint16_t algorithm_mode, uint32_t key_id, SEcube_crypto_context& ctx) override ;
+	/** @brief Encrypt a piece of data, of any size, as part of the encryption started with L1EncryptInit().
+	 * @param [in] ctx The context of the encryption.
+	 * @param [in] input_size The length of the buffer to be encrypted (can be 0).
+	 * @param [in] input_data The buffer to be encrypted.
+	 * @param [out] output_data The buffer where the encrypted data is written. It must be able to hold ctx.buffered + input_size bytes.
+	 * @param [out] output_size The number of bytes written in output_data, a multiple of the chunk size (the rest is kept in the context).
+	 * @detail Throws exception in case of errors. */
+	void L1EncryptUpdate(SEcube_crypto_context& ctx, size_t input_size, const uint8_t* input_data, uint8_t* output_data, size_t& output_size) override ;
+	/** @brief Finalize the encryption started with L1EncryptInit(), adding the PKCS#7 padding.
+	 * @param [in] ctx The context of the encryption, which cannot be used anymore.
+	 * @param [out] encrypted_data The object passed to L1EncryptInit(): the total size of the ciphertext and, with AES-HMAC-SHA256, the digest are stored here.
+	 * @param [out] output_data The buffer where the last encrypted bytes are written. It must be able to hold ctx.buffered + B5_AES_BLK_SIZE bytes.
+	 * @param [out] output_size The number of bytes written in output_data.
+	 * @detail Throws exception in case of errors. */
+	void L1EncryptFinal(SEcube_crypto_context& ctx, SEcube_ciphertext& encrypted_data, uint8_t* output_data, size_t& output_size) override ;
+	/** @brief Stop the encryption started with L1EncryptInit() before L1EncryptFinal(), releasing its crypto session on the SEcube.
+	 * @param [in,out] ctx The context of the encryption, no longer active afterwards.
+	 * @detail Nothing is done if the context is not active. Errors are ignored, so that it can be called while handling another error.
+	 * The other encryption APIs call it on their errors, and the destructor of SEcube_crypto_context calls it on a context still active. */
+	void L1EncryptAbort(SEcube_crypto_context& ctx) override ;
+	/** @brief Start the decryption of data encrypted with L1Encrypt() or L1EncryptInit(), whose ciphertext is passed later, in pieces, with L1DecryptUpdate().
+	 * @param [in] encrypted_data The L1Ciphertext object with the metadata of the encryption. Its ciphertext buffer is not used.
+	 * @param [out] ctx The context of the decryption, to be passed to L1DecryptUpdate() and L1DecryptFinal().
+	 * @detail Throws exception in case of errors. */
+	void L1DecryptInit(SEcube_ciphertext& encrypted_data, SEcube_crypto_context& ctx) override ;
+	/** @brief Decrypt a piece of ciphertext, of any size, as part of the decryption started with L1DecryptInit().
+	 * @param [in] ctx The context of the decryption.
+	 * @param [in] input_size The length of the buffer to be decrypted (can be 0).
+	 * @param [in] input_data The buffer to be decrypted.
+	 * @param [out] output_data The buffer where the decrypted data is written. It must be able to hold ctx.buffered + input_size bytes.
+	 * @param [out] output_size The number of bytes written in output_data (the last chunk is always kept in the context for L1DecryptFinal()).
+	 * @detail Throws exception in case of errors. With AES-HMAC-SHA256 the digest is checked only by L1DecryptFinal(), so the data returned
+	 * here must not be trusted until that call succeeds. */
+	void L1DecryptUpdate(SEcube_crypto_context& ctx, size_t input_size, const uint8_t* input_data, uint8_t* output_data, size_t& output_size) override ;
+	/** @brief Finalize the decryption started with L1DecryptInit(), checking the digest (AES-HMAC-SHA256) and removing the padding.
+	 * @param [in] ctx The context of the decryption, which cannot be used anymore.
+	 * @param [in] encrypted_data The object passed to L1DecryptInit(), with the expected digest.
+	 * @param [out] output_data The buffer where the last decrypted bytes are written. It must be able to hold ctx.buffered bytes.
+	 * @param [out] output_size The number of bytes written in output_data.
+	 * @detail Throws exception in case of errors, in particular if the digest does not match or the padding is not valid. */
+	void L1DecryptFinal(SEcube_crypto_context& ctx, SEcube_ciphertext& encrypted_data, uint8_t* output_data, size_t& output_size) override ;
+	/** @brief Stop the decryption started with L1DecryptInit() before L1DecryptFinal(), releasing its crypto session on the SEcube.
+	 * @param [in,out] ctx The context of the decryption, no longer active afterwards.
+	 * @detail Same as L1EncryptAbort(). */
+	void L1DecryptAbort(SEcube_crypto_context& ctx) override ;
 	/** @brief Compute the digest of some data.
 	 * @param [in] input_size The length of the buffer to be processed.
 	 * @param [in] input_data The buffer to be processed.
@@ -128,6 +210,22 @@ public:
 	 * Check the documentation of the digest object. For instance, if you want to generate the SHA-256 digest you simply need to set
 	 * the "algorithm" parameter. If you want to use the HMAC-SHA256, you also need to set other parameters. */
 	void L1Digest(size_t input_size, std::shared_ptr<uint8_t[]> input_data, SEcube_digest& digest) override ;
+	/** @brief Start the computation of a digest whose data is passed later, in pieces, with L1DigestUpdate().
+	 * @param [in,out] digest The object that describes the digest, configured as for L1Digest(). If HMAC-SHA256 is used without a nonce, the nonce generated here is stored in it.
+	 * @param [out] ctx The context of the digest, to be passed to L1DigestUpdate() and L1DigestFinal().
+	 * @detail Throws exception in case of errors. No other crypto operation should be interleaved with the digest on the same context. */
+	void L1DigestInit(SEcube_digest& digest, SEcube_digest_context& ctx) override ;
+	/** @brief Add some data to a digest started with L1DigestInit().
+	 * @param [in] ctx The context of the digest.
+	 * @param [in] input_size The length of the buffer to be processed (can be 0).
+	 * @param [in] input_data The buffer to be processed.
+	 * @detail Throws exception in case of errors. The data is buffered and sent to the SEcube in full CRYPTO_UPDATE chunks, so the size of the pieces does not change the number of requests. */
+	void L1DigestUpdate(SEcube_digest_context& ctx, size_t input_size, const uint8_t* input_data) override ;
+	/** @brief Finalize a digest started with L1DigestInit().
+	 * @param [in] ctx The context of the digest, which cannot be used anymore.
+	 * @param [out] digest The object where the digest will be stored (the same passed to L1DigestInit()).
+	 * @detail Throws exception in case of errors. If no data at all was passed to L1DigestUpdate(), the digest of the empty input is computed. */
+	void L1DigestFinal(SEcube_digest_context& ctx, SEcube_digest& digest) override ;
 	/* @brief Set the PIN for administrator privilege level on the SEcube.
 	 * @param [in] pin The PIN to be set.
 	 * @detail Throws exception in case of errors. */
@@ -176,6 +274,29 @@ public:
 	/** @brief Get the serial number of the SEcube.
 	 * @param [out] sn The string where the serial number will be stored. */
 	void GetDeviceSerialNumber(std::string& sn);
+	/** @brief Get the histogram of the round trip times of an L1 command sent to the SEcube.
+	 * @param [in] cmd The L1 command (L1Commands::Codes).
+	 * @return The histogram, NULL if there is no SEcube. Use L1ResetLatencyHistograms() to clear it. */
+	const se3LatencyHistogram* L1GetLatencyHistogram(uint16_t cmd);
+	/** @brief Clear the histograms of the round trip times of the commands sent to the SEcube. */
+	void L1ResetLatencyHistograms();
+	/** @brief Queue an L1 command. The request is prepared (encrypted and signed according to cmdFlags) immediately,
+	 * so the host can build the next request while the SEcube is processing the previous one.
+	 * @param [in] cmd The L1 command (L1Commands::Codes).
+	 * @param [in] cmdFlags L1Commands::Flags for the payload protection.
+	 * @param [in] reqLen Length of the request data, at most L1Request::Size::MAX_DATA.
+	 * @param [in] reqData Request data, copied before returning.
+	 * @details At most SE3_L1_PIPELINE_MAX commands can be queued. The responses must be collected in order with L1PipelineReap()
+	 * before using any other L1 API. Throws exception in case of errors, in that case all the queued commands are dropped. */
+	void L1PipelineSubmit(uint16_t cmd, uint16_t cmdFlags, uint16_t reqLen, const uint8_t* reqData);
+	/** @brief Wait for the response of the oldest command queued with L1PipelineSubmit(). The next queued command is sent to the
+	 * SEcube before the response is decrypted.
+	 * @param [out] respLen Length of the response data.
+	 * @param [out] respData Buffer of at least L1Response::Size::MAX_DATA bytes for the response data (may be NULL).
+	 * @details Throws exception in case of errors (including a status different from OK), in that case all the queued commands are dropped. */
+	void L1PipelineReap(uint16_t* respLen, uint8_t* respData);
+	/** @brief Number of commands queued with L1PipelineSubmit() whose response has not been reaped yet. */
+	size_t L1PipelinePending();
 
 	// L1 API implemented to support SEkey API (should not be used explicitly)
 	/** @brief Read or write the user ID and the user name of the SEcube owner (member of SEkey) from/to the SEcube. Used only by SEkey, do not use explicitly.
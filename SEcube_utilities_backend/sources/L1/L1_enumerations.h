@@ -491,6 +491,17 @@ namespace L1Algorithms {
 			ALGORITHM_MAX = 4	/**< Value required by SEfile */
 		};
 	};
+
+	/** Algorithms that only some SEcube firmwares support, each one is listed by CRYPTO_LIST at the position equal to its value. */
+	struct Extensions {
+		enum {
+			/** AES-CTR + HMAC-SHA-256 of independent sectors, used by SEfile. In a CRYPTO_UPDATE, data1 holds one CTR nonce (16 bytes) per sector
+			 * and data2 holds the sectors, all of the same size: the last 32 bytes of each sector are not encrypted, they are replaced by the
+			 * HMAC of the ciphertext of the sector. The HMAC key is derived by SETNONCE, as with AES_HMACSHA256. Each sector starts from its
+			 * own nonce and its own HMAC, so the session can be kept open (no FINIT) and used for any number of updates. */
+			AES_HMACSHA256_SECTORS = 4
+		};
+	};
 }
 
 namespace L1Configuration {
@@ -186,4 +186,11 @@ public:
 	}
 };
 
+class L1MultiDeviceException : public L1Exception {
+public:
+	virtual const char* what() const throw() override {
+		return "No SEcube available for the multi-device operation!";
+	}
+};
+
 #endif
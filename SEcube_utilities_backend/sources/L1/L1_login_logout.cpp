@@ -86,10 +86,16 @@ void L1::L1Login(const std::array<uint8_t, L1Parameters::Size::PIN>& pin, se3_ac
 									L1Parameters::Size::CHALLENGE);
 
 	uint8_t sRespExpected[L1Parameters::Size::CHALLENGE];
+	uint8_t cResp[L1Parameters::Size::CHALLENGE];
 
-	// check server response
-	PBKDF2HmacSha256(pin_, L1Parameters::Size::PIN, cc1, L1Parameters::Size::CHALLENGE, L1Parameters::Parameter::ITERATIONS, sRespExpected, L1Parameters::Size::CHALLENGE);
+	// expected server response and client response, derived together from the pads of the pin
+	B5_tHmacSha256Key pinKey;
+	const uint8_t* salts[] = { cc1, sc };
+	uint8_t* resps[] = { sRespExpected, cResp };
+	B5_HmacSha256_KeyInit(&pinKey, pin_, L1Parameters::Size::PIN);
+	PBKDF2HmacSha256Multi(&pinKey, salts, L1Parameters::Size::CHALLENGE, L1Parameters::Parameter::ITERATIONS, resps, L1Parameters::Size::CHALLENGE, 2);
 
+	// check server response
 	bool cmpRes;
 
 	try {
@@ -98,15 +104,21 @@ void L1::L1Login(const std::array<uint8_t, L1Parameters::Size::PIN>& pin, se3_ac
 												L1Parameters::Size::CHALLENGE);
 	}
 	catch (L1Exception& e) {
+		memset(&pinKey, 0, sizeof(pinKey));
 		throw loginExc;
 	}
 
-	if (cmpRes == false)
+	if (cmpRes == false) {
+		memset(&pinKey, 0, sizeof(pinKey));
 		throw loginExc;
+	}
 
 	//prepare key session
 	//the resulting key is saved in this->base.s.key
-	PBKDF2HmacSha256 (pin_,	L1Parameters::Size::PIN, cc2, L1Parameters::Size::CHALLENGE, 1, this->base.GetSessionKey(),	L1Parameters::Size::PIN);
+	const uint8_t* sessionSalt[] = { cc2 };
+	uint8_t* sessionKey[] = { this->base.GetSessionKey() };
+	PBKDF2HmacSha256Multi(&pinKey, sessionSalt, L1Parameters::Size::CHALLENGE, 1, sessionKey, L1Parameters::Size::PIN, 1);
+	memset(&pinKey, 0, sizeof(pinKey));
 
 	this->base.SetSessionLoggedIn(true);
 	this->base.SetSessionAccessType((se3_access_type)access);
@@ -114,13 +126,7 @@ void L1::L1Login(const std::array<uint8_t, L1Parameters::Size::PIN>& pin, se3_ac
 
 	//encryption can begin here
 	//prepare challenge response
-	PBKDF2HmacSha256 (pin_,
-					  L1Parameters::Size::PIN,
-					  sc,
-					  L1Parameters::Size::CHALLENGE,
-					  L1Parameters::Parameter::ITERATIONS,
-					  this->base.GetSessionBuffer() + L1Response::Offset::DATA + L1Login::RequestOffset::CRESP,
-					  L1Parameters::Size::CHALLENGE);
+	memcpy(this->base.GetSessionBuffer() + L1Response::Offset::DATA + L1Login::RequestOffset::CRESP, cResp, L1Parameters::Size::CHALLENGE);
 
 	reqLen = L1Parameters::Size::CHALLENGE;
 
@@ -62,7 +62,7 @@ void L1::L1CryptoInit(uint16_t algorithm, uint16_t mode, uint32_t keyId, uint32_
 }
 
 void L1::L1CryptoUpdate(uint32_t sessId, uint16_t flags, uint16_t data1Len, uint8_t* data1, uint16_t data2Len, uint8_t* data2, uint16_t* dataOutLen, uint8_t* dataOut) {
-	if(data1Len == 0 && data2Len == 0){
+	if(data1Len == 0 && data2Len == 0 && !(flags & L1Crypto::UpdateFlags::FINIT)){ // only FINIT can come without data (i.e. digest of the empty input)
 		throw std::invalid_argument("Cannot pass empty input buffers!");
 	}
 
@@ -125,6 +125,87 @@ void L1::L1Encrypt(size_t plaintext_size, std::shared_ptr<uint8_t[]> plaintext,
 	if(plaintext == nullptr){
 		throw encryptExc;
 	}
+	SEcube_crypto_context ctx;
+	size_t enc_size = 0; // bytes encrypted by L1EncryptUpdate()
+	size_t last_size = 0; // bytes encrypted by L1EncryptFinal()
+	try {
+		L1EncryptInit(encrypted_data, algorithm, algorithm_mode, key_id, ctx);
+		// the ciphertext is written directly in the L1Ciphertext object, including the PKCS#7 padding
+		encrypted_data.ciphertext = make_unique<uint8_t[]>(plaintext_size + (B5_AES_BLK_SIZE - (plaintext_size % B5_AES_BLK_SIZE)));
+		L1EncryptUpdate(ctx, plaintext_size, plaintext.get(), encrypted_data.ciphertext.get(), enc_size);
+		L1EncryptFinal(ctx, encrypted_data, encrypted_data.ciphertext.get() + enc_size, last_size);
+	}
+	catch (L1Exception& e) {
+		throw encryptExc;
+	}
+}
+
+void L1::L1Decrypt(SEcube_ciphertext& encrypted_data, size_t& plaintext_size, std::shared_ptr<uint8_t[]>& plaintext) {
+	L1DecryptException decryptExc;
+	SEcube_crypto_context ctx;
+	size_t dec_size = 0; // bytes decrypted by L1DecryptUpdate()
+	size_t last_size = 0; // bytes decrypted by L1DecryptFinal(), without padding
+	try {
+		L1DecryptInit(encrypted_data, ctx);
+		shared_ptr<uint8_t[]> tmp(new uint8_t[encrypted_data.ciphertext_size]);
+		L1DecryptUpdate(ctx, encrypted_data.ciphertext_size, encrypted_data.ciphertext.get(), tmp.get(), dec_size);
+		L1DecryptFinal(ctx, encrypted_data, tmp.get() + dec_size, last_size);
+		plaintext_size = dec_size + last_size;
+		plaintext.swap(tmp);
+	}
+	catch(L1Exception& e) {
+		throw decryptExc;
+	}
+}
+
+void L1::CryptoStreamChunk(SEcube_crypto_context& ctx, uint8_t* data, uint16_t dataLen, bool last, uint8_t* dataOut) {
+	L1CryptoUpdateException cryptoUpdateExc;
+	bool auth = (ctx.algorithm == L1Algorithms::Algorithms::AES_HMACSHA256);
+	uint16_t flags = 0;
+	uint16_t curr_len = 0;
+	// the flags are the same used since the first version of L1Encrypt() and L1Decrypt(), to keep the ciphertext compatible
+	if(last){
+		flags = auth ? (L1Crypto::UpdateFlags::RESET | L1Crypto::UpdateFlags::AUTH | L1Crypto::UpdateFlags::FINIT) : L1Crypto::UpdateFlags::FINIT;
+	}
+	if(ctx.mode == CryptoInitialisation::Modes::CTR){
+		if(!last){
+			flags = L1Crypto::UpdateFlags::RESET;
+		}
+		memcpy(ctx.ctr_nonce.data()+8, &ctx.ctr_counter, 8); // nonce is made of first 64 bits that are fixed (actual nonce) and last 64 bits that are the counter
+		L1CryptoUpdate(ctx.sessId, flags, B5_AES_BLK_SIZE, ctx.ctr_nonce.data(), dataLen, data, &curr_len, dataOut);
+		ctx.ctr_counter++;
+	} else {
+		L1CryptoUpdate(ctx.sessId, flags, 0, nullptr, dataLen, data, &curr_len, dataOut);
+	}
+	if(curr_len != (dataLen + ((last && auth) ? B5_SHA256_DIGEST_SIZE : 0))){
+		throw cryptoUpdateExc; // the SEcube must process the whole chunk (and append the signature with AES-HMAC-SHA256)
+	}
+}
+
+void L1::CryptoAbort(SEcube_crypto_context& ctx) {
+	// FINIT releases the crypto session on the SEcube, the data is discarded and errors are ignored since the caller is already failing
+	if(!ctx.active){
+		return;
+	}
+	ctx.active = false;
+	ctx.buffered = 0;
+	try {
+		L1CryptoUpdate(ctx.sessId, L1Crypto::UpdateFlags::FINIT, 0, nullptr, 0, nullptr, nullptr, nullptr);
+	}
+	catch (...) {
+	}
+}
+
+void L1::L1EncryptAbort(SEcube_crypto_context& ctx) {
+	CryptoAbort(ctx);
+}
+
+void L1::L1DecryptAbort(SEcube_crypto_context& ctx) {
+	CryptoAbort(ctx);
+}
+
+void L1::L1EncryptInit(SEcube_ciphertext& encrypted_data, uint16_t algorithm, uint16_t algorithm_mode, uint32_t key_id, SEcube_crypto_context& ctx) {
+	L1EncryptException encryptExc;
 	if((algorithm == L1Algorithms::Algorithms::HMACSHA256) || (algorithm == L1Algorithms::Algorithms::SHA256)){
 		throw std::invalid_argument("Cannot call L1Encrypt with digest algorithms. Call L1Digest instead.");
 	}
@@ -138,162 +219,126 @@ void L1::L1Encrypt(size_t plaintext_size, std::shared_ptr<uint8_t[]> plaintext,
 	   (algorithm_mode != CryptoInitialisation::Modes::CFB)){
 		throw std::invalid_argument("Invalid algorithm mode.");
 	}
-	uint32_t encSessId = 0; // crypto session identifier on the SEcube
-	uint16_t curr_len = 0; // how many bytes have been processed by the latest cryptoupdate() call
-	size_t curr_chunk = 0; // dimension (bytes) of current portion of data to be encrypted
-	uint64_t enc_size = 0; // counter of how many bytes are encrypted
-	size_t total_size_copy = 0; // here we will store a copy of the total size of the plaintext
-	unique_ptr<uint8_t[]> ciphertext; // here we will store the encrypted data
 	encrypted_data.reset(); // reset content of the L1Ciphertext object (in case the caller provided an object already used before)
 	encrypted_data.algorithm = algorithm;
 	encrypted_data.mode = algorithm_mode;
 	encrypted_data.key_id = key_id;
+	ctx.active = false;
+	ctx.algorithm = algorithm;
+	ctx.mode = algorithm_mode;
+	ctx.buffered = 0;
+	ctx.processed = 0;
+	ctx.ctr_counter = 0;
+	ctx.chunk = L1Crypto::UpdateSize::DATAIN;
+	if(algorithm_mode == CryptoInitialisation::Modes::CTR){
+		ctx.chunk -= B5_AES_BLK_SIZE; // in CTR mode the nonce is sent together with each chunk
+	}
+	if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){
+		ctx.chunk -= B5_SHA256_DIGEST_SIZE; // room for the signature in the response to the last chunk
+	}
+	ctx.owner = this;
+	ctx.direction = CryptoInitialisation::Direction::ENCRYPT;
 	try {
-		L1CryptoInit(algorithm, algorithm_mode | CryptoInitialisation::Direction::ENCRYPT, key_id, encSessId);
-		uint8_t padding = (B5_AES_BLK_SIZE - (plaintext_size % B5_AES_BLK_SIZE)); // PKCS#7 padding
-		size_t total_size = plaintext_size + padding;
-		total_size_copy = total_size;
-		unique_ptr<uint8_t[]> plaintext_padded = make_unique<uint8_t[]>(total_size);
-		memcpy(plaintext_padded.get(), plaintext.get(), plaintext_size); // copy first part (real plaintext)
-		memset(plaintext_padded.get()+plaintext_size, padding, padding); // setup padding value (this doesn't do anything if padding=0)
-		ciphertext = make_unique<uint8_t[]>(total_size); // by default allocated for simple AES
-
+		L1CryptoInit(algorithm, algorithm_mode | CryptoInitialisation::Direction::ENCRYPT, key_id, ctx.sessId);
+		ctx.active = true; // the session is open, L1EncryptAbort() closes it if it cannot be set up
 		if(algorithm_mode == CryptoInitialisation::Modes::CTR){
-			enum{
-				/* we need this new value because, in CTR mode, the L1CryptoUpdate will be called passing both the cleartext and the counter,
-				 * so we have to consider also the size of the nonce when sending the cryptoupdate. */
-				DATAIN_NEW = L1Crypto::UpdateSize::DATAIN - B5_AES_BLK_SIZE
-			};
-			curr_chunk = total_size < DATAIN_NEW ? total_size : DATAIN_NEW; // by default computed for simple AES
-			uint8_t ctr_nonce[B5_AES_BLK_SIZE]; // nonce required by AES-CTR (it is combined with the counter)
-			memset(ctr_nonce, 0, B5_AES_BLK_SIZE);
-			L0Support::Se3Rand(B5_AES_BLK_SIZE, ctr_nonce); // fill nonce with random bytes
-			uint64_t ctr_counter = 0;
-			memcpy(ctr_nonce+8, &ctr_counter, 8); // nonce is made of first 64 bits that are fixed (actual nonce) and last 64 bits that are the counter
 			// NONCE -> 64 random bits (real nonce) concatenated 64 bits (counter)
 			// NONCE: uint64_t counter allows for 2^64 * 16 bytes of data...plenty enough
-			for(int i=0; i<B5_AES_BLK_SIZE; i++){ // copy ctr_nonce to L1Ciphertext object
-				encrypted_data.CTR_nonce.at(i) = ctr_nonce[i];
-			}
-			if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){ // AES + HMAC-SHA256
-				ciphertext.reset();
-				ciphertext = make_unique<uint8_t[]>(total_size+B5_SHA256_DIGEST_SIZE); // reassign including signature
-				curr_chunk = total_size < (DATAIN_NEW - B5_SHA256_DIGEST_SIZE) ? total_size : (DATAIN_NEW - B5_SHA256_DIGEST_SIZE); // recomputed including signature
-				uint8_t nonce_key_derivation_hmac_sha256[32]; // nonce to derive (with pbdkf2) the key used to authenticate the digest with HMAC-SHA256
-				memset(nonce_key_derivation_hmac_sha256, 0, 32);
-				L0Support::Se3Rand(32, nonce_key_derivation_hmac_sha256); // fill nonce with random bytes
-				L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::SETNONCE, 32, nonce_key_derivation_hmac_sha256, 0, nullptr, nullptr, nullptr); // set nonce for HMAC-SHA256 key derivation
-				for(int i=0; i<32; i++){ // copy nonce to L1Ciphertext object
-					encrypted_data.digest_nonce.at(i) = nonce_key_derivation_hmac_sha256[i];
-				}
-			}
-			uint8_t *decrypted = plaintext_padded.get(); // alias for plaintext
-			uint8_t *encrypted = ciphertext.get(); // alias for ciphertext
-			do {
-				if(total_size - curr_chunk){ // still in the middle of data
-					if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){ // AES with HMAC-SHA256
-						L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::RESET, B5_AES_BLK_SIZE, ctr_nonce, curr_chunk, decrypted, &curr_len, encrypted);
-					} else { // standard AES without HMAC-SHA256
-						L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::RESET, B5_AES_BLK_SIZE, ctr_nonce, curr_chunk, decrypted, &curr_len, encrypted);
-					}
-				}
-				else{ // last chunk of data
-					if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){ // AES with HMAC-SHA256
-						L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::RESET | L1Crypto::UpdateFlags::AUTH | L1Crypto::UpdateFlags::FINIT, B5_AES_BLK_SIZE, ctr_nonce, curr_chunk, decrypted, &curr_len, encrypted);
-					} else { // standard AES without HMAC-SHA256
-						L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::FINIT, B5_AES_BLK_SIZE, ctr_nonce, curr_chunk, decrypted, &curr_len, encrypted);
-					}
-				}
-				ctr_counter++; // increment counter and concatenate it with the nonce
-				memcpy(ctr_nonce+8, &ctr_counter, 8);
-				total_size -= curr_chunk; // decrement total number of bytes
-				decrypted += curr_chunk; // move on pointer of plaintext
-				encrypted += curr_chunk; // move on pointer of ciphertext
-				curr_chunk = total_size < DATAIN_NEW ? total_size : DATAIN_NEW; // next chunk of data
-				if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){ // recomputed including signature
-					curr_chunk = total_size < (DATAIN_NEW - B5_SHA256_DIGEST_SIZE) ? total_size : (DATAIN_NEW - B5_SHA256_DIGEST_SIZE);
-				}
-				enc_size += curr_len; // increment counter of encrypted data
-			} while(total_size > 0);
-			if((total_size_copy != enc_size) && (total_size_copy != (enc_size - 32))){
-				throw encryptExc; // throw exception if total encoded size is different from the original size (include also signature case with AES-HMAC-SHA256)
-			}
-		} else {
-			curr_chunk = total_size < L1Crypto::UpdateSize::DATAIN ? total_size : L1Crypto::UpdateSize::DATAIN; // by default computed for simple AES
-			if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){
-				ciphertext.reset();
-				ciphertext = make_unique<uint8_t[]>(total_size+B5_SHA256_DIGEST_SIZE); // reassign including signature
-				curr_chunk = total_size < (L1Crypto::UpdateSize::DATAIN - B5_SHA256_DIGEST_SIZE) ? total_size : (L1Crypto::UpdateSize::DATAIN - B5_SHA256_DIGEST_SIZE); // recomputed including signature
-				uint8_t nonce_key_derivation_hmac_sha256[32]; // nonce to derive (with pbdkf2) the key used to authenticate the digest with HMAC-SHA256
-				memset(nonce_key_derivation_hmac_sha256, 0, 32);
-				L0Support::Se3Rand(32, nonce_key_derivation_hmac_sha256); // fill nonce with random bytes
-				L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::SETNONCE, 32, nonce_key_derivation_hmac_sha256, 0, nullptr, nullptr, nullptr); // set nonce for HMAC-SHA256 key derivation
-				for(int i=0; i<32; i++){ // copy nonce to L1Ciphertext object
-					encrypted_data.digest_nonce.at(i) = nonce_key_derivation_hmac_sha256[i];
-				}
-			}
-			if((algorithm_mode == CryptoInitialisation::Modes::CBC) ||
-			   (algorithm_mode == CryptoInitialisation::Modes::CFB) ||
-			   (algorithm_mode == CryptoInitialisation::Modes::OFB)){
-				uint8_t aes_initialization_vector[B5_AES_BLK_SIZE]; // initialization vector
-				memset(aes_initialization_vector, 0, B5_AES_BLK_SIZE);
-				L0Support::Se3Rand(B5_AES_BLK_SIZE, aes_initialization_vector); // fill IV with random bytes
-				L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::SET_IV, B5_AES_BLK_SIZE, aes_initialization_vector, 0, nullptr, nullptr, nullptr); // set IV
-				for(int i=0; i<B5_AES_BLK_SIZE; i++){ // copy IV to L1Ciphertext object
-					encrypted_data.initialization_vector.at(i) = aes_initialization_vector[i];
-				}
-			}
-			uint8_t *decrypted = plaintext_padded.get(); // alias for plaintext
-			uint8_t *encrypted = ciphertext.get(); // alias for ciphertext
-			do {
-				if(total_size - curr_chunk){ // still in the middle of data
-					if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){ // AES with HMAC-SHA256
-						L1CryptoUpdate(encSessId, 0, 0, nullptr, curr_chunk, decrypted, &curr_len, encrypted);
-					} else { // standard AES without HMAC-SHA256
-						L1CryptoUpdate(encSessId, 0, 0, nullptr, curr_chunk, decrypted, &curr_len, encrypted);
-					}
-				}
-				else{ // last chunk of data
-					if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){ // AES with HMAC-SHA256
-						L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::RESET | L1Crypto::UpdateFlags::AUTH | L1Crypto::UpdateFlags::FINIT, 0, nullptr, curr_chunk, decrypted, &curr_len, encrypted);
-					} else { // standard AES without HMAC-SHA256
-						L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::FINIT, 0, nullptr, curr_chunk, decrypted, &curr_len, encrypted);
-					}
-				}
-				total_size -= curr_chunk; // decrement total number of bytes
-				decrypted += curr_chunk; // move on pointer of plaintext
-				encrypted += curr_chunk; // move on pointer of ciphertext
-				curr_chunk = total_size < L1Crypto::UpdateSize::DATAIN ? total_size : L1Crypto::UpdateSize::DATAIN; // next chunk of data
-				if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){ // recomputed including signature
-					curr_chunk = total_size < (L1Crypto::UpdateSize::DATAIN - B5_SHA256_DIGEST_SIZE) ? total_size : (L1Crypto::UpdateSize::DATAIN - B5_SHA256_DIGEST_SIZE);
-				}
-				enc_size += curr_len; // increment counter of encrypted data
-			} while(total_size > 0);
-			if((total_size_copy != enc_size) && (total_size_copy != (enc_size - 32))){
-				throw encryptExc; // throw exception if total encoded size is different from the original size (include also signature case with AES-HMAC-SHA256)
-			}
+			L0Support::Se3Rand(B5_AES_BLK_SIZE, ctx.ctr_nonce.data()); // fill nonce with random bytes
+			memcpy(ctx.ctr_nonce.data()+8, &ctx.ctr_counter, 8);
+			encrypted_data.CTR_nonce = ctx.ctr_nonce; // copy ctr_nonce to L1Ciphertext object
 		}
-
-		// encryption is done, copy data into L1Ciphertext object
-		encrypted_data.ciphertext = make_unique<uint8_t[]>(total_size_copy);
-		memcpy(encrypted_data.ciphertext.get(), ciphertext.get(), total_size_copy); // copy encrypted data
-		encrypted_data.ciphertext_size = total_size_copy; // copy encrypted data size
 		if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){
-			for(int i=0; i<B5_SHA256_DIGEST_SIZE; i++){
-				encrypted_data.digest.at(i) = ciphertext[i+total_size_copy]; // copy AES-HMAC-SHA256 digest
+			L0Support::Se3Rand(B5_SHA256_DIGEST_SIZE, encrypted_data.digest_nonce.data()); // nonce to derive (with pbdkf2) the key used to authenticate the digest with HMAC-SHA256
+			L1CryptoUpdate(ctx.sessId, L1Crypto::UpdateFlags::SETNONCE, B5_SHA256_DIGEST_SIZE, encrypted_data.digest_nonce.data(), 0, nullptr, nullptr, nullptr); // set nonce for HMAC-SHA256 key derivation
+		}
+		if((algorithm_mode == CryptoInitialisation::Modes::CBC) ||
+		   (algorithm_mode == CryptoInitialisation::Modes::CFB) ||
+		   (algorithm_mode == CryptoInitialisation::Modes::OFB)){
+			L0Support::Se3Rand(B5_AES_BLK_SIZE, encrypted_data.initialization_vector.data()); // fill IV with random bytes
+			L1CryptoUpdate(ctx.sessId, L1Crypto::UpdateFlags::SET_IV, B5_AES_BLK_SIZE, encrypted_data.initialization_vector.data(), 0, nullptr, nullptr, nullptr); // set IV
+		}
+	}
+	catch (L1Exception& e) {
+		L1EncryptAbort(ctx);
+		throw encryptExc;
+	}
+}
+
+void L1::L1EncryptUpdate(SEcube_crypto_context& ctx, size_t input_size, const uint8_t* input_data, uint8_t* output_data, size_t& output_size) {
+	L1EncryptException encryptExc;
+	output_size = 0;
+	if(!ctx.active){
+		throw encryptExc;
+	}
+	if((input_size > 0) && ((input_data == nullptr) || (output_data == nullptr))){
+		L1EncryptAbort(ctx);
+		throw encryptExc;
+	}
+	try {
+		/* full chunks are sent as soon as they are available, L1EncryptFinal() always has at least the padding to send */
+		while(input_size > 0){
+			if((ctx.buffered == 0) && (input_size >= ctx.chunk)){ // nothing buffered, send straight from the input
+				CryptoStreamChunk(ctx, const_cast<uint8_t*>(input_data), ctx.chunk, false, output_data + output_size);
+				input_data += ctx.chunk;
+				input_size -= ctx.chunk;
+				output_size += ctx.chunk;
+				continue;
+			}
+			size_t n = (input_size < (ctx.chunk - ctx.buffered)) ? input_size : (ctx.chunk - ctx.buffered);
+			memcpy(ctx.buffer.data() + ctx.buffered, input_data, n);
+			ctx.buffered += n;
+			input_data += n;
+			input_size -= n;
+			if(ctx.buffered == ctx.chunk){
+				CryptoStreamChunk(ctx, ctx.buffer.data(), ctx.chunk, false, output_data + output_size);
+				output_size += ctx.chunk;
+				ctx.buffered = 0;
 			}
 		}
 	}
 	catch (L1Exception& e) {
+		L1EncryptAbort(ctx);
 		throw encryptExc;
 	}
+	ctx.processed += output_size;
 }
 
-void L1::L1Decrypt(SEcube_ciphertext& encrypted_data, size_t& plaintext_size, std::shared_ptr<uint8_t[]>& plaintext) {
+void L1::L1EncryptFinal(SEcube_crypto_context& ctx, SEcube_ciphertext& encrypted_data, uint8_t* output_data, size_t& output_size) {
+	L1EncryptException encryptExc;
+	output_size = 0;
+	if(!ctx.active){
+		throw encryptExc;
+	}
+	if(output_data == nullptr){
+		L1EncryptAbort(ctx);
+		throw encryptExc;
+	}
+	uint8_t padding = (B5_AES_BLK_SIZE - (ctx.buffered % B5_AES_BLK_SIZE)); // PKCS#7 padding, the chunk size is a multiple of the block size so it always fits
+	memset(ctx.buffer.data() + ctx.buffered, padding, padding);
+	ctx.buffered += padding;
+	try {
+		CryptoStreamChunk(ctx, ctx.buffer.data(), ctx.buffered, true, ctx.buffer.data()); // the response is written back in the buffer
+	}
+	catch (L1Exception& e) {
+		L1EncryptAbort(ctx);
+		throw encryptExc;
+	}
+	ctx.active = false; // FINIT closed the session
+	memcpy(output_data, ctx.buffer.data(), ctx.buffered);
+	if(ctx.algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){
+		memcpy(encrypted_data.digest.data(), ctx.buffer.data() + ctx.buffered, B5_SHA256_DIGEST_SIZE); // copy AES-HMAC-SHA256 digest
+	}
+	output_size = ctx.buffered;
+	ctx.processed += ctx.buffered;
+	encrypted_data.ciphertext_size = ctx.processed;
+	ctx.buffered = 0;
+}
+
+void L1::L1DecryptInit(SEcube_ciphertext& encrypted_data, SEcube_crypto_context& ctx) {
 	L1DecryptException decryptExc;
 	uint16_t algorithm = encrypted_data.algorithm;
 	uint16_t algorithm_mode = encrypted_data.mode;
-	uint32_t key_id = encrypted_data.key_id;
 	if((algorithm == L1Algorithms::Algorithms::HMACSHA256) || (algorithm == L1Algorithms::Algorithms::SHA256)){
 		throw std::invalid_argument("Cannot call L1Decrypt with digest algorithms. Call L1Digest instead.");
 	}
@@ -307,195 +352,257 @@ void L1::L1Decrypt(SEcube_ciphertext& encrypted_data, size_t& plaintext_size, st
 	   (algorithm_mode != CryptoInitialisation::Modes::CFB)){
 		throw std::invalid_argument("Invalid algorithm mode.");
 	}
-	uint32_t encSessId = 0; // crypto session identifier on the SEcube
-	uint16_t curr_len = 0; // how many bytes have been processed by the latest cryptoupdate() call
-	size_t curr_chunk = 0; // dimension (bytes) of current portion of data to be decrypted
-	uint64_t dec_size = 0; // counter of how many bytes are decrypted
-	size_t enc_size = encrypted_data.ciphertext_size; // here we will store a copy of the size of the ciphertext
-	unique_ptr<uint8_t[]> decrypted_data; // here we will store the decrypted data
+	ctx.active = false;
+	ctx.algorithm = algorithm;
+	ctx.mode = algorithm_mode;
+	ctx.buffered = 0;
+	ctx.processed = 0;
+	ctx.ctr_counter = 0;
+	ctx.chunk = L1Crypto::UpdateSize::DATAIN;
+	if(algorithm_mode == CryptoInitialisation::Modes::CTR){
+		ctx.chunk -= B5_AES_BLK_SIZE; // in CTR mode the nonce is sent together with each chunk
+	}
+	if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){
+		ctx.chunk -= B5_SHA256_DIGEST_SIZE; // room for the signature in the response to the last chunk
+	}
+	ctx.owner = this;
+	ctx.direction = CryptoInitialisation::Direction::DECRYPT;
 	try {
-		L1CryptoInit(algorithm, algorithm_mode | CryptoInitialisation::Direction::DECRYPT, key_id, encSessId);
-		decrypted_data  = make_unique<uint8_t[]>(encrypted_data.ciphertext_size); // by default allocated for simple AES
+		L1CryptoInit(algorithm, algorithm_mode | CryptoInitialisation::Direction::DECRYPT, encrypted_data.key_id, ctx.sessId);
+		ctx.active = true; // the session is open, L1DecryptAbort() closes it if it cannot be set up
 		if(algorithm_mode == CryptoInitialisation::Modes::CTR){
-			enum{
-				/* we need this new value because, in some cases, the L1CryptoUpdate will be called passing both the cleartext and the nonce,
-				 * so we have to consider also the size of the nonce when sending the cryptoupdate. */
-				DATAIN_NEW = L1Crypto::UpdateSize::DATAIN - B5_AES_BLK_SIZE
-			};
-			curr_chunk = encrypted_data.ciphertext_size < DATAIN_NEW ? encrypted_data.ciphertext_size : DATAIN_NEW; // by default computed for simple AES
-			uint8_t ctr_nonce[B5_AES_BLK_SIZE]; // nonce required by AES-CTR (it is combined with the counter)
-			memcpy(ctr_nonce, encrypted_data.CTR_nonce.data(), B5_AES_BLK_SIZE);
-			uint64_t ctr_counter = 0;
-			memcpy(ctr_nonce+8, &ctr_counter, 8); // nonce is made of first 64 bits that are fixed (actual nonce) and last 64 bits that are the counter
-			// NONCE -> 64 random bits (real nonce) concatenated 64 bits (counter)
-			// NONCE: uint64_t counter allows for 2^64 * 16 bytes of data...plenty enough
-			if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){ // AES + HMAC-SHA256
-				decrypted_data.reset();
-				decrypted_data = make_unique<uint8_t[]>(encrypted_data.ciphertext_size+B5_SHA256_DIGEST_SIZE); // reassign including signature
-				curr_chunk = encrypted_data.ciphertext_size < (DATAIN_NEW - B5_SHA256_DIGEST_SIZE) ? encrypted_data.ciphertext_size : (DATAIN_NEW - B5_SHA256_DIGEST_SIZE); // recomputed including signature
-				L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::SETNONCE, 32, encrypted_data.digest_nonce.data(), 0, nullptr, nullptr, nullptr); // set nonce for HMAC-SHA256 key derivation
-			}
-			uint8_t *decrypted = decrypted_data.get(); // alias for plaintext
-			uint8_t *encrypted = encrypted_data.ciphertext.get(); // alias for ciphertext
-			do {
-				if(enc_size - curr_chunk){ // still in the middle of data
-					if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){ // AES with HMAC-SHA256
-						L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::RESET, B5_AES_BLK_SIZE, ctr_nonce, curr_chunk, encrypted, &curr_len, decrypted);
-					} else { // standard AES without HMAC-SHA256
-						L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::RESET, B5_AES_BLK_SIZE, ctr_nonce, curr_chunk, encrypted, &curr_len, decrypted);
-					}
-				}
-				else{ // last chunk of data
-					if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){ // AES with HMAC-SHA256
-						L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::RESET | L1Crypto::UpdateFlags::AUTH | L1Crypto::UpdateFlags::FINIT, B5_AES_BLK_SIZE, ctr_nonce, curr_chunk, encrypted, &curr_len, decrypted);
-					} else { // standard AES without HMAC-SHA256
-						L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::FINIT, B5_AES_BLK_SIZE, ctr_nonce, curr_chunk, encrypted, &curr_len, decrypted);
-					}
-				}
-				ctr_counter++; // increment counter and concatenate it with the nonce
-				memcpy(ctr_nonce+8, &ctr_counter, 8);
-				enc_size -= curr_chunk; // decrement total number of bytes
-				decrypted += curr_chunk; // move on pointer of plaintext
-				encrypted += curr_chunk; // move on pointer of ciphertext
-				curr_chunk = enc_size < DATAIN_NEW ? enc_size : DATAIN_NEW; // next chunk of data
-				if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){ // recomputed including signature
-					curr_chunk = enc_size < (DATAIN_NEW - B5_SHA256_DIGEST_SIZE) ? enc_size : (DATAIN_NEW - B5_SHA256_DIGEST_SIZE);
-				}
-				dec_size += curr_len; // increment counter of encrypted data
-			} while(enc_size > 0);
-		} else {
-			curr_chunk = encrypted_data.ciphertext_size < L1Crypto::UpdateSize::DATAIN ? encrypted_data.ciphertext_size : L1Crypto::UpdateSize::DATAIN; // by default computed for simple AES
-			if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){
-				decrypted_data.reset();
-				decrypted_data = make_unique<uint8_t[]>(encrypted_data.ciphertext_size+B5_SHA256_DIGEST_SIZE); // reassign including signature
-				curr_chunk = encrypted_data.ciphertext_size < (L1Crypto::UpdateSize::DATAIN - B5_SHA256_DIGEST_SIZE) ? encrypted_data.ciphertext_size : (L1Crypto::UpdateSize::DATAIN - B5_SHA256_DIGEST_SIZE); // recomputed including signature
-				L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::SETNONCE, 32, encrypted_data.digest_nonce.data(), 0, nullptr, nullptr, nullptr); // set nonce for HMAC-SHA256 key derivation
-			}
-			if((algorithm_mode == CryptoInitialisation::Modes::CBC) ||
-			   (algorithm_mode == CryptoInitialisation::Modes::CFB) ||
-			   (algorithm_mode == CryptoInitialisation::Modes::OFB)){
-				L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::SET_IV, B5_AES_BLK_SIZE, encrypted_data.initialization_vector.data(), 0, nullptr, nullptr, nullptr); // set IV
-			}
-			uint8_t *decrypted = decrypted_data.get(); // alias for plaintext
-			uint8_t *encrypted = encrypted_data.ciphertext.get(); // alias for ciphertext
-			do {
-				if(enc_size - curr_chunk){ // still in the middle of data
-					if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){ // AES with HMAC-SHA256
-						L1CryptoUpdate(encSessId, 0, 0, nullptr, curr_chunk, encrypted, &curr_len, decrypted);
-					} else { // standard AES without HMAC-SHA256
-						L1CryptoUpdate(encSessId, 0, 0, nullptr, curr_chunk, encrypted, &curr_len, decrypted);
-					}
-				}
-				else{ // last chunk of data
-					if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){ // AES with HMAC-SHA256
-						L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::RESET | L1Crypto::UpdateFlags::AUTH | L1Crypto::UpdateFlags::FINIT, 0, nullptr, curr_chunk, encrypted, &curr_len, decrypted);
-					} else { // standard AES without HMAC-SHA256
-						L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::FINIT, 0, nullptr, curr_chunk, encrypted, &curr_len, decrypted);
-					}
-				}
-				enc_size -= curr_chunk; // decrement total number of bytes
-				decrypted += curr_chunk; // move on pointer of plaintext
-				encrypted += curr_chunk; // move on pointer of ciphertext
-				curr_chunk = enc_size < L1Crypto::UpdateSize::DATAIN ? enc_size : L1Crypto::UpdateSize::DATAIN; // next chunk of data
-				if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){ // recomputed including signature
-					curr_chunk = enc_size < (L1Crypto::UpdateSize::DATAIN - B5_SHA256_DIGEST_SIZE) ? enc_size : (L1Crypto::UpdateSize::DATAIN - B5_SHA256_DIGEST_SIZE);
-				}
-				dec_size += curr_len; // increment counter of decrypted data
-			} while(enc_size > 0);
+			ctx.ctr_nonce = encrypted_data.CTR_nonce;
 		}
-		if((encrypted_data.ciphertext_size != dec_size) && (encrypted_data.ciphertext_size != (dec_size - 32))){
-			throw decryptExc; // throw exception if total decrypted size is different from the original size (include also signature case with AES-HMAC-SHA256)
+		if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){
+			L1CryptoUpdate(ctx.sessId, L1Crypto::UpdateFlags::SETNONCE, B5_SHA256_DIGEST_SIZE, encrypted_data.digest_nonce.data(), 0, nullptr, nullptr, nullptr); // set nonce for HMAC-SHA256 key derivation
 		}
-		uint8_t padding_size = 0;
-		uint64_t decrypted_size = dec_size;
-		if(algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){ // check signature
-			L1DataIntegrityException exc;
-			int r = memcmp(encrypted_data.digest.data(), decrypted_data.get()+dec_size-B5_SHA256_DIGEST_SIZE, B5_SHA256_DIGEST_SIZE);
-#ifdef SIGNATURE_DEBUG
-			cout << "\n\nSignature attached to ciphertext:" << endl;
-			for(uint8_t val : encrypted_data.digest){
-				printf("%02x ", val);
-			}
-			cout << "\n\nSignature recomputed on decrypted data:" << endl;
-			for(int i=0; i<B5_SHA256_DIGEST_SIZE; i++){
-				printf("%02x ", decrypted_data[dec_size-B5_SHA256_DIGEST_SIZE+i]); // signature is at the end
-			}
-			if(r){
-				cout << "\nsignatures do not match!" << endl;
-			} else {
-				cout << "\nsignatures match!" << endl;
+		if((algorithm_mode == CryptoInitialisation::Modes::CBC) ||
+		   (algorithm_mode == CryptoInitialisation::Modes::CFB) ||
+		   (algorithm_mode == CryptoInitialisation::Modes::OFB)){
+			L1CryptoUpdate(ctx.sessId, L1Crypto::UpdateFlags::SET_IV, B5_AES_BLK_SIZE, encrypted_data.initialization_vector.data(), 0, nullptr, nullptr, nullptr); // set IV
+		}
+	}
+	catch (L1Exception& e) {
+		L1DecryptAbort(ctx);
+		throw decryptExc;
+	}
+}
+
+void L1::L1DecryptUpdate(SEcube_crypto_context& ctx, size_t input_size, const uint8_t* input_data, uint8_t* output_data, size_t& output_size) {
+	L1DecryptException decryptExc;
+	output_size = 0;
+	if(!ctx.active){
+		throw decryptExc;
+	}
+	if((input_size > 0) && ((input_data == nullptr) || (output_data == nullptr))){
+		L1DecryptAbort(ctx);
+		throw decryptExc;
+	}
+	try {
+		/* full chunks are sent only when more data follows them, the last one (with the padding) is left to L1DecryptFinal() */
+		while(input_size > 0){
+			if(ctx.buffered == ctx.chunk){
+				CryptoStreamChunk(ctx, ctx.buffer.data(), ctx.chunk, false, output_data + output_size);
+				output_size += ctx.chunk;
+				ctx.buffered = 0;
 			}
-#endif
-			if(r){ // signature does not match
-				throw exc;
+			if((ctx.buffered == 0) && (input_size > ctx.chunk)){ // nothing buffered, send straight from the input
+				CryptoStreamChunk(ctx, const_cast<uint8_t*>(input_data), ctx.chunk, false, output_data + output_size);
+				input_data += ctx.chunk;
+				input_size -= ctx.chunk;
+				output_size += ctx.chunk;
+				continue;
 			}
-			padding_size = decrypted_data[dec_size-B5_SHA256_DIGEST_SIZE-1];
-			decrypted_size -= (padding_size + B5_SHA256_DIGEST_SIZE);
+			size_t n = (input_size < (ctx.chunk - ctx.buffered)) ? input_size : (ctx.chunk - ctx.buffered);
+			memcpy(ctx.buffer.data() + ctx.buffered, input_data, n);
+			ctx.buffered += n;
+			input_data += n;
+			input_size -= n;
+		}
+	}
+	catch (L1Exception& e) {
+		L1DecryptAbort(ctx);
+		throw decryptExc;
+	}
+	ctx.processed += output_size;
+}
+
+void L1::L1DecryptFinal(SEcube_crypto_context& ctx, SEcube_ciphertext& encrypted_data, uint8_t* output_data, size_t& output_size) {
+	L1DecryptException decryptExc;
+	output_size = 0;
+	if(!ctx.active){
+		throw decryptExc;
+	}
+	if((output_data == nullptr) || (ctx.buffered == 0) || (ctx.buffered % B5_AES_BLK_SIZE)){
+		L1DecryptAbort(ctx);
+		throw decryptExc; // the ciphertext is made of whole blocks, at least the one with the padding
+	}
+	try {
+		CryptoStreamChunk(ctx, ctx.buffer.data(), ctx.buffered, true, ctx.buffer.data()); // the response is written back in the buffer
+	}
+	catch (L1Exception& e) {
+		L1DecryptAbort(ctx);
+		throw decryptExc;
+	}
+	ctx.active = false; // FINIT closed the session
+	if(ctx.algorithm == L1Algorithms::Algorithms::AES_HMACSHA256){ // check signature
+		L1DataIntegrityException exc;
+		int r = memcmp(encrypted_data.digest.data(), ctx.buffer.data() + ctx.buffered, B5_SHA256_DIGEST_SIZE);
+#ifdef SIGNATURE_DEBUG
+		cout << "\n\nSignature attached to ciphertext:" << endl;
+		for(uint8_t val : encrypted_data.digest){
+			printf("%02x ", val);
+		}
+		cout << "\n\nSignature recomputed on decrypted data:" << endl;
+		for(int i=0; i<B5_SHA256_DIGEST_SIZE; i++){
+			printf("%02x ", ctx.buffer[ctx.buffered+i]); // signature is at the end
+		}
+		if(r){
+			cout << "\nsignatures do not match!" << endl;
 		} else {
-			padding_size = decrypted_data[dec_size-1];
-			decrypted_size -= padding_size;
+			cout << "\nsignatures match!" << endl;
+		}
+#endif
+		if(r){ // signature does not match
+			ctx.buffered = 0;
+			throw exc;
 		}
-		shared_ptr<uint8_t[]> tmp(new uint8_t[decrypted_size]);
-		memcpy(tmp.get(), decrypted_data.get(), decrypted_size);
-		plaintext_size = decrypted_size;
-		plaintext.swap(tmp);
 	}
-	catch(L1Exception& e) {
+	uint8_t padding_size = ctx.buffer[ctx.buffered-1];
+	if((padding_size == 0) || (padding_size > B5_AES_BLK_SIZE)){
+		ctx.buffered = 0;
 		throw decryptExc;
 	}
+	output_size = ctx.buffered - padding_size;
+	memcpy(output_data, ctx.buffer.data(), output_size);
+	ctx.processed += output_size;
+	ctx.buffered = 0;
 }
 
 void L1::L1Digest(size_t input_size, std::shared_ptr<uint8_t[]> input_data, SEcube_digest& digest) {
+	L1DigestException digestExc;
+	SEcube_digest_context ctx;
+	try {
+		L1DigestInit(digest, ctx);
+		L1DigestUpdate(ctx, input_size, input_data.get());
+		L1DigestFinal(ctx, digest);
+	}
+	catch (L1Exception& e) {
+		throw digestExc;
+	}
+}
+
+void L1::DigestAbort(SEcube_digest_context& ctx) {
+	// FINIT releases the crypto session on the SEcube, the digest is discarded and errors are ignored since the caller is already failing
+	ctx.active = false;
+	ctx.buffered = 0;
+	try {
+		L1CryptoUpdate(ctx.sessId, L1Crypto::UpdateFlags::FINIT, 0, nullptr, 0, nullptr, nullptr, nullptr);
+	}
+	catch (...) {
+	}
+}
+
+void L1::L1DigestInit(SEcube_digest& digest, SEcube_digest_context& ctx) {
 	L1DigestException digestExc;
 	if(((digest.algorithm != L1Algorithms::Algorithms::HMACSHA256) && (digest.algorithm != L1Algorithms::Algorithms::SHA256))){
 		throw digestExc;
 	}
-	uint32_t encSessId = 0;
-	std::unique_ptr<uint8_t[]> output_data = make_unique<uint8_t[]>(32);
-	uint8_t *input = input_data.get(); // alias for input data
-	uint8_t *output = output_data.get(); // alias for digest
+	ctx.active = false;
+	ctx.buffered = 0;
 	try {
 		switch(digest.algorithm){
 			case L1Algorithms::Algorithms::HMACSHA256:
-				L1CryptoInit(digest.algorithm, 0, digest.key_id, encSessId);
+				L1CryptoInit(digest.algorithm, 0, digest.key_id, ctx.sessId);
+				ctx.active = true; // the session is open, DigestAbort() closes it if the nonce cannot be set
 				if(digest.usenonce){
-					L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::SETNONCE, 32, digest.digest_nonce.data(), 0, nullptr, nullptr, nullptr);
+					L1CryptoUpdate(ctx.sessId, L1Crypto::UpdateFlags::SETNONCE, 32, digest.digest_nonce.data(), 0, nullptr, nullptr, nullptr);
 				} else {
 					uint8_t nonce_key_derivation_hmac_sha256[32];
 					memset(nonce_key_derivation_hmac_sha256, 0, 32);
 					L0Support::Se3Rand(32, nonce_key_derivation_hmac_sha256);
-					L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::SETNONCE, 32, nonce_key_derivation_hmac_sha256, 0, nullptr, nullptr, nullptr);
+					L1CryptoUpdate(ctx.sessId, L1Crypto::UpdateFlags::SETNONCE, 32, nonce_key_derivation_hmac_sha256, 0, nullptr, nullptr, nullptr);
 					for(int i=0; i<32; i++){ // copy nonce to Digest object
 						digest.digest_nonce.at(i) = nonce_key_derivation_hmac_sha256[i];
 					}
 				}
 				break;
 			case L1Algorithms::Algorithms::SHA256:
-				L1CryptoInit(digest.algorithm, 0, L1Key::Id::NULL_ID, encSessId);
+				L1CryptoInit(digest.algorithm, 0, L1Key::Id::NULL_ID, ctx.sessId);
 				break;
 			default:
 				throw digestExc;
 		}
-		size_t curr_chunk = input_size < (L1Crypto::UpdateSize::DATAIN - B5_SHA256_DIGEST_SIZE) ? input_size : (L1Crypto::UpdateSize::DATAIN - B5_SHA256_DIGEST_SIZE);
-		uint16_t curr_len = 0;
-		do {
-			if(input_size - curr_chunk){ // still in the middle of data
-				L1CryptoUpdate(encSessId, 0, curr_chunk, input, 0, nullptr, &curr_len, output);
+	}
+	catch (L1Exception& e) {
+		if(ctx.active){
+			DigestAbort(ctx);
+		}
+		throw digestExc;
+	}
+	ctx.active = true;
+}
+
+void L1::L1DigestUpdate(SEcube_digest_context& ctx, size_t input_size, const uint8_t* input_data) {
+	L1DigestException digestExc;
+	const size_t chunk = ctx.buffer.size();
+	if(!ctx.active){
+		throw digestExc;
+	}
+	if((input_size > 0) && (input_data == nullptr)){
+		DigestAbort(ctx);
+		throw digestExc;
+	}
+	try {
+		/* Full chunks are sent only when more data follows them, so that the last one (empty only if there is no
+		 * data at all) is left to L1DigestFinal(). Chunks are sent straight from the input when nothing is buffered. */
+		while(input_size > 0){
+			if(ctx.buffered == chunk){
+				L1CryptoUpdate(ctx.sessId, 0, chunk, ctx.buffer.data(), 0, nullptr, nullptr, nullptr);
+				ctx.buffered = 0;
 			}
-			else{ // last chunk of data
-				L1CryptoUpdate(encSessId, L1Crypto::UpdateFlags::FINIT, curr_chunk, input, 0, nullptr, &curr_len, output);
+			if((ctx.buffered == 0) && (input_size > chunk)){
+				L1CryptoUpdate(ctx.sessId, 0, chunk, const_cast<uint8_t*>(input_data), 0, nullptr, nullptr, nullptr);
+				input_data += chunk;
+				input_size -= chunk;
+				continue;
 			}
-			input_size -= curr_chunk;
-			input += curr_chunk;
-			curr_chunk = input_size < (L1Crypto::UpdateSize::DATAIN - B5_SHA256_DIGEST_SIZE) ? input_size : (L1Crypto::UpdateSize::DATAIN - B5_SHA256_DIGEST_SIZE);
-		} while(input_size > 0);
-		for(int i=0; i<32; i++){ // copy the digest
-			digest.digest[i] = output_data[i];
+			size_t n = (input_size < (chunk - ctx.buffered)) ? input_size : (chunk - ctx.buffered);
+			memcpy(ctx.buffer.data() + ctx.buffered, input_data, n);
+			ctx.buffered += n;
+			input_data += n;
+			input_size -= n;
 		}
 	}
 	catch (L1Exception& e) {
+		DigestAbort(ctx);
+		throw digestExc;
+	}
+}
+
+void L1::L1DigestFinal(SEcube_digest_context& ctx, SEcube_digest& digest) {
+	L1DigestException digestExc;
+	if(!ctx.active){
+		throw digestExc;
+	}
+	ctx.active = false;
+	uint8_t output[L1Crypto::UpdateSize::DATAOUT];
+	uint16_t curr_len = 0;
+	try {
+		// with no data at all this is a 0 byte FINIT, which returns the digest of the empty input
+		L1CryptoUpdate(ctx.sessId, L1Crypto::UpdateFlags::FINIT, ctx.buffered, ctx.buffer.data(), 0, nullptr, &curr_len, output);
+	}
+	catch (L1Exception& e) {
+		DigestAbort(ctx);
 		throw digestExc;
 	}
+	ctx.buffered = 0;
+	if(curr_len < B5_SHA256_DIGEST_SIZE){
+		throw digestExc;
+	}
+	for(int i=0; i<B5_SHA256_DIGEST_SIZE; i++){ // copy the digest
+		digest.digest[i] = output[i];
+	}
 }
 
 void L1::L1GetAlgorithms(std::vector<se3Algo>& algorithmsArray) {
@@ -0,0 +1,161 @@
+/**
+  ******************************************************************************
+  * File Name          : L1_multidevice.cpp
+  * Description        : Crypto operations striped across several SEcube devices.
+  ******************************************************************************
+  *
+  * Copyright � 2016-present Blu5 Group <https://www.blu5group.com>
+  *
+  * This library is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU Lesser General Public
+  * License as published by the Free Software Foundation; either
+  * version 3 of the License, or (at your option) any later version.
+  *
+  * This library is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  * Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+  *
+  ******************************************************************************
+  */
+
+/**
+ * @file	L1_multidevice.cpp
+ * @date	October, 2026
+ * @brief	Implementation of the L1MultiDevice library.
+ * @version SEcube Open Source SDK 1.5.1
+ */
+
+#include "L1_multidevice.h"
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+L1MultiDevice::~L1MultiDevice() {
+	Close();
+}
+
+size_t L1MultiDevice::Open(const array<uint8_t, L1Parameters::Size::PIN>& pin, se3_access_type access, uint32_t keyId) {
+	L1MultiDeviceException multiExc;
+	L0 l0;
+	Close();
+	uint8_t numdevices = l0.GetNumberDevices();
+	for (uint8_t i = 0; i < numdevices; i++) {
+		try {
+			unique_ptr<L1> l1 = make_unique<L1>(i); // L1 for a specific SEcube, with its own session
+			bool found = false;
+			l1->L1Login(pin, access, true);
+			l1->L1FindKey(keyId, found);
+			if (found) {
+				this->devices.push_back(move(l1));
+			}
+		} catch (...) {
+			// busy device, wrong PIN or communication error: the other devices can still be used
+		}
+	}
+	if (this->devices.empty()) {
+		throw multiExc;
+	}
+	return this->devices.size();
+}
+
+void L1MultiDevice::Close() {
+	this->devices.clear(); // ~L1() logs out and closes the device
+}
+
+size_t L1MultiDevice::GetNumberDevices() {
+	return this->devices.size();
+}
+
+L1* L1MultiDevice::GetDevice(size_t indx) {
+	return (indx < this->devices.size()) ? this->devices[indx].get() : NULL;
+}
+
+void L1MultiDevice::Run(size_t nJobs, const function<void(L1*, size_t)>& job) {
+	L1MultiDeviceException multiExc;
+	if (this->devices.empty()) {
+		throw multiExc;
+	}
+	atomic<size_t> next(0);
+	exception_ptr error = nullptr;
+	mutex errorLock;
+	auto worker = [&](L1* l1) {
+		size_t i;
+		while ((i = next.fetch_add(1)) < nJobs) {
+			try {
+				job(l1, i);
+			} catch (...) {
+				lock_guard<mutex> guard(errorLock);
+				if (error == nullptr) {
+					error = current_exception();
+				}
+				next = nJobs; // the other threads stop after their current job
+				return;
+			}
+		}
+	};
+	size_t nThreads = (nJobs < this->devices.size()) ? nJobs : this->devices.size();
+	vector<thread> threads;
+	for (size_t d = 1; d < nThreads; d++) {
+		threads.emplace_back(worker, this->devices[d].get());
+	}
+	worker(this->devices[0].get());
+	for (thread& t : threads) {
+		t.join();
+	}
+	if (error != nullptr) {
+		rethrow_exception(error);
+	}
+}
+
+void L1MultiDevice::Encrypt(size_t plaintext_size, shared_ptr<uint8_t[]> plaintext, vector<SEcube_ciphertext>& encrypted_data,
+		uint16_t algorithm, uint16_t algorithm_mode, uint32_t key_id, size_t chunk_size) {
+	L1EncryptException encryptExc;
+	if (plaintext == nullptr || chunk_size == 0) {
+		throw encryptExc;
+	}
+	size_t nChunks = (plaintext_size + chunk_size - 1) / chunk_size;
+	if (nChunks == 0) {
+		nChunks = 1; // empty plaintext, still one ciphertext made of padding only
+	}
+	encrypted_data.clear();
+	encrypted_data.resize(nChunks);
+	Run(nChunks, [&](L1* l1, size_t i) {
+		size_t offset = i * chunk_size;
+		size_t len = (plaintext_size - offset < chunk_size) ? (plaintext_size - offset) : chunk_size;
+		shared_ptr<uint8_t[]> chunk(plaintext, plaintext.get() + offset); // no copy, shares the ownership of plaintext
+		l1->L1Encrypt(len, chunk, encrypted_data[i], algorithm, algorithm_mode, key_id);
+	});
+}
+
+void L1MultiDevice::Decrypt(vector<SEcube_ciphertext>& encrypted_data, size_t& plaintext_size, shared_ptr<uint8_t[]>& plaintext) {
+	L1DecryptException decryptExc;
+	if (encrypted_data.empty()) {
+		throw decryptExc;
+	}
+	vector<shared_ptr<uint8_t[]>> chunks(encrypted_data.size());
+	vector<size_t> sizes(encrypted_data.size(), 0);
+	Run(encrypted_data.size(), [&](L1* l1, size_t i) {
+		l1->L1Decrypt(encrypted_data[i], sizes[i], chunks[i]);
+	});
+	size_t total = 0;
+	for (size_t s : sizes) {
+		total += s;
+	}
+	shared_ptr<uint8_t[]> result(new uint8_t[(total > 0) ? total : 1]);
+	size_t offset = 0;
+	for (size_t i = 0; i < chunks.size(); i++) {
+		if (sizes[i] > 0) {
+			memcpy(result.get() + offset, chunks[i].get(), sizes[i]);
+			offset += sizes[i];
+		}
+	}
+	plaintext = result;
+	plaintext_size = total;
+}
@@ -0,0 +1,95 @@
+/**
+  ******************************************************************************
+  * File Name          : L1_multidevice.h
+  * Description        : Prototypes of the L1MultiDevice library.
+  ******************************************************************************
+  *
+  * Copyright � 2016-present Blu5 Group <https://www.blu5group.com>
+  *
+  * This library is free software; you can redistribute it and/or
+  * modify it under the terms of the GNU Lesser General Public
+  * License as published by the Free Software Foundation; either
+  * version 3 of the License, or (at your option) any later version.
+  *
+  * This library is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  * Lesser General Public License for more details.
+  *
+  * You should have received a copy of the GNU Lesser General Public
+  * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+  *
+  ******************************************************************************
+  */
+
+/*! \file  L1_multidevice.h
+ *  \brief Prototypes of the L1MultiDevice library.
+ *  \version SEcube Open Source SDK 1.5.1
+ *
+ *  L1MultiDevice spreads bulk crypto work across all the SEcube devices attached to the host. Each device
+ *  gets its own L1 object (hence its own L1 session) and its own thread, the work is split into independent
+ *  jobs that the threads pull from a shared counter, so a slower device simply takes fewer jobs.
+ *  Encrypt() and Decrypt() stripe L1Encrypt() chunks; Run() can be used for any other kind of independent
+ *  work, for instance SEfile sectors (AES-CTR sectors are a function of their offset only).
+ *  Every device must store the key used for the operations (i.e. it has been distributed with SEkey).
+ */
+
+#ifndef _L1_MULTIDEVICE_H
+#define _L1_MULTIDEVICE_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "../L1.h"
+
+/** Default size of the plaintext encrypted by a single job of L1MultiDevice::Encrypt(). */
+#define SE3_MULTIDEVICE_CHUNK (64 * 1024)
+
+class L1MultiDevice {
+	private:
+		std::vector<std::unique_ptr<L1>> devices;
+	public:
+		L1MultiDevice() {};
+		L1MultiDevice(const L1MultiDevice&) = delete;
+		L1MultiDevice& operator=(const L1MultiDevice&) = delete;
+		~L1MultiDevice(); /**< Destructor. Logout from all the devices. */
+		/** @brief Open all the SEcube devices attached to the host that accept the PIN and store the key.
+		 * @param [in] pin The PIN of the devices.
+		 * @param [in] access Access level of the login (SE3_ACCESS_USER or SE3_ACCESS_ADMIN).
+		 * @param [in] keyId ID of the key that must be stored on the devices.
+		 * @return The number of devices that are used.
+		 * @details The devices that cannot be opened, that refuse the PIN or that do not store the key are skipped.
+		 * Throws exception if no device is left. */
+		size_t Open(const std::array<uint8_t, L1Parameters::Size::PIN>& pin, se3_access_type access, uint32_t keyId);
+		/** @brief Logout from all the devices and release them. */
+		void Close();
+		/** @brief Number of devices used by Run(). */
+		size_t GetNumberDevices();
+		/** @brief Get the L1 object of a device, NULL if indx is out of range. */
+		L1* GetDevice(size_t indx);
+		/** @brief Execute job(l1, i) for every i in [0, nJobs), spreading the jobs on all the devices.
+		 * @param [in] nJobs Number of jobs.
+		 * @param [in] job Function executed by the thread of the device l1. Jobs must be independent of each other.
+		 * @details Returns when all the jobs have been executed. If a job throws, the jobs not yet started are dropped
+		 * and the first exception is thrown again to the caller. The calling thread serves the first device. */
+		void Run(size_t nJobs, const std::function<void(L1*, size_t)>& job);
+		/** @brief Encrypt some data in chunks of chunk_size bytes, each chunk on one of the devices.
+		 * @param [in] plaintext_size The size of the data to be encrypted.
+		 * @param [in] plaintext The data to be encrypted.
+		 * @param [out] encrypted_data One SEcube_ciphertext for each chunk, in order (see L1Encrypt()).
+		 * @param [in] algorithm The algorithm to be used (L1Algorithms::Algorithms).
+		 * @param [in] algorithm_mode The mode of the algorithm (CryptoInitialisation::Modes).
+		 * @param [in] key_id The ID of the key, stored on all the devices.
+		 * @param [in] chunk_size The size of the chunks, it must be greater than 0.
+		 * @details Throws exception in case of errors. */
+		void Encrypt(size_t plaintext_size, std::shared_ptr<uint8_t[]> plaintext, std::vector<SEcube_ciphertext>& encrypted_data,
+				uint16_t algorithm, uint16_t algorithm_mode, uint32_t key_id, size_t chunk_size = SE3_MULTIDEVICE_CHUNK);
+		/** @brief Decrypt data that were encrypted by Encrypt(), each chunk on one of the devices.
+		 * @param [in] encrypted_data The chunks returned by Encrypt().
+		 * @param [out] plaintext_size The size of the decrypted data.
+		 * @param [out] plaintext The decrypted data.
+		 * @details Throws exception in case of errors. */
+		void Decrypt(std::vector<SEcube_ciphertext>& encrypted_data, size_t& plaintext_size, std::shared_ptr<uint8_t[]>& plaintext);
+};
+
+#endif
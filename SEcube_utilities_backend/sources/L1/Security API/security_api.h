@@ -32,6 +32,8 @@
 
 #include "../L1 Base/L1_base.h"
 
+class SecurityApi;
+
 /** This class is used to store the result of the L1Digest() API. It is required, in particular, when the algorithm used to
  *  generate the digest is HMAC-SHA256 because this algorithm requires the usage of a shared secret (a key) and a nonce (to avoid
  *  replay), hence the attributes of this class. If you simply want to compute the digest with SHA-256, then the nonce and
@@ -47,6 +49,19 @@ public:
 	computation. */
 };
 
+/** This class holds the state of a digest computed incrementally with L1DigestInit(), L1DigestUpdate() and L1DigestFinal(), so that
+ *  data which does not fit in RAM (i.e. a large file) can be processed in pieces of any size. The data is sent to the SEcube in chunks
+ *  as large as a CRYPTO_UPDATE request allows; the last chunk is kept in the buffer until L1DigestFinal(), which sends it together with
+ *  the request to finalize the digest. The user should not modify the attributes of this class. */
+class SEcube_digest_context{
+public:
+	uint32_t sessId; /**< The ID of the crypto session opened on the SEcube by L1DigestInit(). */
+	bool active; /**< True between L1DigestInit() and L1DigestFinal(). */
+	size_t buffered; /**< The number of bytes in the buffer, not yet sent to the SEcube. */
+	std::array<uint8_t, L1Crypto::UpdateSize::DATAIN - B5_SHA256_DIGEST_SIZE> buffer; /**< Data waiting to be sent, at most one CRYPTO_UPDATE chunk. */
+	SEcube_digest_context() : sessId(0), active(false), buffered(0) {}
+};
+
 /** This class implements a L1Ciphertext object, which is used exclusively by L1Encrypt() and L1Decrypt().
  *  For these APIs, a dedicated object is required because it is important to keep track of every detail of
  *  the crypto computation, for example which nonce or initialization vector was used. The user should not
@@ -66,6 +81,32 @@ public:
 	void reset(); /**< Reset the content of the L1Ciphertext object. */
 };
 
+/** This class holds the state of an encryption or decryption computed incrementally with L1EncryptInit(), L1EncryptUpdate() and
+ *  L1EncryptFinal() (or the L1Decrypt counterparts), so that data of any size can be processed in bounded memory, writing the result
+ *  directly in buffers provided by the caller. The data is sent to the SEcube in the same chunks used by L1Encrypt() and L1Decrypt(),
+ *  therefore the two APIs are interchangeable: data encrypted with one can be decrypted with the other. The user should not modify the
+ *  attributes of this class. A context destroyed while still active releases its crypto session on the SEcube with L1EncryptAbort() or
+ *  L1DecryptAbort(), so it must not outlive the object that started it; it cannot be copied. */
+class SEcube_crypto_context{
+public:
+	uint32_t sessId; /**< The ID of the crypto session opened on the SEcube by L1EncryptInit() or L1DecryptInit(). */
+	uint16_t algorithm; /**< The algorithm (see L1Algorithms::Algorithms). */
+	uint16_t mode; /**< The mode of the algorithm (see CryptoInitialisation::Modes). */
+	bool active; /**< True between the Init and the Final call. */
+	size_t chunk; /**< The number of bytes sent with each CRYPTO_UPDATE request, which depends on algorithm and mode. */
+	size_t buffered; /**< The number of bytes in the buffer, not yet sent to the SEcube. */
+	uint64_t processed; /**< The number of bytes returned to the caller so far. */
+	uint64_t ctr_counter; /**< The index of the next chunk, combined with the nonce in CTR mode. */
+	std::array<uint8_t, B5_AES_BLK_SIZE> ctr_nonce; /**< The nonce of AES-CTR, the last 8 bytes are replaced by ctr_counter. */
+	std::array<uint8_t, L1Crypto::UpdateSize::DATAIN> buffer; /**< Data waiting to be sent, at most one chunk plus the padding. */
+	SecurityApi* owner; /**< The object that started the encryption or decryption. */
+	uint16_t direction; /**< CryptoInitialisation::Direction::ENCRYPT or DECRYPT. */
+	SEcube_crypto_context() : sessId(0), algorithm(0), mode(0), active(false), chunk(0), buffered(0), processed(0), ctr_counter(0), owner(nullptr), direction(0) {}
+	SEcube_crypto_context(const SEcube_crypto_context&) = delete;
+	SEcube_crypto_context& operator=(const SEcube_crypto_context&) = delete;
+	~SEcube_crypto_context(); /**< Calls L1EncryptAbort() or L1DecryptAbort() if the context is still active. */
+};
+
 class SecurityApi {
 private:
 public:
@@ -77,8 +118,29 @@ public:
 	virtual void L1CryptoUpdate(uint32_t sessId, uint16_t flags, uint16_t data1Len, uint8_t* data1, uint16_t data2Len, uint8_t* data2, uint16_t* dataOutLen, uint8_t* dataOut) = 0;
 	virtual void L1Encrypt(size_t plaintext_size, std::shared_ptr<uint8_t[]> plaintext, SEcube_ciphertext& encrypted_data, uint16_t algorithm, uint16_t algorithm_mode, uint32_t key_id) = 0;
 	virtual void L1Decrypt(SEcube_ciphertext& encrypted_data, size_t& plaintext_size, std::shared_ptr<uint8_t[]>& plaintext) = 0;
+	virtual void L1EncryptInit(SEcube_ciphertext& encrypted_data, uint16_t algorithm, uint16_t algorithm_mode, uint32_t key_id, SEcube_crypto_context& ctx) = 0;
+	virtual void L1EncryptUpdate(SEcube_crypto_context& ctx, size_t input_size, const uint8_t* input_data, uint8_t* output_data, size_t& output_size) = 0;
+	virtual void L1EncryptFinal(SEcube_crypto_context& ctx, SEcube_ciphertext& encrypted_data, uint8_t* output_data, size_t& output_size) = 0;
+	virtual void L1EncryptAbort(SEcube_crypto_context& ctx) = 0;
+	virtual void L1DecryptInit(SEcube_ciphertext& encrypted_data, SEcube_crypto_context& ctx) = 0;
+	virtual void L1DecryptUpdate(SEcube_crypto_context& ctx, size_t input_size, const uint8_t* input_data, uint8_t* output_data, size_t& output_size) = 0;
+	virtual void L1DecryptFinal(SEcube_crypto_context& ctx, SEcube_ciphertext& encrypted_data, uint8_t* output_data, size_t& output_size) = 0;
+	virtual void L1DecryptAbort(SEcube_crypto_context& ctx) = 0;
 	virtual void L1Digest(size_t input_size, std::shared_ptr<uint8_t[]> input_data, SEcube_digest& digest) = 0;
+	virtual void L1DigestInit(SEcube_digest& digest, SEcube_digest_context& ctx) = 0;
+	virtual void L1DigestUpdate(SEcube_digest_context& ctx, size_t input_size, const uint8_t* input_data) = 0;
+	virtual void L1DigestFinal(SEcube_digest_context& ctx, SEcube_digest& digest) = 0;
 	virtual void L1GetAlgorithms(std::vector<se3Algo>& algorithmsArray) = 0;
 };
 
+inline SEcube_crypto_context::~SEcube_crypto_context() {
+	if(this->active && (this->owner != nullptr)){
+		if(this->direction == CryptoInitialisation::Direction::ENCRYPT){
+			this->owner->L1EncryptAbort(*this);
+		} else {
+			this->owner->L1DecryptAbort(*this);
+		}
+	}
+}
+
 #endif
@@ -0,0 +1,79 @@
+/**
+ * Benchmark of the implementations of B5_Aes256_Update (portable tables, AES-NI, VAES), in cycles per byte.
+ *
+ * Each mode encrypts or decrypts an 8 KiB buffer (the size of an L1 payload) with AES-256; the outputs of
+ * all the implementations supported by the CPU are compared with the table based one before timing them.
+ * Cycles are read with RDTSC, so on CPUs whose TSC does not run at the core clock they are reference cycles.
+ *
+ * Build (from the repository root, Linux x86):
+ *   g++ -std=c++17 -O2 -I SEcube_utilities_backend/sources -o aes256_bench benchmarks/aes256_bench.cpp \
+ *       "SEcube_utilities_backend/sources/L1/Crypto Libraries/aes256.cpp" "SEcube_utilities_backend/sources/L1/Crypto Libraries/aes256_ni.cpp"
+ * Run:
+ *   ./aes256_bench [iterations]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <x86intrin.h>
+#include "L1/Crypto Libraries/aes256.h"
+
+using namespace std;
+
+static const int16_t BLOCKS = 8192 / B5_AES_BLK_SIZE;
+
+static void Run(uint8_t mode, uint8_t* key, uint8_t* iv, uint8_t* in, uint8_t* out, int n) {
+	bool dec = (mode == B5_AES256_ECB_DEC) || (mode == B5_AES256_CBC_DEC) || (mode == B5_AES256_CFB_DEC);
+	B5_tAesCtx ctx;
+	B5_Aes256_Init(&ctx, key, B5_AES_256, mode);
+	B5_Aes256_SetIV(&ctx, iv);
+	for (int i = 0; i < n; i++) {
+		if (dec)
+			B5_Aes256_Update(&ctx, in, out, BLOCKS);
+		else
+			B5_Aes256_Update(&ctx, out, in, BLOCKS);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	int n = (argc > 1) ? atoi(argv[1]) : 2000;
+	const struct { const char* name; uint8_t mode; } modes[] = {
+		{ "ECB enc", B5_AES256_ECB_ENC }, { "ECB dec", B5_AES256_ECB_DEC }, { "CBC enc", B5_AES256_CBC_ENC },
+		{ "CBC dec", B5_AES256_CBC_DEC }, { "CFB dec", B5_AES256_CFB_DEC }, { "CTR", B5_AES256_CTR }
+	};
+	const char* impls[] = { "tables", "AES-NI", "VAES" };
+	uint8_t key[B5_AES_256], iv[B5_AES_IV_SIZE];
+	vector<uint8_t> in(BLOCKS * B5_AES_BLK_SIZE), ref(in.size()), out(in.size());
+	int32_t maxImpl = B5_Aes256_GetImpl();
+
+	for (size_t i = 0; i < sizeof(key); i++)
+		key[i] = (uint8_t)(i * 13);
+	for (size_t i = 0; i < sizeof(iv); i++)
+		iv[i] = (uint8_t)(0xF0 + i);
+	for (size_t i = 0; i < in.size(); i++)
+		in[i] = (uint8_t)(i * 7);
+
+	printf("%-8s", "");
+	for (int32_t impl = B5_AES256_IMPL_TABLES; impl <= maxImpl; impl++)
+		printf("%12s", impls[impl]);
+	printf("   (cycles/byte)\n");
+	for (const auto& m : modes) {
+		printf("%-8s", m.name);
+		B5_Aes256_SetImpl(B5_AES256_IMPL_TABLES);
+		Run(m.mode, key, iv, in.data(), ref.data(), 1);
+		for (int32_t impl = B5_AES256_IMPL_TABLES; impl <= maxImpl; impl++) {
+			B5_Aes256_SetImpl(impl);
+			Run(m.mode, key, iv, in.data(), out.data(), 1);
+			if (out != ref) {
+				printf("\n%s %s: output differs from the tables\n", m.name, impls[impl]);
+				return 1;
+			}
+			uint64_t t0 = __rdtsc();
+			Run(m.mode, key, iv, in.data(), out.data(), n);
+			printf("%12.2f", (double)(__rdtsc() - t0) / ((double)n * in.size()));
+		}
+		printf("\n");
+	}
+	return 0;
+}
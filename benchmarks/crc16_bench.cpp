@@ -0,0 +1,73 @@
+/**
+ * Micro-benchmark of the CRC16 kernels of L0Support (byte at a time, slice-by-8, carry-less multiplication).
+ *
+ * Every kernel is first checked against the reference one on random buffers of every length up to 1 KiB
+ * and random initial values, then each kernel computes the CRC of a buffer as large as a full L0 request.
+ *
+ * Build (from the repository root, Linux):
+ *   mkdir -p bench_obj && find SEcube_utilities_backend/sources -name '*.c' -print0 | xargs -0 gcc -O2 -c && mv *.o bench_obj
+ *   find SEcube_utilities_backend/sources -name '*.cpp' -print0 | xargs -0 g++ -std=c++17 -include array -O2 -pthread \
+ *       -I SEcube_utilities_backend/sources -o crc16_bench benchmarks/crc16_bench.cpp bench_obj/*.o
+ * Run:
+ *   ./crc16_bench [iterations]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "L0/L0 Base/L0_base.h"
+
+using namespace std;
+
+typedef uint16_t (*Crc16Kernel)(size_t, const uint8_t*, uint16_t);
+
+static double NowUs() {
+	return chrono::duration<double, micro>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char* argv[]) {
+	int n = (argc > 1) ? atoi(argv[1]) : 20000;
+	const size_t size = L0Communication::Parameter::COMM_N * L0Communication::Parameter::COMM_BLOCK;
+	const struct { const char* name; Crc16Kernel kernel; } kernels[] = {
+		{ "bytewise", L0Support::Se3Crc16Bytewise },
+		{ "slice-by-8", L0Support::Se3Crc16Slice8 },
+		{ "clmul", L0Support::Se3Crc16Clmul },
+		{ "dispatched", L0Support::Se3Crc16Update }
+	};
+	mt19937 rng(1);
+	vector<uint8_t> buf(size);
+	for (uint8_t& b : buf)
+		b = (uint8_t)rng();
+
+	printf("PCLMULQDQ: %s\n", L0Support::Se3Crc16ClmulSupported() ? "yes" : "no");
+	for (size_t len = 0; len <= 1024; len++) {
+		size_t offset = rng() % 64;
+		uint16_t init = (uint16_t)rng();
+		uint16_t ref = L0Support::Se3Crc16Bytewise(len, buf.data() + offset, init);
+		for (const auto& k : kernels) {
+			if (k.kernel == L0Support::Se3Crc16Clmul && !L0Support::Se3Crc16ClmulSupported())
+				continue;
+			if (k.kernel(len, buf.data() + offset, init) != ref) {
+				printf("%s: wrong CRC for length %zu\n", k.name, len);
+				return 1;
+			}
+		}
+	}
+
+	double base = 0;
+	for (const auto& k : kernels) {
+		if (k.kernel == L0Support::Se3Crc16Clmul && !L0Support::Se3Crc16ClmulSupported())
+			continue;
+		volatile uint16_t sink = 0;
+		double t0 = NowUs();
+		for (int i = 0; i < n; i++)
+			sink = k.kernel(size, buf.data(), sink);
+		double us = (NowUs() - t0) / n;
+		if (base == 0)
+			base = us;
+		printf("%-11s %8.3f us per %zu bytes, %8.1f MiB/s (%.1fx)\n", k.name, us, size, size / us / 1.048576, base / us);
+	}
+	return 0;
+}
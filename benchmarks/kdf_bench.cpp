@@ -0,0 +1,173 @@
+/**
+ * Benchmark of PBKDF2HmacSha256 (serial blocks with a full HMAC per iteration, or independent blocks in lanes), in microseconds.
+ *
+ * PBKDF2_IMPL_LANES is first checked against PBKDF2_IMPL_SERIAL with the portable SHA-256, for outputs up to
+ * 10 blocks, salts up to 100 bytes and up to 9 derivations with PBKDF2HmacSha256Multi(), with every SHA-256
+ * implementation supported by the CPU, and against the RFC 7914 test vector. Then it times the derivations of
+ * L1Login() (2 responses of 32 iterations and the session key), of L1::Se3PayloadCryptoInit() (2 blocks,
+ * 1 iteration) and 8 blocks of 4096 iterations. Times are read with std::chrono.
+ *
+ * Build (from the repository root, Linux x86):
+ *   gcc -O2 -c "SEcube_utilities_backend/sources/L1/Crypto Libraries/"{sha256.c,pbkdf2.c}
+ *   g++ -std=c++17 -O2 -I SEcube_utilities_backend/sources -o kdf_bench benchmarks/kdf_bench.cpp sha256.o pbkdf2.o \
+ *       "SEcube_utilities_backend/sources/L1/Crypto Libraries/sha256_ni.cpp"
+ * Run:
+ *   ./kdf_bench [repetitions]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "L1/Crypto Libraries/pbkdf2.h"
+#include "L1/Crypto Libraries/sha256_ni.h"
+
+using namespace std;
+
+static const size_t PIN = 32, CHALLENGE = 32;
+static const uint32_t ITERATIONS = 32;
+
+static double NowUs() {
+	return chrono::duration<double, micro>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* the three derivations of L1Login(), as it did before PBKDF2HmacSha256Multi() */
+static void Login(const uint8_t* pin, const uint8_t* cc1, const uint8_t* cc2, const uint8_t* sc, uint8_t* out) {
+	PBKDF2HmacSha256(pin, PIN, cc1, CHALLENGE, ITERATIONS, out, CHALLENGE);
+	PBKDF2HmacSha256(pin, PIN, cc2, CHALLENGE, 1, out + CHALLENGE, PIN);
+	PBKDF2HmacSha256(pin, PIN, sc, CHALLENGE, ITERATIONS, out + 2 * CHALLENGE, CHALLENGE);
+}
+
+/* the same derivations as L1Login() does now */
+static void LoginMulti(const uint8_t* pin, const uint8_t* cc1, const uint8_t* cc2, const uint8_t* sc, uint8_t* out) {
+	B5_tHmacSha256Key key;
+	const uint8_t* salts[] = { cc1, sc };
+	uint8_t* resps[] = { out, out + 2 * CHALLENGE };
+	const uint8_t* sessionSalt[] = { cc2 };
+	uint8_t* sessionKey[] = { out + CHALLENGE };
+	B5_HmacSha256_KeyInit(&key, pin, PIN);
+	PBKDF2HmacSha256Multi(&key, salts, CHALLENGE, ITERATIONS, resps, CHALLENGE, 2);
+	PBKDF2HmacSha256Multi(&key, sessionSalt, CHALLENGE, 1, sessionKey, PIN, 1);
+}
+
+static bool Derive(int32_t impl, const uint8_t* pw, const vector<const uint8_t*>& salt, size_t nsalt, uint32_t iterations,
+		size_t nout, vector<uint8_t>& out) {
+	B5_tHmacSha256Key key;
+	vector<uint8_t*> o;
+	out.assign(salt.size() * nout + 1, 0xA5);
+	for (size_t j = 0; j < salt.size(); j++)
+		o.push_back(out.data() + j * nout);
+	PBKDF2HmacSha256_SetImpl(impl);
+	B5_HmacSha256_KeyInit(&key, pw, PIN);
+	PBKDF2HmacSha256Multi(&key, const_cast<const uint8_t**>(salt.data()), nsalt, iterations, o.data(), nout, (int32_t)salt.size());
+	return out.back() == 0xA5;
+}
+
+int main(int argc, char* argv[]) {
+	int n = (argc > 1) ? atoi(argv[1]) : 20000;
+	const char* shaImpls[] = { "scalar", "AVX2", "SHA-NI" };
+	const char* kdfImpls[] = { "serial", "lanes" };
+	mt19937 rng(1);
+	uint8_t pin[PIN], cc1[CHALLENGE], cc2[CHALLENGE], sc[CHALLENGE], ref[3 * CHALLENGE], out[3 * CHALLENGE];
+	vector<uint8_t> salts(9 * 100), big(8 * B5_SHA256_DIGEST_SIZE);
+
+	for (auto& b : pin)
+		b = (uint8_t)rng();
+	for (auto& b : cc1)
+		b = (uint8_t)rng();
+	for (auto& b : cc2)
+		b = (uint8_t)rng();
+	for (auto& b : sc)
+		b = (uint8_t)rng();
+	for (auto& b : salts)
+		b = (uint8_t)rng();
+
+	/* RFC 7914, section 11: P = "passwd", S = "salt", c = 1, dkLen = 64 */
+	static const uint8_t rfc[64] = {
+		0x55, 0xac, 0x04, 0x6e, 0x56, 0xe3, 0x08, 0x9f, 0xec, 0x16, 0x91, 0xc2, 0x25, 0x44, 0xb6, 0x05,
+		0xf9, 0x41, 0x85, 0x21, 0x6d, 0xde, 0x04, 0x65, 0xe6, 0x8b, 0x9d, 0x57, 0xc2, 0x0d, 0xac, 0xbc,
+		0x49, 0xca, 0x9c, 0xcc, 0xf1, 0x79, 0xb6, 0x45, 0x99, 0x16, 0x64, 0xb3, 0x9d, 0x77, 0xef, 0x31,
+		0x7c, 0x71, 0xb8, 0x45, 0xb1, 0xe3, 0x0b, 0xd5, 0x09, 0x11, 0x20, 0x41, 0xd3, 0xa1, 0x97, 0x83 };
+
+	/* correctness against the serial implementation with the portable SHA-256 */
+	for (int32_t shaImpl = B5_SHA256_IMPL_SCALAR; shaImpl <= B5_SHA256_IMPL_SHANI; shaImpl++) {
+		if (!B5_Sha256Ni_Supported(shaImpl))
+			continue;
+		for (int32_t impl = PBKDF2_IMPL_SERIAL; impl <= PBKDF2_IMPL_LANES; impl++) {
+			uint8_t dk[64];
+			B5_Sha256_SetImpl(shaImpl);
+			PBKDF2HmacSha256_SetImpl(impl);
+			PBKDF2HmacSha256((const uint8_t*)"passwd", 6, (const uint8_t*)"salt", 4, 1, dk, sizeof(dk));
+			if (memcmp(dk, rfc, sizeof(rfc))) {
+				printf("%s + %s: wrong RFC 7914 output\n", kdfImpls[impl], shaImpls[shaImpl]);
+				return 1;
+			}
+		}
+		for (size_t derivations = 1; derivations <= 9; derivations++) {
+			for (size_t nsalt = 0; nsalt <= 100; nsalt += 25) {
+				for (uint32_t iterations : { 1u, 2u, 33u }) {
+					for (size_t nout = 1; nout <= 10 * B5_SHA256_DIGEST_SIZE; nout += (nout < 70) ? 1 : 31) {
+						vector<const uint8_t*> s;
+						vector<uint8_t> a, b;
+						for (size_t j = 0; j < derivations; j++)
+							s.push_back(salts.data() + 100 * j);
+						B5_Sha256_SetImpl(B5_SHA256_IMPL_SCALAR);
+						bool okA = Derive(PBKDF2_IMPL_SERIAL, pin, s, nsalt, iterations, nout, a);
+						B5_Sha256_SetImpl(shaImpl);
+						bool okB = Derive(PBKDF2_IMPL_LANES, pin, s, nsalt, iterations, nout, b);
+						if (!okA || !okB || a != b) {
+							printf("%s: %zu derivations of %zu bytes (salt %zu, %u iterations) differ\n", shaImpls[shaImpl], derivations, nout, nsalt, iterations);
+							return 1;
+						}
+					}
+				}
+			}
+		}
+		B5_Sha256_SetImpl(B5_SHA256_IMPL_SCALAR);
+		PBKDF2HmacSha256_SetImpl(PBKDF2_IMPL_SERIAL);
+		Login(pin, cc1, cc2, sc, ref);
+		B5_Sha256_SetImpl(shaImpl);
+		PBKDF2HmacSha256_SetImpl(PBKDF2_IMPL_LANES);
+		LoginMulti(pin, cc1, cc2, sc, out);
+		if (memcmp(out, ref, sizeof(ref))) {
+			printf("%s: login derivations differ\n", shaImpls[shaImpl]);
+			return 1;
+		}
+	}
+
+	printf("%-24s%14s%14s%14s   (us)\n", "", "login", "session", "8 x 4096");
+	for (int32_t shaImpl = B5_SHA256_IMPL_SCALAR; shaImpl <= B5_SHA256_IMPL_SHANI; shaImpl++) {
+		if (B5_Sha256_SetImpl(shaImpl) != B5_SHA256_RES_OK)
+			continue;
+		for (int32_t impl = PBKDF2_IMPL_SERIAL; impl <= PBKDF2_IMPL_LANES; impl++) {
+			char name[32];
+			uint8_t keys[2 * B5_SHA256_DIGEST_SIZE];
+			PBKDF2HmacSha256_SetImpl(impl);
+			snprintf(name, sizeof(name), "%s, %s", shaImpls[shaImpl], kdfImpls[impl]);
+			printf("%-24s", name);
+
+			double t0 = NowUs();
+			for (int i = 0; i < n; i++) {
+				if (impl == PBKDF2_IMPL_SERIAL)
+					Login(pin, cc1, cc2, sc, out);
+				else
+					LoginMulti(pin, cc1, cc2, sc, out);
+			}
+			printf("%14.2f", (NowUs() - t0) / n);
+
+			t0 = NowUs();
+			for (int i = 0; i < n; i++)
+				PBKDF2HmacSha256(out, B5_SHA256_DIGEST_SIZE, NULL, 0, 1, keys, sizeof(keys));
+			printf("%14.2f", (NowUs() - t0) / n);
+
+			int m = n / 1000 + 1;
+			t0 = NowUs();
+			for (int i = 0; i < m; i++)
+				PBKDF2HmacSha256(pin, PIN, salts.data(), 16, 4096, big.data(), big.size());
+			printf("%14.2f\n", (NowUs() - t0) / m);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,115 @@
+/**
+ * Benchmark of the pipelined L1 command submission (L1PipelineSubmit/L1PipelineReap).
+ *
+ * A sequence of CRYPTO_UPDATE commands (AES-256-ECB, 4 KiB each, payload encrypted and signed)
+ * is sent to the SEcube first one at a time and then with the pipeline, so that the payload
+ * protection of the next request overlaps with the processing of the current one on the device.
+ * The host cost of the payload protection (AES-256-CBC + HMAC-SHA-256) is measured separately.
+ *
+ * Build (from the repository root, Linux):
+ *   mkdir -p bench_obj && find SEcube_utilities_backend/sources -name '*.c' -print0 | xargs -0 gcc -O2 -c && mv *.o bench_obj
+ *   find SEcube_utilities_backend/sources -name '*.cpp' -print0 | xargs -0 g++ -std=c++17 -include array -O2 -pthread -DSE3_WITH_EMULATOR \
+ *       -I SEcube_utilities_backend/sources -o l1_pipeline_bench benchmarks/l1_pipeline_bench.cpp bench_obj/*.o
+ * Run against the emulator (no SEcube needed):
+ *   SE3_EMULATOR=/tmp/se3emu SE3_EMULATOR_LATENCY_US=200 ./l1_pipeline_bench [commands] [depth]
+ */
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "L1/L1.h"
+
+using namespace std;
+
+static const uint16_t DATA_LEN = 4096;
+static const uint32_t KEY_ID = 10;
+
+static double NowUs() {
+	return chrono::duration<double, micro>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint16_t BuildUpdate(uint32_t sessId, uint8_t* req) {
+	uint16_t flags = 0, len1 = DATA_LEN, len2 = 0;
+	memset(req, 0, L1Crypto::UpdateRequestOffset::DATA);
+	memcpy(req + L1Crypto::UpdateRequestOffset::SID, &sessId, 4);
+	memcpy(req + L1Crypto::UpdateRequestOffset::FLAGS, &flags, 2);
+	memcpy(req + L1Crypto::UpdateRequestOffset::DATAIN1_LEN, &len1, 2);
+	memcpy(req + L1Crypto::UpdateRequestOffset::DATAIN2_LEN, &len2, 2);
+	for (uint16_t i = 0; i < DATA_LEN; i++)
+		req[L1Crypto::UpdateRequestOffset::DATA + i] = (uint8_t)i;
+	return L1Crypto::UpdateRequestOffset::DATA + DATA_LEN;
+}
+
+int main(int argc, char* argv[]) {
+	int n = (argc > 1) ? atoi(argv[1]) : 2000;
+	size_t depth = (argc > 2) ? atoi(argv[2]) : 2;
+	const uint16_t flags = L1Commands::Flags::ENCRYPT | L1Commands::Flags::SIGN;
+	static uint8_t req[L1Request::Size::MAX_DATA], resp[L1Response::Size::MAX_DATA];
+	uint16_t respLen;
+
+	//host cost of the payload protection of one request
+	{
+		uint8_t key[B5_AES_256], iv[B5_AES_BLK_SIZE], auth[B5_SHA256_DIGEST_SIZE];
+		static uint8_t in[DATA_LEN + 64], out[DATA_LEN + 64];
+		memset(key, 1, sizeof(key)); memset(iv, 2, sizeof(iv));
+		B5_tAesCtx aes;
+		B5_tHmacSha256Ctx hmac;
+		double t0 = NowUs();
+		for (int i = 0; i < n; i++) {
+			B5_Aes256_Init(&aes, key, B5_AES_256, B5_AES256_CBC_ENC);
+			B5_Aes256_SetIV(&aes, iv);
+			B5_Aes256_Update(&aes, out, in, sizeof(in) / B5_AES_BLK_SIZE);
+			B5_HmacSha256_Init(&hmac, key, B5_AES_256);
+			B5_HmacSha256_Update(&hmac, iv, sizeof(iv));
+			B5_HmacSha256_Update(&hmac, out, sizeof(out));
+			B5_HmacSha256_Finit(&hmac, auth);
+		}
+		printf("host payload crypto:   %8.1f us/command\n", (NowUs() - t0) / n);
+	}
+
+	L1 l1;
+	array<uint8_t, L1Parameters::Size::PIN> pin{};
+	try {
+		l1.L1Login(pin, SE3_ACCESS_ADMIN, true);
+		bool found = false;
+		l1.L1FindKey(KEY_ID, found);
+		if (!found) {
+			uint8_t kd[32];
+			memset(kd, 0x11, sizeof(kd));
+			se3Key k{KEY_ID, sizeof(kd), kd};
+			l1.L1KeyEdit(k, L1Commands::KeyOpEdit::SE3_KEY_OP_ADD);
+		}
+		uint32_t sessId;
+		l1.L1CryptoInit(L1Algorithms::Algorithms::AES, CryptoInitialisation::Modes::ECB | CryptoInitialisation::Direction::ENCRYPT, KEY_ID, sessId);
+		uint16_t reqLen = BuildUpdate(sessId, req);
+
+		//one command at a time
+		double t0 = NowUs();
+		for (int i = 0; i < n; i++) {
+			l1.L1PipelineSubmit(L1Commands::Codes::CRYPTO_UPDATE, flags, reqLen, req);
+			l1.L1PipelineReap(&respLen, resp);
+		}
+		double serial = (NowUs() - t0) / n;
+		printf("depth 1:               %8.1f us/command\n", serial);
+
+		//pipelined
+		t0 = NowUs();
+		for (int i = 0; i < n; i++) {
+			if (l1.L1PipelinePending() == depth)
+				l1.L1PipelineReap(&respLen, resp);
+			l1.L1PipelineSubmit(L1Commands::Codes::CRYPTO_UPDATE, flags, reqLen, req);
+		}
+		while (l1.L1PipelinePending() > 0)
+			l1.L1PipelineReap(&respLen, resp);
+		double piped = (NowUs() - t0) / n;
+		printf("depth %zu:               %8.1f us/command (%.2fx)\n", depth, piped, serial / piped);
+		l1.L1Logout();
+	}
+	catch (exception& e) {
+		printf("error: %s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,92 @@
+/**
+ * Benchmark of the bulk encryption striped across several SEcube devices (L1MultiDevice).
+ *
+ * A buffer is encrypted with AES-256-CTR in chunks, first on a single device with L1Encrypt() and
+ * then with L1MultiDevice::Encrypt() on all the devices attached; the result is decrypted and checked.
+ * Missing keys are added on every device (admin PIN made of zeros), so run it only on test devices.
+ *
+ * Build (from the repository root, Linux):
+ *   mkdir -p bench_obj && find SEcube_utilities_backend/sources -name '*.c' -print0 | xargs -0 gcc -O2 -c && mv *.o bench_obj
+ *   find SEcube_utilities_backend/sources -name '*.cpp' -print0 | xargs -0 g++ -std=c++17 -include array -O2 -pthread -DSE3_WITH_EMULATOR \
+ *       -I SEcube_utilities_backend/sources -o multidevice_bench benchmarks/multidevice_bench.cpp bench_obj/*.o
+ * Run against four emulated devices (no SEcube needed):
+ *   SE3_EMULATOR=/tmp/se3emu0:/tmp/se3emu1:/tmp/se3emu2:/tmp/se3emu3 SE3_EMULATOR_LATENCY_US=300 ./multidevice_bench [MiB] [chunk KiB]
+ */
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "L1/L1.h"
+#include "L1/Multi Device/L1_multidevice.h"
+
+using namespace std;
+
+static const uint32_t KEY_ID = 10;
+
+static double NowUs() {
+	return chrono::duration<double, micro>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char* argv[]) {
+	size_t size = (size_t)((argc > 1) ? atoi(argv[1]) : 4) * 1024 * 1024;
+	size_t chunk = (size_t)((argc > 2) ? atoi(argv[2]) : 64) * 1024;
+	array<uint8_t, L1Parameters::Size::PIN> pin{};
+	shared_ptr<uint8_t[]> data(new uint8_t[size]);
+	for (size_t i = 0; i < size; i++)
+		data[i] = (uint8_t)(i * 7);
+
+	try {
+		//same key on every device
+		L0 l0;
+		uint8_t numdevices = l0.GetNumberDevices();
+		for (uint8_t d = 0; d < numdevices; d++) {
+			L1 l1(d);
+			l1.L1Login(pin, SE3_ACCESS_ADMIN, true);
+			bool found = false;
+			l1.L1FindKey(KEY_ID, found);
+			if (!found) {
+				uint8_t kd[32];
+				memset(kd, 0x11, sizeof(kd));
+				se3Key k{KEY_ID, sizeof(kd), kd};
+				l1.L1KeyEdit(k, L1Commands::KeyOpEdit::SE3_KEY_OP_ADD);
+			}
+		}
+
+		//one device
+		double single;
+		{
+			L1 l1(0);
+			l1.L1Login(pin, SE3_ACCESS_USER, true);
+			SEcube_ciphertext ct;
+			double t0 = NowUs();
+			for (size_t offset = 0; offset < size; offset += chunk) {
+				shared_ptr<uint8_t[]> part(data, data.get() + offset);
+				l1.L1Encrypt((size - offset < chunk) ? (size - offset) : chunk, part, ct, L1Algorithms::Algorithms::AES, CryptoInitialisation::Modes::CTR, KEY_ID);
+			}
+			single = (NowUs() - t0) / 1e6;
+			printf("1 device:   %8.2f MiB/s\n", size / single / (1024 * 1024));
+		}
+
+		//all the devices
+		L1MultiDevice multi;
+		size_t n = multi.Open(pin, SE3_ACCESS_USER, KEY_ID);
+		vector<SEcube_ciphertext> chunks;
+		double t0 = NowUs();
+		multi.Encrypt(size, data, chunks, L1Algorithms::Algorithms::AES, CryptoInitialisation::Modes::CTR, KEY_ID, chunk);
+		double striped = (NowUs() - t0) / 1e6;
+		printf("%zu devices: %8.2f MiB/s (%.2fx)\n", n, size / striped / (1024 * 1024), single / striped);
+
+		size_t outSize = 0;
+		shared_ptr<uint8_t[]> out;
+		multi.Decrypt(chunks, outSize, out);
+		bool match = (outSize == size) && (memcmp(out.get(), data.get(), size) == 0);
+		printf("decryption: %s\n", match ? "MATCH" : "MISMATCH");
+		return match ? 0 : 1;
+	}
+	catch (exception& e) {
+		printf("error: %s\n", e.what());
+		return 1;
+	}
+}
@@ -0,0 +1,156 @@
+/**
+ * Benchmark of the L1 payload protection (AES-256-CBC, then HMAC-SHA-256 of the IV and of the ciphertext), in cycles per byte.
+ *
+ * The fused B5_Aes256HmacSha256_Encrypt/Decrypt are first checked against B5_Aes256_Update followed (or preceded)
+ * by B5_HmacSha256_Update with the portable implementations, for every payload length up to 8 KiB and every
+ * combination of AES and SHA-256 implementation supported by the CPU; the stitched encryption is also checked
+ * with data already buffered in the HMAC context. Then an 8 KiB payload (the largest L1 payload) is sealed
+ * and opened with the two passes and with the fused functions; the fused decryption is two passes as well.
+ * Cycles are read with RDTSC.
+ *
+ * Build (from the repository root, Linux x86):
+ *   gcc -O2 -c "SEcube_utilities_backend/sources/L1/Crypto Libraries/sha256.c" -o sha256.o
+ *   g++ -std=c++17 -O2 -I SEcube_utilities_backend/sources -o payload_bench benchmarks/payload_bench.cpp sha256.o \
+ *       "SEcube_utilities_backend/sources/L1/Crypto Libraries/"{aes256.cpp,aes256_ni.cpp,sha256_ni.cpp,aes256_hmac.cpp}
+ * Run:
+ *   ./payload_bench [iterations]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <x86intrin.h>
+#include "L1/Crypto Libraries/aes256_hmac.h"
+#include "L1/Crypto Libraries/sha256_ni.h"
+
+using namespace std;
+
+static const int16_t BLOCKS = 8192 / B5_AES_BLK_SIZE;
+
+struct Keys {
+	uint8_t aes[B5_AES_256];
+	B5_tHmacSha256Key mac;
+	uint8_t iv[B5_AES_IV_SIZE];
+	uint8_t pre[B5_SHA256_BLOCK_SIZE];
+};
+
+/* reference: the two passes of L1::Se3PayloadEncrypt/Decrypt; pre bytes are hashed before the IV */
+static void Seal(const Keys& k, uint8_t* data, int16_t nBlk, bool fused, uint8_t* mac, int32_t pre = 0) {
+	B5_tAesCtx aes;
+	B5_tHmacSha256Ctx hmac;
+	B5_Aes256_Init(&aes, k.aes, B5_AES_256, B5_AES256_CBC_ENC);
+	B5_HmacSha256_InitKey(&hmac, &k.mac);
+	B5_HmacSha256_Update(&hmac, k.pre, pre);
+	if (fused) {
+		B5_Aes256HmacSha256_Encrypt(&aes, &hmac, k.iv, data, nBlk);
+	}
+	else {
+		B5_Aes256_SetIV(&aes, k.iv);
+		B5_Aes256_Update(&aes, data, data, nBlk);
+		B5_HmacSha256_Update(&hmac, k.iv, B5_AES_IV_SIZE);
+		B5_HmacSha256_Update(&hmac, data, nBlk * B5_AES_BLK_SIZE);
+	}
+	B5_HmacSha256_Finit(&hmac, mac);
+}
+
+static void Open(const Keys& k, uint8_t* data, int16_t nBlk, bool fused, uint8_t* mac, int32_t pre = 0) {
+	B5_tAesCtx aes;
+	B5_tHmacSha256Ctx hmac;
+	B5_Aes256_Init(&aes, k.aes, B5_AES_256, B5_AES256_CBC_DEC);
+	B5_HmacSha256_InitKey(&hmac, &k.mac);
+	B5_HmacSha256_Update(&hmac, k.pre, pre);
+	if (fused) {
+		B5_Aes256HmacSha256_Decrypt(&aes, &hmac, k.iv, data, nBlk);
+	}
+	else {
+		B5_HmacSha256_Update(&hmac, k.iv, B5_AES_IV_SIZE);
+		B5_HmacSha256_Update(&hmac, data, nBlk * B5_AES_BLK_SIZE);
+		B5_Aes256_SetIV(&aes, k.iv);
+		B5_Aes256_Update(&aes, data, data, nBlk);
+	}
+	B5_HmacSha256_Finit(&hmac, mac);
+}
+
+int main(int argc, char* argv[]) {
+	int n = (argc > 1) ? atoi(argv[1]) : 2000;
+	const char* aesImpls[] = { "tables", "AES-NI", "VAES" };
+	const char* shaImpls[] = { "scalar", "AVX2", "SHA-NI" };
+	mt19937 rng(1);
+	Keys k;
+	uint8_t macKey[B5_AES_256];
+	vector<uint8_t> in(BLOCKS * B5_AES_BLK_SIZE), ref(in.size()), out(in.size());
+	uint8_t refMac[B5_SHA256_DIGEST_SIZE], outMac[B5_SHA256_DIGEST_SIZE];
+
+	for (auto& b : in)
+		b = (uint8_t)rng();
+	for (auto& b : k.aes)
+		b = (uint8_t)rng();
+	for (auto& b : k.iv)
+		b = (uint8_t)rng();
+	for (auto& b : k.pre)
+		b = (uint8_t)rng();
+	for (auto& b : macKey)
+		b = (uint8_t)rng();
+	B5_HmacSha256_KeyInit(&k.mac, macKey, B5_AES_256);
+
+	/* correctness against the portable implementations */
+	for (int32_t aesImpl = B5_AES256_IMPL_TABLES; aesImpl <= B5_AES256_IMPL_VAES; aesImpl++) {
+		for (int32_t shaImpl = B5_SHA256_IMPL_SCALAR; shaImpl <= B5_SHA256_IMPL_SHANI; shaImpl++) {
+			if ((B5_Aes256_SetImpl(aesImpl) != B5_AES256_RES_OK) || (B5_Sha256_SetImpl(shaImpl) != B5_SHA256_RES_OK))
+				continue;
+			for (int16_t nBlk = 1; nBlk <= BLOCKS; nBlk++) {
+				for (int dec = 0; dec < 2; dec++) {
+					B5_Aes256_SetImpl(B5_AES256_IMPL_TABLES);
+					B5_Sha256_SetImpl(B5_SHA256_IMPL_SCALAR);
+					memcpy(ref.data(), in.data(), in.size());
+					if (dec) Open(k, ref.data(), nBlk, false, refMac); else Seal(k, ref.data(), nBlk, false, refMac);
+					B5_Aes256_SetImpl(aesImpl);
+					B5_Sha256_SetImpl(shaImpl);
+					memcpy(out.data(), in.data(), in.size());
+					if (dec) Open(k, out.data(), nBlk, true, outMac); else Seal(k, out.data(), nBlk, true, outMac);
+					if (memcmp(out.data(), ref.data(), in.size()) || memcmp(outMac, refMac, sizeof(refMac))) {
+						printf("%s + %s: %s of %d blocks differs from the two passes\n", aesImpls[aesImpl], shaImpls[shaImpl], dec ? "decryption" : "encryption", nBlk);
+						return 1;
+					}
+				}
+			}
+		}
+	}
+	if (B5_Sha256Ni_Supported(B5_SHA256_IMPL_SHANI) && B5_Aes256_SetImpl(B5_AES256_IMPL_AESNI) == B5_AES256_RES_OK) {
+		B5_Sha256_SetImpl(B5_SHA256_IMPL_SHANI);
+		for (int32_t pre = 0; pre < B5_SHA256_BLOCK_SIZE; pre++) {
+			for (int16_t nBlk = 1; nBlk <= 40; nBlk++) {
+				memcpy(ref.data(), in.data(), in.size());
+				memcpy(out.data(), in.data(), in.size());
+				Seal(k, ref.data(), nBlk, false, refMac, pre);
+				Seal(k, out.data(), nBlk, true, outMac, pre);
+				if (memcmp(out.data(), ref.data(), in.size()) || memcmp(outMac, refMac, sizeof(refMac))) {
+					printf("stitched encryption of %d blocks after %d buffered bytes differs\n", nBlk, pre);
+					return 1;
+				}
+			}
+		}
+	}
+
+	/* fastest implementations supported */
+	B5_Aes256_SetImpl(B5_AES256_IMPL_AESNI);
+	B5_Aes256_SetImpl(B5_AES256_IMPL_VAES);
+	B5_Sha256_SetImpl(B5_SHA256_IMPL_AVX2);
+	B5_Sha256_SetImpl(B5_SHA256_IMPL_SHANI);
+	printf("AES %s, SHA-256 %s, stitched: %s\n", aesImpls[B5_Aes256_GetImpl()], shaImpls[B5_Sha256_GetImpl()], B5_Aes256HmacSha256_Stitched() ? "yes" : "no");
+	printf("%-16s%16s%16s   (cycles/byte, 8 KiB payload)\n", "", "seal", "open");
+	for (int fused = 0; fused < 2; fused++) {
+		printf("%-16s", fused ? "fused" : "two passes");
+		uint64_t t0 = __rdtsc();
+		for (int i = 0; i < n; i++)
+			Seal(k, out.data(), BLOCKS, fused, outMac);
+		printf("%16.2f", (double)(__rdtsc() - t0) / ((double)n * in.size()));
+		t0 = __rdtsc();
+		for (int i = 0; i < n; i++)
+			Open(k, out.data(), BLOCKS, fused, outMac);
+		printf("%16.2f\n", (double)(__rdtsc() - t0) / ((double)n * in.size()));
+	}
+	return 0;
+}
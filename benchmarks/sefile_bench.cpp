@@ -0,0 +1,344 @@
+/**
+ * Benchmark of the SEfile sector encryption, in L1 commands (device round trips) per MiB.
+ *
+ * Sectors are encrypted one at a time (crypt_sectors()) and in batches (crypt_sector_batch()) and the results
+ * are compared. A file is then written, read, sized and re-encrypted (secure_recrypt()) with every sector size
+ * of secure_open(), checking that a byte changed anywhere in a sector fails the read. Last, the same file
+ * operations are timed with a simulated disk latency added to every pread() and pwrite().
+ *
+ * Build (from the repository root, Linux; SEkey needs the system SQLite):
+ *   mkdir -p bench_obj && find SEcube_utilities_backend/sources -name '*.c' -print0 | xargs -0 gcc -O2 -c && mv *.o bench_obj
+ *   find SEcube_utilities_backend/sources SEcube_utilities_backend/sefile SEcube_utilities_backend/sekey -name '*.cpp' -print0 | \
+ *       xargs -0 sh -c 'g++ -std=c++17 -include array -O2 -pthread -DSE3_WITH_EMULATOR -I SEcube_utilities_backend/sources \
+ *       -o sefile_bench benchmarks/sefile_bench.cpp "$@" bench_obj/*.o -lsqlite3 -ldl' _
+ * Run against the emulator (no SEcube needed), key 10 must exist:
+ *   SE3_EMULATOR=/tmp/se3emu SE3_EMULATOR_LATENCY_US=200 ./sefile_bench [MiB] [directory] [disk latency in microseconds, 1000 by default]
+ * SE3_EMULATOR_SECTOR_BATCH=0 emulates a firmware without sector batches, SE3_EMULATOR_RESET_MAC=1 one that
+ * restarts the signature on every RESET.
+ */
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "L1/L1.h"
+#include "../sefile/SEfile.h"
+
+using namespace std;
+
+static const uint32_t KEY_ID = 10;
+
+static atomic<uint32_t> DiskLatencyUs(0);
+static atomic<uint64_t> DiskCalls(0);
+
+/* pread() and pwrite() of the whole process, SEfile included, delayed by DiskLatencyUs */
+extern "C" ssize_t pread(int fd, void* buf, size_t count, off_t offset) {
+	static auto real = (ssize_t(*)(int, void*, size_t, off_t))dlsym(RTLD_NEXT, "pread");
+	if (DiskLatencyUs > 0) {
+		DiskCalls++;
+		this_thread::sleep_for(chrono::microseconds(DiskLatencyUs));
+	}
+	return real(fd, buf, count, offset);
+}
+
+extern "C" ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset) {
+	static auto real = (ssize_t(*)(int, const void*, size_t, off_t))dlsym(RTLD_NEXT, "pwrite");
+	if (DiskLatencyUs > 0) {
+		DiskCalls++;
+		this_thread::sleep_for(chrono::microseconds(DiskLatencyUs));
+	}
+	return real(fd, buf, count, offset);
+}
+
+static double NowUs() {
+	return chrono::duration<double, micro>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t Commands(L1& l1) {
+	uint64_t n = 0;
+	for (uint16_t cmd = L1Commands::Codes::CHALLENGE; cmd <= L1Commands::Codes::SEKEY; cmd++) {
+		const se3LatencyHistogram* h = l1.L1GetLatencyHistogram(cmd);
+		n += (h != NULL) ? h->count : 0;
+	}
+	return n;
+}
+
+static void Report(const char* name, L1& l1, double mib, double t0) {
+	double s = (NowUs() - t0) / 1e6;
+	printf("%-28s%16.1f%14.2f\n", name, Commands(l1) / mib, mib / s);
+	l1.L1ResetLatencyHistograms();
+}
+
+/* writes data in a file, 64 KiB per call, reads it back and encrypts it again with secure_recrypt(), returning the ms taken by each step;
+ * the disk calls delayed are added to calls */
+static array<double, 3> Timed(SEfile& f, L1& l1, const string& path, const vector<uint8_t>& data, uint64_t calls[3]) {
+	const size_t io = 64 * 1024;
+	vector<uint8_t> out(data.size());
+	array<double, 3> ms;
+	uint64_t c0 = DiskCalls;
+	double t0 = NowUs();
+	if (f.secure_open((char*)path.c_str(), SEFILE_WRITE, SEFILE_NEWFILE))
+		throw runtime_error("secure_open");
+	for (size_t off = 0; off < data.size(); off += io) {
+		if (f.secure_write((uint8_t*)data.data() + off, (uint32_t)min(io, data.size() - off)))
+			throw runtime_error("secure_write");
+	}
+	f.secure_close();
+	ms[0] = (NowUs() - t0) / 1e3;
+	calls[0] += DiskCalls - c0;
+	c0 = DiskCalls;
+	t0 = NowUs();
+	if (f.secure_open((char*)path.c_str(), SEFILE_READ, SEFILE_OPEN))
+		throw runtime_error("secure_open");
+	for (size_t off = 0; off < out.size(); off += io) {
+		uint32_t n = 0;
+		if (f.secure_read(out.data() + off, (uint32_t)min(io, out.size() - off), &n))
+			throw runtime_error("secure_read");
+	}
+	f.secure_close();
+	ms[1] = (NowUs() - t0) / 1e3;
+	calls[1] += DiskCalls - c0;
+	c0 = DiskCalls;
+	t0 = NowUs();
+	if (secure_recrypt(path, KEY_ID, &l1))
+		throw runtime_error("secure_recrypt");
+	ms[2] = (NowUs() - t0) / 1e3;
+	calls[2] += DiskCalls - c0;
+	l1.L1ResetLatencyHistograms();
+	if (out != data)
+		throw runtime_error("secure_read mismatch");
+	return ms;
+}
+
+/* writes and reads back data in a file with sectors of sectorSize bytes, 64 KiB per call */
+static bool WriteRead(SEfile& f, L1& l1, const string& path, uint32_t sectorSize, const vector<uint8_t>& data) {
+	const size_t io = 64 * 1024;
+	vector<uint8_t> out(data.size());
+	double size = (double)data.size();
+	char encName[MAX_PATHNAME] = { 0 };
+	struct stat st;
+	printf("%-28u", sectorSize);
+	if (f.secure_open((char*)path.c_str(), SEFILE_WRITE, SEFILE_NEWFILE, sectorSize))
+		throw runtime_error("secure_open");
+	for (size_t off = 0; off < data.size(); off += io) {
+		if (f.secure_write((uint8_t*)data.data() + off, (uint32_t)min(io, data.size() - off)))
+			throw runtime_error("secure_write");
+	}
+	f.secure_close();
+	printf("%16.1f", size / Commands(l1));
+	l1.L1ResetLatencyHistograms();
+	if (f.secure_open((char*)path.c_str(), SEFILE_READ, SEFILE_OPEN))
+		throw runtime_error("secure_open");
+	for (size_t off = 0; off < out.size(); off += io) {
+		uint32_t n = 0;
+		if (f.secure_read(out.data() + off, (uint32_t)min(io, out.size() - off), &n))
+			throw runtime_error("secure_read");
+	}
+	f.secure_close();
+	printf("%16.1f", size / Commands(l1));
+	l1.L1ResetLatencyHistograms();
+	crypto_filename((char*)path.c_str(), encName, NULL);
+	if (stat(encName, &st))
+		throw runtime_error("stat");
+	printf("%13.2f%%", 100.0 * (st.st_size - size) / size);
+	//a byte changed anywhere in the first sector must fail the read, also in the chunks of a sector larger than a CRYPTO_UPDATE
+	bool signedAll = true;
+	for (uint32_t off = 0; off + SEFILE_SECTOR_OVERHEAD < sectorSize; off += 1024) {
+		FILE* raw = fopen(encName, "r+b");
+		uint8_t byte = 0, buf[16];
+		uint32_t n = 0;
+		if ((raw == NULL) || fseek(raw, SEFILE_SECTOR_SIZE + off, SEEK_SET) || (fread(&byte, 1, 1, raw) != 1))
+			throw runtime_error("fopen");
+		byte ^= 1;
+		fseek(raw, SEFILE_SECTOR_SIZE + off, SEEK_SET);
+		fwrite(&byte, 1, 1, raw);
+		fflush(raw);
+		if (f.secure_open((char*)path.c_str(), SEFILE_READ, SEFILE_OPEN))
+			throw runtime_error("secure_open");
+		signedAll = (f.secure_read(buf, sizeof(buf), &n) != 0) && signedAll;
+		f.secure_close();
+		byte ^= 1;
+		fseek(raw, SEFILE_SECTOR_SIZE + off, SEEK_SET);
+		fwrite(&byte, 1, 1, raw);
+		fclose(raw);
+	}
+	l1.L1ResetLatencyHistograms();
+	printf("%12s\n", signedAll ? "yes" : "NO");
+	return (out == data) && signedAll;
+}
+
+int main(int argc, char* argv[]) {
+	size_t mib = (argc > 1) ? atoi(argv[1]) : 1;
+	string dir = (argc > 2) ? argv[2] : "/tmp";
+	uint32_t diskUs = (argc > 3) ? atoi(argv[3]) : 1000;
+	size_t nSectors = mib * 1024 * 1024 / SEFILE_LOGIC_DATA;
+	double size = (double)nSectors * SEFILE_LOGIC_DATA / (1024 * 1024);
+	array<uint8_t, L1Parameters::Size::PIN> pin{};
+	uint8_t nonceCtr[SEFILE_BLOCK_SIZE], noncePbkdf2[SEFILE_NONCE_LEN];
+	unique_ptr<SEFILE_SECTOR[]> clear(new SEFILE_SECTOR[nSectors]), single(new SEFILE_SECTOR[nSectors]);
+	unique_ptr<SEFILE_SECTOR[]> batch(new SEFILE_SECTOR[nSectors]), back(new SEFILE_SECTOR[nSectors]);
+	for (size_t i = 0; i < nSectors; i++) {
+		for (size_t j = 0; j < SEFILE_LOGIC_DATA; j++)
+			clear[i].data[j] = (uint8_t)(i * 31 + j);
+		clear[i].len = SEFILE_LOGIC_DATA;
+	}
+	memset(nonceCtr, 0xA5, sizeof(nonceCtr));
+	memset(noncePbkdf2, 0x5A, sizeof(noncePbkdf2));
+
+	try {
+		L1 l1;
+		l1.L1Login(pin, SE3_ACCESS_USER, true);
+		SEfile f;
+		if (f.secure_init(&l1, KEY_ID, L1Algorithms::Algorithms::AES_HMACSHA256)) {
+			printf("cannot use key %u\n", KEY_ID);
+			return 1;
+		}
+		printf("%zu sectors, up to %u per CRYPTO_UPDATE\n", nSectors, f.EnvBatch);
+		printf("%-28s%16s%14s\n", "", "round trips/MiB", "MiB/s");
+		l1.L1ResetLatencyHistograms();
+
+		double t0 = NowUs();
+		for (size_t i = 0; i < nSectors; i++) {
+			if (f.crypt_sectors(&clear[i], &single[i], SEFILE_SECTOR_DATA_SIZE, i * (SEFILE_SECTOR_DATA_SIZE / SEFILE_BLOCK_SIZE), nonceCtr, noncePbkdf2))
+				throw runtime_error("crypt_sectors");
+		}
+		Report("crypt_sectors", l1, size, t0);
+		t0 = NowUs();
+		for (size_t i = 0; i < nSectors; i++) {
+			if (f.decrypt_sectors(&single[i], &back[i], SEFILE_SECTOR_DATA_SIZE, i * (SEFILE_SECTOR_DATA_SIZE / SEFILE_BLOCK_SIZE), nonceCtr, noncePbkdf2))
+				throw runtime_error("decrypt_sectors");
+		}
+		Report("decrypt_sectors", l1, size, t0);
+
+		t0 = NowUs();
+		if (f.crypt_sector_batch(clear.get(), batch.get(), nSectors, SEFILE_SECTOR_SIZE, 0, nonceCtr, noncePbkdf2, CryptoInitialisation::Direction::ENCRYPT))
+			throw runtime_error("crypt_sector_batch");
+		Report("crypt_sector_batch (enc)", l1, size, t0);
+		t0 = NowUs();
+		if (f.crypt_sector_batch(batch.get(), back.get(), nSectors, SEFILE_SECTOR_SIZE, 0, nonceCtr, noncePbkdf2, CryptoInitialisation::Direction::DECRYPT))
+			throw runtime_error("crypt_sector_batch");
+		Report("crypt_sector_batch (dec)", l1, size, t0);
+		bool match = memcmp(single.get(), batch.get(), nSectors * sizeof(SEFILE_SECTOR)) == 0;
+		for (size_t i = 0; i < nSectors && match; i++) {
+			match = (memcmp(back[i].data, clear[i].data, SEFILE_LOGIC_DATA) == 0) && (memcmp(back[i].signature, batch[i].signature, B5_SHA256_DIGEST_SIZE) == 0);
+		}
+
+		//whole file, 64 KiB per call
+		string path = dir + "/sefile_bench.bin";
+		vector<uint8_t> data(nSectors * SEFILE_LOGIC_DATA), out(data.size());
+		for (size_t i = 0; i < data.size(); i++)
+			data[i] = (uint8_t)(i * 13);
+		const size_t io = 64 * 1024;
+		t0 = NowUs();
+		if (f.secure_open((char*)path.c_str(), SEFILE_WRITE, SEFILE_NEWFILE))
+			throw runtime_error("secure_open");
+		for (size_t off = 0; off < data.size(); off += io) {
+			if (f.secure_write(data.data() + off, (uint32_t)min(io, data.size() - off)))
+				throw runtime_error("secure_write");
+		}
+		f.secure_close();
+		Report("secure_write", l1, size, t0);
+		t0 = NowUs();
+		if (f.secure_open((char*)path.c_str(), SEFILE_READ, SEFILE_OPEN))
+			throw runtime_error("secure_open");
+		for (size_t off = 0; off < out.size(); off += io) {
+			uint32_t n = 0;
+			if (f.secure_read(out.data() + off, (uint32_t)min(io, out.size() - off), &n))
+				throw runtime_error("secure_read");
+		}
+		f.secure_close();
+		Report("secure_read", l1, size, t0);
+		match = match && (out == data);
+
+		//the same file, 100 bytes per call
+		const size_t small = 100;
+		t0 = NowUs();
+		if (f.secure_open((char*)path.c_str(), SEFILE_WRITE, SEFILE_NEWFILE))
+			throw runtime_error("secure_open");
+		for (size_t off = 0; off < data.size(); off += small) {
+			if (f.secure_write(data.data() + off, (uint32_t)min(small, data.size() - off)))
+				throw runtime_error("secure_write");
+		}
+		f.secure_close();
+		Report("secure_write (100 B)", l1, size, t0);
+		t0 = NowUs();
+		if (f.secure_open((char*)path.c_str(), SEFILE_READ, SEFILE_OPEN))
+			throw runtime_error("secure_open");
+		for (size_t off = 0; off < out.size(); off += small) {
+			uint32_t n = 0;
+			if (f.secure_read(out.data() + off, (uint32_t)min(small, out.size() - off), &n))
+				throw runtime_error("secure_read");
+		}
+		f.secure_close();
+		Report("secure_read (100 B)", l1, size, t0);
+		match = match && (out == data);
+
+		//size of the file, recorded in its header
+		uint32_t length = 0;
+		for (int i = 0; i < 10; i++) {
+			if (secure_getfilesize((char*)path.c_str(), &length, &l1) || (length != data.size()))
+				throw runtime_error("secure_getfilesize");
+		}
+		printf("%-28s%16.1f   (round trips/call)\n", "secure_getfilesize", Commands(l1) / 10.0);
+		l1.L1ResetLatencyHistograms();
+
+		//the same file encrypted again, in path + ".reencryptedsefile"
+		t0 = NowUs();
+		if (secure_recrypt(path, KEY_ID, &l1))
+			throw runtime_error("secure_recrypt");
+		Report("secure_recrypt", l1, size, t0);
+		if (f.secure_open((char*)(path + ".reencryptedsefile").c_str(), SEFILE_READ, SEFILE_OPEN))
+			throw runtime_error("secure_open");
+		for (size_t off = 0; off < out.size(); off += io) {
+			uint32_t n = 0;
+			if (f.secure_read(out.data() + off, (uint32_t)min(io, out.size() - off), &n))
+				throw runtime_error("secure_read");
+		}
+		f.secure_close();
+		l1.L1ResetLatencyHistograms();
+		match = match && (out == data);
+
+		printf("\n%-28s%16s%16s%14s%12s\n", "sector size", "write B/trip", "read B/trip", "on disk", "all signed");
+		for (uint32_t sectorSize : { (uint32_t)SEFILE_SECTOR_SIZE, 4096u, 16384u, 65536u })
+			match = WriteRead(f, l1, path, sectorSize, data) && match;
+
+		//disk calls delayed by diskUs, best of 3 runs
+		uint64_t calls[3] = { 0, 0, 0 };
+		array<double, 3> base = Timed(f, l1, path, data, calls), slow;
+		for (int i = 0; i < 2; i++) {
+			array<double, 3> t = Timed(f, l1, path, data, calls);
+			for (size_t s = 0; s < 3; s++)
+				base[s] = min(base[s], t[s]);
+		}
+		DiskLatencyUs = diskUs;
+		calls[0] = calls[1] = calls[2] = 0;
+		slow = Timed(f, l1, path, data, calls);
+		for (int i = 0; i < 2; i++) {
+			array<double, 3> t = Timed(f, l1, path, data, calls);
+			for (size_t s = 0; s < 3; s++)
+				slow[s] = min(slow[s], t[s]);
+		}
+		DiskLatencyUs = 0;
+		printf("\n%u us per disk call%12s%12s%12s%12s%10s\n", diskUs, "calls", "no delay ms", "serial ms", "measured ms", "speedup");
+		const char* names[3] = { "secure_write", "secure_read", "secure_recrypt" };
+		for (size_t s = 0; s < 3; s++) {
+			double disk = calls[s] / 3.0 * diskUs / 1e3, serial = base[s] + disk;
+			printf("%-28s%12.0f%12.1f%12.1f%12.1f%9.2fx\n", names[s], calls[s] / 3.0, base[s], serial, slow[s], serial / slow[s]);
+		}
+		printf("results: %s\n", match ? "MATCH" : "MISMATCH");
+		return match ? 0 : 1;
+	}
+	catch (exception& e) {
+		printf("error: %s\n", e.what());
+		return 1;
+	}
+}
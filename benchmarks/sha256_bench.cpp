@@ -0,0 +1,177 @@
+/**
+ * Benchmark of the implementations of B5_Sha256 (portable B5_Sha256ProcessBlock, AVX2 multi-buffer, SHA-NI), in cycles per byte.
+ *
+ * Every implementation supported by the CPU is first checked against the portable one: single messages of every
+ * length up to 1 KiB fed in random chunks, 8 messages at a time through the multi-buffer functions, and HMAC.
+ * Then it hashes an 8 KiB buffer (the size of an L1 payload), 8 such buffers with B5_Sha256_UpdateMulti(), and
+ * 8 HMACs of a digest as in the PBKDF2 iterations. Cycles are read with RDTSC (reference cycles on some CPUs).
+ *
+ * Build (from the repository root, Linux x86):
+ *   gcc -O2 -c "SEcube_utilities_backend/sources/L1/Crypto Libraries/sha256.c" -o sha256.o
+ *   g++ -std=c++17 -O2 -I SEcube_utilities_backend/sources -o sha256_bench benchmarks/sha256_bench.cpp sha256.o \
+ *       "SEcube_utilities_backend/sources/L1/Crypto Libraries/sha256_ni.cpp"
+ * Run:
+ *   ./sha256_bench [iterations]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <x86intrin.h>
+#include "L1/Crypto Libraries/pbkdf2.h"
+
+using namespace std;
+
+static const int32_t LEN = 8192;
+static const int32_t LANES = B5_SHA256_LANES;
+
+static void Digest(const uint8_t* in, int32_t len, mt19937& rng, uint8_t* out) {
+	B5_tSha256Ctx ctx;
+	B5_Sha256_Init(&ctx);
+	for (int32_t done = 0; done < len;) {
+		int32_t c = min<int32_t>(len - done, rng() % 150);
+		B5_Sha256_Update(&ctx, in + done, c);
+		done += c;
+	}
+	B5_Sha256_Finit(&ctx, out);
+}
+
+/* lanes of the same length, to use the multi-buffer path, or different lengths, to exercise the fallback */
+static void DigestMulti(const uint8_t* in, int32_t len, bool sameLen, uint8_t out[][B5_SHA256_DIGEST_SIZE]) {
+	B5_tSha256Ctx ctx[LANES];
+	B5_tSha256Ctx* p[LANES];
+	const uint8_t* d[LANES];
+	uint8_t* o[LANES];
+	for (int32_t j = 0; j < LANES; j++) {
+		B5_Sha256_Init(&ctx[j]);
+		if (!sameLen)
+			B5_Sha256_Update(&ctx[j], in, j);
+		p[j] = &ctx[j];
+		d[j] = in + 3 * j;
+		o[j] = out[j];
+	}
+	for (int32_t c = 1; c <= len; c += c) {
+		B5_Sha256_UpdateMulti(p, d, c, LANES);
+		for (int32_t j = 0; j < LANES; j++)
+			d[j] += c;
+	}
+	B5_Sha256_FinitMulti(p, o, LANES);
+}
+
+static void HmacMulti(const uint8_t* key, const uint8_t* in, uint8_t out[][B5_SHA256_DIGEST_SIZE], int n) {
+	B5_tHmacSha256Ctx start, ctx[LANES];
+	B5_tHmacSha256Ctx* p[LANES];
+	const uint8_t* d[LANES];
+	uint8_t* o[LANES];
+	B5_HmacSha256_Init(&start, key, 32);
+	for (int i = 0; i < n; i++) {
+		for (int32_t j = 0; j < LANES; j++) {
+			ctx[j] = start;
+			p[j] = &ctx[j];
+			d[j] = in + B5_SHA256_DIGEST_SIZE * j;
+			o[j] = out[j];
+		}
+		B5_HmacSha256_UpdateMulti(p, d, B5_SHA256_DIGEST_SIZE, LANES);
+		B5_HmacSha256_FinitMulti(p, o, LANES);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	int n = (argc > 1) ? atoi(argv[1]) : 2000;
+	const char* impls[] = { "scalar", "AVX2", "SHA-NI" };
+	mt19937 rng(1);
+	vector<uint8_t> in(LANES * LEN + 64);
+	uint8_t ref[LANES][B5_SHA256_DIGEST_SIZE], out[LANES][B5_SHA256_DIGEST_SIZE], key[32];
+	const uint8_t abc[B5_SHA256_DIGEST_SIZE] = {
+		0xBA, 0x78, 0x16, 0xBF, 0x8F, 0x01, 0xCF, 0xEA, 0x41, 0x41, 0x40, 0xDE, 0x5D, 0xAE, 0x22, 0x23,
+		0xB0, 0x03, 0x61, 0xA3, 0x96, 0x17, 0x7A, 0x9C, 0xB4, 0x10, 0xFF, 0x61, 0xF2, 0x00, 0x15, 0xAD
+	};
+
+	for (auto& b : in)
+		b = (uint8_t)rng();
+	for (auto& b : key)
+		b = (uint8_t)rng();
+
+	printf("%-16s%16s%16s%16s   (cycles/byte)\n", "", "8 KiB", "8x8 KiB multi", "8x HMAC(32 B)");
+	for (int32_t impl = B5_SHA256_IMPL_SCALAR; impl <= B5_SHA256_IMPL_SHANI; impl++) {
+		if (B5_Sha256_SetImpl(impl) != B5_SHA256_RES_OK)
+			continue;
+
+		/* correctness against the portable implementation */
+		B5_tSha256Ctx ctx;
+		B5_Sha256_Init(&ctx);
+		B5_Sha256_Update(&ctx, (const uint8_t*)"abc", 3);
+		B5_Sha256_Finit(&ctx, out[0]);
+		if (memcmp(out[0], abc, sizeof(abc))) {
+			printf("%s: wrong digest of \"abc\"\n", impls[impl]);
+			return 1;
+		}
+		for (int32_t len = 0; len <= 1024; len++) {
+			mt19937 r1(len), r2(len);
+			B5_Sha256_SetImpl(B5_SHA256_IMPL_SCALAR);
+			Digest(in.data(), len, r1, ref[0]);
+			B5_Sha256_SetImpl(impl);
+			Digest(in.data(), len, r2, out[0]);
+			if (memcmp(out[0], ref[0], B5_SHA256_DIGEST_SIZE)) {
+				printf("%s: digest of %d bytes differs from the scalar one\n", impls[impl], len);
+				return 1;
+			}
+		}
+		for (int sameLen = 0; sameLen < 2; sameLen++) {
+			B5_Sha256_SetImpl(B5_SHA256_IMPL_SCALAR);
+			DigestMulti(in.data(), 2000, sameLen, ref);
+			B5_Sha256_SetImpl(impl);
+			DigestMulti(in.data(), 2000, sameLen, out);
+			if (memcmp(out, ref, sizeof(ref))) {
+				printf("%s: multi-buffer digests differ from the scalar ones\n", impls[impl]);
+				return 1;
+			}
+		}
+		for (int32_t j = 0; j < LANES; j++) {
+			B5_tHmacSha256Ctx h;
+			B5_Sha256_SetImpl(B5_SHA256_IMPL_SCALAR);
+			B5_HmacSha256_Init(&h, key, 32);
+			B5_HmacSha256_Update(&h, in.data() + B5_SHA256_DIGEST_SIZE * j, B5_SHA256_DIGEST_SIZE);
+			B5_HmacSha256_Finit(&h, ref[j]);
+		}
+		B5_Sha256_SetImpl(impl);
+		HmacMulti(key, in.data(), out, 1);
+		if (memcmp(out, ref, sizeof(ref))) {
+			printf("%s: multi-buffer HMAC differs from the scalar one\n", impls[impl]);
+			return 1;
+		}
+
+		printf("%-16s", impls[impl]);
+		uint64_t t0 = __rdtsc();
+		for (int i = 0; i < n; i++) {
+			B5_Sha256_Init(&ctx);
+			B5_Sha256_Update(&ctx, in.data(), LEN);
+			B5_Sha256_Finit(&ctx, out[0]);
+		}
+		printf("%16.2f", (double)(__rdtsc() - t0) / ((double)n * LEN));
+
+		B5_tSha256Ctx mctx[LANES];
+		B5_tSha256Ctx* p[LANES];
+		const uint8_t* d[LANES];
+		uint8_t* o[LANES];
+		t0 = __rdtsc();
+		for (int i = 0; i < n / LANES + 1; i++) {
+			for (int32_t j = 0; j < LANES; j++) {
+				B5_Sha256_Init(&mctx[j]);
+				p[j] = &mctx[j];
+				d[j] = in.data() + LEN * j;
+				o[j] = out[j];
+			}
+			B5_Sha256_UpdateMulti(p, d, LEN, LANES);
+			B5_Sha256_FinitMulti(p, o, LANES);
+		}
+		printf("%16.2f", (double)(__rdtsc() - t0) / ((double)(n / LANES + 1) * LANES * LEN));
+
+		t0 = __rdtsc();
+		HmacMulti(key, in.data(), out, n);
+		printf("%16.2f\n", (double)(__rdtsc() - t0) / ((double)n * LANES * B5_SHA256_DIGEST_SIZE));
+	}
+	return 0;
+}
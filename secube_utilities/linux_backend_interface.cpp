@@ -48,4 +48,33 @@ int connectToBackend() {
 
     return sock;
 }
+
+/**
+ * This function creates a connection to the Backend running in daemon mode (secube_cmd.exe -daemon), if any.
+ *
+ * returns: socket ID, -1 if the daemon is not running
+ */
+int connectToDaemon() {
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+
+    struct sockaddr_in serv_addr;
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(daemon_port);
+    inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr);
+
+    // A single attempt, the daemon is either running or not:
+    if (::connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    cout << "[LOG] [GUI] Connected to backend daemon!" << endl;
+
+    return sock;
+}
 #endif
@@ -17,6 +17,7 @@
 #define STR_SIZE 300
 #define ARR_SIZE 20
 #define comm_port 1235 // The port used for the socket connection to the Backend
+#define daemon_port 1236 // The port used for the socket connection to the Backend running in daemon mode
 
 using namespace std;
 
@@ -83,8 +84,85 @@ struct Response_LIST_KEYS : Response_GENERIC
   }
 };
 
+/**
+ * Request struct sent to the Backend running in daemon mode.
+ * It contains the same command line that would be used to start the Backend, the daemon answers with the Response Struct of the
+ * requested utility.
+ */
+struct Request_DAEMON
+{
+  char cmd[ARR_SIZE*STR_SIZE]; // The command line (the arguments are separated by spaces, use " " for arguments containing spaces)
+
+  // This method lets cereal know which data members to serialize
+  template<class Archive>
+  void serialize(Archive & archive)
+  {
+    archive( cmd ); // serialize things by passing them to the archive
+  }
+};
+
 int connectToBackend();
 
+/**
+ * This function creates a connection to the Backend running in daemon mode (secube_cmd.exe -daemon), if any.
+ *
+ * returns: socket ID, -1 if the daemon is not running
+ */
+int connectToDaemon();
+
+/**
+ * This function sends the command to the Backend running in daemon mode and waits for its Response.
+ * The daemon keeps the SEcube session and SEkey open, so the utility is performed without starting a new Backend process.
+ *
+ * Returns: true if the Response was received from the daemon, false if the daemon is not running or in case of error
+ */
+template <class Response>
+bool sendRequestToDaemon(string cmd, Response& resp) {
+
+    int sock = connectToDaemon();
+    if (sock < 0) {
+        return false;
+    }
+
+    // Serialize the Request using Cereal and send it:
+    Request_DAEMON req;
+    memset(req.cmd, 0, sizeof(req.cmd));
+    strncpy(req.cmd, cmd.c_str(), sizeof(req.cmd) - 1);
+    std::stringstream ss;
+    {
+        cereal::BinaryOutputArchive oarchive(ss); // Create an output archive
+        oarchive(req);
+    } // archive goes out of scope, ensuring all contents are flushed
+    if (send(sock, ss.str().c_str(), ss.str().length(), 0) < 0) {
+        close(sock);
+        return false;
+    }
+
+    // Wait for Response from the daemon:
+    char reply[BUFLEN] = {0};
+    int res = recv(sock, reply, BUFLEN, MSG_WAITALL); // The daemon closes the connection after the Response
+    bool received = (res > 0);
+    if (!received) {
+        cout << "[LOG] [GUI] Error reading response from the backend daemon!" << endl;
+        resp.err_code = -1;
+        string err_msg = "No response from the Backend!";
+        strcpy(resp.err_msg, err_msg.c_str());
+    } else {
+        cout << "[LOG] [GUI] Received " << res << " bytes from the backend daemon." << endl;
+
+        // Deserialize the Response using Cereal:
+        std::stringstream in;
+        in.write((char*)reply, res);
+        cereal::BinaryInputArchive iarchive(in);
+        iarchive(resp); // Read the data from the archive
+    }
+
+    // Close the socket:
+    close(sock);
+
+    return true;
+}
+
 /**
  * This function creates a process in background for running the Backend application. The utility function performed by the
  * backend depends on the cmd input parameter.
@@ -100,6 +178,11 @@ Response sendRequestToBackend(string cmd) {
     Response resp;
     pid_t child_pid;
 
+    // If the Backend is running in daemon mode, there is no need to start a new Backend process:
+    if (sendRequestToDaemon<Response>(cmd, resp)) {
+        return resp;
+    }
+
     // Check if the Backend application can be found:
     if ( access("./secube_cmd.exe", F_OK)!=0 ) {
         // In case of error tryng to run the Backend application: